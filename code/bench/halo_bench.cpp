@@ -0,0 +1,160 @@
+static char help[] ="Latency benchmark of the halo exchanges selected by use_custom_sc.";
+
+/**
+* Exchanges the ghost points of a local vector of a 2D DMDA of N x N points with dof components and stencil width
+* sw, distributed over all ranks, with each halo exchange type (use_custom_sc = 0, 1, 2, see
+* scatter_ctx/halo_exchange.h), and reports the time per exchange. After the timing, the ghost points across the
+* edges of the local domain are checked against the owned points of the neighbors.
+*
+* Options:
+* -sizes N1,N2,...   - Global grid sizes N (default 256,1024,4096)
+* -dof d             - Number of components (default 3)
+* -sw s              - Stencil width of the DMDA (default 3)
+* -halo_types t1,... - Halo exchange types to benchmark (default 0,1,2)
+* -soa               - Use the component-major ordering of the local vectors (HALO_PETSC is then HALO_CUSTOM)
+* -exchanges n       - Exchanges per repetition (default 1000)
+* -reps r            - Repetitions per type, the minimum time is reported (default 3)
+* -bench_output file - CSV output file (default stdout)
+*
+* Each type is reported as a CSV line: halo,layout,N,dof,sw,ranks,seconds_per_exchange
+* The time is the time of the slowest rank for halo_exchange_begin directly followed by halo_exchange_end, i.e the
+* latency of an exchange without overlapping computation.
+**/
+
+#include <petsc.h>
+#include <algorithm>
+#include "scatter_ctx/halo_exchange.h"
+
+struct BenchCtx {
+  FILE *fp;
+  PetscInt reps, exchanges, dof, sw;
+  PetscBool soa;
+};
+
+static const char* halo_names[] = {"petsc", "custom", "neighbor"};
+
+/**
+* Index of component c of the local point (i,j) in the local array of size lnx x lny.
+**/
+static inline PetscInt local_index(const BenchCtx& bench, const PetscInt lnx, const PetscInt lny, const PetscInt i,
+                                   const PetscInt j, const PetscInt c)
+{
+  return bench.soa ? (c*lny + j)*lnx + i : (j*lnx + i)*bench.dof + c;
+}
+
+/**
+* Sets each owned value of the local vector to its index in the natural ordering, and the ghost values to -1.
+* If check is true, instead counts the ghost values across the edges of the local domain that differ from this.
+**/
+static PetscInt fill_or_check(const BenchCtx& bench, DM da, Vec vlocal, const PetscInt N, const bool check)
+{
+  PetscScalar *arr;
+  PetscInt    i_start, j_start, n_i, n_j, ig_start, jg_start, lnx, lny, n_wrong = 0;
+
+  DMDAGetCorners(da,&i_start,&j_start,NULL,&n_i,&n_j,NULL);
+  DMDAGetGhostCorners(da,&ig_start,&jg_start,NULL,&lnx,&lny,NULL);
+  VecGetArray(vlocal,&arr);
+  for (PetscInt j = jg_start; j < jg_start + lny; j++) {
+    for (PetscInt i = ig_start; i < ig_start + lnx; i++) {
+      const bool owned_i = i >= i_start && i < i_start + n_i;
+      const bool owned_j = j >= j_start && j < j_start + n_j;
+      for (PetscInt c = 0; c < bench.dof; c++) {
+        PetscScalar& value = arr[local_index(bench,lnx,lny,i-ig_start,j-jg_start,c)];
+        const PetscScalar expected = (j*N + i)*bench.dof + c;
+        if (!check) value = (owned_i && owned_j) ? expected : -1;
+        else if (owned_i != owned_j && value != expected) n_wrong++;
+      }
+    }
+  }
+  VecRestoreArray(vlocal,&arr);
+  return n_wrong;
+}
+
+/**
+* Runs the benchmark of all types for an N x N grid.
+**/
+PetscErrorCode bench_size(const BenchCtx& bench, const PetscInt N, const PetscInt *types, const PetscInt n_types)
+{
+  PetscErrorCode ierr;
+  DM             da;
+  Vec            vlocal;
+  PetscMPIInt    size;
+
+  MPI_Comm_size(PETSC_COMM_WORLD,&size);
+  ierr = DMDACreate2d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DMDA_STENCIL_STAR,N,N,PETSC_DECIDE,PETSC_DECIDE,
+                      bench.dof,bench.sw,NULL,NULL,&da);CHKERRQ(ierr);
+  ierr = DMSetFromOptions(da);CHKERRQ(ierr);
+  ierr = DMSetUp(da);CHKERRQ(ierr);
+  ierr = DMCreateLocalVector(da,&vlocal);CHKERRQ(ierr);
+
+  for (PetscInt t = 0; t < n_types; t++) {
+    HaloCtx        halo;
+    PetscLogDouble t0, t1, t_min = PETSC_MAX_REAL;
+
+    ierr = halo_ctx_create(da,(HaloType) types[t],bench.soa,halo);CHKERRQ(ierr);
+    fill_or_check(bench,da,vlocal,N,false);
+    for (PetscInt r = 0; r < bench.reps; r++) {
+      ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRQ(ierr);
+      ierr = PetscTime(&t0);CHKERRQ(ierr);
+      for (PetscInt e = 0; e < bench.exchanges; e++) {
+        ierr = halo_exchange_begin(halo,vlocal);CHKERRQ(ierr);
+        ierr = halo_exchange_end(halo,vlocal);CHKERRQ(ierr);
+      }
+      ierr = PetscTime(&t1);CHKERRQ(ierr);
+      PetscLogDouble t_exchange = (t1 - t0)/bench.exchanges, t_max;
+      MPI_Allreduce(&t_exchange,&t_max,1,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);
+      t_min = std::min(t_min, t_max);
+    }
+    PetscInt n_wrong = fill_or_check(bench,da,vlocal,N,true);
+    MPI_Allreduce(MPI_IN_PLACE,&n_wrong,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD);
+    ierr = halo_ctx_destroy(halo);CHKERRQ(ierr);
+    if (n_wrong) {
+      PetscPrintf(PETSC_COMM_WORLD,"Error: %d wrong ghost values with halo type %s.\n",n_wrong,halo_names[types[t]]);
+      return -1;
+    }
+    ierr = PetscFPrintf(PETSC_COMM_WORLD,bench.fp,"%s,%s,%d,%d,%d,%d,%e\n",halo_names[types[t]],bench.soa ? "soa" : "aos",
+                        N,bench.dof,bench.sw,size,t_min);CHKERRQ(ierr);
+  }
+
+  ierr = VecDestroy(&vlocal);CHKERRQ(ierr);
+  ierr = DMDestroy(&da);CHKERRQ(ierr);
+  return 0;
+}
+
+int main(int argc,char **argv)
+{
+  PetscErrorCode ierr;
+  BenchCtx       bench;
+  PetscInt       sizes[32] = {256, 1024, 4096}, n_sizes = 32, types[3] = {0, 1, 2}, n_types = 3;
+  char           output[PETSC_MAX_PATH_LEN] = "stdout";
+  PetscBool      set_sizes, set_types;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  bench.reps = 3;
+  bench.exchanges = 1000;
+  bench.dof = 3;
+  bench.sw = 3;
+  bench.soa = PETSC_FALSE;
+  ierr = PetscOptionsGetIntArray(NULL,NULL,"-sizes",sizes,&n_sizes,&set_sizes);CHKERRQ(ierr);
+  if (!set_sizes) n_sizes = 3;
+  ierr = PetscOptionsGetIntArray(NULL,NULL,"-halo_types",types,&n_types,&set_types);CHKERRQ(ierr);
+  if (!set_types) n_types = 3;
+  for (PetscInt t = 0; t < n_types; t++) {
+    if (types[t] < 0 || types[t] > 2) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"-halo_types must be 0, 1 or 2");
+  }
+  ierr = PetscOptionsGetInt(NULL,NULL,"-dof",&bench.dof,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetInt(NULL,NULL,"-sw",&bench.sw,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetBool(NULL,NULL,"-soa",&bench.soa,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetInt(NULL,NULL,"-exchanges",&bench.exchanges,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetInt(NULL,NULL,"-reps",&bench.reps,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetString(NULL,NULL,"-bench_output",output,sizeof(output),NULL);CHKERRQ(ierr);
+
+  ierr = PetscFOpen(PETSC_COMM_WORLD,output,"w",&bench.fp);CHKERRQ(ierr);
+  ierr = PetscFPrintf(PETSC_COMM_WORLD,bench.fp,"halo,layout,N,dof,sw,ranks,seconds_per_exchange\n");CHKERRQ(ierr);
+  for (PetscInt s = 0; s < n_sizes; s++) {
+    ierr = bench_size(bench, sizes[s], types, n_types);CHKERRQ(ierr);
+  }
+  ierr = PetscFClose(PETSC_COMM_WORLD,bench.fp);CHKERRQ(ierr);
+  ierr = PetscFinalize();
+  return ierr;
+}
@@ -0,0 +1,148 @@
+static char help[] ="Bandwidth benchmark of the MPI-IO output format against VecView.";
+
+/**
+* Writes a 2D DMDA global vector of N x N points with dof components, distributed over all ranks, with
+* write_vector_to_binary (PETSc binary viewer, VecView) and with mpiio::write (collective MPI-IO), and reports the
+* write bandwidth of each. The MPI-IO file is then mapped on rank 0 with mpiio::map and checked.
+*
+* Options:
+* -sizes N1,N2,...   - Global grid sizes N (default 1024,2048,4096)
+* -dof d             - Number of components (default 3)
+* -reps r            - Repetitions per format, the minimum time is reported (default 3)
+* -io_folder folder  - Output folder, on the file system to benchmark (default data/io_bench)
+* -bench_output file - CSV output file (default stdout)
+*
+* Each format is reported as a CSV line: format,N,dof,ranks,bytes,seconds,gbs
+* The time is the time of the slowest rank, including opening and closing the file.
+**/
+
+#include <petsc.h>
+#include <filesystem>
+#include <string>
+#include "util/io_util.h"
+#include "util/mpiio.h"
+
+struct BenchCtx {
+  FILE *fp;
+  PetscInt reps;
+  std::string folder;
+};
+
+/**
+* Times f, taking the minimum over bench.reps repetitions, and writes a CSV line.
+**/
+template <typename F>
+PetscErrorCode time_write(const BenchCtx& bench, const char *format, const PetscInt N, const PetscInt dof, F&& f)
+{
+  PetscErrorCode ierr;
+  PetscMPIInt    size;
+  PetscLogDouble t0, t1, t_min = PETSC_MAX_REAL;
+  const PetscLogDouble bytes = (PetscLogDouble) N*N*dof*sizeof(PetscScalar);
+
+  MPI_Comm_size(PETSC_COMM_WORLD,&size);
+  for (PetscInt r = 0; r < bench.reps; r++) {
+    ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRQ(ierr);
+    ierr = PetscTime(&t0);CHKERRQ(ierr);
+    ierr = f();CHKERRQ(ierr);
+    ierr = PetscTime(&t1);CHKERRQ(ierr);
+    PetscLogDouble t = t1 - t0, t_max;
+    MPI_Allreduce(&t,&t_max,1,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);
+    t_min = std::min(t_min, t_max);
+  }
+  ierr = PetscFPrintf(PETSC_COMM_WORLD,bench.fp,"%s,%d,%d,%d,%.0f,%e,%f\n",format,N,dof,size,bytes,t_min,
+                      1e-9*bytes/t_min);CHKERRQ(ierr);
+  return 0;
+}
+
+/**
+* Checks on rank 0 that the mapped MPI-IO file holds the values set by bench_size.
+**/
+PetscErrorCode check_file(const std::string path, const PetscInt N, const PetscInt dof)
+{
+  PetscErrorCode    ierr;
+  PetscMPIInt       rank;
+  mpiio::MappedFile f;
+  PetscInt          n_wrong = 0;
+
+  MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+  if (rank == 0) {
+    ierr = mpiio::map(path,f);CHKERRQ(ierr);
+    if (f.header->N[0] != N || f.header->N[1] != N || f.header->dof != dof) n_wrong++;
+    for (PetscInt j = 0; j < N; j++) {
+      for (PetscInt i = 0; i < N; i++) {
+        for (PetscInt c = 0; c < dof; c++) {
+          if (mpiio::value(f,i,j,0,c) != (PetscScalar) ((j*N + i)*dof + c)) n_wrong++;
+        }
+      }
+    }
+    ierr = mpiio::unmap(f);CHKERRQ(ierr);
+    if (n_wrong) PetscPrintf(PETSC_COMM_SELF,"Error: %d wrong values in %s.\n",n_wrong,path.c_str());
+  }
+  MPI_Bcast(&n_wrong,1,MPIU_INT,0,PETSC_COMM_WORLD);
+  return n_wrong ? -1 : 0;
+}
+
+/**
+* Runs the benchmark for an N x N grid with dof components.
+**/
+PetscErrorCode bench_size(const BenchCtx& bench, const PetscInt N, const PetscInt dof)
+{
+  PetscErrorCode ierr;
+  DM             da;
+  Vec            v;
+  PetscScalar    ***arr;
+  PetscInt       i_start, j_start, n_i, n_j;
+
+  ierr = DMDACreate2d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DMDA_STENCIL_BOX,N,N,PETSC_DECIDE,PETSC_DECIDE,
+                      dof,1,NULL,NULL,&da);CHKERRQ(ierr);
+  ierr = DMSetFromOptions(da);CHKERRQ(ierr);
+  ierr = DMSetUp(da);CHKERRQ(ierr);
+  ierr = DMCreateGlobalVector(da,&v);CHKERRQ(ierr);
+
+  // Each value is its index in the natural ordering
+  ierr = DMDAGetCorners(da,&i_start,&j_start,NULL,&n_i,&n_j,NULL);CHKERRQ(ierr);
+  ierr = DMDAVecGetArrayDOF(da,v,&arr);CHKERRQ(ierr);
+  for (PetscInt j = j_start; j < j_start + n_j; j++) {
+    for (PetscInt i = i_start; i < i_start + n_i; i++) {
+      for (PetscInt c = 0; c < dof; c++) arr[j][i][c] = (j*N + i)*dof + c;
+    }
+  }
+  ierr = DMDAVecRestoreArrayDOF(da,v,&arr);CHKERRQ(ierr);
+
+  const std::string file = "v_" + std::to_string(N);
+  ierr = time_write(bench,"vecview",N,dof,[&]() { return write_vector_to_binary(v,bench.folder,file); });CHKERRQ(ierr);
+  ierr = time_write(bench,"mpiio",N,dof,[&]() { return mpiio::write(da,v,bench.folder,file+".sbp",{0,0}); });CHKERRQ(ierr);
+  ierr = check_file(bench.folder+"/"+file+".sbp",N,dof);CHKERRQ(ierr);
+
+  ierr = VecDestroy(&v);CHKERRQ(ierr);
+  ierr = DMDestroy(&da);CHKERRQ(ierr);
+  return 0;
+}
+
+int main(int argc,char **argv)
+{
+  PetscErrorCode ierr;
+  BenchCtx       bench;
+  PetscInt       sizes[32] = {1024, 2048, 4096}, n_sizes = 32, dof = 3;
+  char           output[PETSC_MAX_PATH_LEN] = "stdout", folder[PETSC_MAX_PATH_LEN] = "data/io_bench";
+  PetscBool      set_sizes;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  bench.reps = 3;
+  ierr = PetscOptionsGetIntArray(NULL,NULL,"-sizes",sizes,&n_sizes,&set_sizes);CHKERRQ(ierr);
+  if (!set_sizes) n_sizes = 3;
+  ierr = PetscOptionsGetInt(NULL,NULL,"-dof",&dof,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetInt(NULL,NULL,"-reps",&bench.reps,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetString(NULL,NULL,"-io_folder",folder,sizeof(folder),NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetString(NULL,NULL,"-bench_output",output,sizeof(output),NULL);CHKERRQ(ierr);
+  bench.folder = folder;
+
+  ierr = PetscFOpen(PETSC_COMM_WORLD,output,"w",&bench.fp);CHKERRQ(ierr);
+  ierr = PetscFPrintf(PETSC_COMM_WORLD,bench.fp,"format,N,dof,ranks,bytes,seconds,gbs\n");CHKERRQ(ierr);
+  for (PetscInt s = 0; s < n_sizes; s++) {
+    ierr = bench_size(bench, sizes[s], dof);CHKERRQ(ierr);
+  }
+  ierr = PetscFClose(PETSC_COMM_WORLD,bench.fp);CHKERRQ(ierr);
+  ierr = PetscFinalize();
+  return ierr;
+}
@@ -0,0 +1,341 @@
+static char help[] ="Micro-benchmarks of the SBP operators and the partitioned RHS kernels.";
+
+/**
+* Times the apply functions of the SBP operators (D1_central, HI_central, H_central), the nine region kernels,
+* the boundary condition functions and full RHS evaluations of the homogeneous 2D acoustic wave equation
+* (demo/wave_hom), on a single rank for a sweep of subdomain sizes n x n and SBP orders. The full RHS evaluations of
+* the wave (demo/wave) and advection (demo/advection) demos are timed in both the interleaved and the component-major
+* layout, as kernels wave_rhs_serial_bc_aos|soa and advection_rhs_serial_bc_aos|soa (see sbp_bench_layouts.cpp).
+*
+* Options:
+* -sizes n1,n2,...   - Subdomain sizes (default 64,128,256,512,1024)
+* -orders o1,o2,...  - SBP orders (default 2,4,6, or the order of a single-order build)
+* -reps r            - Repetitions per kernel, the minimum time is reported (default 10)
+* -bench_output file - CSV output file (default stdout)
+* -simd_tol tol      - Tolerance of the SIMD row kernels against the scalar apply functions, relative to the largest
+*                      derivative (default 1e-12)
+*
+* Each kernel is reported as a CSV line: order,kernel,n,points,seconds,ns_per_point,gflops,gbs
+*
+* The SIMD row kernels (apply_x_interior_row, apply_y_interior_row, see sbpops/simd.h) are checked against the scalar
+* apply functions, and the largest difference is printed to stderr. The benchmark fails if it exceeds the tolerance.
+* The kernels perform the same operations in the same order, but with -ffast-math (COPTFLAGS of the Makefile) the
+* compiler may contract and reorder them differently in the two paths, so they agree within the tolerance rather than
+* bit for bit. Build with e.g make bench COPTFLAGS="-O3 -march=native" to check that they are bit-identical.
+* The flop count is the nominal count of the stencils (one multiply and one add per stencil weight), and the byte
+* count is the compulsory traffic, i.e each grid function value read and written once. The throughputs are thus
+* lower bounds of what the hardware executes, but are comparable between builds.
+**/
+
+#include <petsc.h>
+#include <array>
+#include <vector>
+#include <cmath>
+#include "wave_hom/wave_eq_hom_rhs.h"
+#include "sbpops/op_defs.h"
+#include "grids/grid_function.h"
+#include "partitioned_rhs/tiling.h"
+#include "util/threads.h"
+#include "sbp_bench.h"
+
+/**
+* Compares the values of the SIMD row kernel against the scalar apply function, computed into
+* simd and scalar, and prints the largest difference to stderr. Returns -1 if it exceeds the tolerance.
+**/
+PetscErrorCode check_simd(const BenchCtx& bench, const PetscInt order, const char *kernel, const PetscInt n,
+                          const std::vector<PetscScalar>& simd, const std::vector<PetscScalar>& scalar)
+{
+  PetscReal diff = 0, scale = 0;
+  bool      identical = true;
+  for (size_t p = 0; p < simd.size(); p++) {
+    diff = std::max(diff, (PetscReal) std::abs(simd[p] - scalar[p]));
+    scale = std::max(scale, (PetscReal) std::abs(scalar[p]));
+    identical = identical && simd[p] == scalar[p];
+  }
+  PetscFPrintf(PETSC_COMM_WORLD,PETSC_STDERR,"SIMD check order %d, n %d, %s: max |simd - scalar| = %e (relative %e)%s\n",
+               order,n,kernel,diff,scale > 0 ? diff/scale : diff,identical ? ", bit-identical" : "");
+  if (diff > bench.simd_tol*scale) {
+    PetscPrintf(PETSC_COMM_WORLD,"Error: %s differs from the scalar apply function beyond -simd_tol %e.\n",kernel,bench.simd_tol);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+* Runs the benchmarks of the operator set Ops on an n x n subdomain with 3 components.
+**/
+template <class Ops>
+PetscErrorCode bench_order(const BenchCtx& bench, const PetscInt n)
+{
+  PetscErrorCode ierr;
+  const typename Ops::FirstDerivativeOp D1;
+  const typename Ops::InverseNormOp HI;
+  const typename Ops::NormOp H;
+  const PetscInt order = Ops::order;
+  const PetscInt dofs = 3;
+  const PetscInt cls_sz = D1.closure_size();
+  const PetscInt ci = 2*D1.interior_stencil_width();  // flops of an interior stencil
+  const PetscInt cc = 2*D1.closure_stencil_width();   // flops of a closure stencil
+  const PetscInt n_int = n - 2*cls_sz;
+  const std::array<PetscScalar,2> hi = {(n-1)/2., (n-1)/2.};
+  const std::array<PetscScalar,2> h = {1./hi[0], 1./hi[1]};
+  const std::array<PetscScalar,2> xl = {-1, -1};
+  const std::array<PetscInt,2> ind = {0, n};
+  const std::array<PetscInt,2> ind_int = {cls_sz, n-cls_sz};
+  const std::array<PetscInt,2> no_tile = {0, 0};
+  std::array<PetscInt,2> tile;
+
+  if (n_int < 1) return 0;
+  ierr = tiling::get_tile_size(D1.interior_stencil_width(), dofs, tile);CHKERRQ(ierr);
+
+  std::vector<PetscScalar> q_arr(n*n*dofs), F_arr(n*n*dofs), row(n);
+  const grid::partitioned_layout_2d layout(grid::extents_2d(n,n,dofs),0,n,n);
+  auto q = grid::grid_function_2d<PetscScalar>(q_arr.data(), layout);
+  auto F = grid::grid_function_2d<PetscScalar>(F_arr.data(), layout);
+  for (PetscInt j = 0; j < n; j++) {
+    for (PetscInt i = 0; i < n; i++) {
+      for (PetscInt c = 0; c < dofs; c++) {
+        q(j,i,c) = sin(PETSC_PI*(c+1)*(i*h[0] + 2*j*h[1]));
+        F(j,i,c) = 0;
+      }
+    }
+  }
+
+  // Pointer arrays v[j][i][comp], as used by H_central
+  std::vector<PetscScalar*> ptr_i(n*n);
+  std::vector<PetscScalar**> ptr_j(n);
+  for (PetscInt j = 0; j < n; j++) {
+    for (PetscInt i = 0; i < n; i++) {
+      ptr_i[j*n+i] = &q(j,i,0);
+    }
+    ptr_j[j] = &ptr_i[j*n];
+  }
+  const PetscScalar *const *const *const v = ptr_j.data();
+
+  //=============================================================================
+  // D1_central
+  //=============================================================================
+  ierr = time_kernel(bench, order, "D1_x_left", n, n*cls_sz, cc, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = 0; i < cls_sz; i++)
+        F(j,i,0) = D1.apply_x_left(q, hi[0], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "D1_x_interior", n, n*n_int, ci, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = cls_sz; i < n-cls_sz; i++)
+        F(j,i,0) = D1.apply_x_interior(q, hi[0], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "D1_x_interior_row", n, n*n_int, ci, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++) {
+      D1.apply_x_interior_row(q, hi[0], ind_int, j, 2, row.data());
+      for (PetscInt i = cls_sz; i < n-cls_sz; i++)
+        F(j,i,0) = row[i-cls_sz];
+    }
+  });CHKERRQ(ierr);
+  {
+    std::vector<PetscScalar> scalar(n*n_int), simd(n*n_int);
+    for (PetscInt j = 0; j < n; j++) {
+      D1.apply_x_interior_row(q, hi[0], ind_int, j, 2, &simd[j*n_int]);
+      for (PetscInt i = cls_sz; i < n-cls_sz; i++)
+        scalar[j*n_int + i-cls_sz] = D1.apply_x_interior(q, hi[0], i, j, 2);
+    }
+    ierr = check_simd(bench, order, "D1_x_interior_row", n, simd, scalar);CHKERRQ(ierr);
+  }
+  ierr = time_kernel(bench, order, "D1_x_right", n, n*cls_sz, cc, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = n-cls_sz; i < n; i++)
+        F(j,i,0) = D1.apply_x_right(q, hi[0], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "D1_y_left", n, n*cls_sz, cc, 16, [&]() {
+    for (PetscInt j = 0; j < cls_sz; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = D1.apply_y_left(q, hi[1], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "D1_y_interior", n, n*n_int, ci, 16, [&]() {
+    for (PetscInt j = cls_sz; j < n-cls_sz; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = D1.apply_y_interior(q, hi[1], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "D1_y_interior_row", n, n*n_int, ci, 16, [&]() {
+    for (PetscInt j = cls_sz; j < n-cls_sz; j++) {
+      D1.apply_y_interior_row(q, hi[1], ind, j, 2, row.data());
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = row[i];
+    }
+  });CHKERRQ(ierr);
+  {
+    std::vector<PetscScalar> scalar(n_int*n), simd(n_int*n);
+    for (PetscInt j = cls_sz; j < n-cls_sz; j++) {
+      D1.apply_y_interior_row(q, hi[1], ind, j, 2, &simd[(j-cls_sz)*n]);
+      for (PetscInt i = 0; i < n; i++)
+        scalar[(j-cls_sz)*n + i] = D1.apply_y_interior(q, hi[1], i, j, 2);
+    }
+    ierr = check_simd(bench, order, "D1_y_interior_row", n, simd, scalar);CHKERRQ(ierr);
+  }
+  ierr = time_kernel(bench, order, "D1_y_right", n, n*cls_sz, cc, 16, [&]() {
+    for (PetscInt j = n-cls_sz; j < n; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = D1.apply_y_right(q, hi[1], i, j, 2);
+  });CHKERRQ(ierr);
+
+  //=============================================================================
+  // HI_central and H_central
+  //=============================================================================
+  ierr = time_kernel(bench, order, "HI_x_left", n, n*cls_sz, 2, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = 0; i < cls_sz; i++)
+        F(j,i,0) = HI.apply_x_left(q, hi[0], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "HI_x_right", n, n*cls_sz, 2, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = n-cls_sz; i < n; i++)
+        F(j,i,0) = HI.apply_x_right(q, hi[0], n, i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "HI_y_left", n, n*cls_sz, 2, 16, [&]() {
+    for (PetscInt j = 0; j < cls_sz; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = HI.apply_y_left(q, hi[1], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "HI_y_right", n, n*cls_sz, 2, 16, [&]() {
+    for (PetscInt j = n-cls_sz; j < n; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = HI.apply_y_right(q, hi[1], n, i, j, 2);
+  });CHKERRQ(ierr);
+  const PetscInt n_cls = H.get_n_closures();
+  ierr = time_kernel(bench, order, "H_x_left", n, n*n_cls, 2, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = 0; i < n_cls; i++)
+        F(j,i,0) = H.apply_2D_x_left(v, h[0], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "H_x_right", n, n*n_cls, 2, 16, [&]() {
+    for (PetscInt j = 0; j < n; j++)
+      for (PetscInt i = n-n_cls; i < n; i++)
+        F(j,i,0) = H.apply_2D_x_right(v, h[0], n, i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "H_y_left", n, n*n_cls, 2, 16, [&]() {
+    for (PetscInt j = 0; j < n_cls; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = H.apply_2D_y_left(v, h[1], i, j, 2);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "H_y_right", n, n*n_cls, 2, 16, [&]() {
+    for (PetscInt j = n-n_cls; j < n; j++)
+      for (PetscInt i = 0; i < n; i++)
+        F(j,i,1) = H.apply_2D_y_right(v, h[1], n, i, j, 2);
+  });CHKERRQ(ierr);
+
+  //=============================================================================
+  // Region kernels. Each point computes two derivatives in each direction.
+  //=============================================================================
+  const PetscScalar bytes_rhs = 2*dofs*sizeof(PetscScalar);
+  auto flops_region = [&](const PetscInt cx, const PetscInt cy) { return 2*cx + 2*cy + 3; };
+  ierr = time_kernel(bench, order, "region_ll", n, cls_sz*cls_sz, flops_region(cc,cc), bytes_rhs, [&]() {
+    wave_eq_hom_ll(F, q, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_il", n, n_int*cls_sz, flops_region(ci,cc), bytes_rhs, [&]() {
+    wave_eq_hom_il(F, q, ind_int, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_rl", n, cls_sz*cls_sz, flops_region(cc,cc), bytes_rhs, [&]() {
+    wave_eq_hom_rl(F, q, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_li", n, cls_sz*n_int, flops_region(cc,ci), bytes_rhs, [&]() {
+    wave_eq_hom_li(F, q, ind_int, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_ii", n, n_int*n_int, flops_region(ci,ci), bytes_rhs, [&]() {
+    wave_eq_hom_ii(F, q, ind_int, ind_int, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_ri", n, cls_sz*n_int, flops_region(cc,ci), bytes_rhs, [&]() {
+    wave_eq_hom_ri(F, q, ind_int, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_lr", n, cls_sz*cls_sz, flops_region(cc,cc), bytes_rhs, [&]() {
+    wave_eq_hom_lr(F, q, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_ir", n, n_int*cls_sz, flops_region(ci,cc), bytes_rhs, [&]() {
+    wave_eq_hom_ir(F, q, ind_int, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "region_rr", n, cls_sz*cls_sz, flops_region(cc,cc), bytes_rhs, [&]() {
+    wave_eq_hom_rr(F, q, cls_sz, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+
+  //=============================================================================
+  // Boundary conditions
+  //=============================================================================
+  const PetscScalar bytes_bc = 3*sizeof(PetscScalar);
+  ierr = time_kernel(bench, order, "bc_west", n, n, 3, bytes_bc, [&]() {
+    free_surface_bc_west(F, q, ind, HI, hi);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "bc_east", n, n, 3, bytes_bc, [&]() {
+    free_surface_bc_east(F, q, ind, HI, hi);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "bc_south", n, n, 3, bytes_bc, [&]() {
+    free_surface_bc_south(F, q, ind, HI, hi);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "bc_north", n, n, 3, bytes_bc, [&]() {
+    free_surface_bc_north(F, q, ind, HI, hi);
+  });CHKERRQ(ierr);
+
+  //=============================================================================
+  // Full RHS evaluations. The flop count is the one of the interior.
+  //=============================================================================
+  ierr = time_kernel(bench, order, "rhs_serial", n, n*n, flops_region(ci,ci), bytes_rhs, [&]() {
+    wave_eq_hom_serial(F, q, tile, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "rhs_serial_untiled", n, n*n, flops_region(ci,ci), bytes_rhs, [&]() {
+    wave_eq_hom_serial(F, q, no_tile, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "rhs_all", n, n*n, flops_region(ci,ci), bytes_rhs, [&]() {
+    wave_eq_hom_all(F, q, ind, ind, (D1.interior_stencil_width()-1)/2, tile, D1, hi, xl, 0.);
+  });CHKERRQ(ierr);
+  ierr = time_kernel(bench, order, "rhs_serial_bc", n, n*n, flops_region(ci,ci), bytes_rhs, [&]() {
+    wave_eq_hom_serial(F, q, tile, D1, hi, xl, 0.);
+    wave_eq_hom_free_surface_bc_serial(F, q, HI, hi);
+  });CHKERRQ(ierr);
+  return 0;
+}
+
+int main(int argc,char **argv)
+{
+  PetscErrorCode ierr;
+  BenchCtx       bench;
+  PetscInt       sizes[32] = {64, 128, 256, 512, 1024}, n_sizes = 32, n_orders = 3;
+#ifdef SBP_OPERATOR_ORDER
+  PetscInt       orders[3] = {SBP_OPERATOR_ORDER};
+#else
+  PetscInt       orders[3] = {2, 4, 6};
+#endif
+  PetscBool      set_sizes, set_orders, set_output;
+  char           output[PETSC_MAX_PATH_LEN] = "stdout";
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+#ifdef SBP_OPERATOR_ORDER
+  n_orders = 1;
+#endif
+  ierr = PetscOptionsGetIntArray(NULL,NULL,"-sizes",sizes,&n_sizes,&set_sizes);CHKERRQ(ierr);
+  if (!set_sizes) n_sizes = 5;
+  ierr = PetscOptionsGetIntArray(NULL,NULL,"-orders",orders,&n_orders,&set_orders);CHKERRQ(ierr);
+  bench.reps = 10;
+  ierr = PetscOptionsGetInt(NULL,NULL,"-reps",&bench.reps,NULL);CHKERRQ(ierr);
+  bench.simd_tol = 1e-12;
+  ierr = PetscOptionsGetReal(NULL,NULL,"-simd_tol",&bench.simd_tol,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetString(NULL,NULL,"-bench_output",output,sizeof(output),&set_output);CHKERRQ(ierr);
+  ierr = threads::setup();CHKERRQ(ierr);
+
+  ierr = PetscFOpen(PETSC_COMM_WORLD,output,"w",&bench.fp);CHKERRQ(ierr);
+  ierr = PetscFPrintf(PETSC_COMM_WORLD,bench.fp,"order,kernel,n,points,seconds,ns_per_point,gflops,gbs\n");CHKERRQ(ierr);
+  for (PetscInt o = 0; o < n_orders; o++) {
+    for (PetscInt s = 0; s < n_sizes; s++) {
+      ierr = sbp::dispatch_order(orders[o], [&](auto ops) {
+        return bench_order<decltype(ops)>(bench, sizes[s]);
+      });
+      if (!ierr) ierr = bench_layouts(bench, orders[o], sizes[s]);
+      if (ierr) {
+        PetscFClose(PETSC_COMM_WORLD,bench.fp);
+        PetscFinalize();
+        return -1;
+      }
+    }
+  }
+  ierr = PetscFClose(PETSC_COMM_WORLD,bench.fp);CHKERRQ(ierr);
+
+  ierr = PetscFinalize();
+  return ierr;
+}
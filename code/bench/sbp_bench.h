@@ -0,0 +1,45 @@
+#pragma once
+
+#include <petsc.h>
+#include <algorithm>
+
+struct BenchCtx {
+  FILE *fp;
+  PetscInt reps;
+  PetscReal simd_tol;
+};
+
+/**
+* Times f, taking the minimum over bench.reps repetitions after one warm-up call, and writes a CSV line.
+* Input:  order         - SBP order
+*         kernel        - kernel name
+*         n             - subdomain size
+*         points        - number of points computed per call
+*         flops_per_pt  - nominal flops per point
+*         bytes_per_pt  - compulsory bytes per point
+*         f             - kernel to time
+**/
+template <typename F>
+PetscErrorCode time_kernel(const BenchCtx& bench, const PetscInt order, const char *kernel, const PetscInt n,
+                           const PetscInt points, const PetscScalar flops_per_pt, const PetscScalar bytes_per_pt, F&& f)
+{
+  PetscErrorCode ierr;
+  PetscLogDouble t0, t1, t_min = PETSC_MAX_REAL;
+  f();
+  for (PetscInt r = 0; r < bench.reps; r++) {
+    ierr = PetscTime(&t0);CHKERRQ(ierr);
+    f();
+    ierr = PetscTime(&t1);CHKERRQ(ierr);
+    t_min = std::min(t_min, t1 - t0);
+  }
+  ierr = PetscFPrintf(PETSC_COMM_WORLD,bench.fp,"%d,%s,%d,%d,%e,%f,%f,%f\n",order,kernel,n,points,t_min,
+                      1e9*t_min/points,1e-9*flops_per_pt*points/t_min,1e-9*bytes_per_pt*points/t_min);CHKERRQ(ierr);
+  return 0;
+}
+
+/**
+* Times full RHS evaluations of the 2D wave equation with material coefficients and forcing (demo/wave) and of
+* the 2D advection equation (demo/advection), in the interleaved (PartitionedLayout2D) and in the component-major
+* (PartitionedLayout2DSoA) layout, on an n x n subdomain with the operators of the given order.
+**/
+PetscErrorCode bench_layouts(const BenchCtx& bench, const PetscInt order, const PetscInt n);
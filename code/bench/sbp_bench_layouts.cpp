@@ -0,0 +1,109 @@
+/**
+* Interleaved (AoS) against component-major (SoA) grid function layout for the RHS of the wave (demo/wave) and
+* advection (demo/advection) demos. Kept apart from sbp_bench.cpp since the wave and wave_hom kernels share the names
+* of the free surface boundary conditions.
+**/
+
+#include <petsc.h>
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cmath>
+#include "wave/wave_eq_rhs.h"
+#include "advection/advection_rhs.h"
+#include "sbpops/op_defs.h"
+#include "grids/grid_function.h"
+#include "partitioned_rhs/tiling.h"
+#include "sbp_bench.h"
+
+/**
+* Runs the RHS benchmarks of the operator set Ops in the layout Layout on an n x n subdomain.
+**/
+template <class Ops, typename Layout>
+PetscErrorCode bench_layout(const BenchCtx& bench, const PetscInt n, const char *layout_name)
+{
+  PetscErrorCode ierr;
+  const typename Ops::FirstDerivativeOp D1;
+  const typename Ops::InverseNormOp HI;
+  const PetscInt order = Ops::order;
+  const std::array<PetscScalar,2> hi = {(n-1)/2., (n-1)/2.};
+  const std::array<PetscScalar,2> h = {1./hi[0], 1./hi[1]};
+  using mapping = typename Layout::template mapping<grid::extents_2d>;
+  std::array<PetscInt,2> tile;
+  std::string kernel;
+
+  if (n - 2*D1.closure_size() < 1) return 0;
+
+  //=============================================================================
+  // Wave equation with material coefficients and forcing, 3 components
+  //=============================================================================
+  {
+    const PetscInt dofs = 3;
+    std::vector<PetscScalar> q_arr(n*n*dofs), F_arr(n*n*dofs), coef_arr(n*n*N_MATERIAL_COEFFS), force_arr(n*n*2);
+    const mapping layout(grid::extents_2d(n,n,dofs),0,n,n);
+    auto q = grid::grid_function_2d<PetscScalar,Layout>(q_arr.data(), layout);
+    auto F = grid::grid_function_2d<PetscScalar,Layout>(F_arr.data(), layout);
+    // The coefficients and the forcing are interleaved in both cases, as in the demo.
+    const auto coef = grid::grid_function_2d<const PetscScalar>(coef_arr.data(),
+                        grid::partitioned_layout_2d(grid::extents_2d(n,n,N_MATERIAL_COEFFS),0,n,n));
+    const grid::forcing_function_2d force = {grid::grid_function_2d<const PetscScalar>(force_arr.data(),
+                                               grid::partitioned_layout_2d(grid::extents_2d(n,n,2),0,n,n)), 1.};
+    for (PetscInt j = 0; j < n; j++) {
+      for (PetscInt i = 0; i < n; i++) {
+        for (PetscInt c = 0; c < dofs; c++) {
+          q(j,i,c) = sin(PETSC_PI*(c+1)*(i*h[0] + 2*j*h[1]));
+          F(j,i,c) = 0;
+        }
+        coef_arr[(j*n + i)*N_MATERIAL_COEFFS + RHO_INV] = 1./(2 + sin(i*h[0]));
+        coef_arr[(j*n + i)*N_MATERIAL_COEFFS + BULK_MODULUS] = 1 + cos(j*h[1])*cos(j*h[1]);
+        force_arr[(j*n + i)*2] = cos(i*h[0]);
+        force_arr[(j*n + i)*2 + 1] = sin(j*h[1]);
+      }
+    }
+    ierr = tiling::get_tile_size(D1.interior_stencil_width(), dofs, tile);CHKERRQ(ierr);
+    // q and F once, the two coefficients and the two forcing components
+    const PetscScalar bytes = (2*dofs + N_MATERIAL_COEFFS + 2)*sizeof(PetscScalar);
+    kernel = std::string("wave_rhs_serial_bc_") + layout_name;
+    ierr = time_kernel(bench, order, kernel.c_str(), n, n*n, wave_eq_flops_per_point(D1), bytes, [&]() {
+      wave_eq_serial(F, q, tile, D1, coef, force, hi);
+      wave_eq_free_surface_bc_serial(F, q, HI, hi);
+    });CHKERRQ(ierr);
+  }
+
+  //=============================================================================
+  // Advection equation, 1 component
+  //=============================================================================
+  {
+    const PetscInt dofs = 1;
+    std::function<double(int, int)> a = [](const PetscInt i, const PetscInt j){ return 1.5;};
+    std::function<double(int, int)> b = [](const PetscInt i, const PetscInt j){ return -1;};
+    std::vector<PetscScalar> q_arr(n*n*dofs), F_arr(n*n*dofs);
+    const mapping layout(grid::extents_2d(n,n,dofs),0,n,n);
+    auto q = grid::grid_function_2d<PetscScalar,Layout>(q_arr.data(), layout);
+    auto F = grid::grid_function_2d<PetscScalar,Layout>(F_arr.data(), layout);
+    for (PetscInt j = 0; j < n; j++) {
+      for (PetscInt i = 0; i < n; i++) {
+        q(j,i,0) = sin(PETSC_PI*(i*h[0] + 2*j*h[1]));
+        F(j,i,0) = 0;
+      }
+    }
+    ierr = tiling::get_tile_size(D1.interior_stencil_width(), dofs, tile);CHKERRQ(ierr);
+    kernel = std::string("advection_rhs_serial_bc_") + layout_name;
+    ierr = time_kernel(bench, order, kernel.c_str(), n, n*n, advection_flops_per_point(D1,2), 2*sizeof(PetscScalar), [&]() {
+      advection_serial(F, q, tile, D1, hi, a, b);
+      advection_bc_serial(F, q, HI, hi, a, b);
+    });CHKERRQ(ierr);
+  }
+  return 0;
+}
+
+PetscErrorCode bench_layouts(const BenchCtx& bench, const PetscInt order, const PetscInt n)
+{
+  return sbp::dispatch_order(order, [&](auto ops) {
+    PetscErrorCode ierr;
+    ierr = bench_layout<decltype(ops),grid::PartitionedLayout2D>(bench, n, "aos");CHKERRQ(ierr);
+    ierr = bench_layout<decltype(ops),grid::PartitionedLayout2DSoA>(bench, n, "soa");CHKERRQ(ierr);
+    return 0;
+  });
+}
@@ -6,49 +6,80 @@ static char help[] = "Solves advection 1D problem u_t + u_x = 0.\n";
 #include "advection_rhs.h"
 #include "sbpops/op_defs.h"
 #include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_lsrk.h"
 #include "grids/grid_function.h"
 #include "grids/create_layout.h"
 #include "util/io_util.h"
+#include "util/perf_counters.h"
+#include "util/snapshot.h"
+#include "util/checkpoint.h"
+#include "util/receiver.h"
+#include "util/energy.h"
 #include "util/vec_util.h"
-#include "scatter_ctx/scatter_ctx.h"
+#include "scatter_ctx/halo_exchange.h"
 
+template <class Ops>
 struct AppCtx{
     std::array<PetscInt,2> ind_i;
     PetscScalar hi, h, xl, sw;;
     PetscInt N, dofs;
     std::function<double(int)> a;
-    const FirstDerivativeOp D1;
-    const InverseNormOp HI;
-    VecScatter scatctx;
+    const typename Ops::FirstDerivativeOp D1;
+    const typename Ops::InverseNormOp HI;
+    HaloCtx halo;
     grid::partitioned_layout_1d layout;
 };
 
 PetscScalar gaussian(PetscScalar);
-PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx&, Vec);
+template <class Ops>
+PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx<Ops>&, Vec);
+template <class Ops>
 PetscErrorCode rhs(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
 PetscErrorCode rhs_serial(TS, PetscReal, Vec, Vec, void *);
 
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv);
+
 int main(int argc,char **argv)
+{
+  PetscInt       order;
+  PetscErrorCode ierr;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  ierr = sbp::get_order_from_options(order);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"SBP operator order: %d\n",order);
+
+  // The simulation is instantiated for each order, which is only branched on here.
+  ierr = sbp::dispatch_order(order, [&](auto ops) { return simulate<decltype(ops)>(argc, argv); });
+  if (ierr) {
+    PetscFinalize();
+    return -1;
+  }
+  ierr = PetscFinalize();
+  return ierr;
+}
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv)
 { 
   DM             da;
   Vec            v, v_analytic, vlocal;
-  PetscInt       stencil_radius, i_start, i_end, N, n, dofs;
+  PetscInt       stencil_radius, i_start, i_end, N, n, dofs, use_custom_sc;
   PetscScalar    xl, xr, hi, h, dt, t0, Tend, CFL;
   PetscReal      l2_error, max_error;
 
-  AppCtx         appctx;
-  PetscBool      write_data, use_custom_sc;
+  AppCtx<Ops>    appctx;
+  PetscBool      write_data;
   PetscLogDouble v1,v2,elapsed_time = 0;
 
   PetscErrorCode ierr;
   PetscMPIInt    size, rank;
 
-  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
   ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size);CHKERRQ(ierr);
   ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRQ(ierr);
 
   if (get_inputs(argc, argv, N, Tend, CFL, use_custom_sc) == -1) {
-    PetscFinalize();
     return -1;
   }
 
@@ -93,11 +124,8 @@ int main(int argc,char **argv)
   appctx.layout = grid::create_layout_1d(da);
 
   // Extract local to local scatter context
-  if (use_custom_sc) {
-    scatter_ctx_ltol(da, appctx.scatctx);
-  } else {
-    DMDAGetScatter(da, NULL, &appctx.scatctx);
-  }
+  ierr = halo_ctx_create(da, (HaloType) use_custom_sc, PETSC_FALSE, appctx.halo);CHKERRQ(ierr);
+  ierr = perf_counters::setup();CHKERRQ(ierr);
 
   /*  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       Extract global vectors from DMDA; then duplicate for remaining
@@ -108,7 +136,7 @@ int main(int argc,char **argv)
   
   // Initial solution, starting time and end time.
   analytic_solution(da, 0, appctx, v);
-  if (write_data) write_vector_to_binary(v,"data/adv_1D","v_init");
+  if (write_data) write_vector(v,"data/adv_1D","v_init",{0,Ops::order});
 
   ierr = DMCreateLocalVector(da,&vlocal);CHKERRQ(ierr);
   DMGlobalToLocalBegin(da,v,INSERT_VALUES,vlocal);  
@@ -117,15 +145,23 @@ int main(int argc,char **argv)
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     Run simulation and compute the error
   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  checkpoint::CheckpointCtx checkpoints;
+  ierr = checkpoint::create(da, PETSC_FALSE, "data/adv_1D", vlocal, checkpoints);CHKERRQ(ierr);
+  snapshot::SnapshotCtx snapshots;
+  ierr = snapshot::create(da, PETSC_FALSE, "data/adv_1D", PetscPowReal(h,Ops::order), snapshots);CHKERRQ(ierr);
+  receiver::ReceiverCtx receivers;
+  ierr = receiver::create(da, PETSC_FALSE, "data/adv_1D", {xl, 0, 0}, {h, 1, 1}, checkpoints.t_start, receivers);CHKERRQ(ierr);
+  energy::EnergyCtx energy_monitor;
+  ierr = energy::create(da, PETSC_FALSE, "data/adv_1D", typename Ops::NormOp(), {h, 1, 1}, energy_monitor);CHKERRQ(ierr);
   PetscBarrier((PetscObject) v);
   if (rank == 0) {
     PetscTime(&v1);
   }
   if (size == 1) {
-    ts_rk4(da, Tend, dt, vlocal, rhs_serial, &appctx);
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs_serial<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
   }
   else {
-    ts_rk4(da, Tend, dt, vlocal, rhs, &appctx);  
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);  
   }
   
   PetscBarrier((PetscObject) v);
@@ -135,19 +171,26 @@ int main(int argc,char **argv)
   }
 
   PetscPrintf(PETSC_COMM_WORLD,"Elapsed time: %f seconds\n",elapsed_time);
+  ierr = perf_counters::view(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  ierr = snapshot::destroy(snapshots);CHKERRQ(ierr);
+  ierr = receiver::destroy(receivers);CHKERRQ(ierr);
+  ierr = energy::destroy(energy_monitor);CHKERRQ(ierr);
+  ierr = checkpoint::destroy(checkpoints);CHKERRQ(ierr);
 
   DMLocalToGlobalBegin(da,vlocal,INSERT_VALUES,v);
   DMLocalToGlobalEnd(da,vlocal,INSERT_VALUES,v);
 
   analytic_solution(da, Tend, appctx, v_analytic);
-  l2_error = error_l2(v,v_analytic, appctx.h);
-  max_error = error_max(v,v_analytic);
-  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, and the maximum error is %g\n",l2_error,max_error);
+  ErrorNorms errors;
+  ierr = error_norms(da, v, v_analytic, typename Ops::NormOp(), appctx.h, errors);CHKERRQ(ierr);
+  l2_error = errors.l2;
+  max_error = errors.max;
+  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, the H-norm error is %g, and the maximum error is %g\n",l2_error,errors.hnorm,max_error);
 
   if (write_data) {
-    write_vector_to_binary(v,"data/adv_1D","v");
+    write_vector(v,"data/adv_1D","v",{Tend,Ops::order});
     Vec v_error = compute_error(v,v_analytic);
-    write_vector_to_binary(v_error,"data/adv_1D","v_error");
+    write_vector(v_error,"data/adv_1D","v_error",{Tend,Ops::order});
     VecDestroy(&v_error);
     char tmp_str[200];
     std::string data_string;
@@ -162,10 +205,10 @@ int main(int argc,char **argv)
     - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   VecDestroy(&v);
   VecDestroy(&v_analytic);
+  halo_ctx_destroy(appctx.halo);
   DMDestroy(&da);
   
-  ierr = PetscFinalize();
-  return ierr;
+  return 0;
 }
 
 PetscScalar gaussian(PetscScalar x) {
@@ -173,7 +216,8 @@ PetscScalar gaussian(PetscScalar x) {
   return exp(-x*x/(rstar*rstar));
 }
 
-PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx& appctx, Vec v_analytic)
+template <class Ops>
+PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx<Ops>& appctx, Vec v_analytic)
 { 
   PetscScalar x, *array_analytic;
   DMDAVecGetArray(da,v_analytic,&array_analytic);
@@ -187,42 +231,62 @@ PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx&
   return 0;
 }
 
+template <class Ops>
 PetscErrorCode rhs(TS ts, PetscReal t, Vec v_src, Vec v_dst, void* ctx)
 {
   PetscScalar       *array_src, *array_dst;
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
 
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
 
   auto gf_src = grid::grid_function_1d<PetscScalar>(array_src, appctx->layout);
   auto gf_dst = grid::grid_function_1d<PetscScalar>(array_dst, appctx->layout);
-  VecScatterBegin(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
+  halo_exchange_begin(appctx->halo,v_src);
+  logging::begin(logging::RHS_LOCAL);
   advection_local(gf_dst, gf_src, appctx->ind_i, appctx->sw, appctx->D1, appctx->hi, appctx->a);
-  VecScatterEnd(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
+  logging::end(logging::RHS_LOCAL);
+  halo_exchange_end(appctx->halo,v_src);
+  logging::begin(logging::RHS_OVERLAP);
   advection_overlap(gf_dst ,gf_src, appctx->ind_i, appctx->sw, appctx->D1, appctx->hi, appctx->a);
+  logging::end(logging::RHS_OVERLAP);
+  logging::begin(logging::RHS_BC);
   advection_bc(gf_dst, gf_src, appctx->ind_i, appctx->HI, appctx->hi, appctx->a);
+  logging::end(logging::RHS_BC);
   
   // Restore arrays
   VecRestoreArray(v_src, &array_src);
   VecRestoreArray(v_dst, &array_dst);
+  const PetscLogDouble flops = advection_flops_per_point(appctx->D1,1)*(appctx->ind_i[1]-appctx->ind_i[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
+template <class Ops>
 PetscErrorCode rhs_serial(TS ts, PetscReal t, Vec v_src, Vec v_dst, void* ctx)
 {
   PetscScalar       *array_src, *array_dst;
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
 
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
   auto gf_src = grid::grid_function_1d<PetscScalar>(array_src, appctx->layout);
   auto gf_dst = grid::grid_function_1d<PetscScalar>(array_dst, appctx->layout);
   advection_serial(gf_dst, gf_src, appctx->D1, appctx->hi, appctx->a);
+  logging::begin(logging::RHS_BC);
   advection_bc_serial(gf_dst, gf_src, appctx->HI, appctx->hi, appctx->a);
+  logging::end(logging::RHS_BC);
 
   // Restore arrays
   VecRestoreArray(v_src, &array_src);
   VecRestoreArray(v_dst, &array_dst);
+  const PetscLogDouble flops = advection_flops_per_point(appctx->D1,1)*appctx->N;
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
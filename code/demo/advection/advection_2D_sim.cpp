@@ -3,57 +3,112 @@ static char help[] ="Solves the 2D advection equation u_t + au_x +bu_y = 0.";
 
 #include <petsc.h>
 #include <array>
+#include <type_traits>
 #include <functional>
 #include "advection_rhs.h"
 #include "sbpops/op_defs.h"
 #include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_lsrk.h"
 #include "grids/grid_function.h"
 #include "grids/create_layout.h"
 #include "util/io_util.h"
 #include "util/vec_util.h"
-#include "scatter_ctx/scatter_ctx.h"
-
+#include "util/threads.h"
+#include "util/perf_counters.h"
+#include "util/snapshot.h"
+#include "util/checkpoint.h"
+#include "util/receiver.h"
+#include "util/energy.h"
+#include "scatter_ctx/halo_exchange.h"
+#include "partitioned_rhs/deep_halo.h"
+
+template <class Ops>
 struct AppCtx{
-    std::array<PetscInt,2> N, ind_i, ind_j;
+    std::array<PetscInt,2> N, ind_i, ind_j, tile;
     std::array<PetscScalar,2> hi, h, xl;
     PetscInt dofs;
     PetscScalar sw;
     std::function<double(int, int)> a, b;
-    const FirstDerivativeOp D1;
-    const InverseNormOp HI;
-    VecScatter scatctx;
+    const typename Ops::FirstDerivativeOp D1;
+    const typename Ops::InverseNormOp HI;
+    HaloCtx halo;
+    deep_halo::DeepHaloCtx deep_halo;
     grid::partitioned_layout_2d layout;
+    grid::partitioned_layout_2d_soa layout_soa;
 };
 
+/**
+* Returns the layout of the application context corresponding to the grid function layout Layout.
+**/
+template <typename Layout, class Ops>
+const auto& get_layout(const AppCtx<Ops>& appctx)
+{
+  if constexpr (std::is_same_v<Layout, grid::PartitionedLayout2DSoA>) {
+    return appctx.layout_soa;
+  } else {
+    return appctx.layout;
+  }
+}
+
 PetscScalar gaussian(PetscScalar, PetscScalar);
-PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx&, Vec);
+template <class Ops>
+PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx<Ops>&, Vec);
+template <class Ops, typename Layout>
 PetscErrorCode rhs(TS, PetscReal, Vec, Vec, void *);
+template <class Ops, typename Layout>
 PetscErrorCode rhs_serial(TS, PetscReal, Vec, Vec, void *);
+template <class Ops, typename Layout>
+PetscErrorCode rhs_deep_halo(TS, PetscReal, Vec, Vec, void *);
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv);
 
 int main(int argc,char **argv)
+{
+  PetscInt       order;
+  PetscErrorCode ierr;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  ierr = sbp::get_order_from_options(order);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"SBP operator order: %d\n",order);
+
+  // The simulation is instantiated for each order, which is only branched on here.
+  ierr = sbp::dispatch_order(order, [&](auto ops) { return simulate<decltype(ops)>(argc, argv); });
+  if (ierr) {
+    PetscFinalize();
+    return -1;
+  }
+  ierr = PetscFinalize();
+  return ierr;
+}
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv)
 { 
   DM             da;
-  Vec            v, v_analytic, vlocal;
-  PetscInt       stencil_radius, i_xstart, i_xend, i_ystart, i_yend, Nx, Ny, nx, ny, procx, procy, dofs;
+  Vec            v, v_analytic, vlocal, vlocal_soa;
+  PetscInt       stencil_radius, stencil_width, i_xstart, i_xend, i_ystart, i_yend, Nx, Ny, nx, ny, procx, procy, dofs, use_custom_sc;
+  DMDAStencilType stencil_type;
   PetscScalar    xl, xr, yl, yr, hix, hiy, dt, t0, Tend, CFL;
   PetscReal      l2_error, max_error;
 
-  AppCtx         appctx;
-  PetscBool      write_data, use_custom_sc;
+  AppCtx<Ops>    appctx;
+  PetscBool      write_data, use_soa = PETSC_FALSE;
   PetscLogDouble v1,v2,elapsed_time = 0;
 
   PetscErrorCode ierr;
   PetscMPIInt    size, rank;
 
-  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
   ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size);CHKERRQ(ierr);
   ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRQ(ierr);
 
   if (get_inputs(argc, argv, Nx, Ny, Tend, CFL, use_custom_sc) == -1) {
-    PetscFinalize();
     return -1;
   }
 
+  // Store grid functions component-major (structure-of-arrays) instead of interleaved.
+  PetscOptionsGetBool(NULL,NULL,"-soa",&use_soa,NULL);
+
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
      Problem setup
    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -81,8 +136,9 @@ int main(int argc,char **argv)
      Create distributed array (DMDA) to manage parallel grid and vectors
    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   stencil_radius = (appctx.D1.interior_stencil_width()-1)/2;
-  DMDACreate2d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DMDA_STENCIL_STAR,
-               Nx,Ny,PETSC_DECIDE,PETSC_DECIDE,dofs,stencil_radius,NULL,NULL,&da);
+  ierr = deep_halo::setup(stencil_radius, appctx.D1.closure_size(), ts_stages_from_options(), appctx.deep_halo, stencil_width, stencil_type);CHKERRQ(ierr);
+  DMDACreate2d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,stencil_type,
+               Nx,Ny,PETSC_DECIDE,PETSC_DECIDE,dofs,stencil_width,NULL,NULL,&da);
   DMSetFromOptions(da);
   DMSetUp(da);
   DMDAGetCorners(da,&i_xstart,&i_ystart,NULL,&nx,&ny,NULL);
@@ -105,13 +161,20 @@ int main(int argc,char **argv)
   appctx.a = a;
   appctx.b = b;
   appctx.sw = stencil_radius;
+  ierr = threads::setup();CHKERRQ(ierr);
+  ierr = perf_counters::setup();CHKERRQ(ierr);
+  tiling::get_tile_size(appctx.D1.interior_stencil_width(), dofs, appctx.tile);
+  PetscPrintf(PETSC_COMM_WORLD,"RHS tile size: [%d,%d]\n",appctx.tile[0],appctx.tile[1]);
   appctx.layout = grid::create_layout_2d(da);
+  appctx.layout_soa = grid::create_layout_2d_soa(da);
 
   // Extract local to local scatter context
-  if (use_custom_sc) {
-    scatter_ctx_ltol(da, appctx.scatctx);
-  } else {
-    DMDAGetScatter(da, NULL, &appctx.scatctx);
+  if (use_soa) {
+    PetscPrintf(PETSC_COMM_WORLD,"Using component-major (SoA) grid function layout\n");
+  }
+  ierr = halo_ctx_create(da, (HaloType) use_custom_sc, use_soa, appctx.halo);CHKERRQ(ierr);
+  if (deep_halo::setup_ranges(da, (HaloType) use_custom_sc, use_soa, appctx.deep_halo) == -1) {
+    return -1;
   }
 
   /*  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -123,25 +186,51 @@ int main(int argc,char **argv)
   
   // Initial solution, starting time and end time.
   analytic_solution(da, 0, appctx, v);
-  if (write_data) write_vector_to_binary(v,"data/adv_2D","v_init");
+  if (write_data) write_vector(v,"data/adv_2D","v_init",{0,Ops::order});
 
   ierr = DMCreateLocalVector(da,&vlocal);CHKERRQ(ierr);
+  ierr = threads::first_touch(vlocal,appctx.layout);CHKERRQ(ierr);
   DMGlobalToLocalBegin(da,v,INSERT_VALUES,vlocal);  
   DMGlobalToLocalEnd(da,v,INSERT_VALUES,vlocal);
+  if (use_soa) {
+    VecDuplicate(vlocal,&vlocal_soa);
+    threads::first_touch(vlocal_soa,appctx.layout_soa);
+    grid::local_aos_to_soa(da,vlocal,vlocal_soa);
+  }
 
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     Run simulation and compute the error
   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  checkpoint::CheckpointCtx checkpoints;
+  ierr = checkpoint::create(da, use_soa, "data/adv_2D", use_soa ? vlocal_soa : vlocal, checkpoints);CHKERRQ(ierr);
+  snapshot::SnapshotCtx snapshots;
+  ierr = snapshot::create(da, use_soa, "data/adv_2D", PetscPowReal(1/PetscMin(hix,hiy),Ops::order), snapshots);CHKERRQ(ierr);
+  receiver::ReceiverCtx receivers;
+  ierr = receiver::create(da, use_soa, "data/adv_2D", {xl, yl, 0}, {1./hix, 1./hiy, 1}, checkpoints.t_start, receivers);CHKERRQ(ierr);
+  energy::EnergyCtx energy_monitor;
+  ierr = energy::create(da, use_soa, "data/adv_2D", typename Ops::NormOp(), {1./hix, 1./hiy, 1}, energy_monitor);CHKERRQ(ierr);
   PetscBarrier((PetscObject) v);
   if (rank == 0) {
     PetscTime(&v1);
   }
 
-  if (size == 1) {
-    ts_rk4(da, Tend, dt, vlocal, rhs_serial, &appctx);
-  }
-  else {
-    ts_rk4(da, Tend, dt, vlocal, rhs, &appctx);  
+  if (use_soa) {
+    if (size == 1) {
+      ts_rk_from_options(da, Tend, dt, vlocal_soa, rhs_serial<Ops,grid::PartitionedLayout2DSoA>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_TRUE, coupling_width(appctx.D1), PETSC_FALSE);
+    }
+    else {
+      ts_rk_from_options(da, Tend, dt, vlocal_soa, rhs<Ops,grid::PartitionedLayout2DSoA>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_TRUE, coupling_width(appctx.D1), PETSC_FALSE);
+    }
+  } else {
+    if (size == 1) {
+      ts_rk_from_options(da, Tend, dt, vlocal, rhs_serial<Ops,grid::PartitionedLayout2D>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
+    }
+    else if (deep_halo::enabled(appctx.deep_halo)) {
+      ts_rk_from_options(da, Tend, dt, vlocal, rhs_deep_halo<Ops,grid::PartitionedLayout2D>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
+    }
+    else {
+      ts_rk_from_options(da, Tend, dt, vlocal, rhs<Ops,grid::PartitionedLayout2D>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
+    }
   }
   
   PetscBarrier((PetscObject) v);
@@ -151,20 +240,32 @@ int main(int argc,char **argv)
   }
 
   PetscPrintf(PETSC_COMM_WORLD,"Elapsed time: %f seconds\n",elapsed_time);
+  ierr = perf_counters::view(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  ierr = snapshot::destroy(snapshots);CHKERRQ(ierr);
+  ierr = receiver::destroy(receivers);CHKERRQ(ierr);
+  ierr = energy::destroy(energy_monitor);CHKERRQ(ierr);
+  ierr = checkpoint::destroy(checkpoints);CHKERRQ(ierr);
+
+  if (use_soa) {
+    grid::local_soa_to_aos(da,vlocal_soa,vlocal);
+    VecDestroy(&vlocal_soa);
+  }
 
   DMLocalToGlobalBegin(da,vlocal,INSERT_VALUES,v);
   DMLocalToGlobalEnd(da,vlocal,INSERT_VALUES,v);
 
   analytic_solution(da, Tend, appctx, v_analytic);
-  l2_error = error_l2(v,v_analytic, appctx.h);
-  max_error = error_max(v,v_analytic);
-  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, and the maximum error is %g\n",l2_error,max_error);
+  ErrorNorms errors;
+  ierr = error_norms(da, v, v_analytic, typename Ops::NormOp(), appctx.h, errors);CHKERRQ(ierr);
+  l2_error = errors.l2;
+  max_error = errors.max;
+  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, the H-norm error is %g, and the maximum error is %g\n",l2_error,errors.hnorm,max_error);
 
   // Write solution to file
   if (write_data) {
-    write_vector_to_binary(v,"data/adv_2D","v");
+    write_vector(v,"data/adv_2D","v",{Tend,Ops::order});
     Vec v_error = compute_error(v,v_analytic);
-    write_vector_to_binary(v_error,"data/adv_2D","v_error");
+    write_vector(v_error,"data/adv_2D","v_error",{Tend,Ops::order});
     VecDestroy(&v_error);
     char tmp_str[200];
     std::string data_string;
@@ -179,10 +280,10 @@ int main(int argc,char **argv)
     - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   VecDestroy(&v);
   VecDestroy(&v_analytic);
+  halo_ctx_destroy(appctx.halo);
   DMDestroy(&da);
   
-  ierr = PetscFinalize();
-  return ierr;
+  return 0;
 }
 
 PetscScalar gaussian(PetscScalar x, PetscScalar y) {
@@ -190,7 +291,8 @@ PetscScalar gaussian(PetscScalar x, PetscScalar y) {
   return std::exp(-(x*x+y*y)/(rstar*rstar));
 }
 
-PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx& appctx, Vec v_analytic)
+template <class Ops>
+PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx<Ops>& appctx, Vec v_analytic)
 { 
   PetscScalar x,y, **array_analytic;
   DMDAVecGetArray(da,v_analytic,&array_analytic);
@@ -208,42 +310,95 @@ PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx&
   return 0;
 }
 
+template <class Ops, typename Layout>
 PetscErrorCode rhs(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
   PetscScalar       *array_src, *array_dst;
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
 
-  auto gf_src = grid::grid_function_2d<PetscScalar>(array_src, appctx->layout);
-  auto gf_dst = grid::grid_function_2d<PetscScalar>(array_dst, appctx->layout);
-  VecScatterBegin(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
-  advection_local(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->D1, appctx->hi, appctx->a, appctx->b);
-  VecScatterEnd(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
-  advection_overlap(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->D1, appctx->hi, appctx->a, appctx->b);
+  auto gf_src = grid::grid_function_2d<PetscScalar,Layout>(array_src, get_layout<Layout>(*appctx));
+  auto gf_dst = grid::grid_function_2d<PetscScalar,Layout>(array_dst, get_layout<Layout>(*appctx));
+  halo_exchange_begin(appctx->halo,v_src);
+  logging::begin(logging::RHS_LOCAL);
+  advection_local(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->a, appctx->b);
+  logging::end(logging::RHS_LOCAL);
+  halo_exchange_end(appctx->halo,v_src);
+  logging::begin(logging::RHS_OVERLAP);
+  advection_overlap(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->a, appctx->b);
+  logging::end(logging::RHS_OVERLAP);
+  logging::begin(logging::RHS_BC);
   advection_bc(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->HI, appctx->hi, appctx->a, appctx->b);
+  logging::end(logging::RHS_BC);
 
   // Restore arrays
   VecRestoreArray(v_src,&array_src);
   VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = advection_flops_per_point(appctx->D1,2)*(appctx->ind_i[1]-appctx->ind_i[0])*(appctx->ind_j[1]-appctx->ind_j[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
+template <class Ops, typename Layout>
 PetscErrorCode rhs_serial(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
   PetscScalar       *array_src, *array_dst;
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
 
-  auto gf_src = grid::grid_function_2d<PetscScalar>(array_src, appctx->layout);
-  auto gf_dst = grid::grid_function_2d<PetscScalar>(array_dst, appctx->layout);
+  auto gf_src = grid::grid_function_2d<PetscScalar,Layout>(array_src, get_layout<Layout>(*appctx));
+  auto gf_dst = grid::grid_function_2d<PetscScalar,Layout>(array_dst, get_layout<Layout>(*appctx));
   
-  advection_serial(gf_dst, gf_src, appctx->D1, appctx->hi, appctx->a, appctx->b);
+  advection_serial(gf_dst, gf_src, appctx->tile, appctx->D1, appctx->hi, appctx->a, appctx->b);
+  logging::begin(logging::RHS_BC);
   advection_bc_serial(gf_dst, gf_src, appctx->HI, appctx->hi, appctx->a, appctx->b);
+  logging::end(logging::RHS_BC);
+
+  // Restore arrays
+  VecRestoreArray(v_src,&array_src);
+  VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = advection_flops_per_point(appctx->D1,2)*appctx->N[0]*appctx->N[1];
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
+  return 0;
+}
+
+template <class Ops, typename Layout>
+PetscErrorCode rhs_deep_halo(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+{
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  PetscScalar       *array_src, *array_dst;
+  std::array<PetscInt,2> ind_i, ind_j;
+
+  logging::begin(logging::RHS);
+  VecGetArray(v_src,&array_src);
+  VecGetArray(v_dst,&array_dst);
+
+  auto gf_src = grid::grid_function_2d<PetscScalar,Layout>(array_src, get_layout<Layout>(*appctx));
+  auto gf_dst = grid::grid_function_2d<PetscScalar,Layout>(array_dst, get_layout<Layout>(*appctx));
+  // Exchange the halo once every deep_halo.steps time steps, otherwise compute on the valid part of the ghost region.
+  if (deep_halo::next_evaluation(appctx->deep_halo, ind_i, ind_j)) {
+    halo_exchange_begin(appctx->halo,v_src);
+    halo_exchange_end(appctx->halo,v_src);
+  }
+  advection_all(gf_dst, gf_src, ind_i, ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->a, appctx->b);
+  logging::begin(logging::RHS_BC);
+  advection_bc(gf_dst, gf_src, ind_i, ind_j, appctx->HI, appctx->hi, appctx->a, appctx->b);
+  logging::end(logging::RHS_BC);
 
   // Restore arrays
   VecRestoreArray(v_src,&array_src);
   VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = advection_flops_per_point(appctx->D1,2)*(ind_i[1]-ind_i[0])*(ind_j[1]-ind_j[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
-}
\ No newline at end of file
+}
@@ -2,9 +2,13 @@
 
 #include <petscsystypes.h>
 #include <array>
+#include <algorithm>
 #include "grids/grid_function.h"
 #include "partitioned_rhs/rhs.h"
+#include "partitioned_rhs/tiling.h"
 #include "partitioned_rhs/boundary_conditions.h"
+#include "sbpops/simd.h"
+#include "util/logging.h"
 
 //=============================================================================
 // 1D functions
@@ -45,8 +49,14 @@ inline void advection_i(grid::grid_function_1d<PetscScalar> dst,
                                         const PetscScalar hi,
                                         VelocityFunction&& a)
 {
-  for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {
-    dst(i,0) = -std::forward<VelocityFunction>(a)(i)*D1.apply_interior(src,hi,i,0);
+  // Derivatives are computed in blocks using the SIMD row kernel of D1.
+  PetscScalar ux[sbp::simd::row_block];
+  for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += sbp::simd::row_block) {
+    const PetscInt i1 = std::min(i0 + sbp::simd::row_block, ind_i[1]);
+    D1.apply_interior_row(src, hi, {i0, i1}, 0, ux);
+    for (PetscInt i = i0; i < i1; i++) {
+      dst(i,0) = -std::forward<VelocityFunction>(a)(i)*ux[i-i0];
+    }
   }
 }
 
@@ -152,9 +162,9 @@ inline void advection_bc_serial(grid::grid_function_1d<PetscScalar> dst,
   *   * il *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_ll(grid::grid_function_2d<PetscScalar> dst,
-                  const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_ll(grid::grid_function_2d<PetscScalar,Layout> dst,
+                  const grid::grid_function_2d<PetscScalar,Layout> src,
                   const PetscInt cl_sz,
                   const SbpDerivative& D1,
                   const std::array<PetscScalar,2>& hi,
@@ -179,9 +189,9 @@ void advection_ll(grid::grid_function_2d<PetscScalar> dst,
   *   *    * il *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_il(grid::grid_function_2d<PetscScalar> dst,
-                  const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_il(grid::grid_function_2d<PetscScalar,Layout> dst,
+                  const grid::grid_function_2d<PetscScalar,Layout> src,
                   const std::array<PetscInt,2> ind_i,
                   const PetscInt cl_sz,
                   const SbpDerivative& D1,
@@ -206,9 +216,9 @@ void advection_il(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    * rl *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_rl(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_rl(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
@@ -233,9 +243,9 @@ void advection_rl(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_li(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_li(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const std::array<PetscInt,2> ind_j,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -261,9 +271,9 @@ void advection_li(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_ii(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_ii(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const std::array<PetscInt,2> ind_i,
                     const std::array<PetscInt,2> ind_j,
                     const SbpDerivative& D1,
@@ -271,11 +281,17 @@ void advection_ii(grid::grid_function_2d<PetscScalar> dst,
                     VelocityFunction&& a_x,
                     VelocityFunction&& a_y)
 {
-
+  // Derivatives are computed in blocks of rows using the SIMD row kernels of D1.
+  PetscScalar ux[sbp::simd::row_block], uy[sbp::simd::row_block];
   for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) { 
-    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) { 
-      dst(j,i,0) = -(std::forward<VelocityFunction>(a_x)(i,j)*D1.apply_x_interior(src,hi[0],i,j,0) +
-                     std::forward<VelocityFunction>(a_y)(i,j)*D1.apply_y_interior(src,hi[1],i,j,0));
+    for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += sbp::simd::row_block) { 
+      const PetscInt i1 = std::min(i0 + sbp::simd::row_block, ind_i[1]);
+      D1.apply_x_interior_row(src, hi[0], {i0, i1}, j, 0, ux);
+      D1.apply_y_interior_row(src, hi[1], {i0, i1}, j, 0, uy);
+      for (PetscInt i = i0; i < i1; i++) { 
+        dst(j,i,0) = -(std::forward<VelocityFunction>(a_x)(i,j)*ux[i-i0] +
+                       std::forward<VelocityFunction>(a_y)(i,j)*uy[i-i0]);
+      }
     }
   }
 }
@@ -289,9 +305,9 @@ void advection_ii(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_ri(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_ri(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const std::array<PetscInt,2> ind_j,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -318,9 +334,9 @@ void advection_ri(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_lr(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_lr(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
@@ -345,9 +361,9 @@ void advection_lr(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_ir(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_ir(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const std::array<PetscInt,2> ind_i,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -373,9 +389,9 @@ void advection_ir(grid::grid_function_2d<PetscScalar> dst,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative, typename VelocityFunction>
-void advection_rr(grid::grid_function_2d<PetscScalar> dst,
-                  const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_rr(grid::grid_function_2d<PetscScalar,Layout> dst,
+                  const grid::grid_function_2d<PetscScalar,Layout> src,
                   const PetscInt cl_sz,
                   const SbpDerivative& D1,
                   const std::array<PetscScalar,2>& hi,
@@ -392,74 +408,106 @@ void advection_rr(grid::grid_function_2d<PetscScalar> dst,
   }
 }
 
-template <class SbpDerivative, typename VelocityFunction>
-void advection_local(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_all(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
                     VelocityFunction&& a_x,
                     VelocityFunction&& a_y)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_local(advection_ll<decltype(D1),decltype(a_x)>,
-            advection_li<decltype(D1),decltype(a_x)>,
-            advection_lr<decltype(D1),decltype(a_x)>,
-            advection_il<decltype(D1),decltype(a_x)>,
-            advection_ii<decltype(D1),decltype(a_x)>,
-            advection_ir<decltype(D1),decltype(a_x)>,
-            advection_rl<decltype(D1),decltype(a_x)>,
-            advection_ri<decltype(D1),decltype(a_x)>,
-            advection_rr<decltype(D1),decltype(a_x)>,
-            dst,src,ind_i,ind_j,cl_sz,halo_sz,D1,hi,a_x,a_y);
+  rhs_all_tiled(tile,
+                advection_ll<decltype(D1),decltype(a_x),Layout>,
+                advection_li<decltype(D1),decltype(a_x),Layout>,
+                advection_lr<decltype(D1),decltype(a_x),Layout>,
+                advection_il<decltype(D1),decltype(a_x),Layout>,
+                advection_ii<decltype(D1),decltype(a_x),Layout>,
+                advection_ir<decltype(D1),decltype(a_x),Layout>,
+                advection_rl<decltype(D1),decltype(a_x),Layout>,
+                advection_ri<decltype(D1),decltype(a_x),Layout>,
+                advection_rr<decltype(D1),decltype(a_x),Layout>,
+                dst,src,ind_i,ind_j,cl_sz,halo_sz,D1,hi,a_x,a_y);
 }
 
-template <class SbpDerivative, typename VelocityFunction>
-void advection_overlap(grid::grid_function_2d<PetscScalar> dst,
-                    const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_local(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
                     VelocityFunction&& a_x,
                     VelocityFunction&& a_y)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_overlap(advection_li<decltype(D1),decltype(a_x)>,
-              advection_il<decltype(D1),decltype(a_x)>,
-              advection_ii<decltype(D1),decltype(a_x)>,
-              advection_ir<decltype(D1),decltype(a_x)>,
-              advection_ri<decltype(D1),decltype(a_x)>,
-              dst,src,ind_i,ind_j,cl_sz,halo_sz,D1,hi,a_x,a_y);
+  rhs_local_tiled(tile,
+                  advection_ll<decltype(D1),decltype(a_x),Layout>,
+                  advection_li<decltype(D1),decltype(a_x),Layout>,
+                  advection_lr<decltype(D1),decltype(a_x),Layout>,
+                  advection_il<decltype(D1),decltype(a_x),Layout>,
+                  advection_ii<decltype(D1),decltype(a_x),Layout>,
+                  advection_ir<decltype(D1),decltype(a_x),Layout>,
+                  advection_rl<decltype(D1),decltype(a_x),Layout>,
+                  advection_ri<decltype(D1),decltype(a_x),Layout>,
+                  advection_rr<decltype(D1),decltype(a_x),Layout>,
+                  dst,src,ind_i,ind_j,cl_sz,halo_sz,D1,hi,a_x,a_y);
 }
 
-template <class SbpDerivative, typename VelocityFunction>
-void advection_serial(grid::grid_function_2d<PetscScalar> dst,
-                     const grid::grid_function_2d<PetscScalar> src,
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_overlap(grid::grid_function_2d<PetscScalar,Layout> dst,
+                    const grid::grid_function_2d<PetscScalar,Layout> src,
+                    const std::array<PetscInt,2>& ind_i,
+                    const std::array<PetscInt,2>& ind_j,
+                    const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
+                    const SbpDerivative& D1,
+                    const std::array<PetscScalar,2>& hi,
+                    VelocityFunction&& a_x,
+                    VelocityFunction&& a_y)
+{
+  const PetscInt cl_sz = D1.closure_size();
+  rhs_overlap_tiled(tile,
+                    advection_li<decltype(D1),decltype(a_x),Layout>,
+                    advection_il<decltype(D1),decltype(a_x),Layout>,
+                    advection_ii<decltype(D1),decltype(a_x),Layout>,
+                    advection_ir<decltype(D1),decltype(a_x),Layout>,
+                    advection_ri<decltype(D1),decltype(a_x),Layout>,
+                    dst,src,ind_i,ind_j,cl_sz,halo_sz,D1,hi,a_x,a_y);
+}
+
+template <class SbpDerivative, typename VelocityFunction, typename Layout>
+void advection_serial(grid::grid_function_2d<PetscScalar,Layout> dst,
+                     const grid::grid_function_2d<PetscScalar,Layout> src,
+                     const std::array<PetscInt,2>& tile,
                      const SbpDerivative& D1,
                      const std::array<PetscScalar,2>& hi,
                      VelocityFunction&& a_x,
                      VelocityFunction&& a_y)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_serial(advection_ll<decltype(D1),decltype(a_x)>,
-             advection_li<decltype(D1),decltype(a_x)>,
-             advection_lr<decltype(D1),decltype(a_x)>,
-             advection_il<decltype(D1),decltype(a_x)>,
-             advection_ii<decltype(D1),decltype(a_x)>,
-             advection_ir<decltype(D1),decltype(a_x)>,
-             advection_rl<decltype(D1),decltype(a_x)>,
-             advection_ri<decltype(D1),decltype(a_x)>,
-             advection_rr<decltype(D1),decltype(a_x)>,
-             dst,src,cl_sz,D1,hi,a_x,a_y);
+  rhs_serial_tiled(tile,
+                   advection_ll<decltype(D1),decltype(a_x),Layout>,
+                   advection_li<decltype(D1),decltype(a_x),Layout>,
+                   advection_lr<decltype(D1),decltype(a_x),Layout>,
+                   advection_il<decltype(D1),decltype(a_x),Layout>,
+                   advection_ii<decltype(D1),decltype(a_x),Layout>,
+                   advection_ir<decltype(D1),decltype(a_x),Layout>,
+                   advection_rl<decltype(D1),decltype(a_x),Layout>,
+                   advection_ri<decltype(D1),decltype(a_x),Layout>,
+                   advection_rr<decltype(D1),decltype(a_x),Layout>,
+                   dst,src,cl_sz,D1,hi,a_x,a_y);
 }
 
-template <class SbpInvQuad, typename VelocityFunction>
-void SAT_bc_west(grid::grid_function_2d<PetscScalar> dst,
-                           const grid::grid_function_2d<PetscScalar> src,
+template <class SbpInvQuad, typename VelocityFunction, typename Layout>
+void SAT_bc_west(grid::grid_function_2d<PetscScalar,Layout> dst,
+                           const grid::grid_function_2d<PetscScalar,Layout> src,
                            const std::array<PetscInt,2>& ind_j,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi,
@@ -474,9 +522,9 @@ void SAT_bc_west(grid::grid_function_2d<PetscScalar> dst,
   }
 };
 
-template <class SbpInvQuad, typename VelocityFunction>
-void SAT_bc_south(grid::grid_function_2d<PetscScalar> dst,
-                           const grid::grid_function_2d<PetscScalar> src,
+template <class SbpInvQuad, typename VelocityFunction, typename Layout>
+void SAT_bc_south(grid::grid_function_2d<PetscScalar,Layout> dst,
+                           const grid::grid_function_2d<PetscScalar,Layout> src,
                            const std::array<PetscInt,2>& ind_i,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi,
@@ -491,9 +539,9 @@ void SAT_bc_south(grid::grid_function_2d<PetscScalar> dst,
   }
 };
 
-template <class SbpInvQuad, typename VelocityFunction>
-void SAT_bc_east(grid::grid_function_2d<PetscScalar> dst,
-                           const grid::grid_function_2d<PetscScalar> src,
+template <class SbpInvQuad, typename VelocityFunction, typename Layout>
+void SAT_bc_east(grid::grid_function_2d<PetscScalar,Layout> dst,
+                           const grid::grid_function_2d<PetscScalar,Layout> src,
                            const std::array<PetscInt,2>& ind_j,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi,
@@ -509,9 +557,9 @@ void SAT_bc_east(grid::grid_function_2d<PetscScalar> dst,
   }
 };
 
-template <class SbpInvQuad, typename VelocityFunction>
-void SAT_bc_north(grid::grid_function_2d<PetscScalar> dst,
-                           const grid::grid_function_2d<PetscScalar> src,
+template <class SbpInvQuad, typename VelocityFunction, typename Layout>
+void SAT_bc_north(grid::grid_function_2d<PetscScalar,Layout> dst,
+                           const grid::grid_function_2d<PetscScalar,Layout> src,
                            const std::array<PetscInt,2>& ind_i,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi,
@@ -527,23 +575,23 @@ void SAT_bc_north(grid::grid_function_2d<PetscScalar> dst,
   }
 };
 
-template <class SbpInvQuad, typename VelocityFunction>
-void advection_bc_serial(grid::grid_function_2d<PetscScalar> dst,
-                         const grid::grid_function_2d<PetscScalar> src,
+template <class SbpInvQuad, typename VelocityFunction, typename Layout>
+void advection_bc_serial(grid::grid_function_2d<PetscScalar,Layout> dst,
+                         const grid::grid_function_2d<PetscScalar,Layout> src,
                          const SbpInvQuad& HI,
                          const std::array<PetscScalar,2>& hi,
                          VelocityFunction&& a_x,
                          VelocityFunction&& a_y)
 {
-  bc_serial(SAT_bc_west<decltype(HI),decltype(a_x)>,
-            SAT_bc_south<decltype(HI),decltype(a_x)>,
-            SAT_bc_east<decltype(HI),decltype(a_y)>,
-            SAT_bc_north<decltype(HI),decltype(a_y)>,dst,src,HI,hi,a_x,a_y);
+  bc_serial_tiled(SAT_bc_west<decltype(HI),decltype(a_x),Layout>,
+                  SAT_bc_south<decltype(HI),decltype(a_x),Layout>,
+                  SAT_bc_east<decltype(HI),decltype(a_y),Layout>,
+                  SAT_bc_north<decltype(HI),decltype(a_y),Layout>,dst,src,HI,hi,a_x,a_y);
 };
 
-template <class SbpInvQuad, typename VelocityFunction>
-void advection_bc(grid::grid_function_2d<PetscScalar> dst,
-                   const grid::grid_function_2d<PetscScalar> src,
+template <class SbpInvQuad, typename VelocityFunction, typename Layout>
+void advection_bc(grid::grid_function_2d<PetscScalar,Layout> dst,
+                   const grid::grid_function_2d<PetscScalar,Layout> src,
                    const std::array<PetscInt,2>& ind_i,
                    const std::array<PetscInt,2>& ind_j,
                    const SbpInvQuad& HI,
@@ -551,8 +599,18 @@ void advection_bc(grid::grid_function_2d<PetscScalar> dst,
                    VelocityFunction&& a_x,
                    VelocityFunction&& a_y)
 {
-  bc(SAT_bc_west<decltype(HI),decltype(a_x)>,
-     SAT_bc_south<decltype(HI),decltype(a_x)>,
-     SAT_bc_east<decltype(HI),decltype(a_y)>,
-     SAT_bc_north<decltype(HI),decltype(a_y)>,dst,src,ind_i,ind_j,HI,hi,a_x,a_y);
-};
\ No newline at end of file
+  bc_tiled(SAT_bc_west<decltype(HI),decltype(a_x),Layout>,
+           SAT_bc_south<decltype(HI),decltype(a_x),Layout>,
+           SAT_bc_east<decltype(HI),decltype(a_y),Layout>,
+           SAT_bc_north<decltype(HI),decltype(a_y),Layout>,dst,src,ind_i,ind_j,HI,hi,a_x,a_y);
+};
+
+/**
+* Nominal number of flops of the RHS at an interior point of a 1D or 2D grid, used for logging.
+**/
+template <class SbpDerivative>
+constexpr PetscLogDouble advection_flops_per_point(const SbpDerivative& D1, const PetscInt dim)
+{
+  // A derivative and a velocity product per dimension, and the sum of the dimensions
+  return dim*(logging::derivative_flops(D1) + 1) + (dim - 1);
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include<petscsystypes.h>
+#include <algorithm>
 #include "grids/grid_function.h"
 #include "partitioned_rhs/rhs.h"
 #include "partitioned_rhs/boundary_conditions.h"
+#include "sbpops/simd.h"
+#include "util/logging.h"
 
 // Approximate RHS of reflection problem, [u;v]_t = [v_x;u_x]
 template <class SbpDerivative>
@@ -26,9 +29,16 @@ inline void reflection_i(grid::grid_function_1d<PetscScalar> dst,
                           const SbpDerivative& D1, 
                           const PetscScalar hi)
 {
-  for (PetscInt i = ind_i[0]; i<ind_i[1]; i++) {
-    dst(i,1) = D1.apply_interior(src,hi,i,0);
-    dst(i,0) = D1.apply_interior(src,hi,i,1);
+  // Derivatives are computed in blocks using the SIMD row kernel of D1.
+  PetscScalar ux[sbp::simd::row_block], vx[sbp::simd::row_block];
+  for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += sbp::simd::row_block) {
+    const PetscInt i1 = std::min(i0 + sbp::simd::row_block, ind_i[1]);
+    D1.apply_interior_row(src, hi, {i0, i1}, 0, ux);
+    D1.apply_interior_row(src, hi, {i0, i1}, 1, vx);
+    for (PetscInt i = i0; i < i1; i++) {
+      dst(i,1) = ux[i-i0];
+      dst(i,0) = vx[i-i0];
+    }
   }
 };
 
@@ -130,4 +140,14 @@ inline void reflection_bc_serial(grid::grid_function_1d<PetscScalar> dst,
                                  const grid::grid_function_1d<PetscScalar> src)
 {
   bc_serial(proj_dirichlet_bc_l,proj_dirichlet_bc_r,dst,src);
-};
\ No newline at end of file
+};
+
+/**
+* Nominal number of flops of the RHS at an interior point, used for logging.
+**/
+template <class SbpDerivative>
+constexpr PetscLogDouble reflection_flops_per_point(const SbpDerivative& D1)
+{
+  // Two derivatives
+  return 2*logging::derivative_flops(D1);
+}
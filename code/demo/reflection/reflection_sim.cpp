@@ -5,49 +5,81 @@ static char help[] = "Solves 1D reflection problem.\n";
 #include "reflection_rhs.h"
 #include "sbpops/op_defs.h"
 #include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_lsrk.h"
 #include "grids/create_layout.h"
 #include "grids/grid_function.h"
 #include "util/io_util.h"
+#include "util/perf_counters.h"
+#include "util/snapshot.h"
+#include "util/checkpoint.h"
+#include "util/receiver.h"
+#include "util/energy.h"
 #include "util/vec_util.h"
-#include "scatter_ctx/scatter_ctx.h"
+#include "scatter_ctx/halo_exchange.h"
 
+template <class Ops>
 struct AppCtx{
     std::array<PetscInt,2> ind_i;
     PetscScalar hi, h, xl, sw;;
     PetscInt N, dofs;
-    const FirstDerivativeOp D1;
-    VecScatter scatctx;
+    const typename Ops::FirstDerivativeOp D1;
+    HaloCtx halo;
     grid::partitioned_layout_1d layout;
 };
 
 PetscScalar theta1(PetscScalar x, PetscScalar t);
 PetscScalar theta2(PetscScalar x, PetscScalar t);
-PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx& appctx);
-PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx& appctx, const Vec v_analytic, const PetscScalar W);
+template <class Ops>
+PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx<Ops>& appctx);
+template <class Ops>
+PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx<Ops>& appctx, const Vec v_analytic, const PetscScalar W);
+template <class Ops>
 PetscErrorCode rhs(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
 PetscErrorCode rhs_serial(TS, PetscReal, Vec, Vec, void *);
 
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv);
+
 int main(int argc,char **argv)
+{
+  PetscInt       order;
+  PetscErrorCode ierr;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  ierr = sbp::get_order_from_options(order);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"SBP operator order: %d\n",order);
+
+  // The simulation is instantiated for each order, which is only branched on here.
+  ierr = sbp::dispatch_order(order, [&](auto ops) { return simulate<decltype(ops)>(argc, argv); });
+  if (ierr) {
+    PetscFinalize();
+    return -1;
+  }
+  ierr = PetscFinalize();
+  return ierr;
+}
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv)
 { 
   DM             da;
   Vec            v, v_analytic, vlocal;
-  PetscInt       stencil_radius, i_xstart, i_xend, N, n, dofs;
+  PetscInt       stencil_radius, i_xstart, i_xend, N, n, dofs, use_custom_sc;
   PetscScalar    xl, xr, h, hi, dt, t0, Tend, CFL;
   PetscReal      l2_error, max_error;
 
-  AppCtx         appctx;
-  PetscBool      write_data, use_custom_sc;
+  AppCtx<Ops>    appctx;
+  PetscBool      write_data;
   PetscLogDouble v1,v2,elapsed_time = 0;
 
   PetscErrorCode ierr;
   PetscMPIInt    size, rank;
 
-  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
   ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size);CHKERRQ(ierr);
   ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRQ(ierr);
 
   if (get_inputs(argc, argv, N, Tend, CFL, use_custom_sc) == -1) {
-    PetscFinalize();
     return -1;
   }
 
@@ -94,11 +126,8 @@ int main(int argc,char **argv)
   appctx.layout = grid::create_layout_1d(da);
 
   // Extract local to local scatter context
-  if (use_custom_sc) {
-    scatter_ctx_ltol(da, appctx.scatctx);
-  } else {
-    DMDAGetScatter(da, NULL, &appctx.scatctx);
-  }
+  ierr = halo_ctx_create(da, (HaloType) use_custom_sc, PETSC_FALSE, appctx.halo);CHKERRQ(ierr);
+  ierr = perf_counters::setup();CHKERRQ(ierr);
 
   /*  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       Extract global vectors from DMDA; then duplicate for remaining
@@ -110,7 +139,7 @@ int main(int argc,char **argv)
   // Initial solution, starting time and end time.
   initial_condition(da, v, appctx);
 
-  if (write_data) write_vector_to_binary(v,"data/reflection","v_init");
+  if (write_data) write_vector(v,"data/reflection","v_init",{0,Ops::order});
 
   ierr = DMCreateLocalVector(da,&vlocal);CHKERRQ(ierr);
   DMGlobalToLocalBegin(da,v,INSERT_VALUES,vlocal);  
@@ -119,16 +148,24 @@ int main(int argc,char **argv)
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     Run simulation and compute the error
   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  checkpoint::CheckpointCtx checkpoints;
+  ierr = checkpoint::create(da, PETSC_FALSE, "data/reflection", vlocal, checkpoints);CHKERRQ(ierr);
+  snapshot::SnapshotCtx snapshots;
+  ierr = snapshot::create(da, PETSC_FALSE, "data/reflection", PetscPowReal(h,Ops::order), snapshots);CHKERRQ(ierr);
+  receiver::ReceiverCtx receivers;
+  ierr = receiver::create(da, PETSC_FALSE, "data/reflection", {xl, 0, 0}, {h, 1, 1}, checkpoints.t_start, receivers);CHKERRQ(ierr);
+  energy::EnergyCtx energy_monitor;
+  ierr = energy::create(da, PETSC_FALSE, "data/reflection", typename Ops::NormOp(), {h, 1, 1}, energy_monitor);CHKERRQ(ierr);
   PetscBarrier((PetscObject) v);
   if (rank == 0) {
     PetscTime(&v1);
   }
   
   if (size == 1) {
-    ts_rk4(da, Tend, dt, vlocal, rhs_serial, &appctx);
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs_serial<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
   }
   else {
-    ts_rk4(da, Tend, dt, vlocal, rhs, &appctx);  
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);  
   }
   
   PetscBarrier((PetscObject) v);
@@ -138,19 +175,26 @@ int main(int argc,char **argv)
   }
 
   PetscPrintf(PETSC_COMM_WORLD,"Elapsed time: %f seconds\n",elapsed_time);
+  ierr = perf_counters::view(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  ierr = snapshot::destroy(snapshots);CHKERRQ(ierr);
+  ierr = receiver::destroy(receivers);CHKERRQ(ierr);
+  ierr = energy::destroy(energy_monitor);CHKERRQ(ierr);
+  ierr = checkpoint::destroy(checkpoints);CHKERRQ(ierr);
 
   DMLocalToGlobalBegin(da,vlocal,INSERT_VALUES,v);
   DMLocalToGlobalEnd(da,vlocal,INSERT_VALUES,v);
 
   analytic_solution(da, Tend, appctx, v_analytic, xr-xl);
-  l2_error = error_l2(v,v_analytic, appctx.h);
-  max_error = error_max(v,v_analytic);
-  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, and the maximum error is %g\n",l2_error,max_error);
+  ErrorNorms errors;
+  ierr = error_norms(da, v, v_analytic, typename Ops::NormOp(), appctx.h, errors);CHKERRQ(ierr);
+  l2_error = errors.l2;
+  max_error = errors.max;
+  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, the H-norm error is %g, and the maximum error is %g\n",l2_error,errors.hnorm,max_error);
 
   if (write_data) {
-    write_vector_to_binary(v,"data/reflection","v");
+    write_vector(v,"data/reflection","v",{Tend,Ops::order});
     Vec v_error = compute_error(v,v_analytic);
-    write_vector_to_binary(v_error,"data/reflection","v_error");
+    write_vector(v_error,"data/reflection","v_error",{Tend,Ops::order});
     VecDestroy(&v_error);
     char tmp_str[200];
     std::string data_string;
@@ -165,10 +209,10 @@ int main(int argc,char **argv)
     - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   VecDestroy(&v);
   VecDestroy(&v_analytic);
+  halo_ctx_destroy(appctx.halo);
   DMDestroy(&da);
   
-  ierr = PetscFinalize();
-  return ierr;
+  return 0;
 }
 
 /**
@@ -188,7 +232,8 @@ PetscScalar theta2(PetscScalar x, PetscScalar t)
   return -theta1(x,t);
 }
 
-PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx& appctx, const Vec v_analytic, const PetscScalar W)
+template <class Ops>
+PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx<Ops>& appctx, const Vec v_analytic, const PetscScalar W)
 {
   PetscScalar x, **array_analytic;
   DMDAVecGetArrayDOF(da,v_analytic,&array_analytic);
@@ -208,7 +253,8 @@ PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx&
 * Inputs: v      - vector to place initial data
 *         appctx - application context, contains necessary information
 **/
-PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx& appctx) 
+template <class Ops>
+PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx<Ops>& appctx) 
 {
   PetscInt i; 
   PetscScalar **varr, x;
@@ -225,42 +271,62 @@ PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx& appctx)
 }
 
 
+template <class Ops>
 PetscErrorCode rhs(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
   PetscScalar       *array_src, *array_dst;
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);  
   auto gf_src = grid::grid_function_1d<PetscScalar>(array_src, appctx->layout);
   auto gf_dst = grid::grid_function_1d<PetscScalar>(array_dst, appctx->layout);
-  VecScatterBegin(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
+  halo_exchange_begin(appctx->halo,v_src);
+  logging::begin(logging::RHS_LOCAL);
   reflection_local(gf_dst, gf_src, appctx->ind_i, appctx->sw, appctx->D1, appctx->hi);
+  logging::end(logging::RHS_LOCAL);
+  logging::begin(logging::RHS_BC);
   reflection_bc(gf_dst, gf_src, appctx->ind_i);
-  VecScatterEnd(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
+  logging::end(logging::RHS_BC);
+  halo_exchange_end(appctx->halo,v_src);
+  logging::begin(logging::RHS_OVERLAP);
   reflection_overlap(gf_dst, gf_src, appctx->ind_i, appctx->sw, appctx->D1, appctx->hi);
+  logging::end(logging::RHS_OVERLAP);
   
 
   // Restore arrays
   VecRestoreArray(v_src, &array_src);
   VecRestoreArray(v_dst, &array_dst);
+  const PetscLogDouble flops = reflection_flops_per_point(appctx->D1)*(appctx->ind_i[1]-appctx->ind_i[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
+template <class Ops>
 PetscErrorCode rhs_serial(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
   PetscScalar       *array_src, *array_dst;
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);  
   auto gf_src = grid::grid_function_1d<PetscScalar>(array_src, appctx->layout);
   auto gf_dst = grid::grid_function_1d<PetscScalar>(array_dst, appctx->layout);
   reflection_serial(gf_dst, gf_src, appctx->D1, appctx->hi);
+  logging::begin(logging::RHS_BC);
   reflection_bc_serial(gf_dst, gf_src);  
+  logging::end(logging::RHS_BC);
   
 
   // Restore arrays
   VecRestoreArray(v_src, &array_src);
   VecRestoreArray(v_dst, &array_dst);
+  const PetscLogDouble flops = reflection_flops_per_point(appctx->D1)*appctx->N;
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
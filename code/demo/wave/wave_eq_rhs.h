@@ -2,9 +2,15 @@
 
 #include<petscsystypes.h>
 #include <array>
+#include <algorithm>
 #include "partitioned_rhs/rhs.h"
+#include "partitioned_rhs/tiling.h"
 #include "partitioned_rhs/boundary_conditions.h"
 #include "grids/grid_function.h"
+#include "grids/coefficient_field.h"
+#include "grids/forcing.h"
+#include "sbpops/simd.h"
+#include "util/logging.h"
 
 /**
 * Functions for computing the righ-hand-side of the acoustic wave equation
@@ -13,7 +19,7 @@
 * where q = [u,v,p]^T, and 
 * F1 = -1/rho(x,y) p_x + forcing_u
 * F2 = -1/rho(x,y) p_y + forcing_v
-* F3 = -(u_x + q_y)
+* F3 = -K(x,y)(u_x + v_y)
 *
 * Subscripts _x, and _y denote partial derivates. These are approximated by the summation-by-parts (SBP) difference operator.
 * The SBP difference operators have specialized stencils in the boundary regions (for each coordinate direction)
@@ -33,6 +39,13 @@
 * The RHS function F(t,q) are separated into the above regions, using the specialized stencils of the difference operator.
 * Furthermore, along the boundary points, additional SBP operators are used to impose free surface boundary conditions,
 * i.e, zero pressure conditions.
+*
+* The material parameters 1/rho and K are precomputed on the local grid points and passed to the kernels as a
+* coefficient field (see grids/coefficient_field.h), with components given by MaterialCoeff.
+*
+* The forcing is passed to the kernels as a forcing function (see grids/forcing.h), with components [forcing_u, forcing_v].
+* The forcing of the manufactured solution is separable, forcing_u = forcing_time(t)*forcing_u_space(x,y) and similarly
+* for forcing_v, so only the time factor is evaluated per RHS evaluation.
 * 
 **/
   
@@ -45,6 +58,18 @@ PetscScalar rho_inv(const PetscInt i, const PetscInt j, const std::array<PetscSc
   return 1./(2 + x*y);
 };
 
+/**
+* Bulk modulus (incompressibility) K(x,y) at grid point i,j
+**/
+PetscScalar bulk_modulus(const PetscInt i, const PetscInt j, const std::array<PetscScalar,2>& hi, const std::array<PetscScalar,2>& xl) {
+  return 1;
+};
+
+/**
+* Components of the material coefficient field
+**/
+enum MaterialCoeff {RHO_INV = 0, BULK_MODULUS = 1, N_MATERIAL_COEFFS = 2};
+
 /**
 * Forcing function on u component
 **/
@@ -63,6 +88,31 @@ PetscScalar forcing_v(const PetscInt i, const PetscInt j, const PetscScalar t, c
   return -(4*PETSC_PI*cos(5*PETSC_PI*t)*cos(4*PETSC_PI*y)*sin(3*PETSC_PI*x)*(x*y + 1))/(x*y + 2);
 };
 
+/**
+* Time factor of the forcing functions, forcing_u = forcing_time*forcing_u_space, forcing_v = forcing_time*forcing_v_space
+**/
+PetscScalar forcing_time(const PetscScalar t) {
+  return cos(5*PETSC_PI*t);
+};
+
+/**
+* Spatial part of the forcing function on u component
+**/
+PetscScalar forcing_u_space(const PetscInt i, const PetscInt j, const std::array<PetscScalar,2>& hi, const std::array<PetscScalar,2>& xl) {
+  PetscScalar x = xl[0] + i/hi[0];
+  PetscScalar y = xl[1] + j/hi[1];
+  return -(3*PETSC_PI*cos(3*PETSC_PI*x)*sin(4*PETSC_PI*y)*(x*y + 1))/(x*y + 2);
+};
+
+/**
+* Spatial part of the forcing function on v component
+**/
+PetscScalar forcing_v_space(const PetscInt i, const PetscInt j, const std::array<PetscScalar,2>& hi, const std::array<PetscScalar,2>& xl) {
+  PetscScalar x = xl[0] + i/hi[0];
+  PetscScalar y = xl[1] + j/hi[1];
+  return -(4*PETSC_PI*cos(4*PETSC_PI*y)*sin(3*PETSC_PI*x)*(x*y + 1))/(x*y + 2);
+};
+
  /**
   *   ****************
   *   *    *    *    *
@@ -72,20 +122,20 @@ PetscScalar forcing_v(const PetscInt i, const PetscInt j, const PetscScalar t, c
   *   * ll *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_ll(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_ll(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   for (PetscInt j = 0; j < cl_sz; j++) { 
     for (PetscInt i = 0; i < cl_sz; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_left(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_left(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_left(q, hi[0], i, j, 0) - D1.apply_y_left(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_left(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_left(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_left(q, hi[0], i, j, 0) + D1.apply_y_left(q, hi[1], i, j, 1));
     }
   }
 }
@@ -100,21 +150,21 @@ void wave_eq_ll(grid::grid_function_2d<PetscScalar> F,
   *   *    * il *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_il(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_il(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_i,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   for (PetscInt j = 0; j < cl_sz; j++) { 
     for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {  
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_interior(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_left(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_interior(q, hi[0], i, j, 0) - D1.apply_y_left(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_interior(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_left(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_interior(q, hi[0], i, j, 0) + D1.apply_y_left(q, hi[1], i, j, 1));
     }
   }
 }
@@ -128,21 +178,21 @@ void wave_eq_il(grid::grid_function_2d<PetscScalar> F,
   *   *    *    * rl *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_rl(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_rl(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt nx = q.mapping().nx();
   for (PetscInt j = 0; j < cl_sz; j++) { 
     for (PetscInt i = nx-cl_sz; i < nx; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_right(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_left(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_right(q, hi[0], i, j, 0) - D1.apply_y_left(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_right(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_left(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_right(q, hi[0], i, j, 0) + D1.apply_y_left(q, hi[1], i, j, 1));
     }
   }
 }
@@ -156,22 +206,22 @@ void wave_eq_rl(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_li(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_li(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_j,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
  
  for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) { 
     for (PetscInt i = 0; i < cl_sz; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_left(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_interior(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_left(q, hi[0], i, j, 0) - D1.apply_y_interior(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_left(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_interior(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_left(q, hi[0], i, j, 0) + D1.apply_y_interior(q, hi[1], i, j, 1));
     }
   }
 }
@@ -185,22 +235,30 @@ void wave_eq_li(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_ii(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_ii(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_i,
                     const std::array<PetscInt,2> ind_j,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
-
+  // Derivatives are computed in blocks of rows using the SIMD row kernels of D1.
+  PetscScalar px[sbp::simd::row_block], py[sbp::simd::row_block], ux[sbp::simd::row_block], vy[sbp::simd::row_block];
   for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) { 
-    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_interior(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_interior(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_interior(q, hi[0], i, j, 0) - D1.apply_y_interior(q, hi[1], i, j, 1);
+    for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += sbp::simd::row_block) { 
+      const PetscInt i1 = std::min(i0 + sbp::simd::row_block, ind_i[1]);
+      D1.apply_x_interior_row(q, hi[0], {i0, i1}, j, 2, px);
+      D1.apply_y_interior_row(q, hi[1], {i0, i1}, j, 2, py);
+      D1.apply_x_interior_row(q, hi[0], {i0, i1}, j, 0, ux);
+      D1.apply_y_interior_row(q, hi[1], {i0, i1}, j, 1, vy);
+      for (PetscInt i = i0; i < i1; i++) { 
+        F(j, i, 0) = -coef(j, i, RHO_INV)*px[i-i0] + force(j, i, 0);
+        F(j, i, 1) = -coef(j, i, RHO_INV)*py[i-i0] + force(j, i, 1);
+        F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(ux[i-i0] + vy[i-i0]);
+      }
     }
   }
 }
@@ -214,22 +272,22 @@ void wave_eq_ii(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_ri(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_ri(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_j,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt nx = q.mapping().nx();
   for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) { 
     for (PetscInt i = nx-cl_sz; i < nx; i++) {
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_right(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_interior(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_right(q, hi[0], i, j, 0) - D1.apply_y_interior(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_right(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_interior(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_right(q, hi[0], i, j, 0) + D1.apply_y_interior(q, hi[1], i, j, 1));
     }
   }
 }
@@ -244,21 +302,21 @@ void wave_eq_ri(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_lr(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_lr(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt ny = q.mapping().ny();  
   for (PetscInt j = ny-cl_sz; j < ny; j++) { 
     for (PetscInt i = 0; i < cl_sz; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_left(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_right(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_left(q, hi[0], i, j, 0) - D1.apply_y_right(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_left(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_right(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_left(q, hi[0], i, j, 0) + D1.apply_y_right(q, hi[1], i, j, 1));
     }
   }
 }
@@ -272,22 +330,22 @@ void wave_eq_lr(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_ir(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_ir(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_i,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt ny = q.mapping().ny();
   for (PetscInt j = ny-cl_sz; j < ny; j++) { 
     for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_interior(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_right(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_interior(q, hi[0], i, j, 0) - D1.apply_y_right(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_interior(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_right(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_interior(q, hi[0], i, j, 0) + D1.apply_y_right(q, hi[1], i, j, 1));
     }
   }
 }
@@ -301,121 +359,129 @@ void wave_eq_ir(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_rr(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_rr(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt nx = q.mapping().nx();
   const PetscInt ny = q.mapping().ny();
   for (PetscInt j = ny-cl_sz; j < ny; j++) { 
     for (PetscInt i = nx-cl_sz; i < nx; i++) { 
-      F(j, i, 0) = -rho_inv(i, j, hi, xl)*D1.apply_x_right(q, hi[0], i, j, 2) + forcing_u(i, j, t, hi, xl);
-      F(j, i, 1) = -rho_inv(i, j, hi, xl)*D1.apply_y_right(q, hi[1], i, j, 2) + forcing_v(i, j, t, hi, xl);
-      F(j, i, 2) = -D1.apply_x_right(q, hi[0], i, j, 0) - D1.apply_y_right(q, hi[1], i, j, 1);
+      F(j, i, 0) = -coef(j, i, RHO_INV)*D1.apply_x_right(q, hi[0], i, j, 2) + force(j, i, 0);
+      F(j, i, 1) = -coef(j, i, RHO_INV)*D1.apply_y_right(q, hi[1], i, j, 2) + force(j, i, 1);
+      F(j, i, 2) = -coef(j, i, BULK_MODULUS)*(D1.apply_x_right(q, hi[0], i, j, 0) + D1.apply_y_right(q, hi[1], i, j, 1));
     }
   }
 }
 
-template <class SbpDerivative>
-void wave_eq_all(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_all(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_all(wave_eq_ll<decltype(D1)>,
-            wave_eq_li<decltype(D1)>,
-            wave_eq_lr<decltype(D1)>,
-            wave_eq_il<decltype(D1)>,
-            wave_eq_ii<decltype(D1)>,
-            wave_eq_ir<decltype(D1)>,
-            wave_eq_rl<decltype(D1)>,
-            wave_eq_ri<decltype(D1)>,
-            wave_eq_rr<decltype(D1)>,
-            F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
+  rhs_all_tiled(tile,
+                wave_eq_ll<decltype(D1),Layout>,
+                wave_eq_li<decltype(D1),Layout>,
+                wave_eq_lr<decltype(D1),Layout>,
+                wave_eq_il<decltype(D1),Layout>,
+                wave_eq_ii<decltype(D1),Layout>,
+                wave_eq_ir<decltype(D1),Layout>,
+                wave_eq_rl<decltype(D1),Layout>,
+                wave_eq_ri<decltype(D1),Layout>,
+                wave_eq_rr<decltype(D1),Layout>,
+                F,q,ind_i,ind_j,cl_sz,halo_sz,D1,coef,force,hi);
 }
 
-template <class SbpDerivative>
-void wave_eq_local(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_local(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_local(wave_eq_ll<decltype(D1)>,
-            wave_eq_li<decltype(D1)>,
-            wave_eq_lr<decltype(D1)>,
-            wave_eq_il<decltype(D1)>,
-            wave_eq_ii<decltype(D1)>,
-            wave_eq_ir<decltype(D1)>,
-            wave_eq_rl<decltype(D1)>,
-            wave_eq_ri<decltype(D1)>,
-            wave_eq_rr<decltype(D1)>,
-            F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
+  rhs_local_tiled(tile,
+                  wave_eq_ll<decltype(D1),Layout>,
+                  wave_eq_li<decltype(D1),Layout>,
+                  wave_eq_lr<decltype(D1),Layout>,
+                  wave_eq_il<decltype(D1),Layout>,
+                  wave_eq_ii<decltype(D1),Layout>,
+                  wave_eq_ir<decltype(D1),Layout>,
+                  wave_eq_rl<decltype(D1),Layout>,
+                  wave_eq_ri<decltype(D1),Layout>,
+                  wave_eq_rr<decltype(D1),Layout>,
+                  F,q,ind_i,ind_j,cl_sz,halo_sz,D1,coef,force,hi);
 }
 
-template <class SbpDerivative>
-void wave_eq_overlap(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_overlap(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
-                    const std::array<PetscScalar,2>& hi,
-                    const std::array<PetscScalar,2>& xl,
-                    const PetscScalar t)
+                    const grid::grid_function_2d<const PetscScalar> coef,
+                    const grid::forcing_function_2d& force,
+                    const std::array<PetscScalar,2>& hi)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_overlap(wave_eq_li<decltype(D1)>,
-              wave_eq_il<decltype(D1)>,
-              wave_eq_ii<decltype(D1)>,
-              wave_eq_ir<decltype(D1)>,
-              wave_eq_ri<decltype(D1)>,
-              F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
+  rhs_overlap_tiled(tile,
+                    wave_eq_li<decltype(D1),Layout>,
+                    wave_eq_il<decltype(D1),Layout>,
+                    wave_eq_ii<decltype(D1),Layout>,
+                    wave_eq_ir<decltype(D1),Layout>,
+                    wave_eq_ri<decltype(D1),Layout>,
+                    F,q,ind_i,ind_j,cl_sz,halo_sz,D1,coef,force,hi);
 }
 
-template <class SbpDerivative>
-void wave_eq_serial(grid::grid_function_2d<PetscScalar> F,
-                          const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_serial(grid::grid_function_2d<PetscScalar,Layout> F,
+                          const grid::grid_function_2d<PetscScalar,Layout> q,
+                          const std::array<PetscInt,2>& tile,
                           const SbpDerivative& D1,
-                          const std::array<PetscScalar,2>& hi,
-                          const std::array<PetscScalar,2>& xl,
-                          const PetscScalar t)
+                          const grid::grid_function_2d<const PetscScalar> coef,
+                          const grid::forcing_function_2d& force,
+                          const std::array<PetscScalar,2>& hi)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_serial(wave_eq_ll<decltype(D1)>,
-             wave_eq_li<decltype(D1)>,
-             wave_eq_lr<decltype(D1)>,
-             wave_eq_il<decltype(D1)>,
-             wave_eq_ii<decltype(D1)>,
-             wave_eq_ir<decltype(D1)>,
-             wave_eq_rl<decltype(D1)>,
-             wave_eq_ri<decltype(D1)>,
-             wave_eq_rr<decltype(D1)>,
-             F,q,cl_sz,D1,hi,xl,t);
+  rhs_serial_tiled(tile,
+                   wave_eq_ll<decltype(D1),Layout>,
+                   wave_eq_li<decltype(D1),Layout>,
+                   wave_eq_lr<decltype(D1),Layout>,
+                   wave_eq_il<decltype(D1),Layout>,
+                   wave_eq_ii<decltype(D1),Layout>,
+                   wave_eq_ir<decltype(D1),Layout>,
+                   wave_eq_rl<decltype(D1),Layout>,
+                   wave_eq_ri<decltype(D1),Layout>,
+                   wave_eq_rr<decltype(D1),Layout>,
+                   F,q,cl_sz,D1,coef,force,hi);
 }
 
 /**
 * Free surface boundary condition functions
 **/
-template<class SbpInvQuad>
-void free_surface_bc_west(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_west(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_j,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -426,9 +492,9 @@ void free_surface_bc_west(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template<class SbpInvQuad>
-void free_surface_bc_south(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_south(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_i,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -439,9 +505,9 @@ void free_surface_bc_south(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template<class SbpInvQuad>
-void free_surface_bc_east(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_east(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_j,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -453,9 +519,9 @@ void free_surface_bc_east(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template<class SbpInvQuad>
-void free_surface_bc_north(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_north(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_i,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -467,28 +533,38 @@ void free_surface_bc_north(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template <class SbpInvQuad>
-void wave_eq_free_surface_bc_serial(grid::grid_function_2d<PetscScalar> F,
-                                 const grid::grid_function_2d<PetscScalar> q,
+template <class SbpInvQuad, typename Layout>
+void wave_eq_free_surface_bc_serial(grid::grid_function_2d<PetscScalar,Layout> F,
+                                 const grid::grid_function_2d<PetscScalar,Layout> q,
                                  const SbpInvQuad& HI,
                                  const std::array<PetscScalar,2>& hi)
 {
-  bc_serial(free_surface_bc_west<decltype(HI)>,
-             free_surface_bc_south<decltype(HI)>,
-             free_surface_bc_east<decltype(HI)>,
-             free_surface_bc_north<decltype(HI)>,F,q,HI,hi);
+  bc_serial_tiled(free_surface_bc_west<decltype(HI),Layout>,
+                  free_surface_bc_south<decltype(HI),Layout>,
+                  free_surface_bc_east<decltype(HI),Layout>,
+                  free_surface_bc_north<decltype(HI),Layout>,F,q,HI,hi);
 };
 
-template <class SbpInvQuad>
-void wave_eq_free_surface_bc(grid::grid_function_2d<PetscScalar> F,
-                             const grid::grid_function_2d<PetscScalar> q,
+template <class SbpInvQuad, typename Layout>
+void wave_eq_free_surface_bc(grid::grid_function_2d<PetscScalar,Layout> F,
+                             const grid::grid_function_2d<PetscScalar,Layout> q,
                              const std::array<PetscInt,2>& ind_i,
                              const std::array<PetscInt,2>& ind_j,
                              const SbpInvQuad& HI,
                              const std::array<PetscScalar,2>& hi)
 {
-  bc(free_surface_bc_west<decltype(HI)>,
-    free_surface_bc_south<decltype(HI)>,
-    free_surface_bc_east<decltype(HI)>,
-    free_surface_bc_north<decltype(HI)>,F,q,ind_i,ind_j,HI,hi);
-};
\ No newline at end of file
+  bc_tiled(free_surface_bc_west<decltype(HI),Layout>,
+           free_surface_bc_south<decltype(HI),Layout>,
+           free_surface_bc_east<decltype(HI),Layout>,
+           free_surface_bc_north<decltype(HI),Layout>,F,q,ind_i,ind_j,HI,hi);
+};
+
+/**
+* Nominal number of flops of the RHS at an interior point, used for logging.
+**/
+template <class SbpDerivative>
+constexpr PetscLogDouble wave_eq_flops_per_point(const SbpDerivative& D1)
+{
+  // Four derivatives, the material coefficient products and the forcing
+  return 4*logging::derivative_flops(D1) + 6;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include<petscsystypes.h>
+#include <array>
+#include <algorithm>
+#include "partitioned_rhs/rhs.h"
+#include "partitioned_rhs/tiling.h"
+#include "partitioned_rhs/boundary_conditions.h"
+#include "grids/grid_function.h"
+#include "grids/region.h"
+#include "sbpops/simd.h"
+#include "util/logging.h"
+
+/**
+* Functions for computing the righ-hand-side of the 3D acoustic wave equation
+*
+* F(t,q) = [F1(t,q),F2(t,q),F3(t,q),F4(t,q)]^T
+* where q = [u,v,w,p]^T, and
+* F1 = -p_x
+* F2 = -p_y
+* F3 = -p_z
+* F4 = -(u_x + v_y + w_z)
+*
+* Subscripts _x, _y and _z denote partial derivates. These are approximated by the summation-by-parts (SBP) difference
+* operator. The SBP difference operators have specialized stencils in the boundary regions (for each coordinate
+* direction). For this reason, the domain is separated into 27 parts, the tensor product of the left (l), interior (i)
+* and right (r) parts in each direction. The RHS is computed by a single region function, templated on the parts in
+* each direction, see the 3D functions in partitioned_rhs/rhs.h.
+*
+* Along the boundary points, additional SBP operators are used to impose free surface boundary conditions,
+* i.e, zero pressure conditions.
+*
+**/
+
+/**
+* Computes the RHS on the box ind_i x ind_j x ind_k within the region (rx, ry, rz).
+* In the interior of all directions the derivatives are computed in blocks of rows using the SIMD row kernels of D1.
+**/
+template <grid::Region rx, grid::Region ry, grid::Region rz, class SbpDerivative, typename Layout>
+void wave_eq_3d_region(grid::grid_function_3d<PetscScalar,Layout> F,
+                       const grid::grid_function_3d<PetscScalar,Layout> q,
+                       const std::array<PetscInt,2>& ind_i,
+                       const std::array<PetscInt,2>& ind_j,
+                       const std::array<PetscInt,2>& ind_k,
+                       const SbpDerivative& D1,
+                       const std::array<PetscScalar,3>& hi)
+{
+  if constexpr (rx == grid::INTERIOR && ry == grid::INTERIOR && rz == grid::INTERIOR) {
+    constexpr PetscInt nb = sbp::simd::row_block;
+    PetscScalar px[nb], py[nb], pz[nb], ux[nb], vy[nb], wz[nb];
+    for (PetscInt k = ind_k[0]; k < ind_k[1]; k++) {
+      for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) {
+        for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += nb) {
+          const PetscInt i1 = std::min(i0 + nb, ind_i[1]);
+          D1.apply_x_interior_row(q, hi[0], {i0, i1}, j, k, 3, px);
+          D1.apply_y_interior_row(q, hi[1], {i0, i1}, j, k, 3, py);
+          D1.apply_z_interior_row(q, hi[2], {i0, i1}, j, k, 3, pz);
+          D1.apply_x_interior_row(q, hi[0], {i0, i1}, j, k, 0, ux);
+          D1.apply_y_interior_row(q, hi[1], {i0, i1}, j, k, 1, vy);
+          D1.apply_z_interior_row(q, hi[2], {i0, i1}, j, k, 2, wz);
+          for (PetscInt i = i0; i < i1; i++) {
+            F(k, j, i, 0) = -px[i-i0];
+            F(k, j, i, 1) = -py[i-i0];
+            F(k, j, i, 2) = -pz[i-i0];
+            F(k, j, i, 3) = -(ux[i-i0] + vy[i-i0] + wz[i-i0]);
+          }
+        }
+      }
+    }
+  } else {
+    for (PetscInt k = ind_k[0]; k < ind_k[1]; k++) {
+      for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) {
+        for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {
+          F(k, j, i, 0) = -D1.template apply_x<rx>(q, hi[0], i, j, k, 3);
+          F(k, j, i, 1) = -D1.template apply_y<ry>(q, hi[1], i, j, k, 3);
+          F(k, j, i, 2) = -D1.template apply_z<rz>(q, hi[2], i, j, k, 3);
+          F(k, j, i, 3) = -(D1.template apply_x<rx>(q, hi[0], i, j, k, 0) +
+                            D1.template apply_y<ry>(q, hi[1], i, j, k, 1) +
+                            D1.template apply_z<rz>(q, hi[2], i, j, k, 2));
+        }
+      }
+    }
+  }
+}
+
+/**
+* Region function passed to the 3D dispatchers, forwarding the regions as template arguments to wave_eq_3d_region.
+**/
+struct WaveEq3DRegion {
+  template <typename RX, typename RY, typename RZ, typename... Args>
+  void operator()(RX, RY, RZ, Args&&... args) const
+  {
+    wave_eq_3d_region<RX::value, RY::value, RZ::value>(std::forward<Args>(args)...);
+  }
+};
+
+template <class SbpDerivative, typename Layout>
+void wave_eq_3d_all(grid::grid_function_3d<PetscScalar,Layout> F,
+                    const grid::grid_function_3d<PetscScalar,Layout> q,
+                    const std::array<PetscInt,2>& ind_i,
+                    const std::array<PetscInt,2>& ind_j,
+                    const std::array<PetscInt,2>& ind_k,
+                    const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
+                    const SbpDerivative& D1,
+                    const std::array<PetscScalar,3>& hi)
+{
+  rhs_all_tiled(tile, WaveEq3DRegion(), F, q, ind_i, ind_j, ind_k, D1.closure_size(), halo_sz, D1, hi);
+}
+
+template <class SbpDerivative, typename Layout>
+void wave_eq_3d_local(grid::grid_function_3d<PetscScalar,Layout> F,
+                      const grid::grid_function_3d<PetscScalar,Layout> q,
+                      const std::array<PetscInt,2>& ind_i,
+                      const std::array<PetscInt,2>& ind_j,
+                      const std::array<PetscInt,2>& ind_k,
+                      const PetscInt halo_sz,
+                      const std::array<PetscInt,2>& tile,
+                      const SbpDerivative& D1,
+                      const std::array<PetscScalar,3>& hi)
+{
+  rhs_local_tiled(tile, WaveEq3DRegion(), F, q, ind_i, ind_j, ind_k, D1.closure_size(), halo_sz, D1, hi);
+}
+
+template <class SbpDerivative, typename Layout>
+void wave_eq_3d_overlap(grid::grid_function_3d<PetscScalar,Layout> F,
+                        const grid::grid_function_3d<PetscScalar,Layout> q,
+                        const std::array<PetscInt,2>& ind_i,
+                        const std::array<PetscInt,2>& ind_j,
+                        const std::array<PetscInt,2>& ind_k,
+                        const PetscInt halo_sz,
+                        const std::array<PetscInt,2>& tile,
+                        const SbpDerivative& D1,
+                        const std::array<PetscScalar,3>& hi)
+{
+  rhs_overlap_tiled(tile, WaveEq3DRegion(), F, q, ind_i, ind_j, ind_k, D1.closure_size(), halo_sz, D1, hi);
+}
+
+template <class SbpDerivative, typename Layout>
+void wave_eq_3d_serial(grid::grid_function_3d<PetscScalar,Layout> F,
+                       const grid::grid_function_3d<PetscScalar,Layout> q,
+                       const std::array<PetscInt,2>& tile,
+                       const SbpDerivative& D1,
+                       const std::array<PetscScalar,3>& hi)
+{
+  rhs_serial_tiled(tile, WaveEq3DRegion(), F, q, D1.closure_size(), D1, hi);
+}
+
+/**
+* Free surface boundary condition functions
+**/
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_3d_west(grid::grid_function_3d<PetscScalar,Layout> F,
+                             const grid::grid_function_3d<PetscScalar,Layout> q,
+                             const std::array<PetscInt,2>& ind_j,
+                             const std::array<PetscInt,2>& ind_k,
+                             const SbpInvQuad& HI,
+                             const std::array<PetscScalar,3>& hi)
+{
+  const PetscInt i = 0;
+  for (PetscInt k = ind_k[0]; k < ind_k[1]; k++) {
+    for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) {
+      F(k, j, i, 0) -= HI.apply_x_left(q, hi[0], i, j, k, 3);
+    }
+  }
+};
+
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_3d_east(grid::grid_function_3d<PetscScalar,Layout> F,
+                             const grid::grid_function_3d<PetscScalar,Layout> q,
+                             const std::array<PetscInt,2>& ind_j,
+                             const std::array<PetscInt,2>& ind_k,
+                             const SbpInvQuad& HI,
+                             const std::array<PetscScalar,3>& hi)
+{
+  const PetscInt nx = q.mapping().nx();
+  const PetscInt i = nx-1;
+  for (PetscInt k = ind_k[0]; k < ind_k[1]; k++) {
+    for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) {
+      F(k, j, i, 0) += HI.apply_x_right(q, hi[0], nx, i, j, k, 3);
+    }
+  }
+};
+
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_3d_south(grid::grid_function_3d<PetscScalar,Layout> F,
+                              const grid::grid_function_3d<PetscScalar,Layout> q,
+                              const std::array<PetscInt,2>& ind_i,
+                              const std::array<PetscInt,2>& ind_k,
+                              const SbpInvQuad& HI,
+                              const std::array<PetscScalar,3>& hi)
+{
+  const PetscInt j = 0;
+  for (PetscInt k = ind_k[0]; k < ind_k[1]; k++) {
+    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {
+      F(k, j, i, 1) -= HI.apply_y_left(q, hi[1], i, j, k, 3);
+    }
+  }
+};
+
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_3d_north(grid::grid_function_3d<PetscScalar,Layout> F,
+                              const grid::grid_function_3d<PetscScalar,Layout> q,
+                              const std::array<PetscInt,2>& ind_i,
+                              const std::array<PetscInt,2>& ind_k,
+                              const SbpInvQuad& HI,
+                              const std::array<PetscScalar,3>& hi)
+{
+  const PetscInt ny = q.mapping().ny();
+  const PetscInt j = ny-1;
+  for (PetscInt k = ind_k[0]; k < ind_k[1]; k++) {
+    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {
+      F(k, j, i, 1) += HI.apply_y_right(q, hi[1], ny, i, j, k, 3);
+    }
+  }
+};
+
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_3d_bottom(grid::grid_function_3d<PetscScalar,Layout> F,
+                               const grid::grid_function_3d<PetscScalar,Layout> q,
+                               const std::array<PetscInt,2>& ind_i,
+                               const std::array<PetscInt,2>& ind_j,
+                               const SbpInvQuad& HI,
+                               const std::array<PetscScalar,3>& hi)
+{
+  const PetscInt k = 0;
+  for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) {
+    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {
+      F(k, j, i, 2) -= HI.apply_z_left(q, hi[2], i, j, k, 3);
+    }
+  }
+};
+
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_3d_top(grid::grid_function_3d<PetscScalar,Layout> F,
+                            const grid::grid_function_3d<PetscScalar,Layout> q,
+                            const std::array<PetscInt,2>& ind_i,
+                            const std::array<PetscInt,2>& ind_j,
+                            const SbpInvQuad& HI,
+                            const std::array<PetscScalar,3>& hi)
+{
+  const PetscInt nz = q.mapping().nz();
+  const PetscInt k = nz-1;
+  for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) {
+    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) {
+      F(k, j, i, 2) += HI.apply_z_right(q, hi[2], nz, i, j, k, 3);
+    }
+  }
+};
+
+template <class SbpInvQuad, typename Layout>
+void wave_eq_3d_free_surface_bc_serial(grid::grid_function_3d<PetscScalar,Layout> F,
+                                       const grid::grid_function_3d<PetscScalar,Layout> q,
+                                       const SbpInvQuad& HI,
+                                       const std::array<PetscScalar,3>& hi)
+{
+  bc_serial_tiled(free_surface_bc_3d_west<decltype(HI),Layout>,
+                  free_surface_bc_3d_south<decltype(HI),Layout>,
+                  free_surface_bc_3d_east<decltype(HI),Layout>,
+                  free_surface_bc_3d_north<decltype(HI),Layout>,
+                  free_surface_bc_3d_bottom<decltype(HI),Layout>,
+                  free_surface_bc_3d_top<decltype(HI),Layout>,F,q,HI,hi);
+};
+
+template <class SbpInvQuad, typename Layout>
+void wave_eq_3d_free_surface_bc(grid::grid_function_3d<PetscScalar,Layout> F,
+                                const grid::grid_function_3d<PetscScalar,Layout> q,
+                                const std::array<PetscInt,2>& ind_i,
+                                const std::array<PetscInt,2>& ind_j,
+                                const std::array<PetscInt,2>& ind_k,
+                                const SbpInvQuad& HI,
+                                const std::array<PetscScalar,3>& hi)
+{
+  bc_tiled(free_surface_bc_3d_west<decltype(HI),Layout>,
+           free_surface_bc_3d_south<decltype(HI),Layout>,
+           free_surface_bc_3d_east<decltype(HI),Layout>,
+           free_surface_bc_3d_north<decltype(HI),Layout>,
+           free_surface_bc_3d_bottom<decltype(HI),Layout>,
+           free_surface_bc_3d_top<decltype(HI),Layout>,F,q,ind_i,ind_j,ind_k,HI,hi);
+};
+
+/**
+* Nominal number of flops of the RHS at an interior point, used for logging.
+**/
+template <class SbpDerivative>
+constexpr PetscLogDouble wave_eq_3d_flops_per_point(const SbpDerivative& D1)
+{
+  // Six derivatives and the divergence
+  return 6*logging::derivative_flops(D1) + 2;
+}
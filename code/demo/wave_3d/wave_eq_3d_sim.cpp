@@ -0,0 +1,392 @@
+static char help[] ="Solves the 3D acoustic wave equation on first order form: u_t = A*u_x + B*u_y + C*u_z.";
+
+
+/**
+* Solves 3D acoustic wave equation on first order form, with unit density and incompressibility.
+* Variables:
+* u - x-velocity
+* v - y-velocity
+* w - z-velocity
+* p - pressure
+*
+* Equations:
+* ut = -px
+* vt = -py
+* wt = -pz
+* pt = -(ux + vy + wz)
+*
+* The RHS functions are defined in wave_eq_3d_rhs.h
+*
+**/
+
+#include <petsc.h>
+#include <array>
+#include "wave_eq_3d_rhs.h"
+#include "sbpops/op_defs.h"
+#include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_lsrk.h"
+#include "grids/grid_function.h"
+#include "grids/create_layout.h"
+#include "scatter_ctx/halo_exchange.h"
+#include "util/io_util.h"
+#include "util/vec_util.h"
+#include "util/threads.h"
+#include "util/perf_counters.h"
+#include "util/snapshot.h"
+#include "util/checkpoint.h"
+#include "util/receiver.h"
+#include "util/energy.h"
+
+template <class Ops>
+struct AppCtx{
+    std::array<PetscInt,3> N;
+    std::array<PetscInt,2> ind_i, ind_j, ind_k, tile;
+    std::array<PetscScalar,3> hi, h, xl;
+    PetscInt dofs;
+    PetscScalar sw;
+    const typename Ops::FirstDerivativeOp D1;
+    const typename Ops::InverseNormOp HI;
+    HaloCtx halo;
+    grid::partitioned_layout_3d layout;
+};
+
+template <class Ops>
+PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx<Ops>& appctx);
+template <class Ops>
+PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx<Ops>&, Vec);
+template <class Ops>
+PetscErrorCode rhs(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
+PetscErrorCode rhs_non_overlapping(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
+PetscErrorCode rhs_serial(TS, PetscReal, Vec, Vec, void *);
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv);
+
+int main(int argc,char **argv)
+{
+  PetscInt       order;
+  PetscErrorCode ierr;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  ierr = sbp::get_order_from_options(order);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"SBP operator order: %d\n",order);
+
+  // The simulation is instantiated for each order, which is only branched on here.
+  ierr = sbp::dispatch_order(order, [&](auto ops) { return simulate<decltype(ops)>(argc, argv); });
+  if (ierr) {
+    PetscFinalize();
+    return -1;
+  }
+  ierr = PetscFinalize();
+  return ierr;
+}
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv)
+{
+  DM             da;
+  Vec            v, v_analytic, vlocal;
+  PetscInt       stencil_radius, i_xstart, i_xend, i_ystart, i_yend, i_zstart, i_zend, Nx, Ny, Nz, nx, ny, nz, procx, procy, procz, dofs, use_custom_sc;
+  PetscScalar    xl, xr, yl, yr, zl, zr, hix, hiy, hiz, dt, t0, Tend, CFL;
+  PetscReal      l2_error, max_error;
+
+  AppCtx<Ops>    appctx;
+  PetscBool      write_data;
+  PetscLogDouble v1,v2,elapsed_time = 0;
+
+  PetscErrorCode ierr;
+  PetscMPIInt    size, rank;
+
+  ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size);CHKERRQ(ierr);
+  ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRQ(ierr);
+
+  if (get_inputs(argc, argv, Nx, Ny, Nz, Tend, CFL, use_custom_sc) == -1) {
+    return -1;
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     Problem setup
+   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  // Space
+  dofs = 4;
+  xl = -1;
+  xr = 1;
+  yl = -1;
+  yr = 1;
+  zl = -1;
+  zr = 1;
+  hix = (Nx-1)/(xr-xl);
+  hiy = (Ny-1)/(yr-yl);
+  hiz = (Nz-1)/(zr-zl);
+
+  // Time
+  t0 = 0;
+  dt = CFL/(std::max({hix,hiy,hiz}));
+
+  // Set if data should be written.
+  write_data = PETSC_FALSE;
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     Create distributed array (DMDA) to manage parallel grid and vectors
+   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  stencil_radius = (appctx.D1.interior_stencil_width()-1)/2;
+  DMDACreate3d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DMDA_STENCIL_STAR,
+               Nx,Ny,Nz,PETSC_DECIDE,PETSC_DECIDE,PETSC_DECIDE,dofs,stencil_radius,NULL,NULL,NULL,&da);
+  DMSetFromOptions(da);
+  DMSetUp(da);
+  DMDAGetCorners(da,&i_xstart,&i_ystart,&i_zstart,&nx,&ny,&nz);
+  i_xend = i_xstart + nx;
+  i_yend = i_ystart + ny;
+  i_zend = i_zstart + nz;
+
+  DMDAGetInfo(da,NULL,NULL,NULL,NULL,&procx,&procy,&procz,NULL,NULL,NULL,NULL,NULL,NULL);
+  PetscPrintf(PETSC_COMM_WORLD,"Processor topology dimensions: [%d,%d,%d]\n",procx,procy,procz);
+
+  // Populate application context.
+  appctx.N = {Nx, Ny, Nz};
+  appctx.hi = {hix, hiy, hiz};
+  appctx.h = {1./hix, 1./hiy, 1./hiz};
+  appctx.xl = {xl, yl, zl};
+  appctx.ind_i = {i_xstart,i_xend};
+  appctx.ind_j = {i_ystart,i_yend};
+  appctx.ind_k = {i_zstart,i_zend};
+  appctx.dofs = dofs;
+  appctx.sw = stencil_radius;
+  if (regions_3d::check_ranges(PETSC_COMM_WORLD, appctx.ind_i, appctx.ind_j, appctx.ind_k, appctx.N,
+                               appctx.D1.closure_size(), stencil_radius) == -1) {
+    return -1;
+  }
+  ierr = threads::setup();CHKERRQ(ierr);
+  ierr = perf_counters::setup();CHKERRQ(ierr);
+  tiling::get_tile_size_3d(appctx.D1.interior_stencil_width(), dofs, appctx.tile);
+  PetscPrintf(PETSC_COMM_WORLD,"RHS tile size: [%d,%d]\n",appctx.tile[0],appctx.tile[1]);
+  appctx.layout = grid::create_layout_3d(da);
+
+  // Extract local to local scatter context
+  ierr = halo_ctx_create(da, (HaloType) use_custom_sc, PETSC_FALSE, appctx.halo);CHKERRQ(ierr);
+
+  /*  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+      Extract global vectors from DMDA; then duplicate for remaining
+      vectors that are the same types
+    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  DMCreateGlobalVector(da,&v);
+  VecDuplicate(v,&v_analytic);
+  // Initial solution, starting time and end time.
+  initial_condition(da, v, appctx);
+
+  if (write_data) write_vector(v,"data/wave_3d","v_init",{0,Ops::order});
+
+  ierr = DMCreateLocalVector(da,&vlocal);CHKERRQ(ierr);
+  ierr = threads::first_touch(vlocal,appctx.layout);CHKERRQ(ierr);
+  DMGlobalToLocalBegin(da,v,INSERT_VALUES,vlocal);
+  DMGlobalToLocalEnd(da,v,INSERT_VALUES,vlocal);
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    Run simulation and compute the error
+  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  checkpoint::CheckpointCtx checkpoints;
+  ierr = checkpoint::create(da, PETSC_FALSE, "data/wave_3d", vlocal, checkpoints);CHKERRQ(ierr);
+  snapshot::SnapshotCtx snapshots;
+  ierr = snapshot::create(da, PETSC_FALSE, "data/wave_3d", PetscPowReal(1/PetscMin(PetscMin(hix,hiy),hiz),Ops::order), snapshots);CHKERRQ(ierr);
+  receiver::ReceiverCtx receivers;
+  ierr = receiver::create(da, PETSC_FALSE, "data/wave_3d", {xl, yl, zl}, {1./hix, 1./hiy, 1./hiz}, checkpoints.t_start, receivers);CHKERRQ(ierr);
+  energy::EnergyCtx energy_monitor;
+  ierr = energy::create(da, PETSC_FALSE, "data/wave_3d", typename Ops::NormOp(), {1./hix, 1./hiy, 1./hiz}, energy_monitor);CHKERRQ(ierr);
+  PetscBarrier((PetscObject) v);
+  if (rank == 0) {
+    PetscTime(&v1);
+  }
+
+  if (size == 1) {
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs_serial<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
+  }
+  else {
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
+  }
+
+  PetscBarrier((PetscObject) v);
+  if (rank == 0) {
+    PetscTime(&v2);
+    elapsed_time = v2 - v1;
+  }
+
+  PetscPrintf(PETSC_COMM_WORLD,"Elapsed time: %f seconds\n",elapsed_time);
+  ierr = perf_counters::view(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  ierr = snapshot::destroy(snapshots);CHKERRQ(ierr);
+  ierr = receiver::destroy(receivers);CHKERRQ(ierr);
+  ierr = energy::destroy(energy_monitor);CHKERRQ(ierr);
+  ierr = checkpoint::destroy(checkpoints);CHKERRQ(ierr);
+
+  DMLocalToGlobalBegin(da,vlocal,INSERT_VALUES,v);
+  DMLocalToGlobalEnd(da,vlocal,INSERT_VALUES,v);
+
+  analytic_solution(da, Tend, appctx, v_analytic);
+  ErrorNorms errors;
+  ierr = error_norms(da, v, v_analytic, typename Ops::NormOp(), appctx.h, errors);CHKERRQ(ierr);
+  l2_error = errors.l2;
+  max_error = errors.max;
+  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, the H-norm error is %g, and the maximum error is %g\n",l2_error,errors.hnorm,max_error);
+
+  // Write solution to file
+  if (write_data) {
+    write_vector(v,"data/wave_3d","v",{Tend,Ops::order});
+    Vec v_error = compute_error(v,v_analytic);
+    write_vector(v_error,"data/wave_3d","v_error",{Tend,Ops::order});
+    VecDestroy(&v_error);
+    char tmp_str[200];
+    std::string data_string;
+    sprintf(tmp_str,"%d\t%d\t%d\t%d\t%e\t%f\t%f\t%e\t%e\n",size,Nx,Ny,Nz,dt,Tend,elapsed_time,l2_error,max_error);
+    data_string.assign(tmp_str);
+    write_data_to_file(data_string, "data/wave_3d", "data.tsv");
+  }
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+      Free work space.  All PETSc objects should be destroyed when they
+      are no longer needed.
+    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  VecDestroy(&v);
+  VecDestroy(&v_analytic);
+  VecDestroy(&vlocal);
+  halo_ctx_destroy(appctx.halo);
+  DMDestroy(&da);
+
+  return 0;
+}
+
+template <class Ops>
+PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx<Ops>& appctx, Vec v) {
+  PetscInt i, j, k, n, m, l;
+  PetscScalar ****varr, x, y, z, omega;
+
+  n = 1; // n = 1,2,3,4,...
+  m = 2; // m = 1,2,3,4,...
+  l = 3; // l = 1,2,3,4,...
+  omega = sqrt(n*n + m*m + l*l);
+
+  DMDAVecGetArrayDOF(da,v,&varr);
+
+  for (k = appctx.ind_k[0]; k < appctx.ind_k[1]; k++)
+  {
+    z = appctx.xl[2] + k*appctx.h[2];
+    for (j = appctx.ind_j[0]; j < appctx.ind_j[1]; j++)
+    {
+      y = appctx.xl[1] + j*appctx.h[1];
+      for (i = appctx.ind_i[0]; i < appctx.ind_i[1]; i++)
+      {
+        x = appctx.xl[0] + i*appctx.h[0];
+        varr[k][j][i][0] = -n*cos(n*PETSC_PI*x)*sin(m*PETSC_PI*y)*sin(l*PETSC_PI*z)*sin(PETSC_PI*omega*t)/omega;
+        varr[k][j][i][1] = -m*sin(n*PETSC_PI*x)*cos(m*PETSC_PI*y)*sin(l*PETSC_PI*z)*sin(PETSC_PI*omega*t)/omega;
+        varr[k][j][i][2] = -l*sin(n*PETSC_PI*x)*sin(m*PETSC_PI*y)*cos(l*PETSC_PI*z)*sin(PETSC_PI*omega*t)/omega;
+        varr[k][j][i][3] = sin(n*PETSC_PI*x)*sin(m*PETSC_PI*y)*sin(l*PETSC_PI*z)*cos(PETSC_PI*omega*t);
+      }
+    }
+  }
+  DMDAVecRestoreArrayDOF(da,v,&varr);
+  return 0;
+}
+
+/**
+* Set initial condition.
+* Inputs: v      - vector to place initial data
+*         appctx - application context, contains necessary information
+**/
+template <class Ops>
+PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx<Ops>& appctx)
+{
+  analytic_solution(da, 0, appctx, v);
+  return 0;
+}
+
+template <class Ops>
+PetscErrorCode rhs(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+{
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  PetscScalar       *array_src, *array_dst;
+
+  logging::begin(logging::RHS);
+  VecGetArray(v_src,&array_src);
+  VecGetArray(v_dst,&array_dst);
+
+  auto gf_src = grid::grid_function_3d<PetscScalar>(array_src, appctx->layout);
+  auto gf_dst = grid::grid_function_3d<PetscScalar>(array_dst, appctx->layout);
+
+  // Overlapping
+  halo_exchange_begin(appctx->halo,v_src);
+  logging::begin(logging::RHS_LOCAL);
+  wave_eq_3d_local(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->ind_k, appctx->sw, appctx->tile, appctx->D1, appctx->hi);
+  logging::end(logging::RHS_LOCAL);
+  halo_exchange_end(appctx->halo,v_src);
+  logging::begin(logging::RHS_OVERLAP);
+  wave_eq_3d_overlap(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->ind_k, appctx->sw, appctx->tile, appctx->D1, appctx->hi);
+  logging::end(logging::RHS_OVERLAP);
+  logging::begin(logging::RHS_BC);
+  wave_eq_3d_free_surface_bc(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->ind_k, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
+
+  // Restore arrays
+  VecRestoreArray(v_src,&array_src);
+  VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_3d_flops_per_point(appctx->D1)*(appctx->ind_i[1]-appctx->ind_i[0])*(appctx->ind_j[1]-appctx->ind_j[0])*(appctx->ind_k[1]-appctx->ind_k[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
+  return 0;
+}
+
+template <class Ops>
+PetscErrorCode rhs_non_overlapping(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+{
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  PetscScalar       *array_src, *array_dst;
+
+  logging::begin(logging::RHS);
+  VecGetArray(v_src,&array_src);
+  VecGetArray(v_dst,&array_dst);
+
+  auto gf_src = grid::grid_function_3d<PetscScalar>(array_src, appctx->layout);
+  auto gf_dst = grid::grid_function_3d<PetscScalar>(array_dst, appctx->layout);
+  halo_exchange_begin(appctx->halo,v_src);
+  halo_exchange_end(appctx->halo,v_src);
+  wave_eq_3d_all(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->ind_k, appctx->sw, appctx->tile, appctx->D1, appctx->hi);
+  logging::begin(logging::RHS_BC);
+  wave_eq_3d_free_surface_bc(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->ind_k, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
+
+  // Restore arrays
+  VecRestoreArray(v_src,&array_src);
+  VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_3d_flops_per_point(appctx->D1)*(appctx->ind_i[1]-appctx->ind_i[0])*(appctx->ind_j[1]-appctx->ind_j[0])*(appctx->ind_k[1]-appctx->ind_k[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
+  return 0;
+}
+
+template <class Ops>
+PetscErrorCode rhs_serial(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+{
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  PetscScalar       *array_src, *array_dst;
+
+  logging::begin(logging::RHS);
+  VecGetArray(v_src,&array_src);
+  VecGetArray(v_dst,&array_dst);
+
+  auto gf_src = grid::grid_function_3d<PetscScalar>(array_src, appctx->layout);
+  auto gf_dst = grid::grid_function_3d<PetscScalar>(array_dst, appctx->layout);
+  wave_eq_3d_serial(gf_dst, gf_src, appctx->tile, appctx->D1, appctx->hi);
+  logging::begin(logging::RHS_BC);
+  wave_eq_3d_free_surface_bc_serial(gf_dst, gf_src, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
+
+  // Restore arrays
+  VecRestoreArray(v_src,&array_src);
+  VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_3d_flops_per_point(appctx->D1)*appctx->N[0]*appctx->N[1]*appctx->N[2];
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
+  return 0;
+}
@@ -2,9 +2,13 @@
 
 #include<petscsystypes.h>
 #include <array>
+#include <algorithm>
 #include "partitioned_rhs/rhs.h"
+#include "partitioned_rhs/tiling.h"
 #include "partitioned_rhs/boundary_conditions.h"
 #include "grids/grid_function.h"
+#include "sbpops/simd.h"
+#include "util/logging.h"
 
 /**
 * Functions for computing the righ-hand-side of the acoustic wave equation
@@ -45,9 +49,9 @@
   *   * ll *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_ll(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_ll(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
@@ -73,9 +77,9 @@ void wave_eq_hom_ll(grid::grid_function_2d<PetscScalar> F,
   *   *    * il *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_il(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_il(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_i,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -101,9 +105,9 @@ void wave_eq_hom_il(grid::grid_function_2d<PetscScalar> F,
   *   *    *    * rl *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_rl(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_rl(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
@@ -129,9 +133,9 @@ void wave_eq_hom_rl(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_li(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_li(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_j,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -158,9 +162,9 @@ void wave_eq_hom_li(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_ii(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_ii(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_i,
                     const std::array<PetscInt,2> ind_j,
                     const SbpDerivative& D1,
@@ -168,12 +172,20 @@ void wave_eq_hom_ii(grid::grid_function_2d<PetscScalar> F,
                     const std::array<PetscScalar,2>& xl,
                     const PetscScalar t)
 {
-
+  // Derivatives are computed in blocks of rows using the SIMD row kernels of D1.
+  PetscScalar px[sbp::simd::row_block], py[sbp::simd::row_block], ux[sbp::simd::row_block], vy[sbp::simd::row_block];
   for (PetscInt j = ind_j[0]; j < ind_j[1]; j++) { 
-    for (PetscInt i = ind_i[0]; i < ind_i[1]; i++) { 
-      F(j, i, 0) = -D1.apply_x_interior(q, hi[0], i, j, 2);
-      F(j, i, 1) = -D1.apply_y_interior(q, hi[1], i, j, 2);
-      F(j, i, 2) = -D1.apply_x_interior(q, hi[0], i, j, 0) - D1.apply_y_interior(q, hi[1], i, j, 1);
+    for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += sbp::simd::row_block) { 
+      const PetscInt i1 = std::min(i0 + sbp::simd::row_block, ind_i[1]);
+      D1.apply_x_interior_row(q, hi[0], {i0, i1}, j, 2, px);
+      D1.apply_y_interior_row(q, hi[1], {i0, i1}, j, 2, py);
+      D1.apply_x_interior_row(q, hi[0], {i0, i1}, j, 0, ux);
+      D1.apply_y_interior_row(q, hi[1], {i0, i1}, j, 1, vy);
+      for (PetscInt i = i0; i < i1; i++) { 
+        F(j, i, 0) = -px[i-i0];
+        F(j, i, 1) = -py[i-i0];
+        F(j, i, 2) = -ux[i-i0] - vy[i-i0];
+      }
     }
   }
 }
@@ -187,9 +199,9 @@ void wave_eq_hom_ii(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_ri(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_ri(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_j,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -217,9 +229,9 @@ void wave_eq_hom_ri(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_lr(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_lr(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
@@ -245,9 +257,9 @@ void wave_eq_hom_lr(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_ir(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_ir(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2> ind_i,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
@@ -274,9 +286,9 @@ void wave_eq_hom_ir(grid::grid_function_2d<PetscScalar> F,
   *   *    *    *    *
   *   ****************
   **/
-template <class SbpDerivative>
-void wave_eq_hom_rr(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_rr(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const PetscInt cl_sz,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
@@ -294,101 +306,109 @@ void wave_eq_hom_rr(grid::grid_function_2d<PetscScalar> F,
   }
 }
 
-template <class SbpDerivative>
-void wave_eq_hom_all(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_all(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
                     const std::array<PetscScalar,2>& xl,
                     const PetscScalar t)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_all(wave_eq_hom_ll<decltype(D1)>,
-            wave_eq_hom_li<decltype(D1)>,
-            wave_eq_hom_lr<decltype(D1)>,
-            wave_eq_hom_il<decltype(D1)>,
-            wave_eq_hom_ii<decltype(D1)>,
-            wave_eq_hom_ir<decltype(D1)>,
-            wave_eq_hom_rl<decltype(D1)>,
-            wave_eq_hom_ri<decltype(D1)>,
-            wave_eq_hom_rr<decltype(D1)>,
-            F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
+  rhs_all_tiled(tile,
+                wave_eq_hom_ll<decltype(D1),Layout>,
+                wave_eq_hom_li<decltype(D1),Layout>,
+                wave_eq_hom_lr<decltype(D1),Layout>,
+                wave_eq_hom_il<decltype(D1),Layout>,
+                wave_eq_hom_ii<decltype(D1),Layout>,
+                wave_eq_hom_ir<decltype(D1),Layout>,
+                wave_eq_hom_rl<decltype(D1),Layout>,
+                wave_eq_hom_ri<decltype(D1),Layout>,
+                wave_eq_hom_rr<decltype(D1),Layout>,
+                F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
 }
 
-template <class SbpDerivative>
-void wave_eq_hom_local(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_local(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
                     const std::array<PetscScalar,2>& xl,
                     const PetscScalar t)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_local(wave_eq_hom_ll<decltype(D1)>,
-            wave_eq_hom_li<decltype(D1)>,
-            wave_eq_hom_lr<decltype(D1)>,
-            wave_eq_hom_il<decltype(D1)>,
-            wave_eq_hom_ii<decltype(D1)>,
-            wave_eq_hom_ir<decltype(D1)>,
-            wave_eq_hom_rl<decltype(D1)>,
-            wave_eq_hom_ri<decltype(D1)>,
-            wave_eq_hom_rr<decltype(D1)>,
-            F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
+  rhs_local_tiled(tile,
+                  wave_eq_hom_ll<decltype(D1),Layout>,
+                  wave_eq_hom_li<decltype(D1),Layout>,
+                  wave_eq_hom_lr<decltype(D1),Layout>,
+                  wave_eq_hom_il<decltype(D1),Layout>,
+                  wave_eq_hom_ii<decltype(D1),Layout>,
+                  wave_eq_hom_ir<decltype(D1),Layout>,
+                  wave_eq_hom_rl<decltype(D1),Layout>,
+                  wave_eq_hom_ri<decltype(D1),Layout>,
+                  wave_eq_hom_rr<decltype(D1),Layout>,
+                  F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
 }
 
-template <class SbpDerivative>
-void wave_eq_hom_overlap(grid::grid_function_2d<PetscScalar> F,
-                    const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_overlap(grid::grid_function_2d<PetscScalar,Layout> F,
+                    const grid::grid_function_2d<PetscScalar,Layout> q,
                     const std::array<PetscInt,2>& ind_i,
                     const std::array<PetscInt,2>& ind_j,
                     const PetscInt halo_sz,
+                    const std::array<PetscInt,2>& tile,
                     const SbpDerivative& D1,
                     const std::array<PetscScalar,2>& hi,
                     const std::array<PetscScalar,2>& xl,
                     const PetscScalar t)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_overlap(wave_eq_hom_li<decltype(D1)>,
-              wave_eq_hom_il<decltype(D1)>,
-              wave_eq_hom_ii<decltype(D1)>,
-              wave_eq_hom_ir<decltype(D1)>,
-              wave_eq_hom_ri<decltype(D1)>,
-              F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
+  rhs_overlap_tiled(tile,
+                    wave_eq_hom_li<decltype(D1),Layout>,
+                    wave_eq_hom_il<decltype(D1),Layout>,
+                    wave_eq_hom_ii<decltype(D1),Layout>,
+                    wave_eq_hom_ir<decltype(D1),Layout>,
+                    wave_eq_hom_ri<decltype(D1),Layout>,
+                    F,q,ind_i,ind_j,cl_sz,halo_sz,D1,hi,xl,t);
 }
 
-template <class SbpDerivative>
-void wave_eq_hom_serial(grid::grid_function_2d<PetscScalar> F,
-                          const grid::grid_function_2d<PetscScalar> q,
+template <class SbpDerivative, typename Layout>
+void wave_eq_hom_serial(grid::grid_function_2d<PetscScalar,Layout> F,
+                          const grid::grid_function_2d<PetscScalar,Layout> q,
+                          const std::array<PetscInt,2>& tile,
                           const SbpDerivative& D1,
                           const std::array<PetscScalar,2>& hi,
                           const std::array<PetscScalar,2>& xl,
                           const PetscScalar t)
 {
   const PetscInt cl_sz = D1.closure_size();
-  rhs_serial(wave_eq_hom_ll<decltype(D1)>,
-             wave_eq_hom_li<decltype(D1)>,
-             wave_eq_hom_lr<decltype(D1)>,
-             wave_eq_hom_il<decltype(D1)>,
-             wave_eq_hom_ii<decltype(D1)>,
-             wave_eq_hom_ir<decltype(D1)>,
-             wave_eq_hom_rl<decltype(D1)>,
-             wave_eq_hom_ri<decltype(D1)>,
-             wave_eq_hom_rr<decltype(D1)>,
-             F,q,cl_sz,D1,hi,xl,t);
+  rhs_serial_tiled(tile,
+                   wave_eq_hom_ll<decltype(D1),Layout>,
+                   wave_eq_hom_li<decltype(D1),Layout>,
+                   wave_eq_hom_lr<decltype(D1),Layout>,
+                   wave_eq_hom_il<decltype(D1),Layout>,
+                   wave_eq_hom_ii<decltype(D1),Layout>,
+                   wave_eq_hom_ir<decltype(D1),Layout>,
+                   wave_eq_hom_rl<decltype(D1),Layout>,
+                   wave_eq_hom_ri<decltype(D1),Layout>,
+                   wave_eq_hom_rr<decltype(D1),Layout>,
+                   F,q,cl_sz,D1,hi,xl,t);
 }
 
 /**
 * Free surface boundary condition functions
 **/
-template<class SbpInvQuad>
-void free_surface_bc_west(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_west(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_j,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -399,9 +419,9 @@ void free_surface_bc_west(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template<class SbpInvQuad>
-void free_surface_bc_south(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_south(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_i,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -412,9 +432,9 @@ void free_surface_bc_south(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template<class SbpInvQuad>
-void free_surface_bc_east(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_east(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_j,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -426,9 +446,9 @@ void free_surface_bc_east(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template<class SbpInvQuad>
-void free_surface_bc_north(grid::grid_function_2d<PetscScalar> F,
-                           const grid::grid_function_2d<PetscScalar> q,
+template<class SbpInvQuad, typename Layout>
+void free_surface_bc_north(grid::grid_function_2d<PetscScalar,Layout> F,
+                           const grid::grid_function_2d<PetscScalar,Layout> q,
                            const std::array<PetscInt,2>& ind_i,
                            const SbpInvQuad& HI,
                            const std::array<PetscScalar,2>& hi)
@@ -440,28 +460,38 @@ void free_surface_bc_north(grid::grid_function_2d<PetscScalar> F,
   }
 };
 
-template <class SbpInvQuad>
-void wave_eq_hom_free_surface_bc_serial(grid::grid_function_2d<PetscScalar> F,
-                                 const grid::grid_function_2d<PetscScalar> q,
+template <class SbpInvQuad, typename Layout>
+void wave_eq_hom_free_surface_bc_serial(grid::grid_function_2d<PetscScalar,Layout> F,
+                                 const grid::grid_function_2d<PetscScalar,Layout> q,
                                  const SbpInvQuad& HI,
                                  const std::array<PetscScalar,2>& hi)
 {
-  bc_serial(free_surface_bc_west<decltype(HI)>,
-             free_surface_bc_south<decltype(HI)>,
-             free_surface_bc_east<decltype(HI)>,
-             free_surface_bc_north<decltype(HI)>,F,q,HI,hi);
+  bc_serial_tiled(free_surface_bc_west<decltype(HI),Layout>,
+                  free_surface_bc_south<decltype(HI),Layout>,
+                  free_surface_bc_east<decltype(HI),Layout>,
+                  free_surface_bc_north<decltype(HI),Layout>,F,q,HI,hi);
 };
 
-template <class SbpInvQuad>
-void wave_eq_hom_free_surface_bc(grid::grid_function_2d<PetscScalar> F,
-                             const grid::grid_function_2d<PetscScalar> q,
+template <class SbpInvQuad, typename Layout>
+void wave_eq_hom_free_surface_bc(grid::grid_function_2d<PetscScalar,Layout> F,
+                             const grid::grid_function_2d<PetscScalar,Layout> q,
                              const std::array<PetscInt,2>& ind_i,
                              const std::array<PetscInt,2>& ind_j,
                              const SbpInvQuad& HI,
                              const std::array<PetscScalar,2>& hi)
 {
-  bc(free_surface_bc_west<decltype(HI)>,
-    free_surface_bc_south<decltype(HI)>,
-    free_surface_bc_east<decltype(HI)>,
-    free_surface_bc_north<decltype(HI)>,F,q,ind_i,ind_j,HI,hi);
-};
\ No newline at end of file
+  bc_tiled(free_surface_bc_west<decltype(HI),Layout>,
+           free_surface_bc_south<decltype(HI),Layout>,
+           free_surface_bc_east<decltype(HI),Layout>,
+           free_surface_bc_north<decltype(HI),Layout>,F,q,ind_i,ind_j,HI,hi);
+};
+
+/**
+* Nominal number of flops of the RHS at an interior point, used for logging.
+**/
+template <class SbpDerivative>
+constexpr PetscLogDouble wave_eq_hom_flops_per_point(const SbpDerivative& D1)
+{
+  // Four derivatives and the divergence
+  return 4*logging::derivative_flops(D1) + 1;
+}
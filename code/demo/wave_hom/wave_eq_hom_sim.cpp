@@ -27,50 +27,89 @@ static char help[] ="Solves the 2D acoustic wave equation on first order form: u
 #include "wave_eq_hom_rhs.h"
 #include "sbpops/op_defs.h"
 #include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_lsrk.h"
 #include "grids/grid_function.h"
 #include "grids/create_layout.h"
-#include "scatter_ctx/scatter_ctx.h"
+#include "scatter_ctx/halo_exchange.h"
+#include "partitioned_rhs/deep_halo.h"
 #include "util/io_util.h"
 #include "util/vec_util.h"
-
+#include "util/threads.h"
+#include "util/perf_counters.h"
+#include "util/snapshot.h"
+#include "util/checkpoint.h"
+#include "util/receiver.h"
+#include "util/energy.h"
+
+template <class Ops>
 struct AppCtx{
-    std::array<PetscInt,2> N, ind_i, ind_j;
+    std::array<PetscInt,2> N, ind_i, ind_j, tile;
     std::array<PetscScalar,2> hi, h, xl;
     PetscInt dofs;
     PetscScalar sw;
-    const FirstDerivativeOp D1;
-    const InverseNormOp HI;
-    VecScatter scatctx;
+    const typename Ops::FirstDerivativeOp D1;
+    const typename Ops::InverseNormOp HI;
+    HaloCtx halo;
+    deep_halo::DeepHaloCtx deep_halo;
     grid::partitioned_layout_2d layout;
 };
 
-PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx& appctx);
-PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx&, Vec);
+template <class Ops>
+PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx<Ops>& appctx);
+template <class Ops>
+PetscErrorCode analytic_solution(const DM, const PetscScalar, const AppCtx<Ops>&, Vec);
+template <class Ops>
 PetscErrorCode rhs(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
 PetscErrorCode rhs_non_overlapping(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
 PetscErrorCode rhs_serial(TS, PetscReal, Vec, Vec, void *);
+template <class Ops>
+PetscErrorCode rhs_deep_halo(TS, PetscReal, Vec, Vec, void *);
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv);
 
 int main(int argc,char **argv)
+{
+  PetscInt       order;
+  PetscErrorCode ierr;
+
+  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
+  ierr = sbp::get_order_from_options(order);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"SBP operator order: %d\n",order);
+
+  // The simulation is instantiated for each order, which is only branched on here.
+  ierr = sbp::dispatch_order(order, [&](auto ops) { return simulate<decltype(ops)>(argc, argv); });
+  if (ierr) {
+    PetscFinalize();
+    return -1;
+  }
+  ierr = PetscFinalize();
+  return ierr;
+}
+
+template <class Ops>
+PetscErrorCode simulate(int argc, char **argv)
 { 
   DM             da;
   Vec            v, v_analytic, vlocal;
-  PetscInt       stencil_radius, i_xstart, i_xend, i_ystart, i_yend, Nx, Ny, nx, ny, procx, procy, dofs;
+  PetscInt       stencil_radius, stencil_width, i_xstart, i_xend, i_ystart, i_yend, Nx, Ny, nx, ny, procx, procy, dofs, use_custom_sc;
+  DMDAStencilType stencil_type;
   PetscScalar    xl, xr, yl, yr, hix, hiy, dt, t0, Tend, CFL;
   PetscReal      l2_error, max_error;
 
-  AppCtx         appctx;
-  PetscBool      write_data, use_custom_sc;
+  AppCtx<Ops>    appctx;
+  PetscBool      write_data;
   PetscLogDouble v1,v2,elapsed_time = 0;
 
   PetscErrorCode ierr;
   PetscMPIInt    size, rank;
 
-  ierr = PetscInitialize(&argc,&argv,(char*)0,help);if (ierr) return ierr;
   ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size);CHKERRQ(ierr);
   ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRQ(ierr);
 
   if (get_inputs(argc, argv, Nx, Ny, Tend, CFL, use_custom_sc) == -1) {
-    PetscFinalize();
     return -1;
   }
 
@@ -97,8 +136,9 @@ int main(int argc,char **argv)
      Create distributed array (DMDA) to manage parallel grid and vectors
    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   stencil_radius = (appctx.D1.interior_stencil_width()-1)/2;
-  DMDACreate2d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DMDA_STENCIL_STAR,
-               Nx,Ny,PETSC_DECIDE,PETSC_DECIDE,dofs,stencil_radius,NULL,NULL,&da);
+  ierr = deep_halo::setup(stencil_radius, appctx.D1.closure_size(), ts_stages_from_options(), appctx.deep_halo, stencil_width, stencil_type);CHKERRQ(ierr);
+  DMDACreate2d(PETSC_COMM_WORLD,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,stencil_type,
+               Nx,Ny,PETSC_DECIDE,PETSC_DECIDE,dofs,stencil_width,NULL,NULL,&da);
   DMSetFromOptions(da);
   DMSetUp(da);
   DMDAGetCorners(da,&i_xstart,&i_ystart,NULL,&nx,&ny,NULL);
@@ -124,13 +164,16 @@ int main(int argc,char **argv)
   appctx.ind_j = {i_ystart,i_yend};
   appctx.dofs = dofs;
   appctx.sw = stencil_radius;
+  ierr = threads::setup();CHKERRQ(ierr);
+  ierr = perf_counters::setup();CHKERRQ(ierr);
+  tiling::get_tile_size(appctx.D1.interior_stencil_width(), dofs, appctx.tile);
+  PetscPrintf(PETSC_COMM_WORLD,"RHS tile size: [%d,%d]\n",appctx.tile[0],appctx.tile[1]);
   appctx.layout = grid::create_layout_2d(da);
 
   // Extract local to local scatter context
-  if (use_custom_sc) {
-    scatter_ctx_ltol(da, appctx.scatctx);
-  } else {
-    DMDAGetScatter(da, NULL, &appctx.scatctx);
+  ierr = halo_ctx_create(da, (HaloType) use_custom_sc, PETSC_FALSE, appctx.halo);CHKERRQ(ierr);
+  if (deep_halo::setup_ranges(da, (HaloType) use_custom_sc, PETSC_FALSE, appctx.deep_halo) == -1) {
+    return -1;
   }
   
   /*  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -142,15 +185,24 @@ int main(int argc,char **argv)
   // Initial solution, starting time and end time.
   initial_condition(da, v, appctx);
 
-  if (write_data) write_vector_to_binary(v,"data/wave","v_init");
+  if (write_data) write_vector(v,"data/wave","v_init",{0,Ops::order});
 
   ierr = DMCreateLocalVector(da,&vlocal);CHKERRQ(ierr);
+  ierr = threads::first_touch(vlocal,appctx.layout);CHKERRQ(ierr);
   DMGlobalToLocalBegin(da,v,INSERT_VALUES,vlocal);  
   DMGlobalToLocalEnd(da,v,INSERT_VALUES,vlocal);
 
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     Run simulation and compute the error
   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  checkpoint::CheckpointCtx checkpoints;
+  ierr = checkpoint::create(da, PETSC_FALSE, "data/wave", vlocal, checkpoints);CHKERRQ(ierr);
+  snapshot::SnapshotCtx snapshots;
+  ierr = snapshot::create(da, PETSC_FALSE, "data/wave", PetscPowReal(1/PetscMin(hix,hiy),Ops::order), snapshots);CHKERRQ(ierr);
+  receiver::ReceiverCtx receivers;
+  ierr = receiver::create(da, PETSC_FALSE, "data/wave", {xl, yl, 0}, {1./hix, 1./hiy, 1}, checkpoints.t_start, receivers);CHKERRQ(ierr);
+  energy::EnergyCtx energy_monitor;
+  ierr = energy::create(da, PETSC_FALSE, "data/wave", typename Ops::NormOp(), {1./hix, 1./hiy, 1}, energy_monitor);CHKERRQ(ierr);
   PetscBarrier((PetscObject) v);
   if (rank == 0) {
     PetscTime(&v1);
@@ -158,10 +210,13 @@ int main(int argc,char **argv)
 
   // TODO: Add runtime flag checking for overlapping or non-overlapping RHS
   if (size == 1) {
-    ts_rk4(da, Tend, dt, vlocal, rhs_serial, &appctx);  
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs_serial<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);  
+  }
+  else if (deep_halo::enabled(appctx.deep_halo)) {
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs_deep_halo<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE);
   }
   else {
-    ts_rk4(da, Tend, dt, vlocal, rhs, &appctx); 
+    ts_rk_from_options(da, Tend, dt, vlocal, rhs<Ops>, &appctx, checkpoints.t_start, checkpoints.step_start, PETSC_FALSE, coupling_width(appctx.D1), PETSC_FALSE); 
   }
   
   PetscBarrier((PetscObject) v);
@@ -171,23 +226,30 @@ int main(int argc,char **argv)
   }
 
   PetscPrintf(PETSC_COMM_WORLD,"Elapsed time: %f seconds\n",elapsed_time);
+  ierr = perf_counters::view(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  ierr = snapshot::destroy(snapshots);CHKERRQ(ierr);
+  ierr = receiver::destroy(receivers);CHKERRQ(ierr);
+  ierr = energy::destroy(energy_monitor);CHKERRQ(ierr);
+  ierr = checkpoint::destroy(checkpoints);CHKERRQ(ierr);
 
   DMLocalToGlobalBegin(da,vlocal,INSERT_VALUES,v);
   DMLocalToGlobalEnd(da,vlocal,INSERT_VALUES,v);
 
   analytic_solution(da, Tend, appctx, v_analytic);
-  l2_error = error_l2(v,v_analytic, appctx.h);
-  max_error = error_max(v,v_analytic);
-  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, and the maximum error is %g\n",l2_error,max_error);
+  ErrorNorms errors;
+  ierr = error_norms(da, v, v_analytic, typename Ops::NormOp(), appctx.h, errors);CHKERRQ(ierr);
+  l2_error = errors.l2;
+  max_error = errors.max;
+  PetscPrintf(PETSC_COMM_WORLD,"The l2-error is: %g, the H-norm error is %g, and the maximum error is %g\n",l2_error,errors.hnorm,max_error);
 
   // Print outs to generate .csv file. Headers: mode, order, custom sc, size, Nx, nx, error, elap time
   // PetscPrintf(PETSC_COMM_WORLD,"local,%s,%d,%d,%d,%d,%f,%f\n",getenv("order"),use_custom_sc,size,Nx,nx,l2_error,elapsed_time);
 
   // Write solution to file
   if (write_data) {
-    write_vector_to_binary(v,"data/wave","v");
+    write_vector(v,"data/wave","v",{Tend,Ops::order});
     Vec v_error = compute_error(v,v_analytic);
-    write_vector_to_binary(v_error,"data/wave","v_error");
+    write_vector(v_error,"data/wave","v_error",{Tend,Ops::order});
     VecDestroy(&v_error);
     char tmp_str[200];
     std::string data_string;
@@ -202,13 +264,14 @@ int main(int argc,char **argv)
     - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   VecDestroy(&v);
   VecDestroy(&v_analytic);
+  halo_ctx_destroy(appctx.halo);
   DMDestroy(&da);
   
-  ierr = PetscFinalize();
-  return ierr;
+  return 0;
 }
 
-PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx &appctx, Vec v) {
+template <class Ops>
+PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx<Ops>& appctx, Vec v) {
   PetscInt i, j, n, m; 
   PetscScalar ***varr, x, y;
 
@@ -237,17 +300,20 @@ PetscErrorCode analytic_solution(const DM da, const PetscScalar t, const AppCtx
 * Inputs: v      - vector to place initial data
 *         appctx - application context, contains necessary information
 **/
-PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx& appctx) 
+template <class Ops>
+PetscErrorCode initial_condition(const DM da, Vec v, const AppCtx<Ops>& appctx) 
 {
   analytic_solution(da, 0, appctx, v);
   return 0;
 }
 
+template <class Ops>
 PetscErrorCode rhs(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
   PetscScalar       *array_src, *array_dst;
 
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
 
@@ -255,55 +321,113 @@ PetscErrorCode rhs(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
   auto gf_dst = grid::grid_function_2d<PetscScalar>(array_dst, appctx->layout);
 
   // Overlapping
-  VecScatterBegin(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
-  wave_eq_hom_local(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->D1, appctx->hi, appctx->xl, t);
-  VecScatterEnd(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
-  wave_eq_hom_overlap(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->D1, appctx->hi, appctx->xl, t);
+  halo_exchange_begin(appctx->halo,v_src);
+  logging::begin(logging::RHS_LOCAL);
+  wave_eq_hom_local(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->xl, t);
+  logging::end(logging::RHS_LOCAL);
+  halo_exchange_end(appctx->halo,v_src);
+  logging::begin(logging::RHS_OVERLAP);
+  wave_eq_hom_overlap(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->xl, t);
+  logging::end(logging::RHS_OVERLAP);
+  logging::begin(logging::RHS_BC);
   wave_eq_hom_free_surface_bc(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
 
   // Restore arrays
   VecRestoreArray(v_src,&array_src);
   VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_hom_flops_per_point(appctx->D1)*(appctx->ind_i[1]-appctx->ind_i[0])*(appctx->ind_j[1]-appctx->ind_j[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
+template <class Ops>
 PetscErrorCode rhs_non_overlapping(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
   PetscScalar       *array_src, *array_dst;
 
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
 
   auto gf_src = grid::grid_function_2d<PetscScalar>(array_src, appctx->layout);
   auto gf_dst = grid::grid_function_2d<PetscScalar>(array_dst, appctx->layout);
-  VecScatterBegin(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
-  VecScatterEnd(appctx->scatctx,v_src,v_src,INSERT_VALUES,SCATTER_FORWARD);
-  wave_eq_hom_all(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->D1, appctx->hi, appctx->xl, t);
+  halo_exchange_begin(appctx->halo,v_src);
+  halo_exchange_end(appctx->halo,v_src);
+  wave_eq_hom_all(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->xl, t);
+  logging::begin(logging::RHS_BC);
   wave_eq_hom_free_surface_bc(gf_dst, gf_src, appctx->ind_i, appctx->ind_j, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
 
   // Restore arrays
   VecRestoreArray(v_src,&array_src);
   VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_hom_flops_per_point(appctx->D1)*(appctx->ind_i[1]-appctx->ind_i[0])*(appctx->ind_j[1]-appctx->ind_j[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
+template <class Ops>
 PetscErrorCode rhs_serial(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
 {
-  AppCtx *appctx = (AppCtx*) ctx;
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
   PetscScalar       *array_src, *array_dst;
 
+  logging::begin(logging::RHS);
   VecGetArray(v_src,&array_src);
   VecGetArray(v_dst,&array_dst);
 
   auto gf_src = grid::grid_function_2d<PetscScalar>(array_src, appctx->layout);
   auto gf_dst = grid::grid_function_2d<PetscScalar>(array_dst, appctx->layout);
-  wave_eq_hom_serial(gf_dst, gf_src, appctx->D1, appctx->hi, appctx->xl, t);
+  wave_eq_hom_serial(gf_dst, gf_src, appctx->tile, appctx->D1, appctx->hi, appctx->xl, t);
+  logging::begin(logging::RHS_BC);
   wave_eq_hom_free_surface_bc_serial(gf_dst, gf_src, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
 
   // Restore arrays
   VecRestoreArray(v_src,&array_src);
   VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_hom_flops_per_point(appctx->D1)*appctx->N[0]*appctx->N[1];
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
   return 0;
 }
 
+template <class Ops>
+PetscErrorCode rhs_deep_halo(TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+{
+  AppCtx<Ops> *appctx = (AppCtx<Ops>*) ctx;
+  PetscScalar       *array_src, *array_dst;
+  std::array<PetscInt,2> ind_i, ind_j;
+
+  logging::begin(logging::RHS);
+  VecGetArray(v_src,&array_src);
+  VecGetArray(v_dst,&array_dst);
+
+  auto gf_src = grid::grid_function_2d<PetscScalar>(array_src, appctx->layout);
+  auto gf_dst = grid::grid_function_2d<PetscScalar>(array_dst, appctx->layout);
+  // Exchange the halo once every deep_halo.steps time steps, otherwise compute on the valid part of the ghost region.
+  if (deep_halo::next_evaluation(appctx->deep_halo, ind_i, ind_j)) {
+    halo_exchange_begin(appctx->halo,v_src);
+    halo_exchange_end(appctx->halo,v_src);
+  }
+  wave_eq_hom_all(gf_dst, gf_src, ind_i, ind_j, appctx->sw, appctx->tile, appctx->D1, appctx->hi, appctx->xl, t);
+  logging::begin(logging::RHS_BC);
+  wave_eq_hom_free_surface_bc(gf_dst, gf_src, ind_i, ind_j, appctx->HI, appctx->hi);
+  logging::end(logging::RHS_BC);
+
+  // Restore arrays
+  VecRestoreArray(v_src,&array_src);
+  VecRestoreArray(v_dst,&array_dst);
+  const PetscLogDouble flops = wave_eq_hom_flops_per_point(appctx->D1)*(ind_i[1]-ind_i[0])*(ind_j[1]-ind_j[0]);
+  logging::flops(flops);
+  perf_counters::add_flops(flops);
+  logging::end(logging::RHS);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <petscdmda.h>
+#include <string>
+#include "grids/grid_function.h"
+#include "grids/create_layout.h"
+
+namespace grid
+{
+    /**
+    * Coefficient fields: spatially varying coefficients of a PDE (e.g material parameters) precomputed on the local
+    * (ghosted) grid points of a 2D DMDA. The coefficients are stored interleaved, one component per coefficient, in a
+    * local vector of a DMDA compatible with the solution DMDA, i.e with the same partitioning and stencil width.
+    * A coefficient field is accessed as a grid function using global indices, such that coefficient c at the
+    * solution point (j,i) is coeffs(j,i,c), independently of the layout of the solution grid functions.
+    **/
+    struct CoefficientField2D {
+        DM da;                          // DMDA with one dof per coefficient, compatible with the solution DMDA
+        Vec v;                          // Local vector holding the coefficients
+        partitioned_layout_2d layout;   // Layout of v
+    };
+
+    /**
+    * Creates a coefficient field of n_coeffs coefficients for the solution DMDA da. The coefficients are zero.
+    **/
+    PetscErrorCode coefficient_field_create(const DM da, const PetscInt n_coeffs, CoefficientField2D& coeffs);
+
+    /**
+    * Sets the coefficients from a function f(i, j, c), returning coefficient c at grid point (i,j), on all local
+    * points including the ghost points. No communication is required.
+    **/
+    template <typename Function>
+    PetscErrorCode coefficient_field_fill(CoefficientField2D& coeffs, Function&& f)
+    {
+        PetscErrorCode ierr;
+        PetscInt i_xstart, i_ystart, nx, ny, n_coeffs;
+        PetscScalar *array;
+
+        ierr = DMDAGetInfo(coeffs.da,NULL,NULL,NULL,NULL,NULL,NULL,NULL,&n_coeffs,NULL,NULL,NULL,NULL,NULL);CHKERRQ(ierr);
+        ierr = DMDAGetGhostCorners(coeffs.da,&i_xstart,&i_ystart,NULL,&nx,&ny,NULL);CHKERRQ(ierr);
+        ierr = VecGetArray(coeffs.v,&array);CHKERRQ(ierr);
+        auto gf = grid_function_2d<PetscScalar>(array, coeffs.layout);
+        for (PetscInt j = i_ystart; j < i_ystart + ny; j++) {
+            for (PetscInt i = i_xstart; i < i_xstart + nx; i++) {
+                for (PetscInt c = 0; c < n_coeffs; c++) {
+                    gf(j, i, c) = f(i, j, c);
+                }
+            }
+        }
+        ierr = VecRestoreArray(coeffs.v,&array);CHKERRQ(ierr);
+        return 0;
+    }
+
+    /**
+    * Reads the coefficients from a PETSc binary file holding a global vector of the coefficient DMDA, e.g written by
+    * write_vector_to_binary, and distributes them to the local points including the ghost points.
+    **/
+    PetscErrorCode coefficient_field_load(CoefficientField2D& coeffs, const std::string& file);
+
+    /**
+    * Gives read access to the coefficients as a grid function. Must be matched by coefficient_field_restore.
+    **/
+    PetscErrorCode coefficient_field_get(const CoefficientField2D& coeffs, grid_function_2d<const PetscScalar>& gf);
+    PetscErrorCode coefficient_field_restore(const CoefficientField2D& coeffs, grid_function_2d<const PetscScalar>& gf);
+
+    PetscErrorCode coefficient_field_destroy(CoefficientField2D& coeffs);
+}
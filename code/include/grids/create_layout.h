@@ -7,4 +7,17 @@ namespace grid
 {
     partitioned_layout_1d create_layout_1d(const DM& da);
     partitioned_layout_2d create_layout_2d(const DM& da);
+    partitioned_layout_2d_soa create_layout_2d_soa(const DM& da);
+    partitioned_layout_3d create_layout_3d(const DM& da);
+
+    /**
+    * Converts a local (ghosted) vector between the interleaved ordering used by the DMDA, i.e PartitionedLayout2D,
+    * and the component-major ordering of PartitionedLayout2DSoA. Ghost points are converted as well.
+    * Inputs: da    - DMDA object
+    *         v_src - Local vector in the source ordering
+    *
+    * Output: v_dst - Local vector in the target ordering. Must have the same size as v_src, e.g obtained via VecDuplicate.
+    **/
+    PetscErrorCode local_aos_to_soa(const DM& da, const Vec v_src, Vec v_dst);
+    PetscErrorCode local_soa_to_aos(const DM& da, const Vec v_src, Vec v_dst);
 }
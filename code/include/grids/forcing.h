@@ -0,0 +1,67 @@
+#pragma once
+#include <petscdmda.h>
+#include <functional>
+#include "grids/grid_function.h"
+#include "grids/coefficient_field.h"
+
+namespace grid
+{
+    /**
+    * Forcing functions (source terms) of a PDE, cached on the local (ghosted) grid points of a 2D DMDA.
+    *
+    * A separable source g(t)*f(x,y) stores the spatial part f once, and each RHS evaluation only computes the scalar
+    * time factor g(t). A general source f(x,y,t) is re-evaluated on all local points whenever the time changes, which
+    * costs the same as evaluating it inside the RHS kernels, but is only done once for Runge-Kutta stages sharing the
+    * same time (e.g the two middle stages of RK4).
+    *
+    * In both cases the kernels read the source through a forcing_function_2d, force(j,i,c) = g*f(j,i,c), with g = 1
+    * for a general source.
+    **/
+    using SpatialSource2D = std::function<PetscScalar(PetscInt i, PetscInt j, PetscInt c)>;
+    using TimeFactor = std::function<PetscScalar(PetscScalar t)>;
+    using SpaceTimeSource2D = std::function<PetscScalar(PetscInt i, PetscInt j, PetscInt c, PetscScalar t)>;
+
+    struct ForcingField2D {
+        CoefficientField2D values;  // f(x,y), or f(x,y,t) at time t for a general source
+        TimeFactor time_factor;     // g(t) of a separable source, empty for a general source
+        SpaceTimeSource2D source;   // f(x,y,t) of a general source, empty for a separable source
+        PetscScalar g;              // Time factor at time t
+        PetscScalar t;              // Time of the cached values
+        bool valid;                 // If the cached values are valid
+    };
+
+    /**
+    * Read-only view of a forcing field at a given time, as passed to the RHS kernels.
+    **/
+    struct forcing_function_2d {
+        grid_function_2d<const PetscScalar> f;
+        PetscScalar g;
+
+        inline PetscScalar operator()(const PetscInt j, const PetscInt i, const PetscInt c) const
+        {
+            return g*f(j, i, c);
+        }
+    };
+
+    /**
+    * Creates a forcing field of the separable source g(t)*f(i,j,c), with n_comps components, for the DMDA da.
+    * Evaluates the spatial part f on all local points.
+    **/
+    PetscErrorCode forcing_field_create_separable(const DM da, const PetscInt n_comps, const SpatialSource2D& f,
+                                                  const TimeFactor& g, ForcingField2D& forcing);
+
+    /**
+    * Creates a forcing field of the general source f(i,j,c,t), with n_comps components, for the DMDA da.
+    **/
+    PetscErrorCode forcing_field_create(const DM da, const PetscInt n_comps, const SpaceTimeSource2D& f,
+                                        ForcingField2D& forcing);
+
+    /**
+    * Gives read access to the forcing at time t. Evaluates the time factor of a separable source, or the source on all
+    * local points for a general source unless already cached at time t. Must be matched by forcing_field_restore.
+    **/
+    PetscErrorCode forcing_field_get(ForcingField2D& forcing, const PetscScalar t, forcing_function_2d& force);
+    PetscErrorCode forcing_field_restore(ForcingField2D& forcing, forcing_function_2d& force);
+
+    PetscErrorCode forcing_field_destroy(ForcingField2D& forcing);
+}
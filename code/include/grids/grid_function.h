@@ -8,9 +8,9 @@ namespace grid
     template <typename T>
     using grid_function_1d = stdex::basic_mdspan<T, extents_1d, PartitionedLayout1D>;
 
-    template <typename T>
-    using grid_function_2d = stdex::basic_mdspan<T, extents_2d, PartitionedLayout2D>;
+    template <typename T, typename Layout = PartitionedLayout2D>
+    using grid_function_2d = stdex::basic_mdspan<T, extents_2d, Layout>;
     
-    template <typename T>
-    using grid_function_3d = stdex::mdspan<T, stdex::dynamic_extent, stdex::dynamic_extent, stdex::dynamic_extent>;
+    template <typename T, typename Layout = PartitionedLayout3D>
+    using grid_function_3d = stdex::basic_mdspan<T, extents_3d, Layout>;
 }
\ No newline at end of file
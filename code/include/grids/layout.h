@@ -111,7 +111,13 @@ namespace grid{
 
       constexpr index_t
       ny() const noexcept {
-        return _nx;
+        return _ny;
+      }
+
+      // Returns the extents [nxg, nyg, dofs] of the local (ghosted) domain
+      constexpr Extents const&
+      extents() const noexcept {
+        return _extents;
       }
 
       // Returns the offset going from global to local indexing
@@ -153,10 +159,207 @@ namespace grid{
     };
   };
 
+  /**
+  * Component-major (structure-of-arrays) counterpart of PartitionedLayout2D. Each component of the
+  * grid function is stored as a separate contiguous [j][i] array of the local (ghosted) domain, i.e
+  * the layout maps (j,i,comp) to comp*nxg*nyg + i + nxg*j. Consecutive points in x are thus adjacent
+  * in memory for every component, which allows the stencils to stream each field with unit stride.
+  * Since the ordering differs from the interleaved ordering used by PETSc (DMDAVecGetArrayDOF),
+  * vectors using this layout must be converted using the functions in grids/create_layout.h and
+  * communicated using the scatter context in scatter_ctx/scatter_ctx.h.
+  **/
+  struct PartitionedLayout2DSoA {
+    template <class Extents>
+    struct mapping {
+
+      // for simplicity
+      static_assert(Extents::rank() == 3, "PartitionedLayout2DSoA is hard-coded for 2D layout with Dofs");
+
+      // for convenience
+      using index_t = typename Extents::index_type;
+
+      // constructor
+      mapping(Extents const& exts, index_t offset, index_t nx, index_t ny) noexcept
+        : _extents(exts),
+          _g2l_offset(offset),
+          _nx(nx),
+          _ny(ny)
+      {
+        assert(exts.extent(0) > 0);
+        assert(exts.extent(1) > 0);
+        assert(exts.extent(2) > 0);
+      }
+
+      mapping() noexcept = default;
+      mapping(mapping const&) noexcept = default;
+      mapping(mapping&&) noexcept = default;
+      mapping& operator=(mapping const&) noexcept = default;
+      mapping& operator=(mapping&&) noexcept = default;
+      ~mapping() noexcept = default;
+
+      //------------------------------------------------------------
+      // Helper members (not part of the layout concept)
+      constexpr index_t
+      nx() const noexcept {
+        return _nx;
+      }
+
+      constexpr index_t
+      ny() const noexcept {
+        return _ny;
+      }
+
+      // Returns the extents [nxg, nyg, dofs] of the local (ghosted) domain
+      constexpr Extents const&
+      extents() const noexcept {
+        return _extents;
+      }
+
+      // Returns the offset going from global to local indexing
+      constexpr index_t
+      global_to_local_offset() const noexcept {
+        return _g2l_offset;
+      }
+
+      // Flattens a 3D index (j,i,comp) to a 1D index.
+      constexpr index_t
+      flatten(index_t j, index_t i, index_t comp) const noexcept {
+        return i + _extents.extent(0)*j + _extents.extent(0)*_extents.extent(1)*comp;
+      }
+
+      //------------------------------------------------------------
+      // Required members.
+      constexpr index_t
+      operator()(index_t j, index_t i, index_t comp) const noexcept {
+        return flatten(j,i,comp) + global_to_local_offset();
+      }
+
+      constexpr index_t
+      required_span_size() const noexcept {
+        return _extents.extent(0)*_extents.extent(1)*_extents.extent(2);
+      }
+
+      static constexpr bool is_always_unique() noexcept { return true; }
+      static constexpr bool is_always_strided() noexcept { return true; }
+      static constexpr bool is_always_contiguous() noexcept { return true; }
+      static constexpr bool is_unique() noexcept { return true; }
+      static constexpr bool is_contiguous() noexcept { return true; }
+      static constexpr bool is_strided() noexcept { return true; }
+
+     private:
+
+      Extents _extents;
+      index_t _g2l_offset;
+      index_t _nx,_ny;
+    };
+  };
+
+  /**
+  * Layout of a multicomponent 3D grid function on the local (ghosted) domain of a 3D DMDA, in the interleaved
+  * ordering used by PETSc (DMDAVecGetArrayDOF), i.e (k,j,i,comp) is mapped to comp + dofs*(i + nxg*(j + nyg*k)).
+  * Indices are global, the offset going from global to local indexing is part of the mapping.
+  **/
+  struct PartitionedLayout3D {
+    template <class Extents>
+    struct mapping {
+
+      // for simplicity
+      static_assert(Extents::rank() == 4, "PartitionedLayout3D is hard-coded for 3D layout with Dofs");
+
+      // for convenience
+      using index_t = typename Extents::index_type;
+
+      // constructor
+      mapping(Extents const& exts, index_t offset, index_t nx, index_t ny, index_t nz) noexcept
+        : _extents(exts),
+          _g2l_offset(offset),
+          _nx(nx),
+          _ny(ny),
+          _nz(nz)
+      {
+        assert(exts.extent(0) > 0);
+        assert(exts.extent(1) > 0);
+        assert(exts.extent(2) > 0);
+        assert(exts.extent(3) > 0);
+      }
+
+      mapping() noexcept = default;
+      mapping(mapping const&) noexcept = default;
+      mapping(mapping&&) noexcept = default;
+      mapping& operator=(mapping const&) noexcept = default;
+      mapping& operator=(mapping&&) noexcept = default;
+      ~mapping() noexcept = default;
+
+      //------------------------------------------------------------
+      // Helper members (not part of the layout concept)
+      constexpr index_t
+      nx() const noexcept {
+        return _nx;
+      }
+
+      constexpr index_t
+      ny() const noexcept {
+        return _ny;
+      }
+
+      constexpr index_t
+      nz() const noexcept {
+        return _nz;
+      }
+
+      // Returns the extents [nxg, nyg, nzg, dofs] of the local (ghosted) domain
+      constexpr Extents const&
+      extents() const noexcept {
+        return _extents;
+      }
+
+      // Returns the offset going from global to local indexing
+      constexpr index_t
+      global_to_local_offset() const noexcept {
+        return _g2l_offset;
+      }
+
+      // Flattens a 4D index (k,j,i,comp) to a 1D index.
+      constexpr index_t
+      flatten(index_t k, index_t j, index_t i, index_t comp) const noexcept {
+        return _extents.extent(3)*(i + _extents.extent(0)*(j + _extents.extent(1)*k)) + comp;
+      }
+
+      //------------------------------------------------------------
+      // Required members.
+      constexpr index_t
+      operator()(index_t k, index_t j, index_t i, index_t comp) const noexcept {
+        return flatten(k,j,i,comp) + global_to_local_offset();
+      }
+
+      constexpr index_t
+      required_span_size() const noexcept {
+        return _extents.extent(0)*_extents.extent(1)*_extents.extent(2)*_extents.extent(3);
+      }
+
+      static constexpr bool is_always_unique() noexcept { return true; }
+      static constexpr bool is_always_strided() noexcept { return true; }
+      static constexpr bool is_always_contiguous() noexcept { return true; }
+      static constexpr bool is_unique() noexcept { return true; }
+      static constexpr bool is_contiguous() noexcept { return true; }
+      static constexpr bool is_strided() noexcept { return true; }
+
+     private:
+
+      Extents _extents;
+      index_t _g2l_offset;
+      index_t _nx,_ny,_nz;
+    };
+  };
+
   //Alias definitions
   using extents_1d = stdex::extents<stdex::dynamic_extent, stdex::dynamic_extent>;
   using partitioned_layout_1d = typename PartitionedLayout1D::template mapping<extents_1d>;
 
   using extents_2d = stdex::extents<stdex::dynamic_extent, stdex::dynamic_extent, stdex::dynamic_extent>;
   using partitioned_layout_2d = typename PartitionedLayout2D::template mapping<extents_2d>;
+  using partitioned_layout_2d_soa = typename PartitionedLayout2DSoA::template mapping<extents_2d>;
+
+  using extents_3d = stdex::extents<stdex::dynamic_extent, stdex::dynamic_extent, stdex::dynamic_extent, stdex::dynamic_extent>;
+  using partitioned_layout_3d = typename PartitionedLayout3D::template mapping<extents_3d>;
 }
@@ -0,0 +1,15 @@
+#pragma once
+#include <type_traits>
+
+namespace grid
+{
+    /**
+    * Region of a grid index in one coordinate direction: the left closure, the interior or the right closure of the
+    * difference operator. Used to select the stencils of the 3D region functions at compile time, see the 3D
+    * functions in partitioned_rhs/rhs.h.
+    **/
+    enum Region {LEFT = 0, INTERIOR = 1, RIGHT = 2};
+
+    template <Region r>
+    using region_t = std::integral_constant<Region, r>;
+}
@@ -43,13 +43,14 @@ template <typename BCWest,
           typename BCSouth,
           typename BCEast,
           typename BCNorth,
+          typename Layout,
           typename... Args>
 void bc(const BCWest& bc_w,
         const BCSouth& bc_s,
         const BCEast& bc_e,
         const BCNorth& bc_n,
-              grid::grid_function_2d<PetscScalar> dst,
-        const grid::grid_function_2d<PetscScalar> src,
+              grid::grid_function_2d<PetscScalar,Layout> dst,
+        const grid::grid_function_2d<PetscScalar,Layout> src,
         const std::array<PetscInt,2>& ind_i,
         const std::array<PetscInt,2>& ind_j,
               Args... args)
@@ -70,13 +71,14 @@ template <typename BCWest,
           typename BCSouth,
           typename BCEast,
           typename BCNorth,
+          typename Layout,
           typename... Args>
 void bc_serial(const BCWest& bc_w,
                const BCSouth& bc_s,
                const BCEast& bc_e,
                const BCNorth& bc_n,
-                     grid::grid_function_2d<PetscScalar> dst,
-               const grid::grid_function_2d<PetscScalar> src,
+                     grid::grid_function_2d<PetscScalar,Layout> dst,
+               const grid::grid_function_2d<PetscScalar,Layout> src,
                      Args... args)
 {
   const PetscInt nx = src.mapping().nx();
@@ -85,4 +87,73 @@ void bc_serial(const BCWest& bc_w,
   bc_s(dst,src,{0,nx},args...);
   bc_e(dst,src,{0,ny},args...);
   bc_n(dst,src,{0,nx},args...);
-};
\ No newline at end of file
+};
+
+//=============================================================================
+// 3D functions
+//=============================================================================
+/**
+* Boundary condition functions for the faces west/east (x), south/north (y) and bottom/top (z). Each face function
+* is called with the index ranges of the face in the two remaining directions, in the order (x,y,z).
+**/
+template <typename BCWest,
+          typename BCSouth,
+          typename BCEast,
+          typename BCNorth,
+          typename BCBottom,
+          typename BCTop,
+          typename Layout,
+          typename... Args>
+void bc(const BCWest& bc_w,
+        const BCSouth& bc_s,
+        const BCEast& bc_e,
+        const BCNorth& bc_n,
+        const BCBottom& bc_b,
+        const BCTop& bc_t,
+              grid::grid_function_3d<PetscScalar,Layout> dst,
+        const grid::grid_function_3d<PetscScalar,Layout> src,
+        const std::array<PetscInt,2>& ind_i,
+        const std::array<PetscInt,2>& ind_j,
+        const std::array<PetscInt,2>& ind_k,
+              Args... args)
+{
+  const PetscInt nx = src.mapping().nx();
+  const PetscInt ny = src.mapping().ny();
+  const PetscInt nz = src.mapping().nz();
+  if (ind_i[0] == 0) // West
+    bc_w(dst,src,ind_j,ind_k,args...);
+  if (ind_i[1] == nx) // East
+    bc_e(dst,src,ind_j,ind_k,args...);
+  if (ind_j[0] == 0) // South
+    bc_s(dst,src,ind_i,ind_k,args...);
+  if (ind_j[1] == ny) // North
+    bc_n(dst,src,ind_i,ind_k,args...);
+  if (ind_k[0] == 0) // Bottom
+    bc_b(dst,src,ind_i,ind_j,args...);
+  if (ind_k[1] == nz) // Top
+    bc_t(dst,src,ind_i,ind_j,args...);
+};
+
+template <typename BCWest,
+          typename BCSouth,
+          typename BCEast,
+          typename BCNorth,
+          typename BCBottom,
+          typename BCTop,
+          typename Layout,
+          typename... Args>
+void bc_serial(const BCWest& bc_w,
+               const BCSouth& bc_s,
+               const BCEast& bc_e,
+               const BCNorth& bc_n,
+               const BCBottom& bc_b,
+               const BCTop& bc_t,
+                     grid::grid_function_3d<PetscScalar,Layout> dst,
+               const grid::grid_function_3d<PetscScalar,Layout> src,
+                     Args... args)
+{
+  const PetscInt nx = src.mapping().nx();
+  const PetscInt ny = src.mapping().ny();
+  const PetscInt nz = src.mapping().nz();
+  bc(bc_w, bc_s, bc_e, bc_n, bc_b, bc_t, dst, src, {0,nx}, {0,ny}, {0,nz}, args...);
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include<array>
+#include<algorithm>
+#include<petscdmda.h>
+#include "scatter_ctx/halo_exchange.h"
+
+/**
+* Communication avoiding (deep halo) time stepping of the 2D partitioned RHS.
+*
+* The DMDA is given a ghost width deep enough for k time steps of an s-stage Runge-Kutta scheme, and the halo is only
+* exchanged at the first RHS evaluation of every k steps. In between, each rank evaluates the RHS on its owned points
+* and on the part of its ghost region that is still valid, redundantly computing points owned by its neighbors.
+* Each evaluation consumes one stencil radius of valid ghost points on each side, so after k*s evaluations the
+* valid range has shrunk to the owned points and the halo is exchanged again.
+*
+*   ***********************
+*   *  ghost (level 0)    *
+*   *  *****************  *
+*   *  * level 1       *  *
+*   *  *  ***********  *  *
+*   *  *  *  owned  *  *  *
+*   *  *  ***********  *  *
+*   *  *****************  *
+*   ***********************
+*
+* Ranges are given in global indices. At a physical boundary the range is not shrunk, since the closure stencils
+* only depend on points of the local array. Away from a physical boundary the range is kept outside the closure
+* region, whose stencils require all points up to the boundary; the ghost width is padded accordingly.
+*
+* The ghost regions include the corners, so the DMDA must use a box stencil and the halo exchange must communicate
+* corners, i.e HALO_PETSC with the interleaved layout.
+**/
+namespace deep_halo
+{
+  struct DeepHaloCtx {
+    PetscInt steps;                       // Number of time steps k between halo exchanges, 0 if disabled
+    PetscInt stages;                      // Number of RHS evaluations per time step
+    PetscInt radius;                      // Radius of the interior stencil
+    PetscInt cls_sz;                      // Closure size of the difference operator
+    PetscInt n_evals;                     // Number of RHS evaluations since the last halo exchange
+    std::array<PetscInt,2> N;             // Global number of grid points
+    std::array<PetscInt,2> ghost_i, ghost_j; // Index ranges of the local (ghosted) array
+  };
+
+  inline bool enabled(const DeepHaloCtx& ctx)
+  {
+    return ctx.steps > 0;
+  }
+
+  /**
+  * Reads the runtime option -deep_halo k (default 0, disabled) and determines the DMDA ghost width and stencil type.
+  * Input:  radius        - Radius of the interior stencil of the difference operator.
+  *         cls_sz        - Closure size of the difference operator.
+  *         stages        - Number of RHS evaluations per time step, see ts_stages_from_options.
+  *
+  * Output: ctx           - Deep halo context.
+  *         stencil_width - DMDA stencil width: k*stages*radius, padded for the closure, or radius if disabled.
+  *         stencil_type  - DMDA stencil type: DMDA_STENCIL_BOX, or DMDA_STENCIL_STAR if disabled.
+  **/
+  PetscErrorCode setup(const PetscInt radius, const PetscInt cls_sz, const PetscInt stages, DeepHaloCtx& ctx,
+                       PetscInt& stencil_width, DMDAStencilType& stencil_type);
+
+  /**
+  * Stores the ranges of the local array of the DMDA, and checks that the valid range still covers the owned
+  * points after k*stages evaluations on all ranks. Returns -1 if the halo exchange does not communicate corners,
+  * or if the ghost region of a rank spans a direction of the grid. Disables the deep halo on a single process.
+  * Input:  da    - DMDA object, created with the stencil width and type of setup.
+  *         type  - Type of halo exchange.
+  *         soa   - If the local vectors use component-major ordering.
+  *
+  * Output: ctx   - Deep halo context.
+  **/
+  PetscErrorCode setup_ranges(const DM da, const HaloType type, const PetscBool soa, DeepHaloCtx& ctx);
+
+  /**
+  * Shrinks a valid range by one evaluation of the RHS.
+  **/
+  inline std::array<PetscInt,2> shrink(const std::array<PetscInt,2>& ind, const PetscInt N, const PetscInt radius, const PetscInt cls_sz)
+  {
+    return {ind[0] == 0 ? 0 : std::max(ind[0] + radius, cls_sz),
+            ind[1] == N ? N : std::min(ind[1] - radius, N - cls_sz)};
+  }
+
+  /**
+  * Called once per RHS evaluation. Returns true if the halo should be exchanged before the evaluation, and the
+  * ranges on which the RHS should be computed.
+  * Output: ind_i, ind_j - Index ranges in x and y of the points to compute.
+  **/
+  inline bool next_evaluation(DeepHaloCtx& ctx, std::array<PetscInt,2>& ind_i, std::array<PetscInt,2>& ind_j)
+  {
+    const bool exchange = (ctx.n_evals == 0);
+    ind_i = ctx.ghost_i;
+    ind_j = ctx.ghost_j;
+    for (PetscInt m = 0; m <= ctx.n_evals; m++) {
+      ind_i = shrink(ind_i, ctx.N[0], ctx.radius, ctx.cls_sz);
+      ind_j = shrink(ind_j, ctx.N[1], ctx.radius, ctx.cls_sz);
+    }
+    ctx.n_evals = (ctx.n_evals + 1) % (ctx.steps*ctx.stages);
+    return exchange;
+  }
+}
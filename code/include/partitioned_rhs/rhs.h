@@ -1,7 +1,9 @@
 #pragma once
 #include<array>
-#include<petscsystypes.h>
+#include<petscsys.h>
 #include "grids/grid_function.h"
+#include "grids/region.h"
+#include "util/perf_counters.h"
 
 //=============================================================================
 // 1D functions
@@ -25,6 +27,7 @@ void rhs_local(const RhsL& rhs_l,
                const PetscInt halo_sz,
                      Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_LOCAL);
   const PetscInt nx = src.mapping().nx();
   const PetscInt i_start = ind_i[0]+halo_sz;
   const PetscInt i_end = ind_i[1]-halo_sz;
@@ -50,6 +53,7 @@ void rhs_overlap(const RhsInterior& rhs_i,
                   const PetscInt halo_sz,
                         Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_OVERLAP);
   const PetscInt nx = src.mapping().nx();
   if (ind_i[0]== 0) { // Left region
     rhs_i(dst,src,{ind_i[1]-halo_sz,ind_i[1]},args...);
@@ -75,6 +79,7 @@ void rhs_serial(const RhsLeft& rhs_l,
                 const PetscInt cls_sz,
                 Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_SERIAL);
   const PetscInt nx = src.mapping().nx(); 
   rhs_l(dst,src,cls_sz,args...);
   rhs_i(dst,src,{cls_sz,nx-cls_sz},args...);
@@ -103,6 +108,7 @@ template <typename RhsLL,
           typename RhsRL,
           typename RhsRI,
           typename RhsRR,
+          typename Layout,
           typename... Args>
 void rhs_all(const RhsLL& rhs_ll,
                const RhsLI& rhs_li,
@@ -113,14 +119,15 @@ void rhs_all(const RhsLL& rhs_ll,
                const RhsRL& rhs_rl,
                const RhsRI& rhs_ri,
                const RhsRR& rhs_rr,
-                     grid::grid_function_2d<PetscScalar> dst,
-               const grid::grid_function_2d<PetscScalar> src,
+                     grid::grid_function_2d<PetscScalar,Layout> dst,
+               const grid::grid_function_2d<PetscScalar,Layout> src,
                const std::array<PetscInt,2>& ind_i,
                const std::array<PetscInt,2>& ind_j,
                const PetscInt cls_sz,
                const PetscInt halo_sz,
                Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_ALL);
   const PetscInt i_start = ind_i[0]; 
   const PetscInt i_end = ind_i[1];
   const PetscInt j_start = ind_j[0];
@@ -189,6 +196,7 @@ template <typename RhsLL,
           typename RhsRL,
           typename RhsRI,
           typename RhsRR,
+          typename Layout,
           typename... Args>
 void rhs_local(const RhsLL& rhs_ll,
                const RhsLI& rhs_li,
@@ -199,14 +207,15 @@ void rhs_local(const RhsLL& rhs_ll,
                const RhsRL& rhs_rl,
                const RhsRI& rhs_ri,
                const RhsRR& rhs_rr,
-                     grid::grid_function_2d<PetscScalar> dst,
-               const grid::grid_function_2d<PetscScalar> src,
+                     grid::grid_function_2d<PetscScalar,Layout> dst,
+               const grid::grid_function_2d<PetscScalar,Layout> src,
                const std::array<PetscInt,2>& ind_i,
                const std::array<PetscInt,2>& ind_j,
                const PetscInt cls_sz,
                const PetscInt halo_sz,
                Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_LOCAL);
   const PetscInt i_start = ind_i[0] + halo_sz; 
   const PetscInt i_end = ind_i[1] - halo_sz;
   const PetscInt j_start = ind_j[0] + halo_sz;
@@ -271,20 +280,22 @@ template <typename RhsLI,
           typename RhsII,
           typename RhsIR,
           typename RhsRI,
+          typename Layout,
           typename... Args>
 void rhs_overlap(const RhsLI& rhs_li,
                  const RhsIL& rhs_il,
                  const RhsII& rhs_ii,
                  const RhsIR& rhs_ir,
                  const RhsRI& rhs_ri,
-                       grid::grid_function_2d<PetscScalar> dst,
-                 const grid::grid_function_2d<PetscScalar> src,
+                       grid::grid_function_2d<PetscScalar,Layout> dst,
+                 const grid::grid_function_2d<PetscScalar,Layout> src,
                  const std::array<PetscInt,2>& ind_i,
                  const std::array<PetscInt,2>& ind_j,
                  const PetscInt cls_sz,
                  const PetscInt halo_sz,
                        Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_OVERLAP);
   const PetscInt i_start = ind_i[0]; 
   const PetscInt i_end = ind_i[1];
   const PetscInt j_start = ind_j[0];
@@ -369,6 +380,7 @@ template <typename RhsLL,
           typename RhsRL,
           typename RhsRI,
           typename RhsRR,
+          typename Layout,
           typename... Args>
 void rhs_serial(const RhsLL& rhs_ll,
                 const RhsLI& rhs_li,
@@ -379,11 +391,12 @@ void rhs_serial(const RhsLL& rhs_ll,
                 const RhsRL& rhs_rl,
                 const RhsRI& rhs_ri,
                 const RhsRR& rhs_rr,
-                      grid::grid_function_2d<PetscScalar> dst,
-                const grid::grid_function_2d<PetscScalar> src,
+                      grid::grid_function_2d<PetscScalar,Layout> dst,
+                const grid::grid_function_2d<PetscScalar,Layout> src,
                 const PetscInt cls_sz,
                       Args... args)
 {
+  const perf_counters::Section section(perf_counters::RHS_SERIAL);
   const PetscInt nx = src.mapping().nx();
   const PetscInt ny = src.mapping().ny();
   rhs_ll(dst, src, cls_sz, args...);
@@ -398,5 +411,209 @@ void rhs_serial(const RhsLL& rhs_ll,
 }
 
 // =============================================================================
-// TODO: 3D functions
-// ============================================================================= 
\ No newline at end of file
+// 3D functions
+// =============================================================================
+/**
+ * In 3D the domain is separated into the 27 regions given by the tensor product of the left closure (l), interior (i)
+ * and right closure (r) regions in each direction, e.g (l,i,r) is the part of the z = z_max face within the left
+ * closure in x. Rather than one region function per region, the 3D functions take a single region function rhs,
+ * templated on the regions and called as
+ *
+ *   rhs(rx, ry, rz, dst, src, ind_i, ind_j, ind_k, args...)
+ *
+ * where rx, ry, rz are grid::region_t<grid::LEFT>, grid::region_t<grid::INTERIOR> or grid::region_t<grid::RIGHT>, and
+ * ind_i, ind_j, ind_k are the index ranges of a box within the region. The stencils of the region can thus be selected
+ * at compile time, e.g using D1.apply_x<decltype(rx)::value>(...).
+ *
+ * In each direction the owned range of the process is split into segments: the closure at a physical boundary, the
+ * band of halo_sz points next to a processor boundary (which depends on ghost points), and the remaining interior.
+ * The boxes are the tensor products of the segments. rhs_local computes the boxes not depending on ghost points,
+ * rhs_overlap the remaining boxes and rhs_all all boxes. Unlike the 2D functions, a process may touch both physical
+ * boundaries in a direction.
+ **/
+namespace regions_3d
+{
+  struct Segment {
+    grid::Region region;
+    std::array<PetscInt,2> ind;
+    bool inner;               // If the segment is independent of the ghost points
+  };
+
+  /**
+  * Splits the owned range ind of a direction with N global points into at most 5 segments.
+  * Returns the number of (non-empty) segments. The range must be valid, see check_ranges.
+  **/
+  inline PetscInt segments(const std::array<PetscInt,2>& ind, const PetscInt N, const PetscInt cls_sz, const PetscInt halo_sz,
+                           std::array<Segment,5>& seg)
+  {
+    PetscInt n = 0;
+    auto add = [&](const grid::Region r, const PetscInt start, const PetscInt end, const bool inner) {
+      if (end > start) seg[n++] = {r, {start, end}, inner};
+    };
+    const PetscInt start = (ind[0] == 0) ? cls_sz : ind[0] + halo_sz;
+    const PetscInt end = (ind[1] == N) ? N - cls_sz : ind[1] - halo_sz;
+    if (ind[0] == 0)
+      add(grid::LEFT, 0, cls_sz, true);
+    else
+      add(grid::INTERIOR, ind[0], start, false);
+    add(grid::INTERIOR, start, end, true);
+    if (ind[1] == N)
+      add(grid::RIGHT, N - cls_sz, N, true);
+    else
+      add(grid::INTERIOR, end, ind[1], false);
+    return n;
+  }
+
+  /**
+  * Returns true if segments splits the owned range ind without overlap, i.e if it is at least as wide as the closures
+  * at its physical boundaries (cls_sz) plus the points depending on ghost points at its other ends (halo_sz).
+  **/
+  inline bool valid_range(const std::array<PetscInt,2>& ind, const PetscInt N, const PetscInt cls_sz, const PetscInt halo_sz)
+  {
+    const PetscInt left = (ind[0] == 0) ? cls_sz : halo_sz;
+    const PetscInt right = (ind[1] == N) ? cls_sz : halo_sz;
+    return ind[1] - ind[0] >= left + right;
+  }
+
+  /**
+  * Collective check that the owned ranges of all ranks are valid, see valid_range. Otherwise the LEFT and RIGHT
+  * closure segments would overlap the INTERIOR ones. Prints an error and returns -1 if any rank has an invalid range.
+  **/
+  inline PetscErrorCode check_ranges(const MPI_Comm comm,
+                                     const std::array<PetscInt,2>& ind_i,
+                                     const std::array<PetscInt,2>& ind_j,
+                                     const std::array<PetscInt,2>& ind_k,
+                                     const std::array<PetscInt,3>& N,
+                                     const PetscInt cls_sz,
+                                     const PetscInt halo_sz)
+  {
+    int invalid = !valid_range(ind_i, N[0], cls_sz, halo_sz) || !valid_range(ind_j, N[1], cls_sz, halo_sz)
+                  || !valid_range(ind_k, N[2], cls_sz, halo_sz);
+    int any_invalid;
+    MPI_Allreduce(&invalid, &any_invalid, 1, MPI_INT, MPI_LOR, comm);
+    if (any_invalid) {
+      PetscPrintf(comm,"Error: the local grid sizes are too small for the closures (%d points) and halo (%d points). Use fewer processes.\n",
+                  cls_sz,halo_sz);
+      return -1;
+    }
+    return 0;
+  }
+
+  /**
+  * Calls f with the region r as a compile time constant.
+  **/
+  template <typename F>
+  inline void with_region(const grid::Region r, const F& f)
+  {
+    switch (r) {
+      case grid::LEFT:     f(grid::region_t<grid::LEFT>{}); break;
+      case grid::INTERIOR: f(grid::region_t<grid::INTERIOR>{}); break;
+      case grid::RIGHT:    f(grid::region_t<grid::RIGHT>{}); break;
+    }
+  }
+
+  enum Selection {ALL, LOCAL, OVERLAP};
+
+  /**
+  * Calls the region function on the boxes of the selection.
+  **/
+  template <typename Rhs, typename Layout, typename... Args>
+  void dispatch(const Selection selection,
+                const Rhs& rhs,
+                      grid::grid_function_3d<PetscScalar,Layout> dst,
+                const grid::grid_function_3d<PetscScalar,Layout> src,
+                const std::array<PetscInt,2>& ind_i,
+                const std::array<PetscInt,2>& ind_j,
+                const std::array<PetscInt,2>& ind_k,
+                const PetscInt cls_sz,
+                const PetscInt halo_sz,
+                Args... args)
+  {
+    std::array<Segment,5> si, sj, sk;
+    const PetscInt ni = segments(ind_i, src.mapping().nx(), cls_sz, halo_sz, si);
+    const PetscInt nj = segments(ind_j, src.mapping().ny(), cls_sz, halo_sz, sj);
+    const PetscInt nk = segments(ind_k, src.mapping().nz(), cls_sz, halo_sz, sk);
+    for (PetscInt c = 0; c < nk; c++) {
+      for (PetscInt b = 0; b < nj; b++) {
+        for (PetscInt a = 0; a < ni; a++) {
+          const bool inner = si[a].inner && sj[b].inner && sk[c].inner;
+          if ((selection == LOCAL && !inner) || (selection == OVERLAP && inner)) continue;
+          with_region(si[a].region, [&](auto rx) {
+            with_region(sj[b].region, [&](auto ry) {
+              with_region(sk[c].region, [&](auto rz) {
+                rhs(rx, ry, rz, dst, src, si[a].ind, sj[b].ind, sk[c].ind, args...);
+              });
+            });
+          });
+        }
+      }
+    }
+  }
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_all(const Rhs& rhs,
+                   grid::grid_function_3d<PetscScalar,Layout> dst,
+             const grid::grid_function_3d<PetscScalar,Layout> src,
+             const std::array<PetscInt,2>& ind_i,
+             const std::array<PetscInt,2>& ind_j,
+             const std::array<PetscInt,2>& ind_k,
+             const PetscInt cls_sz,
+             const PetscInt halo_sz,
+             Args... args)
+{
+  const perf_counters::Section section(perf_counters::RHS_ALL);
+  regions_3d::dispatch(regions_3d::ALL, rhs, dst, src, ind_i, ind_j, ind_k, cls_sz, halo_sz, args...);
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_local(const Rhs& rhs,
+                     grid::grid_function_3d<PetscScalar,Layout> dst,
+               const grid::grid_function_3d<PetscScalar,Layout> src,
+               const std::array<PetscInt,2>& ind_i,
+               const std::array<PetscInt,2>& ind_j,
+               const std::array<PetscInt,2>& ind_k,
+               const PetscInt cls_sz,
+               const PetscInt halo_sz,
+               Args... args)
+{
+  const perf_counters::Section section(perf_counters::RHS_LOCAL);
+  regions_3d::dispatch(regions_3d::LOCAL, rhs, dst, src, ind_i, ind_j, ind_k, cls_sz, halo_sz, args...);
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_overlap(const Rhs& rhs,
+                       grid::grid_function_3d<PetscScalar,Layout> dst,
+                 const grid::grid_function_3d<PetscScalar,Layout> src,
+                 const std::array<PetscInt,2>& ind_i,
+                 const std::array<PetscInt,2>& ind_j,
+                 const std::array<PetscInt,2>& ind_k,
+                 const PetscInt cls_sz,
+                 const PetscInt halo_sz,
+                 Args... args)
+{
+  const perf_counters::Section section(perf_counters::RHS_OVERLAP);
+  regions_3d::dispatch(regions_3d::OVERLAP, rhs, dst, src, ind_i, ind_j, ind_k, cls_sz, halo_sz, args...);
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_serial(const Rhs& rhs,
+                      grid::grid_function_3d<PetscScalar,Layout> dst,
+                const grid::grid_function_3d<PetscScalar,Layout> src,
+                const PetscInt cls_sz,
+                Args... args)
+{
+  const perf_counters::Section section(perf_counters::RHS_SERIAL);
+  const PetscInt nx = src.mapping().nx();
+  const PetscInt ny = src.mapping().ny();
+  const PetscInt nz = src.mapping().nz();
+  regions_3d::dispatch(regions_3d::ALL, rhs, dst, src, {0,nx}, {0,ny}, {0,nz}, cls_sz, 0, args...);
+} 
\ No newline at end of file
@@ -0,0 +1,494 @@
+#pragma once
+#include<array>
+#include<algorithm>
+#include<type_traits>
+#include<petscsystypes.h>
+#include "partitioned_rhs/rhs.h"
+#include "partitioned_rhs/boundary_conditions.h"
+#include "util/threads.h"
+
+/**
+* Cache blocked (tiled) traversal of the 2D partitioned RHS.
+*
+* The region functions called by rhs_all, rhs_local, rhs_overlap and rhs_serial compute the RHS on index ranges. The
+* wrappers below split the ranges passed to a region function into tiles and call the region function once per tile,
+* so that the stencil rows of a tile stay in cache while the tile is swept. The region functions are not modified.
+*
+*   ****************
+*   * lr * ir * rr *
+*   ****************
+*   * li * ii * ri *
+*   ****************
+*   * ll * il * rl *
+*   ****************
+*
+* ii            - tiled in both directions, tile size tile[0] x tile[1].
+* il, ir        - strips of closure rows, tiled in x-direction with tile length tile[0].
+* li, ri        - strips of closure columns, tiled in y-direction with tile length tile[1].
+* ll, lr, rl, rr - closure corners of cls_sz x cls_sz points, which are called as a single tile.
+*
+* When compiled with OpenMP, the tiles are distributed over the threads of the rank (see util/threads.h). For ii
+* each thread is assigned a contiguous band of rows, matching the first touch placement of threads::first_touch,
+* and sweeps the tiles of its band in the order above. The tiles of the strips are distributed statically. The
+* corners are computed by the calling thread. Distinct tiles write to distinct points, so no synchronization
+* is required apart from the barrier at the end of each region.
+**/
+namespace tiling
+{
+  /**
+  * Determines the tile size used for the 2D partitioned RHS. By default the tile size is chosen such that
+  * the rows of the input and output grid functions touched by the stencil of a tile fit in half the L2 cache.
+  * The tile size can be set at runtime using the options -tile_i and -tile_j. A non-positive tile size
+  * disables tiling in that direction.
+  * Input:  stencil_width - Width of the interior stencil of the difference operator.
+  *         dofs          - Number of grid function components.
+  *
+  * Output: tile          - Tile size [tile_i, tile_j].
+  **/
+  PetscErrorCode get_tile_size(const PetscInt stencil_width, const PetscInt dofs, std::array<PetscInt,2>& tile);
+
+  /**
+  * Determines the tile size used for the 3D partitioned RHS. By default the tile size is chosen such that the
+  * planes of a tile touched by the z-stencil, for the input and output grid functions, fit in half the L2 cache.
+  * The tile size can be set at runtime using the options -tile_i and -tile_j. A non-positive tile size
+  * disables tiling in that direction.
+  * Input:  stencil_width - Width of the interior stencil of the difference operator.
+  *         dofs          - Number of grid function components.
+  *
+  * Output: tile          - Tile size [tile_i, tile_j] in the xy-plane.
+  **/
+  PetscErrorCode get_tile_size_3d(const PetscInt stencil_width, const PetscInt dofs, std::array<PetscInt,2>& tile);
+
+  /**
+  * Calls a region function on the tiles of a 2D range.
+  **/
+  template <typename Rhs>
+  struct TiledBlock {
+    Rhs rhs;
+    std::array<PetscInt,2> tile;
+
+    template <typename Dst, typename Src, typename... Args>
+    void operator()(Dst dst, const Src src, const std::array<PetscInt,2>& ind_i, const std::array<PetscInt,2>& ind_j, Args... args) const
+    {
+      const PetscInt ti = tile[0] > 0 ? tile[0] : std::max(ind_i[1]-ind_i[0], (PetscInt) 1);
+      const PetscInt tj = tile[1] > 0 ? tile[1] : std::max(ind_j[1]-ind_j[0], (PetscInt) 1);
+      #pragma omp parallel
+      {
+#ifdef _OPENMP
+        const std::array<PetscInt,2> band = threads::band(ind_j, omp_get_thread_num(), omp_get_num_threads());
+#else
+        const std::array<PetscInt,2> band = ind_j;
+#endif
+        // Tiles are traversed column by column, so that consecutive tiles share the rows of the y-stencil.
+        for (PetscInt i0 = ind_i[0]; i0 < ind_i[1]; i0 += ti) {
+          for (PetscInt j0 = band[0]; j0 < band[1]; j0 += tj) {
+            rhs(dst, src, {i0, std::min(i0 + ti, ind_i[1])}, {j0, std::min(j0 + tj, band[1])}, args...);
+          }
+        }
+      }
+    };
+  };
+
+  /**
+  * Calls a region function on the tiles of a 1D range (strip of closure points).
+  **/
+  template <typename Rhs>
+  struct TiledStrip {
+    Rhs rhs;
+    PetscInt tile;
+
+    template <typename Dst, typename Src, typename... Args>
+    void operator()(Dst dst, const Src src, const std::array<PetscInt,2>& ind, const PetscInt cls_sz, Args... args) const
+    {
+      const PetscInt n = std::max(ind[1]-ind[0], (PetscInt) 1);
+      // Limit the tile length such that there are at least as many tiles as threads.
+      const PetscInt nt = threads::num_threads();
+      const PetscInt t = std::min(tile > 0 ? tile : n, std::max((n + nt - 1)/nt, (PetscInt) 1));
+      const PetscInt n_tiles = (ind[1] - ind[0] + t - 1)/t;
+      #pragma omp parallel for schedule(static)
+      for (PetscInt k = 0; k < n_tiles; k++) {
+        const PetscInt k0 = ind[0] + k*t;
+        rhs(dst, src, {k0, std::min(k0 + t, ind[1])}, cls_sz, args...);
+      }
+    };
+  };
+
+  /**
+  * Calls a boundary condition function on chunks of the boundary range, distributed over the threads.
+  **/
+  template <typename Bc>
+  struct TiledBoundary {
+    Bc bc;
+
+    template <typename Dst, typename Src, typename... Args>
+    void operator()(Dst dst, const Src src, const std::array<PetscInt,2>& ind, Args... args) const
+    {
+      #pragma omp parallel
+      {
+#ifdef _OPENMP
+        const std::array<PetscInt,2> chunk = threads::band(ind, omp_get_thread_num(), omp_get_num_threads());
+#else
+        const std::array<PetscInt,2> chunk = ind;
+#endif
+        if (chunk[1] > chunk[0])
+          bc(dst, src, chunk, args...);
+      }
+    };
+  };
+
+  /**
+  * Calls a 3D region function (see the 3D functions in partitioned_rhs/rhs.h) on the tiles of a 3D box.
+  * The box is split into columns of tile[0] x tile[1] points in the xy-plane, each swept in z-direction, such that the
+  * planes of the z-stencil stay in cache. If there are fewer columns than threads, the columns are also split in
+  * z-direction. The tiles are distributed statically over the threads.
+  **/
+  template <typename Rhs>
+  struct TiledRegion3D {
+    Rhs rhs;
+    std::array<PetscInt,2> tile;
+
+    template <typename RX, typename RY, typename RZ, typename Dst, typename Src, typename... Args>
+    void operator()(RX rx, RY ry, RZ rz, Dst dst, const Src src, const std::array<PetscInt,2>& ind_i,
+                    const std::array<PetscInt,2>& ind_j, const std::array<PetscInt,2>& ind_k, Args... args) const
+    {
+      const PetscInt ti = tile[0] > 0 ? tile[0] : std::max(ind_i[1]-ind_i[0], (PetscInt) 1);
+      const PetscInt tj = tile[1] > 0 ? tile[1] : std::max(ind_j[1]-ind_j[0], (PetscInt) 1);
+      const PetscInt n_ti = (ind_i[1] - ind_i[0] + ti - 1)/ti;
+      const PetscInt n_tj = (ind_j[1] - ind_j[0] + tj - 1)/tj;
+      const PetscInt n_tk = std::min(std::max(threads::num_threads()/std::max(n_ti*n_tj, (PetscInt) 1), (PetscInt) 1),
+                                     std::max(ind_k[1] - ind_k[0], (PetscInt) 1));
+      #pragma omp parallel for collapse(3) schedule(static)
+      for (PetscInt c = 0; c < n_tk; c++) {
+        for (PetscInt b = 0; b < n_tj; b++) {
+          for (PetscInt a = 0; a < n_ti; a++) {
+            const PetscInt i0 = ind_i[0] + a*ti;
+            const PetscInt j0 = ind_j[0] + b*tj;
+            const std::array<PetscInt,2> ti_rng = {i0, std::min(i0 + ti, ind_i[1])};
+            const std::array<PetscInt,2> tj_rng = {j0, std::min(j0 + tj, ind_j[1])};
+            rhs(rx, ry, rz, dst, src, ti_rng, tj_rng, threads::band(ind_k, c, n_tk), args...);
+          }
+        }
+      }
+    };
+  };
+
+  template <typename Rhs>
+  TiledRegion3D<std::decay_t<Rhs>> region_3d(const Rhs& rhs, const std::array<PetscInt,2>& tile)
+  {
+    return {rhs, tile};
+  };
+
+  template <typename Rhs>
+  TiledBlock<std::decay_t<Rhs>> block(const Rhs& rhs, const std::array<PetscInt,2>& tile)
+  {
+    return {rhs, tile};
+  };
+
+  template <typename Rhs>
+  TiledStrip<std::decay_t<Rhs>> strip(const Rhs& rhs, const PetscInt tile)
+  {
+    return {rhs, tile};
+  };
+
+  template <typename Bc>
+  TiledBoundary<std::decay_t<Bc>> boundary(const Bc& bc)
+  {
+    return {bc};
+  };
+}
+
+//=============================================================================
+// Tiled 2D dispatch. Same as the functions in partitioned_rhs/rhs.h, with the
+// additional first argument tile holding the tile size.
+//=============================================================================
+template <typename RhsLL,
+          typename RhsLI,
+          typename RhsLR,
+          typename RhsIL,
+          typename RhsII,
+          typename RhsIR,
+          typename RhsRL,
+          typename RhsRI,
+          typename RhsRR,
+          typename Layout,
+          typename... Args>
+void rhs_all_tiled(const std::array<PetscInt,2>& tile,
+                   const RhsLL& rhs_ll,
+                   const RhsLI& rhs_li,
+                   const RhsLR& rhs_lr,
+                   const RhsIL& rhs_il,
+                   const RhsII& rhs_ii,
+                   const RhsIR& rhs_ir,
+                   const RhsRL& rhs_rl,
+                   const RhsRI& rhs_ri,
+                   const RhsRR& rhs_rr,
+                         grid::grid_function_2d<PetscScalar,Layout> dst,
+                   const grid::grid_function_2d<PetscScalar,Layout> src,
+                   const std::array<PetscInt,2>& ind_i,
+                   const std::array<PetscInt,2>& ind_j,
+                   const PetscInt cls_sz,
+                   const PetscInt halo_sz,
+                   Args... args)
+{
+  rhs_all(rhs_ll, tiling::strip(rhs_li, tile[1]), rhs_lr,
+          tiling::strip(rhs_il, tile[0]), tiling::block(rhs_ii, tile), tiling::strip(rhs_ir, tile[0]),
+          rhs_rl, tiling::strip(rhs_ri, tile[1]), rhs_rr,
+          dst, src, ind_i, ind_j, cls_sz, halo_sz, args...);
+}
+
+template <typename RhsLL,
+          typename RhsLI,
+          typename RhsLR,
+          typename RhsIL,
+          typename RhsII,
+          typename RhsIR,
+          typename RhsRL,
+          typename RhsRI,
+          typename RhsRR,
+          typename Layout,
+          typename... Args>
+void rhs_local_tiled(const std::array<PetscInt,2>& tile,
+                     const RhsLL& rhs_ll,
+                     const RhsLI& rhs_li,
+                     const RhsLR& rhs_lr,
+                     const RhsIL& rhs_il,
+                     const RhsII& rhs_ii,
+                     const RhsIR& rhs_ir,
+                     const RhsRL& rhs_rl,
+                     const RhsRI& rhs_ri,
+                     const RhsRR& rhs_rr,
+                           grid::grid_function_2d<PetscScalar,Layout> dst,
+                     const grid::grid_function_2d<PetscScalar,Layout> src,
+                     const std::array<PetscInt,2>& ind_i,
+                     const std::array<PetscInt,2>& ind_j,
+                     const PetscInt cls_sz,
+                     const PetscInt halo_sz,
+                     Args... args)
+{
+  rhs_local(rhs_ll, tiling::strip(rhs_li, tile[1]), rhs_lr,
+            tiling::strip(rhs_il, tile[0]), tiling::block(rhs_ii, tile), tiling::strip(rhs_ir, tile[0]),
+            rhs_rl, tiling::strip(rhs_ri, tile[1]), rhs_rr,
+            dst, src, ind_i, ind_j, cls_sz, halo_sz, args...);
+}
+
+template <typename RhsLI,
+          typename RhsIL,
+          typename RhsII,
+          typename RhsIR,
+          typename RhsRI,
+          typename Layout,
+          typename... Args>
+void rhs_overlap_tiled(const std::array<PetscInt,2>& tile,
+                       const RhsLI& rhs_li,
+                       const RhsIL& rhs_il,
+                       const RhsII& rhs_ii,
+                       const RhsIR& rhs_ir,
+                       const RhsRI& rhs_ri,
+                             grid::grid_function_2d<PetscScalar,Layout> dst,
+                       const grid::grid_function_2d<PetscScalar,Layout> src,
+                       const std::array<PetscInt,2>& ind_i,
+                       const std::array<PetscInt,2>& ind_j,
+                       const PetscInt cls_sz,
+                       const PetscInt halo_sz,
+                             Args... args)
+{
+  rhs_overlap(tiling::strip(rhs_li, tile[1]), tiling::strip(rhs_il, tile[0]), tiling::block(rhs_ii, tile),
+              tiling::strip(rhs_ir, tile[0]), tiling::strip(rhs_ri, tile[1]),
+              dst, src, ind_i, ind_j, cls_sz, halo_sz, args...);
+}
+
+template <typename RhsLL,
+          typename RhsLI,
+          typename RhsLR,
+          typename RhsIL,
+          typename RhsII,
+          typename RhsIR,
+          typename RhsRL,
+          typename RhsRI,
+          typename RhsRR,
+          typename Layout,
+          typename... Args>
+void rhs_serial_tiled(const std::array<PetscInt,2>& tile,
+                      const RhsLL& rhs_ll,
+                      const RhsLI& rhs_li,
+                      const RhsLR& rhs_lr,
+                      const RhsIL& rhs_il,
+                      const RhsII& rhs_ii,
+                      const RhsIR& rhs_ir,
+                      const RhsRL& rhs_rl,
+                      const RhsRI& rhs_ri,
+                      const RhsRR& rhs_rr,
+                            grid::grid_function_2d<PetscScalar,Layout> dst,
+                      const grid::grid_function_2d<PetscScalar,Layout> src,
+                      const PetscInt cls_sz,
+                            Args... args)
+{
+  rhs_serial(rhs_ll, tiling::strip(rhs_li, tile[1]), rhs_lr,
+             tiling::strip(rhs_il, tile[0]), tiling::block(rhs_ii, tile), tiling::strip(rhs_ir, tile[0]),
+             rhs_rl, tiling::strip(rhs_ri, tile[1]), rhs_rr,
+             dst, src, cls_sz, args...);
+}
+
+//=============================================================================
+// Threaded 2D boundary conditions. Same as the functions in
+// partitioned_rhs/boundary_conditions.h, with each boundary range split over
+// the threads of the rank.
+//=============================================================================
+template <typename BCWest,
+          typename BCSouth,
+          typename BCEast,
+          typename BCNorth,
+          typename Layout,
+          typename... Args>
+void bc_tiled(const BCWest& bc_w,
+              const BCSouth& bc_s,
+              const BCEast& bc_e,
+              const BCNorth& bc_n,
+                    grid::grid_function_2d<PetscScalar,Layout> dst,
+              const grid::grid_function_2d<PetscScalar,Layout> src,
+              const std::array<PetscInt,2>& ind_i,
+              const std::array<PetscInt,2>& ind_j,
+                    Args... args)
+{
+  bc(tiling::boundary(bc_w), tiling::boundary(bc_s), tiling::boundary(bc_e), tiling::boundary(bc_n),
+     dst, src, ind_i, ind_j, args...);
+};
+
+template <typename BCWest,
+          typename BCSouth,
+          typename BCEast,
+          typename BCNorth,
+          typename Layout,
+          typename... Args>
+void bc_serial_tiled(const BCWest& bc_w,
+                     const BCSouth& bc_s,
+                     const BCEast& bc_e,
+                     const BCNorth& bc_n,
+                           grid::grid_function_2d<PetscScalar,Layout> dst,
+                     const grid::grid_function_2d<PetscScalar,Layout> src,
+                           Args... args)
+{
+  bc_serial(tiling::boundary(bc_w), tiling::boundary(bc_s), tiling::boundary(bc_e), tiling::boundary(bc_n),
+            dst, src, args...);
+};
+
+
+//=============================================================================
+// Tiled 3D dispatch. Same as the 3D functions in partitioned_rhs/rhs.h, with
+// the additional first argument tile holding the tile size in the xy-plane.
+//=============================================================================
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_all_tiled(const std::array<PetscInt,2>& tile,
+                   const Rhs& rhs,
+                         grid::grid_function_3d<PetscScalar,Layout> dst,
+                   const grid::grid_function_3d<PetscScalar,Layout> src,
+                   const std::array<PetscInt,2>& ind_i,
+                   const std::array<PetscInt,2>& ind_j,
+                   const std::array<PetscInt,2>& ind_k,
+                   const PetscInt cls_sz,
+                   const PetscInt halo_sz,
+                   Args... args)
+{
+  rhs_all(tiling::region_3d(rhs, tile), dst, src, ind_i, ind_j, ind_k, cls_sz, halo_sz, args...);
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_local_tiled(const std::array<PetscInt,2>& tile,
+                     const Rhs& rhs,
+                           grid::grid_function_3d<PetscScalar,Layout> dst,
+                     const grid::grid_function_3d<PetscScalar,Layout> src,
+                     const std::array<PetscInt,2>& ind_i,
+                     const std::array<PetscInt,2>& ind_j,
+                     const std::array<PetscInt,2>& ind_k,
+                     const PetscInt cls_sz,
+                     const PetscInt halo_sz,
+                     Args... args)
+{
+  rhs_local(tiling::region_3d(rhs, tile), dst, src, ind_i, ind_j, ind_k, cls_sz, halo_sz, args...);
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_overlap_tiled(const std::array<PetscInt,2>& tile,
+                       const Rhs& rhs,
+                             grid::grid_function_3d<PetscScalar,Layout> dst,
+                       const grid::grid_function_3d<PetscScalar,Layout> src,
+                       const std::array<PetscInt,2>& ind_i,
+                       const std::array<PetscInt,2>& ind_j,
+                       const std::array<PetscInt,2>& ind_k,
+                       const PetscInt cls_sz,
+                       const PetscInt halo_sz,
+                       Args... args)
+{
+  rhs_overlap(tiling::region_3d(rhs, tile), dst, src, ind_i, ind_j, ind_k, cls_sz, halo_sz, args...);
+}
+
+template <typename Rhs,
+          typename Layout,
+          typename... Args>
+void rhs_serial_tiled(const std::array<PetscInt,2>& tile,
+                      const Rhs& rhs,
+                            grid::grid_function_3d<PetscScalar,Layout> dst,
+                      const grid::grid_function_3d<PetscScalar,Layout> src,
+                      const PetscInt cls_sz,
+                      Args... args)
+{
+  rhs_serial(tiling::region_3d(rhs, tile), dst, src, cls_sz, args...);
+}
+
+//=============================================================================
+// Threaded 3D boundary conditions. Same as the 3D functions in
+// partitioned_rhs/boundary_conditions.h, with the first index range of each
+// face split over the threads of the rank.
+//=============================================================================
+template <typename BCWest,
+          typename BCSouth,
+          typename BCEast,
+          typename BCNorth,
+          typename BCBottom,
+          typename BCTop,
+          typename Layout,
+          typename... Args>
+void bc_tiled(const BCWest& bc_w,
+              const BCSouth& bc_s,
+              const BCEast& bc_e,
+              const BCNorth& bc_n,
+              const BCBottom& bc_b,
+              const BCTop& bc_t,
+                    grid::grid_function_3d<PetscScalar,Layout> dst,
+              const grid::grid_function_3d<PetscScalar,Layout> src,
+              const std::array<PetscInt,2>& ind_i,
+              const std::array<PetscInt,2>& ind_j,
+              const std::array<PetscInt,2>& ind_k,
+                    Args... args)
+{
+  bc(tiling::boundary(bc_w), tiling::boundary(bc_s), tiling::boundary(bc_e), tiling::boundary(bc_n),
+     tiling::boundary(bc_b), tiling::boundary(bc_t), dst, src, ind_i, ind_j, ind_k, args...);
+};
+
+template <typename BCWest,
+          typename BCSouth,
+          typename BCEast,
+          typename BCNorth,
+          typename BCBottom,
+          typename BCTop,
+          typename Layout,
+          typename... Args>
+void bc_serial_tiled(const BCWest& bc_w,
+                     const BCSouth& bc_s,
+                     const BCEast& bc_e,
+                     const BCNorth& bc_n,
+                     const BCBottom& bc_b,
+                     const BCTop& bc_t,
+                           grid::grid_function_3d<PetscScalar,Layout> dst,
+                     const grid::grid_function_3d<PetscScalar,Layout> src,
+                           Args... args)
+{
+  bc_serial(tiling::boundary(bc_w), tiling::boundary(bc_s), tiling::boundary(bc_e), tiling::boundary(bc_n),
+            tiling::boundary(bc_b), tiling::boundary(bc_t), dst, src, args...);
+};
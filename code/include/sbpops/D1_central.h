@@ -1,7 +1,10 @@
 #pragma once
 
 #include<petscsystypes.h>
+#include<array>
 #include "grids/grid_function.h"
+#include "grids/region.h"
+#include "sbpops/simd.h"
 
 
 namespace sbp {
@@ -83,6 +86,28 @@ namespace sbp {
       return hi*u;
     };
 
+    /**
+    * Computes the derivative in x-direction of a multicomponent 1D grid function v[i][comp] for a run of indices within the set of interior points.
+    * The run is processed with the SIMD row kernel in sbpops/simd.h.
+    * Input:  v     - Multicomponent 1D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hi    - inverse grid spacing
+    *         ind_i - Grid index range [i_start, i_end) in x-direction. Indices must be within the set of interior points
+    *         comp  - grid function component.
+    *
+    * Output: u     - Contiguous buffer of length i_end - i_start holding the derivative v_x[i][comp]
+    **/
+    inline void apply_interior_row(const grid::grid_function_1d<PetscScalar> v, const PetscScalar hi, const std::array<PetscInt,2>& ind_i, const PetscInt comp, PetscScalar *const u) const
+    {
+      const PetscInt i_start = ind_i[0]-(int_width-1)/2;
+      const PetscInt stride = &v(i_start+1,comp) - &v(i_start,comp);
+      const PetscScalar *rows[int_width];
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        rows[is] = &v(i_start+is,comp);
+      }
+      simd::apply_stencil_row<int_width>(rows, stride, static_cast<const Stencils&>(*this).interior_stencil, hi, ind_i[1]-ind_i[0], u);
+    };
+
     /**
     * Computes the derivative in x-direction of a multicomponent 1D grid function v[i][comp] for an index i within the set of right closure points.
     * Input:  v     - Multicomponent 1D grid function v (typically obtained via DMDAVecGetArrayDOF)
@@ -116,7 +141,8 @@ namespace sbp {
     *
     * Output: derivative v_x[j][i][comp]
     **/
-    inline PetscScalar apply_x_left(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_x_left(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       PetscScalar u = 0;
       for (PetscInt is = 0; is<cls_width; is++)
@@ -136,7 +162,8 @@ namespace sbp {
     *
     * Output: derivative v_x[j][i][comp]
     **/
-    inline PetscScalar apply_y_left(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_y_left(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       PetscScalar u = 0;
       for (PetscInt is = 0; is<cls_width; is++)
@@ -156,7 +183,8 @@ namespace sbp {
     *
     * Output: derivative v_x[j][i][comp]
     **/
-    inline PetscScalar apply_x_interior(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_x_interior(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       PetscScalar u = 0;
       for (PetscInt is = 0; is<int_width; is++)
@@ -176,7 +204,8 @@ namespace sbp {
     *
     * Output: derivative v_x[j][i][comp]
     **/
-    inline PetscScalar apply_y_interior(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_y_interior(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       PetscScalar u = 0;
       for (PetscInt is = 0; is<int_width; is++)
@@ -186,6 +215,54 @@ namespace sbp {
       return hiy*u;
     };
 
+    /**
+    * Computes the derivative in x-direction of a multicomponent 2D grid function v[j][i][comp] for a run of indices i within the set of interior points.
+    * The run is processed with the SIMD row kernel in sbpops/simd.h.
+    * Input:  v     - Multicomponent 2D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hix   - inverse grid spacing in x-direction
+    *         ind_i - Grid index range [i_start, i_end) in x-direction. Indices must be within the set of interior points.
+    *         j     - Grid index in y-direction.
+    *         comp  - grid function component.
+    *
+    * Output: u     - Contiguous buffer of length i_end - i_start holding the derivative v_x[j][i][comp]
+    **/
+    template <typename Layout>
+    inline void apply_x_interior_row(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hix, const std::array<PetscInt,2>& ind_i, const PetscInt j, const PetscInt comp, PetscScalar *const u) const
+    {
+      const PetscInt i_start = ind_i[0]-(int_width-1)/2;
+      const PetscInt stride = &v(j,i_start+1,comp) - &v(j,i_start,comp);
+      const PetscScalar *rows[int_width];
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        rows[is] = &v(j,i_start+is,comp);
+      }
+      simd::apply_stencil_row<int_width>(rows, stride, static_cast<const Stencils&>(*this).interior_stencil, hix, ind_i[1]-ind_i[0], u);
+    };
+
+    /**
+    * Computes the derivative in y-direction of a multicomponent 2D grid function v[j][i][comp] for a run of indices i, with j within the set of interior points.
+    * The run is processed with the SIMD row kernel in sbpops/simd.h.
+    * Input:  v     - Multicomponent 2D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hiy   - inverse grid spacing in y-direction
+    *         ind_i - Grid index range [i_start, i_end) in x-direction.
+    *         j     - Grid index in y-direction. Must be within the set of interior points.
+    *         comp  - grid function component.
+    *
+    * Output: u     - Contiguous buffer of length i_end - i_start holding the derivative v_y[j][i][comp]
+    **/
+    template <typename Layout>
+    inline void apply_y_interior_row(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hiy, const std::array<PetscInt,2>& ind_i, const PetscInt j, const PetscInt comp, PetscScalar *const u) const
+    {
+      const PetscInt j_start = j-(int_width-1)/2;
+      const PetscInt stride = &v(j_start,ind_i[0]+1,comp) - &v(j_start,ind_i[0],comp);
+      const PetscScalar *rows[int_width];
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        rows[is] = &v(j_start+is,ind_i[0],comp);
+      }
+      simd::apply_stencil_row<int_width>(rows, stride, static_cast<const Stencils&>(*this).interior_stencil, hiy, ind_i[1]-ind_i[0], u);
+    };
+
     /**
     * Computes the derivative in x-direction of a multicomponent 2D grid function v[j][i][comp] for an index i within the set of right closure points.
     * Input:  v     - Multicomponent 2D grid function v (typically obtained via DMDAVecGetArrayDOF)
@@ -197,7 +274,8 @@ namespace sbp {
     *
     * Output: derivative v_x[j][i][comp]
     **/
-    inline PetscScalar apply_x_right(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_x_right(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       const PetscInt Nx = v.mapping().nx();
       PetscScalar u = 0;
@@ -219,7 +297,8 @@ namespace sbp {
     *
     * Output: derivative v_x[j][i][comp]
     **/
-    inline PetscScalar apply_y_right(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_y_right(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       const PetscInt Ny = v.mapping().ny();
       PetscScalar u = 0;
@@ -230,6 +309,242 @@ namespace sbp {
       return hiy*u;
     };
 
+    //=============================================================================
+    // 3D functions
+    //=============================================================================
+    /**
+    * Computes the derivative in x-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index i within the set of left closure points.
+    * Input:  v     - Multicomponent 3D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hix   - inverse grid spacing in x-direction
+    *         i     - Grid index in x-direction. Index must be within the set of left closure points
+    *         j     - Grid index in y-direction.
+    *         k     - Grid index in z-direction.
+    *         comp  - grid function component.
+    *
+    * Output: derivative v_x[k][j][i][comp]
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_x_left(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is<cls_width; is++)
+      {
+        u += static_cast<const Stencils&>(*this).closure_stencils[i][is]*v(k,j,is,comp);
+      }
+      return hix*u;
+    };
+
+    /**
+    * Computes the derivative in y-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index j within the set of left closure points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_y_left(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is<cls_width; is++)
+      {
+        u += static_cast<const Stencils&>(*this).closure_stencils[j][is]*v(k,is,i,comp);
+      }
+      return hiy*u;
+    };
+
+    /**
+    * Computes the derivative in z-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index k within the set of left closure points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_z_left(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiz, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is<cls_width; is++)
+      {
+        u += static_cast<const Stencils&>(*this).closure_stencils[k][is]*v(is,j,i,comp);
+      }
+      return hiz*u;
+    };
+
+    /**
+    * Computes the derivative in x-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index i within the set of interior points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_x_interior(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        u += static_cast<const Stencils&>(*this).interior_stencil[is]*v(k,j,i-(int_width-1)/2+is,comp);
+      }
+      return hix*u;
+    };
+
+    /**
+    * Computes the derivative in y-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index j within the set of interior points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_y_interior(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        u += static_cast<const Stencils&>(*this).interior_stencil[is]*v(k,j-(int_width-1)/2+is,i,comp);
+      }
+      return hiy*u;
+    };
+
+    /**
+    * Computes the derivative in z-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index k within the set of interior points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_z_interior(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiz, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        u += static_cast<const Stencils&>(*this).interior_stencil[is]*v(k-(int_width-1)/2+is,j,i,comp);
+      }
+      return hiz*u;
+    };
+
+    /**
+    * Computes the derivative in x-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index i within the set of right closure points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_x_right(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      const PetscInt Nx = v.mapping().nx();
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is < cls_width; is++)
+      {
+        u -= static_cast<const Stencils&>(*this).closure_stencils[Nx-i-1][cls_width-is-1]*v(k,j,Nx-cls_width+is,comp);
+      }
+      return hix*u;
+    };
+
+    /**
+    * Computes the derivative in y-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index j within the set of right closure points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_y_right(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      const PetscInt Ny = v.mapping().ny();
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is < cls_width; is++)
+      {
+        u -= static_cast<const Stencils&>(*this).closure_stencils[Ny-j-1][cls_width-is-1]*v(k,Ny-cls_width+is,i,comp);
+      }
+      return hiy*u;
+    };
+
+    /**
+    * Computes the derivative in z-direction of a multicomponent 3D grid function v[k][j][i][comp] for an index k within the set of right closure points.
+    * See apply_x_left.
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_z_right(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiz, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      const PetscInt Nz = v.mapping().nz();
+      PetscScalar u = 0;
+      for (PetscInt is = 0; is < cls_width; is++)
+      {
+        u -= static_cast<const Stencils&>(*this).closure_stencils[Nz-k-1][cls_width-is-1]*v(Nz-cls_width+is,j,i,comp);
+      }
+      return hiz*u;
+    };
+
+    /**
+    * Computes the derivative in x-, y- or z-direction of a multicomponent 3D grid function v[k][j][i][comp], using the
+    * stencil of region r (grid::LEFT, grid::INTERIOR or grid::RIGHT) in that direction, selected at compile time.
+    * See apply_x_left.
+    **/
+    template <grid::Region r, typename Layout>
+    inline PetscScalar apply_x(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hix, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      if constexpr (r == grid::LEFT) return apply_x_left(v, hix, i, j, k, comp);
+      else if constexpr (r == grid::INTERIOR) return apply_x_interior(v, hix, i, j, k, comp);
+      else return apply_x_right(v, hix, i, j, k, comp);
+    };
+
+    template <grid::Region r, typename Layout>
+    inline PetscScalar apply_y(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiy, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      if constexpr (r == grid::LEFT) return apply_y_left(v, hiy, i, j, k, comp);
+      else if constexpr (r == grid::INTERIOR) return apply_y_interior(v, hiy, i, j, k, comp);
+      else return apply_y_right(v, hiy, i, j, k, comp);
+    };
+
+    template <grid::Region r, typename Layout>
+    inline PetscScalar apply_z(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiz, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      if constexpr (r == grid::LEFT) return apply_z_left(v, hiz, i, j, k, comp);
+      else if constexpr (r == grid::INTERIOR) return apply_z_interior(v, hiz, i, j, k, comp);
+      else return apply_z_right(v, hiz, i, j, k, comp);
+    };
+
+    /**
+    * Computes the derivative in x-direction of a multicomponent 3D grid function v[k][j][i][comp] for a run of indices i within the set of interior points.
+    * The run is processed with the SIMD row kernel in sbpops/simd.h.
+    * Input:  v     - Multicomponent 3D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hix   - inverse grid spacing in x-direction
+    *         ind_i - Grid index range [i_start, i_end) in x-direction. Indices must be within the set of interior points.
+    *         j     - Grid index in y-direction.
+    *         k     - Grid index in z-direction.
+    *         comp  - grid function component.
+    *
+    * Output: u     - Contiguous buffer of length i_end - i_start holding the derivative v_x[k][j][i][comp]
+    **/
+    template <typename Layout>
+    inline void apply_x_interior_row(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hix, const std::array<PetscInt,2>& ind_i, const PetscInt j, const PetscInt k, const PetscInt comp, PetscScalar *const u) const
+    {
+      const PetscInt i_start = ind_i[0]-(int_width-1)/2;
+      const PetscInt stride = &v(k,j,i_start+1,comp) - &v(k,j,i_start,comp);
+      const PetscScalar *rows[int_width];
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        rows[is] = &v(k,j,i_start+is,comp);
+      }
+      simd::apply_stencil_row<int_width>(rows, stride, static_cast<const Stencils&>(*this).interior_stencil, hix, ind_i[1]-ind_i[0], u);
+    };
+
+    /**
+    * Computes the derivative in y-direction of a multicomponent 3D grid function v[k][j][i][comp] for a run of indices i, with j within the set of interior points.
+    * See apply_x_interior_row.
+    **/
+    template <typename Layout>
+    inline void apply_y_interior_row(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiy, const std::array<PetscInt,2>& ind_i, const PetscInt j, const PetscInt k, const PetscInt comp, PetscScalar *const u) const
+    {
+      const PetscInt j_start = j-(int_width-1)/2;
+      const PetscInt stride = &v(k,j_start,ind_i[0]+1,comp) - &v(k,j_start,ind_i[0],comp);
+      const PetscScalar *rows[int_width];
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        rows[is] = &v(k,j_start+is,ind_i[0],comp);
+      }
+      simd::apply_stencil_row<int_width>(rows, stride, static_cast<const Stencils&>(*this).interior_stencil, hiy, ind_i[1]-ind_i[0], u);
+    };
+
+    /**
+    * Computes the derivative in z-direction of a multicomponent 3D grid function v[k][j][i][comp] for a run of indices i, with k within the set of interior points.
+    * See apply_x_interior_row.
+    **/
+    template <typename Layout>
+    inline void apply_z_interior_row(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hiz, const std::array<PetscInt,2>& ind_i, const PetscInt j, const PetscInt k, const PetscInt comp, PetscScalar *const u) const
+    {
+      const PetscInt k_start = k-(int_width-1)/2;
+      const PetscInt stride = &v(k_start,j,ind_i[0]+1,comp) - &v(k_start,j,ind_i[0],comp);
+      const PetscScalar *rows[int_width];
+      for (PetscInt is = 0; is<int_width; is++)
+      {
+        rows[is] = &v(k_start+is,j,ind_i[0],comp);
+      }
+      simd::apply_stencil_row<int_width>(rows, stride, static_cast<const Stencils&>(*this).interior_stencil, hiz, ind_i[1]-ind_i[0], u);
+    };
+
   };
 
   
@@ -67,7 +67,8 @@ namespace sbp {
     *
     * Output: HI[i][i]*v[i][comp]
     **/
-    inline PetscScalar apply_x_left(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_x_left(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[i]*v(j,i,comp);
     };
@@ -81,7 +82,8 @@ namespace sbp {
     *
     * Output: HI[i][i]*v[i][comp]
     **/
-    inline PetscScalar apply_y_left(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_y_left(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[j]*v(j,i,comp);
     };
@@ -96,7 +98,8 @@ namespace sbp {
     *
     * Output: HI[i][i]*v[i][comp]
     **/
-    inline PetscScalar apply_x_right(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_x_right(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[N-i-1]*v(j,i,comp);
     };
@@ -111,10 +114,69 @@ namespace sbp {
     *
     * Output: HI[i][i]*v[i][comp]
     **/
-    inline PetscScalar apply_y_right(const grid::grid_function_2d<PetscScalar> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt comp) const
+    template <typename Layout>
+    inline PetscScalar apply_y_right(const grid::grid_function_2d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt comp) const
     {
       return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[N-j-1]*v(j,i,comp);
     };
+
+    //=============================================================================
+    // 3D functions
+    //=============================================================================
+    /**
+    * Returns HI_ii * v_kji for i (j, k) within left closure points.
+    * Input:  v     - Multicomponent 3D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hi    - Inverse grid spacing
+    *         i,j,k - Grid indices. The index in the direction of the operator must be within the set of left closure points.
+    *         comp  - Grid function component.
+    *
+    * Output: HI[i][i]*v[k][j][i][comp] (respectively HI[j][j], HI[k][k])
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_x_left(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[i]*v(k,j,i,comp);
+    };
+
+    template <typename Layout>
+    inline PetscScalar apply_y_left(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[j]*v(k,j,i,comp);
+    };
+
+    template <typename Layout>
+    inline PetscScalar apply_z_left(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[k]*v(k,j,i,comp);
+    };
+
+    /**
+    * Returns HI_ii * v_kji for i (j, k) within right closure points.
+    * Input:  v     - Multicomponent 3D grid function v (typically obtained via DMDAVecGetArrayDOF)
+    *         hi    - Inverse grid spacing
+    *         N     - Number of global grid points in the direction of the operator.
+    *         i,j,k - Grid indices. The index in the direction of the operator must be within the set of right closure points.
+    *         comp  - Grid function component.
+    *
+    * Output: HI[i][i]*v[k][j][i][comp] (respectively HI[j][j], HI[k][k])
+    **/
+    template <typename Layout>
+    inline PetscScalar apply_x_right(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[N-i-1]*v(k,j,i,comp);
+    };
+
+    template <typename Layout>
+    inline PetscScalar apply_y_right(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[N-j-1]*v(k,j,i,comp);
+    };
+
+    template <typename Layout>
+    inline PetscScalar apply_z_right(const grid::grid_function_3d<PetscScalar,Layout> v, const PetscScalar hi, const PetscInt N, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt comp) const
+    {
+      return hi*static_cast<const InverseQuadrature&>(*this).closure_invquad[N-k-1]*v(k,j,i,comp);
+    };
   };
 
   
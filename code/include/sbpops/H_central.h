@@ -23,6 +23,16 @@ namespace sbp {
       return n_closures;
     };
 
+    /**
+    * Returns the quadrature weight H[i][i]/h of grid point i.
+    * Input:  N     - Number of global grid points.
+    *         i     - Grid index.
+    **/
+    static inline constexpr PetscScalar weight(const PetscInt N, const PetscInt i)
+    {
+      return i < n_closures ? Quadrature::closure_quad[i] : (i >= N - n_closures ? Quadrature::closure_quad[N-i-1] : 1);
+    };
+
     //=============================================================================
     // 1D functions
     //=============================================================================
@@ -1,31 +1,101 @@
 #pragma once
 
+#include <petscsys.h>
 #include "sbpops/D1_central.h"
 #include "sbpops/H_central.h"
 #include "sbpops/HI_central.h"
 
-#ifndef SBP_OPERATOR_ORDER
-#error "SBP_OPERATOR_ORDER not defined (must be one of 2,4,6)"
-#endif
-
 // TODO: In the future we can add a preprocessor flag for different
 // operator types. e.g #ifdef SBP_OPERATOR_TYPE_CENTRAL
 // #ifndef SBP_OPERATOR_TYPE_CENTRAL
 // #define SBP_OPERATOR_TYPE_CENTRAL
 // #endif
 
-// #ifdef SBP_OPERATOR_TYPE_CENTRAL
-#if SBP_OPERATOR_ORDER == 2
-	typedef sbp::D1_central<sbp::Stencils_2nd,3,1,2> FirstDerivativeOp;
-	typedef sbp::H_central<sbp::Quadrature_2nd,1> NormOp;
-	typedef sbp::HI_central<sbp::InverseQuadrature_2nd,1> InverseNormOp;
-#elif SBP_OPERATOR_ORDER == 4
-	typedef sbp::D1_central<sbp::Stencils_4th,5,4,6> FirstDerivativeOp;
-	typedef sbp::H_central<sbp::Quadrature_4th,4> NormOp;
-	typedef sbp::HI_central<sbp::InverseQuadrature_4th,4> InverseNormOp;
-#elif SBP_OPERATOR_ORDER == 6
-	typedef sbp::D1_central<sbp::Stencils_6th,7,6,9> FirstDerivativeOp;
-	typedef sbp::H_central<sbp::Quadrature_6th,6> NormOp;
-	typedef sbp::HI_central<sbp::InverseQuadrature_6th,6> InverseNormOp;
+#if defined(SBP_OPERATOR_ORDER) && SBP_OPERATOR_ORDER != 2 && SBP_OPERATOR_ORDER != 4 && SBP_OPERATOR_ORDER != 6
+#error "SBP_OPERATOR_ORDER must be one of 2,4,6"
+#endif
+
+namespace sbp {
+  /**
+  * Central SBP operators of a given order of accuracy.
+  **/
+  template <PetscInt order>
+  struct CentralOperators;
+
+  template <>
+  struct CentralOperators<2> {
+    static constexpr PetscInt order = 2;
+    typedef sbp::D1_central<sbp::Stencils_2nd,3,1,2> FirstDerivativeOp;
+    typedef sbp::H_central<sbp::Quadrature_2nd,1> NormOp;
+    typedef sbp::HI_central<sbp::InverseQuadrature_2nd,1> InverseNormOp;
+  };
+
+  template <>
+  struct CentralOperators<4> {
+    static constexpr PetscInt order = 4;
+    typedef sbp::D1_central<sbp::Stencils_4th,5,4,6> FirstDerivativeOp;
+    typedef sbp::H_central<sbp::Quadrature_4th,4> NormOp;
+    typedef sbp::HI_central<sbp::InverseQuadrature_4th,4> InverseNormOp;
+  };
+
+  template <>
+  struct CentralOperators<6> {
+    static constexpr PetscInt order = 6;
+    typedef sbp::D1_central<sbp::Stencils_6th,7,6,9> FirstDerivativeOp;
+    typedef sbp::H_central<sbp::Quadrature_6th,6> NormOp;
+    typedef sbp::HI_central<sbp::InverseQuadrature_6th,6> InverseNormOp;
+  };
+
+  /**
+  * Reads the order of the SBP operators from the option -sbp_order. Defaults to SBP_OPERATOR_ORDER if defined,
+  * otherwise to 4.
+  **/
+  inline PetscErrorCode get_order_from_options(PetscInt& order)
+  {
+    PetscErrorCode ierr;
+#ifdef SBP_OPERATOR_ORDER
+    order = SBP_OPERATOR_ORDER;
+#else
+    order = 4;
+#endif
+    ierr = PetscOptionsGetInt(NULL,NULL,"-sbp_order",&order,NULL);CHKERRQ(ierr);
+    return 0;
+  }
+
+  /**
+  * Calls f(CentralOperators<order>()) for the order selected at runtime, and returns its error code. Everything
+  * called by f is instantiated for each order, such that the kernels are fully specialized and the order is only
+  * branched on once. If SBP_OPERATOR_ORDER is defined, only that order is compiled into the binary.
+  * Input:  order - Order of the SBP operators, one of 2,4,6.
+  *         f     - Generic callable taking the operator set CentralOperators<order>.
+  **/
+  template <typename F>
+  PetscErrorCode dispatch_order(const PetscInt order, F&& f)
+  {
+    switch (order) {
+#if !defined(SBP_OPERATOR_ORDER) || SBP_OPERATOR_ORDER == 2
+      case 2: return f(CentralOperators<2>());
+#endif
+#if !defined(SBP_OPERATOR_ORDER) || SBP_OPERATOR_ORDER == 4
+      case 4: return f(CentralOperators<4>());
+#endif
+#if !defined(SBP_OPERATOR_ORDER) || SBP_OPERATOR_ORDER == 6
+      case 6: return f(CentralOperators<6>());
+#endif
+      default:
+#ifdef SBP_OPERATOR_ORDER
+        PetscPrintf(PETSC_COMM_WORLD,"Error: SBP order %d is not available, the binary is built for order %d only.\n",order,SBP_OPERATOR_ORDER);
+#else
+        PetscPrintf(PETSC_COMM_WORLD,"Error: SBP order %d is not available, must be one of 2,4,6.\n",order);
+#endif
+        return -1;
+    }
+  }
+}
+
+// Operators of a single-order build
+#ifdef SBP_OPERATOR_ORDER
+typedef sbp::CentralOperators<SBP_OPERATOR_ORDER>::FirstDerivativeOp FirstDerivativeOp;
+typedef sbp::CentralOperators<SBP_OPERATOR_ORDER>::NormOp NormOp;
+typedef sbp::CentralOperators<SBP_OPERATOR_ORDER>::InverseNormOp InverseNormOp;
 #endif //SBP_OPERATOR_ORDER
-// #endif //SBP_OPERATOR_TYPE_CENTRAL
\ No newline at end of file
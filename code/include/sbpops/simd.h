@@ -0,0 +1,134 @@
+#pragma once
+
+#include<petscsystypes.h>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace sbp {
+namespace simd {
+
+  /**
+  * Number of grid points processed per call to the row kernels of the SBP operators. Kernels
+  * computing a row of derivatives keep one buffer of this size per derivative on the stack.
+  **/
+  constexpr PetscInt row_block = 64;
+
+  /**
+  * Thin wrapper around the widest double precision vector register available. The instruction set
+  * is selected at compile time from the target flags (e.g -march=native), falling back to a portable
+  * fixed size array which the compiler is free to auto-vectorize. Arithmetic is performed with separate
+  * multiply and add operations, i.e exactly the operations performed by the scalar apply functions.
+  **/
+#if defined(__AVX512F__)
+  struct pack {
+    static constexpr PetscInt width = 8;
+    __m512d v;
+
+    static inline pack zero() { return {_mm512_setzero_pd()}; };
+    static inline pack broadcast(const double a) { return {_mm512_set1_pd(a)}; };
+    static inline pack load(const double *const p) { return {_mm512_loadu_pd(p)}; };
+    static inline pack load(const double *const p, const PetscInt stride)
+    {
+      if (stride == 1) return load(p);
+      // Built with AVX512F only (_mm512_mullo_epi64 would require AVX512DQ)
+      const __m512i idx = _mm512_set_epi64(7*stride,6*stride,5*stride,4*stride,3*stride,2*stride,stride,0);
+      return {_mm512_i64gather_pd(idx, p, sizeof(double))};
+    };
+    inline void store(double *const p) const { _mm512_storeu_pd(p,v); };
+    friend inline pack operator+(const pack a, const pack b) { return {_mm512_add_pd(a.v,b.v)}; };
+    friend inline pack operator*(const pack a, const pack b) { return {_mm512_mul_pd(a.v,b.v)}; };
+  };
+#elif defined(__AVX2__)
+  struct pack {
+    static constexpr PetscInt width = 4;
+    __m256d v;
+
+    static inline pack zero() { return {_mm256_setzero_pd()}; };
+    static inline pack broadcast(const double a) { return {_mm256_set1_pd(a)}; };
+    static inline pack load(const double *const p) { return {_mm256_loadu_pd(p)}; };
+    static inline pack load(const double *const p, const PetscInt stride)
+    {
+      if (stride == 1) return load(p);
+      const __m256i idx = _mm256_set_epi64x(3*stride,2*stride,stride,0);
+      return {_mm256_i64gather_pd(p, idx, sizeof(double))};
+    };
+    inline void store(double *const p) const { _mm256_storeu_pd(p,v); };
+    friend inline pack operator+(const pack a, const pack b) { return {_mm256_add_pd(a.v,b.v)}; };
+    friend inline pack operator*(const pack a, const pack b) { return {_mm256_mul_pd(a.v,b.v)}; };
+  };
+#else
+  struct pack {
+    static constexpr PetscInt width = 4;
+    double v[width];
+
+    static inline pack zero() { return broadcast(0); };
+    static inline pack broadcast(const double a)
+    {
+      pack r;
+      for (PetscInt l = 0; l < width; l++) r.v[l] = a;
+      return r;
+    };
+    static inline pack load(const double *const p, const PetscInt stride = 1)
+    {
+      pack r;
+      for (PetscInt l = 0; l < width; l++) r.v[l] = p[l*stride];
+      return r;
+    };
+    inline void store(double *const p) const
+    {
+      for (PetscInt l = 0; l < width; l++) p[l] = v[l];
+    };
+    friend inline pack operator+(const pack a, const pack b)
+    {
+      pack r;
+      for (PetscInt l = 0; l < width; l++) r.v[l] = a.v[l] + b.v[l];
+      return r;
+    };
+    friend inline pack operator*(const pack a, const pack b)
+    {
+      pack r;
+      for (PetscInt l = 0; l < width; l++) r.v[l] = a.v[l]*b.v[l];
+      return r;
+    };
+  };
+#endif
+
+  /**
+  * Applies a stencil to a run of n points stored with a constant stride, i.e
+  * u[i] = h*sum_is stencil[is]*v[is][i], where the input rows v[is] are given as pointers and strides.
+  * The summation order matches the scalar apply functions of the SBP operators.
+  * Input:  v       - Pointers to the first point of each of the width input rows.
+  *         stride  - Distance between consecutive points in the input rows.
+  *         stencil - Stencil weights.
+  *         h       - Scaling of the result (typically inverse grid spacing).
+  *         n       - Number of points.
+  *
+  * Output: u       - Contiguous buffer of length n holding the result.
+  **/
+  template <PetscInt width>
+  inline void apply_stencil_row(const PetscScalar *const (&v)[width], const PetscInt stride, const double (&stencil)[width],
+                                const PetscScalar h, const PetscInt n, PetscScalar *const u)
+  {
+    PetscInt i = 0;
+    for (; i + pack::width <= n; i += pack::width)
+    {
+      pack acc = pack::zero();
+      for (PetscInt is = 0; is < width; is++)
+      {
+        acc = acc + pack::broadcast(stencil[is])*pack::load(v[is] + i*stride, stride);
+      }
+      (pack::broadcast(h)*acc).store(u + i);
+    }
+    for (; i < n; i++)
+    {
+      PetscScalar acc = 0;
+      for (PetscInt is = 0; is < width; is++)
+      {
+        acc += stencil[is]*v[is][i*stride];
+      }
+      u[i] = h*acc;
+    }
+  };
+} //End namespace simd
+} //End namespace sbp
@@ -0,0 +1,67 @@
+#pragma once
+
+#include<petsc.h>
+#include<array>
+#include<vector>
+
+/**
+* Halo (ghost point) exchange of local vectors, with the same begin/end usage as VecScatterBegin/VecScatterEnd.
+*
+* HALO_PETSC     - The local to local scatter context of the DMDA (DMDAGetScatter).
+* HALO_CUSTOM    - The local to local scatter context built by scatter_ctx_ltol, only communicating ghost points.
+* HALO_NEIGHBOR  - Nonblocking neighborhood collective (MPI_Ineighbor_alltoallw) over a Cartesian communicator
+*                  matching the DMDA process grid. The owned points sent to the neighbors are packed into a
+*                  contiguous send buffer, since MPI does not allow the send and receive buffers to alias. The
+*                  ghost points are received directly into the local array through precomputed subarray datatypes.
+*
+* Like the custom scatter context, HALO_NEIGHBOR communicates the ghost points across the edges of the
+* local domain (star stencil). Ghost points in the corners of the local domain are not communicated.
+**/
+enum HaloType {HALO_PETSC = 0, HALO_CUSTOM = 1, HALO_NEIGHBOR = 2};
+
+struct HaloCtx {
+  HaloType type;
+  VecScatter scatctx;                     // HALO_PETSC, HALO_CUSTOM
+  // HALO_NEIGHBOR
+  MPI_Comm comm;                          // Cartesian communicator
+  PetscBool soa;                          // Component-major ordering of the local vectors
+  std::array<PetscInt,3> local_sizes;     // Size (lnx, lny, dof) of the local array
+  std::vector<int> neighbors;             // Rank in comm of each neighbor, or MPI_PROC_NULL
+  std::vector<std::array<PetscInt,4>> send_boxes; // Owned points (j0, sj, i0, si) sent to each neighbor
+  std::vector<std::array<PetscInt,4>> recv_boxes; // Ghost points (j0, sj, i0, si) received from each neighbor
+  std::vector<int> send_counts;           // Number of values sent to each neighbor
+  std::vector<MPI_Aint> send_displs;      // Byte displacements of the packed strips in send_buffer
+  std::vector<MPI_Datatype> send_types;   // All MPIU_SCALAR
+  std::vector<PetscScalar> send_buffer;   // Owned points sent to each neighbor, packed
+  std::vector<int> counts;                // Number of datatypes received from each neighbor (0 or 1)
+  std::vector<MPI_Aint> displs;           // Byte displacements, all 0 (the offsets are part of the datatypes)
+  std::vector<MPI_Datatype> recv_types;   // Ghost points received from each neighbor
+  MPI_Request request;
+  PetscScalar *array;                     // Array of the vector being exchanged, between begin and end
+};
+
+/**
+* Creates a halo exchange context for the local vectors of a 1D or 2D DMDA, or of a 3D DMDA for HALO_PETSC and
+* HALO_CUSTOM.
+* Inputs: da        - DMDA object
+*         type      - Type of halo exchange
+*         soa       - If true, the local vectors are stored in component-major ordering (grid::PartitionedLayout2DSoA).
+*                     Requires type HALO_CUSTOM or HALO_NEIGHBOR; HALO_PETSC is replaced by HALO_CUSTOM.
+*         halo      - Halo exchange context
+**/
+PetscErrorCode halo_ctx_create(DM da, const HaloType type, const PetscBool soa, HaloCtx& halo);
+
+/**
+* Destroys the communicator, datatypes and scatter context owned by the halo exchange context.
+**/
+PetscErrorCode halo_ctx_destroy(HaloCtx& halo);
+
+/**
+* Starts the exchange of the ghost points of the local vector v.
+**/
+PetscErrorCode halo_exchange_begin(HaloCtx& halo, Vec v);
+
+/**
+* Completes the exchange of the ghost points of the local vector v started by halo_exchange_begin.
+**/
+PetscErrorCode halo_exchange_end(HaloCtx& halo, Vec v);
@@ -2,4 +2,11 @@
 
 #include<petsc.h>
 
-PetscErrorCode scatter_ctx_ltol(DM da, VecScatter& ltol);
\ No newline at end of file
+PetscErrorCode scatter_ctx_ltol(DM da, VecScatter& ltol);
+
+/**
+* Local to local scatter context for 2D local vectors stored in component-major ordering, i.e grid::PartitionedLayout2DSoA.
+* Inputs: da        - DMDA object
+*         ltol      - pointer to local to local scatter context
+**/
+PetscErrorCode scatter_ctx_ltol_soa(DM da, VecScatter& ltol);
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <petscts.h>
+#include <petscdmda.h>
+
+/**
+* Matrix-free operator of the spatial discretization. The RHS function F(t,v) of the time stepping (region kernels,
+* halo exchange and SAT/boundary terms) is wrapped as a PETSc MatShell acting on global vectors of the DMDA, such
+* that F can be used as the RHS Jacobian of implicit, IMEX or exponential integrators (TSSetRHSJacobian).
+*
+* MatMult(A,x,y) copies the owned points of x into a ghosted local work vector in the layout of the RHS function
+* (interleaved or component-major), evaluates the RHS, which exchanges the halos, and copies the owned points of the
+* result to y. For an affine RHS, F(t,v) = A(t)*v + g(t) with forcing or boundary data g, the shell subtracts
+* g(t) = F(t,0) so that it applies the Jacobian A(t).
+*
+* The linear part can also be assembled into a sparse AIJ or BAIJ matrix J (rhs_shell_assemble), which is stored with
+* the MatShell. J is found by probing the MatShell with the vectors of a coloring of the grid points, where points with
+* the same color are more than twice the coupling width of the SBP stencils apart. Each probe then gives the columns
+* of its color exactly, including the boundary closures and SAT terms. The spatial operator is assumed to be
+* independent of time.
+**/
+struct RHSShellCtx {
+  DM da;
+  PetscBool soa;                                // RHS function takes component-major local vectors
+  PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *);
+  void* ctx;
+  PetscReal t = 0;                              // Time at which the operator is applied
+  PetscBool affine;                             // Subtract F(t,0)
+  Vec x_local, y_local;                         // Local work vectors in the layout of rhs
+  Vec offset = NULL;                            // F(t,0) of an affine RHS, global vector
+  PetscReal offset_t = PETSC_MAX_REAL;          // Time of offset
+  PetscInt dof, gnp;
+  PetscInt start[3], n[3], gstart[3], gn[3];
+  Mat J = NULL;                                 // Assembled linear part, see rhs_shell_assemble
+  Vec x_global = NULL, y_global = NULL;         // Work vectors of rhs_shell_assembled
+};
+
+/**
+* Returns the coupling width of the first derivative operator D1, i.e the largest distance between a grid point and
+* the points its derivative depends on, in the interior stencil or the boundary closures.
+**/
+template <class D1Op>
+inline PetscInt coupling_width(const D1Op& D1)
+{
+  return PetscMax((D1.interior_stencil_width()-1)/2, D1.closure_stencil_width()-1);
+}
+
+/**
+* Creates the MatShell of the RHS function.
+* Inputs: da      - DMDA object
+*         soa     - If true, rhs takes local vectors in component-major ordering.
+*         rhs     - RHS function. Inputs (required by petsc): (TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx).
+*                   It is called with a NULL TS context.
+*         ctx     - User defined context of rhs
+*         affine  - If true, F(t,0) is subtracted, see above.
+*
+* Output: A       - MatShell acting on global vectors of da. Destroy with MatDestroy.
+**/
+PetscErrorCode rhs_shell_create(const DM da, const PetscBool soa, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *),
+                                void* ctx, const PetscBool affine, Mat& A);
+
+/**
+* Sets the time at which the MatShell A applies the RHS.
+**/
+PetscErrorCode rhs_shell_set_time(Mat A, const PetscReal t);
+
+/**
+* Evaluates the full RHS F(t,x) (including any forcing) on global vectors, for TSSetRHSFunction with the MatShell A
+* as context.
+**/
+PetscErrorCode rhs_shell_function(TS ts, PetscReal t, Vec x, Vec y, void* A);
+
+/**
+* RHS Jacobian callback for TSSetRHSJacobian, setting the time of the MatShell A.
+**/
+PetscErrorCode rhs_shell_jacobian(TS ts, PetscReal t, Vec x, Mat A, Mat P, void* ctx);
+
+/**
+* Copies the owned points between the global vector v_global and the local vector v_local in the layout of the RHS
+* function of the MatShell A. The ghost points of v_local are not set.
+**/
+PetscErrorCode rhs_shell_global_to_local(Mat A, Vec v_global, Vec v_local);
+PetscErrorCode rhs_shell_local_to_global(Mat A, Vec v_local, Vec v_global);
+
+/**
+* Assembles the linear part of the MatShell A into a sparse matrix J of the given type (MATAIJ or MATBAIJ with block
+* size dof), stored with A. The nonzero structure is preallocated exactly. The number of RHS evaluations is the
+* number of colors, (2*width+1)^dim*dof.
+* Inputs: A       - MatShell created by rhs_shell_create. Should be affine, unless the RHS has no forcing.
+*         type    - Matrix type
+*         width   - Coupling width of the spatial discretization, e.g coupling_width(D1). Entries further apart are an
+*                   error.
+**/
+PetscErrorCode rhs_shell_assemble(Mat A, const MatType type, const PetscInt width);
+
+/**
+* RHS function F(t,v) = J*v + g(t) on local vectors in the layout of the RHS function of the MatShell A, with the
+* assembled matrix J of A (rhs_shell_assemble) and the forcing g(t) = F(t,0) of an affine A. Can be used in place of
+* the RHS function of A in any of the time stepping routines, with A as context.
+**/
+PetscErrorCode rhs_shell_assembled(TS ts, PetscReal t, Vec v_src, Vec v_dst, void* A);
+
+/**
+* Estimates the spectral radius of the operator of the MatShell A (the assembled matrix if there is one) with iters
+* power iterations, e.g to choose the time step of an explicit scheme.
+**/
+PetscErrorCode rhs_shell_spectral_radius(Mat A, const PetscInt iters, PetscReal& rho);
+
+/**
+* Times reps applications of the MatShell A against reps calls of its raw RHS function on the local vector v_local,
+* and prints the times and the overhead of the shell. If A has an assembled matrix, its SpMV is timed as well.
+**/
+PetscErrorCode rhs_shell_bench(Mat A, Vec v_local, const PetscInt reps);
+
+/**
+* Time steps the system of ODEs v' = F(t,v) with a PETSc TS on global vectors, with the MatShell A of F as RHS
+* Jacobian. The integrator is selected with the TS runtime options and defaults to Crank-Nicolson (-ts_type cn),
+* solved with GMRES, unpreconditioned or preconditioned with the assembled matrix of A if there is one. Implicit (beuler, cn, theta, bdf), IMEX (arkimex) and the explicit integrators
+* can be used. The step monitors (ts_monitor.h) are called with the solution copied to the local vector v.
+* Inputs: t_end     - Final time
+*         dt        - Time step
+*         v         - Local working vector in the layout of the RHS function. Should contain initial data.
+*         A         - MatShell created by rhs_shell_create
+*         t_start   - Initial time, e.g of a restart
+*         step_start- Number of time steps taken before t_start
+**/
+PetscErrorCode ts_matshell(const PetscScalar t_end, const PetscScalar dt, Vec v, Mat A, const PetscReal t_start = 0,
+                           const PetscInt step_start = 0);
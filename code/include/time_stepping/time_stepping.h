@@ -1,6 +1,8 @@
 #pragma once
 
 #include <petscdmda.h>
+#include <array>
+#include "util/logging.h"
 
 /**
 * Time steps system of ODEs with RK4 using the built-in PETSc routines TS.
@@ -27,33 +29,59 @@ PetscErrorCode RK4_custom(const DM da, const PetscScalar Tend, PetscScalar dt, V
 
 
 /**
-* Finds local indices of inner points (no ghost points).
+* Inner points (non-ghost points) of a local vector, stored as rows of contiguous array entries.
+* The row (j,k) starts at offset + stride[0]*j + stride[1]*k and holds len entries.
+**/
+struct InnerRows {
+  PetscInt offset;                // Array index of the first inner point
+  PetscInt len;                   // Number of array entries in a row, nx*dof
+  std::array<PetscInt,2> n;       // Number of rows in y and z
+  std::array<PetscInt,2> stride;  // Array stride between rows in y and z
+};
+
+
+/**
+* Finds the rows of inner points (no ghost points) of the local vectors of a DMDA.
 * Inputs: da          - 1D, 2D or 3D DMDA object.
-*         ctx      - Application context.
-*         ln_tot      - Pointer to integer representing number of inner points.
-*         linner_ids  - Pointer to array containing inner indices.
+*         rows        - InnerRows struct describing the inner points.
 **/
-PetscErrorCode get_local_inner_ids(const DM da, PetscInt *ln_tot, PetscInt **linner_ids);
+PetscErrorCode get_local_inner_rows(const DM da, InnerRows& rows);
 
 
 /**
-* Computes v[i] = y[i] + alpha*x[i] for specified indices i.
-* Inputs: v, k1, k2, k3, k4   - PETSc vectors used for computation.
+* Calls kernel(start, end) for the array index range [start, end) of each inner row.
+**/
+template <typename Kernel>
+void for_each_inner_row(const InnerRows& rows, Kernel&& kernel);
+
+
+/**
+* Computes w[i] = v[i] + alpha*k[i] for inner points i.
+* Inputs: w, v, k             - PETSc vectors used for computation.
 *         alpha               - PETSc scalar used for computation.
-*         ln                  - Number of indices to update.
-*         linner_ids          - Vector of length ln containing the indices to update.
+*         rows                - Inner points to update.
+**/
+PetscErrorCode rk4_stage(Vec w, const Vec v, const PetscScalar alpha, const Vec k, const InnerRows& rows);
+
+
+/**
+* Computes w[i] = v[i] + alpha*k3[i] and the partial sum k1[i] = k1[i] + 2*(k2[i] + k3[i]) of the
+* RK4 update in the same sweep, for inner points i.
+* Inputs: w, v, k1, k2, k3    - PETSc vectors used for computation.
+*         alpha               - PETSc scalar used for computation, alpha = dt for RK4.
+*         rows                - Inner points to update.
 **/
-PetscErrorCode apply_WAXPY(Vec v, const PetscScalar alpha, const Vec x, const Vec y, const PetscInt ln, const PetscInt *linner_ids);
+PetscErrorCode rk4_stage_sum(Vec w, const Vec v, const PetscScalar alpha, Vec k1, const Vec k2, const Vec k3, const InnerRows& rows);
 
 
 /**
-* Computes v[i] = v[i] + alpha*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]) for specified indices i.
-* Inputs: v, k1, k2, k3, k4   - PETSc vectors used for computation.
+* Computes v[i] = v[i] + alpha*(s[i] + k4[i]) for inner points i, where s = k1 + 2*k2 + 2*k3 is
+* the partial sum computed by rk4_stage_sum.
+* Inputs: v, s, k4            - PETSc vectors used for computation.
 *         alpha               - PETSc scalar used for computation, alpha = dt/6 for RK4.
-*         ln                  - Number of indices to update.
-*         linner_ids          - Vector of length ln containing the indices to update.
+*         rows                - Inner points to update.
 **/
-PetscErrorCode rk4_util(Vec v, const Vec k1, const Vec k2, const Vec k3, const Vec k4, const PetscScalar alpha, const PetscInt ln, const PetscInt *linner_ids);
+PetscErrorCode rk4_update(Vec v, const Vec s, const Vec k4, const PetscScalar alpha, const InnerRows& rows);
 
 
 /////////// IMPLEMENTATIONS ///////////
@@ -97,9 +125,10 @@ PetscErrorCode RK4_petsc(const DM da, const PetscScalar Tend, const PetscScalar
 
 PetscErrorCode RK4_custom(const DM da, const PetscScalar Tend, PetscScalar dt, Vec v, PetscErrorCode (*rhs)(DM, PetscReal, Vec, Vec, void *), void* ctx) 
 {
-  Vec k1, k2, k3, k4, tmp;
+  Vec k1, k2, k3, tmp;
   PetscScalar t = 0.0, dtDIV2, dtDIV6;
-  PetscInt tidx, ln_tot, *linner_ids, tlen;
+  PetscInt tidx, tlen;
+  InnerRows rows;
 
  	tlen = round(Tend/dt);
   if (abs(tlen*dt - Tend) > 1e-14)
@@ -112,167 +141,156 @@ PetscErrorCode RK4_custom(const DM da, const PetscScalar Tend, PetscScalar dt, V
   dtDIV2 = 0.5*dt;
   dtDIV6 = dt/6;
 
-  // Find which local indices to update (non-ghost points)
-  get_local_inner_ids(da, &ln_tot, &linner_ids);
+  // Find which local array entries to update (non-ghost points)
+  get_local_inner_rows(da, rows);
 
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    Apply RK4
+    Apply RK4. k1 holds the partial sum k1 + 2*k2 + 2*k3 after the third
+    stage, and k4 is stored in k2.
   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
   DMGetLocalVector(da, &k1);
   DMGetLocalVector(da, &k2);
   DMGetLocalVector(da, &k3);
-  DMGetLocalVector(da, &k4);
   DMGetLocalVector(da, &tmp);
 
+  logging::push_time_stepping_stage();
   for (tidx = 0; tidx < tlen; tidx++) {
     rhs(da, t, v, k1, ctx); // k1 = D*v
-    apply_WAXPY(tmp, dtDIV2, k1, v, ln_tot, linner_ids); // tmp = v + 0.5*dt*k1
+    rk4_stage(tmp, v, dtDIV2, k1, rows); // tmp = v + 0.5*dt*k1
 
     rhs(da, t + dtDIV2, tmp, k2, ctx); // k2 = D*(v + 0.5*dt*k1)
-    apply_WAXPY(tmp, dtDIV2, k2, v, ln_tot, linner_ids); // tmp = v + 0.5*dt*k2
+    rk4_stage(tmp, v, dtDIV2, k2, rows); // tmp = v + 0.5*dt*k2
 
     rhs(da, t + dtDIV2, tmp, k3, ctx); // k3 = D*(v + 0.5*dt*k2)
-    apply_WAXPY(tmp, dt, k3, v, ln_tot, linner_ids); // tmp = v + dt*k3
+    rk4_stage_sum(tmp, v, dt, k1, k2, k3, rows); // tmp = v + dt*k3, k1 = k1 + 2*(k2 + k3)
 
-    rhs(da, t + dt, tmp, k4, ctx); // k4 = D*(v + dt*k3)
+    rhs(da, t + dt, tmp, k2, ctx); // k4 = D*(v + dt*k3)
 
-    rk4_util(v, k1, k2, k3,k4, dtDIV6, ln_tot, linner_ids); // v = v + dt/6*(k1 + 2*k2 + 2*k3 + k4)
+    rk4_update(v, k1, k2, dtDIV6, rows); // v = v + dt/6*(k1 + 2*k2 + 2*k3 + k4)
 
     t = t + dt;
   }
+  logging::pop_stage();
   PetscPrintf(PETSC_COMM_WORLD,"Final t: %.8e\n",t);
 
   DMRestoreLocalVector(da, &k1);
   DMRestoreLocalVector(da, &k2);
   DMRestoreLocalVector(da, &k3);
-  DMRestoreLocalVector(da, &k4);
   DMRestoreLocalVector(da, &tmp);
 
   return 0;
 }
 
-PetscErrorCode get_local_inner_ids(const DM da, PetscInt *ln_tot, PetscInt **linner_ids)
+PetscErrorCode get_local_inner_rows(const DM da, InnerRows& rows)
 {
-  PetscInt i_xstart, i_ystart, i_zstart, nx, ny, nz, lnx, lny;
-  PetscInt dim, Nx, Ny, Nz, dof, sw;
+  PetscInt i_xstart, i_ystart, i_zstart, nx, ny, nz;
+  PetscInt g_xstart, g_ystart, g_zstart, lnx, lny, lnz;
+  PetscInt dof;
   DMDAGetCorners(da,&i_xstart,&i_ystart,&i_zstart,&nx,&ny,&nz);
-  DMDAGetGhostCorners(da,NULL,NULL,NULL,&lnx,&lny,NULL);
-  DMDAGetInfo(da,&dim,&Nx,&Ny,&Nz,NULL,NULL,NULL,&dof,&sw,NULL,NULL,NULL,NULL);
-
-  PetscInt li_start[3] = {0,0,0}, li_end[3] = {1,1,1};
+  DMDAGetGhostCorners(da,&g_xstart,&g_ystart,&g_zstart,&lnx,&lny,&lnz);
+  DMDAGetInfo(da,NULL,NULL,NULL,NULL,NULL,NULL,NULL,&dof,NULL,NULL,NULL,NULL,NULL);
+
+  // Unused dimensions have a single point and no ghost points, so that the
+  // 1D and 2D cases reduce to a single row and a single plane respectively.
+  const PetscInt lx = i_xstart - g_xstart, ly = i_ystart - g_ystart, lz = i_zstart - g_zstart;
+  rows.offset = dof*(lx + lnx*(ly + lny*lz));
+  rows.len = dof*nx;
+  rows.n = {ny, nz};
+  rows.stride = {dof*lnx, dof*lnx*lny};
+  return 0;
+}
 
-  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    Find starting and stopping indices in each dimension
-  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
-  const PetscInt i_xend = i_xstart + nx;
-  if (dim > 0) 
-  {
-    if (i_xstart == 0) {                 // Left x
-      li_start[0] = 0;
-      li_end[0] = nx*dof;
-    } else if (i_xend == Nx) {  // Right x
-      li_start[0] = sw*dof;
-      li_end[0] = (sw + nx)*dof;
-    } else {                                      // Center x
-      li_start[0] = sw*dof;
-      li_end[0] = (sw + nx)*dof;
+template <typename Kernel>
+void for_each_inner_row(const InnerRows& rows, Kernel&& kernel)
+{
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (PetscInt k = 0; k < rows.n[1]; k++) {
+    for (PetscInt j = 0; j < rows.n[0]; j++) {
+      const PetscInt start = rows.offset + rows.stride[0]*j + rows.stride[1]*k;
+      kernel(start, start + rows.len);
     }
   }
-  const PetscInt i_yend = i_ystart + ny;
-  if (dim > 1)
-  {
-    if (i_ystart == 0) {                 // Left y
-      li_start[1] = 0;
-      li_end[1] = ny*dof;
-    } else if (i_yend == Ny) {  // Right y
-      li_start[1] = sw*dof;
-      li_end[1] = (sw + ny)*dof;
-    } else {                                      // Center y
-      li_start[1] = sw*dof;
-      li_end[1] = (sw + ny)*dof;
-    }      
-  }
-  const PetscInt i_zend = i_zstart + nz;
-  if (dim > 2) // NOT BUG TESTED!
-  {
-    if (i_zstart == 0) {                 // Left z
-      li_start[2] = 0;
-      li_end[2] = nz*dof;
-    } else if (i_zend == Nz) {  // Right z
-      li_start[2] = sw*dof;
-      li_end[2] = (sw + nz)*dof;
-    } else {                                      // Center z
-      li_start[2] = sw*dof;
-      li_end[2] = (sw + nz)*dof;
-    }  
-  }
+}
 
-  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    Loop through inner points and save array indices.
-  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
-  *ln_tot = nx*ny*nz*dof;
-  *linner_ids = (PetscInt *) malloc(*ln_tot*sizeof(PetscInt));
-  PetscInt count = 0;
-  PetscInt idx;
-  for (PetscInt l = 0; l < dof; l++) {
-    for (PetscInt k = li_start[2]; k < li_end[2]; k+=dof) {
-      for (PetscInt j = li_start[1]; j < li_end[1]; j+=dof) {
-        for (PetscInt i = li_start[0]; i < li_end[0]; i+=dof) {
-          idx = l + i + lnx*(j + lny*k);
-          (*linner_ids)[count] = idx;
-          count++;
-        }  
-      }
-    }  
-  }
+PetscErrorCode rk4_stage(Vec w, const Vec v, const PetscScalar alpha, const Vec k, const InnerRows& rows)
+{
+  PetscErrorCode     ierr;
+  PetscScalar        *w_arr;
+  const PetscScalar  *v_arr, *k_arr;
+
+  ierr = logging::begin(logging::TS_UPDATE);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(v,&v_arr);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(k,&k_arr);CHKERRQ(ierr);
+  ierr = VecGetArray(w,&w_arr);CHKERRQ(ierr);
+
+  for_each_inner_row(rows, [&](const PetscInt start, const PetscInt end) {
+    for (PetscInt i = start; i < end; i++) {
+      w_arr[i] = v_arr[i] + alpha*k_arr[i];
+    }
+  });
+
+  ierr = VecRestoreArrayRead(v,&v_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(k,&k_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArray(w,&w_arr);CHKERRQ(ierr);
 
+  ierr = logging::flops(2*rows.len*rows.n[0]*rows.n[1]);CHKERRQ(ierr);
+  ierr = logging::end(logging::TS_UPDATE);CHKERRQ(ierr);
   return 0;
 }
 
-PetscErrorCode apply_WAXPY(Vec v, const PetscScalar alpha, const Vec x, const Vec y, const PetscInt ln, const PetscInt *linner_ids) 
+PetscErrorCode rk4_stage_sum(Vec w, const Vec v, const PetscScalar alpha, Vec k1, const Vec k2, const Vec k3, const InnerRows& rows)
 {
   PetscErrorCode     ierr;
-  PetscInt           i;
-  PetscScalar        *v_arr;
-  const PetscScalar  *x_arr, *y_arr;
+  PetscScalar        *w_arr, *k1_arr;
+  const PetscScalar  *v_arr, *k2_arr, *k3_arr;
 
-  ierr = VecGetArrayRead(x,&x_arr);CHKERRQ(ierr);
-  ierr = VecGetArrayRead(y,&y_arr);CHKERRQ(ierr);
-  ierr = VecGetArray(v,&v_arr);CHKERRQ(ierr);
+  ierr = logging::begin(logging::TS_UPDATE);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(v,&v_arr);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(k2,&k2_arr);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(k3,&k3_arr);CHKERRQ(ierr);
+  ierr = VecGetArray(k1,&k1_arr);CHKERRQ(ierr);
+  ierr = VecGetArray(w,&w_arr);CHKERRQ(ierr);
 
-  for (i = 0; i < ln; i++) {
-    v_arr[linner_ids[i]] = y_arr[linner_ids[i]] + alpha*x_arr[linner_ids[i]];
-  }
+  for_each_inner_row(rows, [&](const PetscInt start, const PetscInt end) {
+    for (PetscInt i = start; i < end; i++) {
+      w_arr[i] = v_arr[i] + alpha*k3_arr[i];
+      k1_arr[i] = k1_arr[i] + 2*(k2_arr[i] + k3_arr[i]);
+    }
+  });
 
-  ierr = VecRestoreArrayRead(x,&x_arr);CHKERRQ(ierr);
-  ierr = VecRestoreArrayRead(y,&y_arr);CHKERRQ(ierr);
-  ierr = VecRestoreArray(v,&v_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(v,&v_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(k2,&k2_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(k3,&k3_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArray(k1,&k1_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArray(w,&w_arr);CHKERRQ(ierr);
 
+  ierr = logging::flops(5*rows.len*rows.n[0]*rows.n[1]);CHKERRQ(ierr);
+  ierr = logging::end(logging::TS_UPDATE);CHKERRQ(ierr);
   return 0;
 }
 
-PetscErrorCode rk4_util(Vec v, const Vec k1, const Vec k2, const Vec k3, const Vec k4, const PetscScalar alpha, const PetscInt ln, const PetscInt *linner_ids) 
+PetscErrorCode rk4_update(Vec v, const Vec s, const Vec k4, const PetscScalar alpha, const InnerRows& rows)
 {
   PetscErrorCode     ierr;
-  PetscInt           i;
   PetscScalar        *v_arr;
-  const PetscScalar  *k1_arr,*k2_arr,*k3_arr,*k4_arr;
+  const PetscScalar  *s_arr, *k4_arr;
 
-  ierr = VecGetArrayRead(k1,&k1_arr);CHKERRQ(ierr);
-  ierr = VecGetArrayRead(k2,&k2_arr);CHKERRQ(ierr);
-  ierr = VecGetArrayRead(k3,&k3_arr);CHKERRQ(ierr);
+  ierr = logging::begin(logging::TS_UPDATE);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(s,&s_arr);CHKERRQ(ierr);
   ierr = VecGetArrayRead(k4,&k4_arr);CHKERRQ(ierr);
   ierr = VecGetArray(v,&v_arr);CHKERRQ(ierr);
 
-  for (i = 0; i < ln; i++) {
-    v_arr[linner_ids[i]] += alpha*(k1_arr[linner_ids[i]] + 2*(k2_arr[linner_ids[i]] + k3_arr[linner_ids[i]]) + k4_arr[linner_ids[i]]);
-  }
+  for_each_inner_row(rows, [&](const PetscInt start, const PetscInt end) {
+    for (PetscInt i = start; i < end; i++) {
+      v_arr[i] += alpha*(s_arr[i] + k4_arr[i]);
+    }
+  });
 
-  ierr = VecRestoreArrayRead(k1,&k1_arr);CHKERRQ(ierr);
-  ierr = VecRestoreArrayRead(k2,&k2_arr);CHKERRQ(ierr);
-  ierr = VecRestoreArrayRead(k3,&k3_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(s,&s_arr);CHKERRQ(ierr);
   ierr = VecRestoreArrayRead(k4,&k4_arr);CHKERRQ(ierr);
   ierr = VecRestoreArray(v,&v_arr);CHKERRQ(ierr);
 
+  ierr = logging::flops(3*rows.len*rows.n[0]*rows.n[1]);CHKERRQ(ierr);
+  ierr = logging::end(logging::TS_UPDATE);CHKERRQ(ierr);
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <petscts.h>
+#include <petscdmda.h>
+#include "time_stepping/rhs_shell.h"
+
+/**
+* Low-storage explicit Runge-Kutta schemes on Williamson 2N form. Each stage s computes
+*   dq = A[s]*dq + dt*F(t + C[s]*dt, v)
+*   v  = v + B[s]*dq
+* so that only the accumulator dq and the RHS output F are needed in addition to the solution v,
+* independently of the number of stages. Since the RHS functions overwrite (rather than accumulate into)
+* their output, F is held in a separate work vector, giving two work vectors in total.
+*
+* LSRK_WILLIAMSON3  - Williamson (1980), 3rd order, 3 stages.
+* LSRK_CK45         - Carpenter and Kennedy (1994), 4th order, 5 stages.
+**/
+enum LSRKType {LSRK_WILLIAMSON3, LSRK_CK45};
+
+/**
+* Time steps system of ODEs with a low-storage Runge-Kutta scheme using a fixed time step.
+* The time step is adjusted such that t_end is an integer multiple of dt.
+* Inputs: da        - DMDA context
+*         t_end     - Final time
+*         dt        - Time step
+*         v         - Working vector. Should contain initial data.
+*         type      - Low-storage scheme
+*         rhs       - RHS function. Inputs: (DM da, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+*         ctx       - User defined context
+*         t_start   - Initial time, e.g of a restart. Must be step_start time steps from 0.
+*         step_start- Number of time steps taken before t_start
+*         soa       - If true, v is a local vector in component-major ordering (PartitionedLayout2DSoA).
+* The work vectors are first touched by the threads, see ts_first_touch_work_vectors in ts_rk.h.
+**/
+PetscErrorCode ts_lsrk(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, const LSRKType type, PetscErrorCode (*rhs)(DM, PetscReal, Vec, Vec, void *), void* ctx,
+                       const PetscReal t_start = 0, const PetscInt step_start = 0, const PetscBool soa = PETSC_FALSE);
+
+/**
+* Same as above for RHS functions with the signature required by PETSc TS, in which case the RHS is
+* called with a NULL TS context.
+**/
+PetscErrorCode ts_lsrk(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, const LSRKType type, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                       const PetscReal t_start = 0, const PetscInt step_start = 0, const PetscBool soa = PETSC_FALSE);
+
+/**
+* Time steps system of ODEs with the scheme selected by the runtime option
+*   -lsrk williamson3 | ck45    Low-storage Runge-Kutta scheme, see ts_lsrk.
+*   -use_matshell               Wrap rhs in a MatShell and time step with PETSc TS on global vectors, see ts_matshell
+*                               in rhs_shell.h. The integrator is selected with -ts_type (default cn).
+*   -matshell_affine 0|1        Subtract the forcing F(t,0) in the MatShell (default affine), see rhs_shell_create.
+*                               With -operator aij|baij, F(t,0) costs a full RHS evaluation per new stage time.
+*   -matshell_bench reps        Time the MatShell apply (and the assembled SpMV) against rhs before time stepping.
+*   -operator matfree|aij|baij  Time step with rhs (default), or with the operator assembled into an AIJ or BAIJ matrix
+*                               from rhs, see rhs_shell_assemble. Requires coupling.
+*   -operator_spectral_radius n Print an estimate of the spectral radius of the operator from n power iterations.
+* If none of -lsrk and -use_matshell is set, the standard RK4 using PETSc TS (ts_rk4) is used.
+* Inputs: da        - DMDA context
+*         t_end     - Final time
+*         dt        - Time step
+*         v         - Working vector. Should contain initial data.
+*         rhs       - RHS function. Inputs (required by petsc): (TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx)
+*         ctx       - User defined context
+*         t_start   - Initial time, e.g of a restart
+*         step_start- Number of time steps taken before t_start
+*         soa       - If true, v is a local vector in component-major ordering (PartitionedLayout2DSoA).
+*         coupling  - Coupling width of the spatial discretization, e.g coupling_width(D1) (rhs_shell.h)
+*         affine    - If true, rhs has forcing or boundary data, F(t,v) = A*v + g(t), and the MatShell subtracts
+*                     g(t) = F(t,0). Should be false for an RHS without forcing, where F(t,0) = 0.
+**/
+PetscErrorCode ts_rk_from_options(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                                  const PetscReal t_start = 0, const PetscInt step_start = 0, const PetscBool soa = PETSC_FALSE,
+                                  const PetscInt coupling = 0, PetscBool affine = PETSC_TRUE);
+
+/**
+* Returns the number of RHS evaluations per time step of the scheme selected by ts_rk_from_options.
+**/
+PetscInt ts_stages_from_options();
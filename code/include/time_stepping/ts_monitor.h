@@ -0,0 +1,34 @@
+#pragma once
+
+#include <petscts.h>
+
+/**
+* Monitor called after each time step of the time stepping routines (ts_rk4, ts_rk45, ts_lsrk and ts_rk_from_options),
+* and once with step = 0 before the first step.
+* Inputs: step      - Number of completed time steps
+*         t         - Time of the solution
+*         v         - Solution. The working vector of the time stepper, i.e a local vector for the demos. Must not be
+*                     modified.
+*         ctx       - User defined context
+**/
+typedef PetscErrorCode (*TSStepMonitor)(PetscInt step, PetscReal t, Vec v, void* ctx);
+
+/**
+* Adds a step monitor, called after the monitors added before it.
+**/
+PetscErrorCode ts_monitor_add(TSStepMonitor monitor, void* ctx);
+
+/**
+* Removes the step monitor added with the same function and context.
+**/
+PetscErrorCode ts_monitor_remove(TSStepMonitor monitor, void* ctx);
+
+/**
+* Calls the step monitors.
+**/
+PetscErrorCode ts_monitor_call(const PetscInt step, const PetscReal t, Vec v);
+
+/**
+* Calls the step monitors from a PETSc TS, see TSMonitorSet.
+**/
+PetscErrorCode ts_monitor_petsc(TS ts, PetscInt step, PetscReal t, Vec v, void* ctx);
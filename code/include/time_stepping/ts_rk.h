@@ -11,8 +11,11 @@
 *         v         - Working vector. Should contain initial data.
 *         rhs       - RHS function. Inputs (required by petsc): (TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx) 
 *         ctx       - User defined context
+*         t_start   - Initial time, e.g of a restart
+*         step_start- Number of time steps taken before t_start
 **/
-PetscErrorCode ts_rk45(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx);
+PetscErrorCode ts_rk45(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                      const PetscReal t_start = 0, const PetscInt step_start = 0);
 
 /**
 * Time steps system of ODEs with standard non-adaptive RK4 using the built-in PETSc routines TS.
@@ -22,5 +25,31 @@ PetscErrorCode ts_rk45(const DM da, const PetscScalar t_end, const PetscScalar d
 *         v         - Working vector. Should contain initial data.
 *         rhs       - RHS function. Inputs (required by petsc): (TS ts, PetscReal t, Vec v_src, Vec v_dst, void *ctx) 
 *         ctx       - User defined context
+*         t_start   - Initial time, e.g of a restart
+*         step_start- Number of time steps taken before t_start
+*         soa       - If true, v is a local vector in component-major ordering (PartitionedLayout2DSoA).
+* The stage vectors of TSRK are first touched by the threads, see ts_first_touch_work_vectors. The stage RHS
+* evaluations of TSRK are not accessible, and stay on the NUMA node of the master thread.
 **/
-PetscErrorCode ts_rk4(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx);
\ No newline at end of file
+PetscErrorCode ts_rk4(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                      const PetscReal t_start = 0, const PetscInt step_start = 0, const PetscBool soa = PETSC_FALSE);
+
+/**
+* Prints the number of work vectors of a time stepping scheme, i.e the vectors of the size of v it allocates in
+* addition to the solution v, and the memory they take on the largest rank.
+* Inputs: scheme    - Name of the scheme
+*         n_stages  - Number of stages (RHS evaluations per time step)
+*         n_work    - Number of work vectors
+*         v         - Solution vector
+**/
+PetscErrorCode ts_report_work_vectors(const char *scheme, const PetscInt n_stages, const PetscInt n_work, const Vec v);
+
+/**
+* Replaces the arrays of the work vectors w of the time stepping, of the size of a local vector of da, by arrays which
+* are first touched by the threads as the local vector (see threads::first_touch). Has no effect on a single thread.
+* Inputs: da        - DMDA context
+*         soa       - If true, the vectors are in component-major ordering (PartitionedLayout2DSoA).
+*         n         - Number of work vectors
+*         w         - Work vectors
+**/
+PetscErrorCode ts_first_touch_work_vectors(const DM da, const PetscBool soa, const PetscInt n, Vec *w);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <petscdmda.h>
+#include <string>
+
+/**
+* Checkpoint/restart of the time stepping. A checkpoint holds the solution, the time and the time step, and is written
+* every N time steps and/or every S seconds of wall-clock time. The solution is written in parallel with
+* mpiio::write (see util/mpiio.h), alternating between the two files slot0.sbp and slot1.sbp. Once all ranks have
+* completely written and flushed their blocks of a slot, rank 0 atomically replaces the file checkpoint.info, which
+* names the slot, the time step and the time of the last good checkpoint. A crash or a failed write of a checkpoint
+* thus leaves the previous one intact.
+**/
+namespace checkpoint
+{
+  struct CheckpointCtx {
+    DM da;
+    PetscBool soa;                                // Local vectors in component-major ordering (PartitionedLayout2DSoA)
+    std::string folder;
+    PetscInt interval = 0;                        // Time steps between checkpoints, 0 if not used
+    PetscReal walltime = 0;                       // Seconds of wall-clock time between checkpoints, 0 if not used
+    Vec global = NULL, local_aos = NULL;
+    PetscInt slot = 0;                            // Slot of the next checkpoint
+    PetscInt last_step = -1;                      // Time step of the last checkpoint or of the restart
+    PetscLogDouble last_time = 0;                 // Wall-clock time of the last checkpoint on rank 0
+    int walltime_due = 0;                         // Wall-clock decision of rank 0, broadcast with one step delay
+    MPI_Request request = MPI_REQUEST_NULL;
+    // Start of the time stepping, nonzero after a restart
+    PetscReal t_start = 0;
+    PetscInt step_start = 0;
+    // Statistics
+    PetscInt count = 0;
+    PetscLogDouble write_time = 0;
+  };
+
+  /**
+  * Sets up checkpointing from the runtime options
+  *   -checkpoint_interval N        Write a checkpoint every N time steps (default 0, off).
+  *   -checkpoint_walltime S        Write a checkpoint every S seconds of wall-clock time (default 0, off). Rank 0 decides
+  *                                 and broadcasts its decision with a nonblocking broadcast, so that the ranks do not
+  *                                 synchronize every step. The checkpoint is written one step after the time is up.
+  *   -restart                      Continue from the last good checkpoint in folder/checkpoints.
+  * and adds checkpoint::monitor as a step monitor of the time stepping (see time_stepping/ts_monitor.h). After a
+  * restart, ctx.t_start and ctx.step_start hold the time and time step to continue the time stepping from.
+  * Inputs: da      - DMDA object
+  *         soa     - If true, the local vectors of the time stepping are in component-major ordering.
+  *         folder  - Output folder. The checkpoints are written to folder/checkpoints.
+  *         v       - Local vector of the time stepping. Overwritten with the checkpointed solution on restart.
+  *
+  * Output: ctx     - Checkpoint context. Must not be moved while in use.
+  **/
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, Vec v, CheckpointCtx& ctx);
+
+  /**
+  * Step monitor writing a checkpoint when due. v is the local vector of the time stepping.
+  **/
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ctx);
+
+  /**
+  * Prints the checkpoint statistics and frees the context.
+  **/
+  PetscErrorCode destroy(CheckpointCtx& ctx);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <petscdmda.h>
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+* Monitor of the discrete SBP energy ||v||_H = sqrt(v'*H*v) of the solution, summed over all components, where H is
+* the SBP norm including the boundary closure weights. The energy of an energy stable discretization is bounded, so
+* growth flags an instability.
+*
+* Each sample sums the weighted squares over the owned points and posts a nonblocking MPI_Iallreduce, which completes
+* while the next time steps are taken. The result is collected at the next sample (or by destroy), so the monitor adds
+* no synchronization point to the time stepping. Rank 0 appends "step t energy" to <folder>/energy.tsv.
+**/
+namespace energy
+{
+  struct EnergyCtx {
+    DM da;
+    PetscBool soa;                                // Local vectors in component-major ordering (PartitionedLayout2DSoA)
+    PetscInt interval = 0;                        // Time steps between samples, 0 if disabled
+    PetscReal max_growth = 10;                    // Flag if the energy grows by more than this factor
+    PetscBool abort = PETSC_FALSE;                // Stop the run if flagged
+    std::string folder;
+    PetscInt dof, gnp;
+    std::array<PetscInt,3> start, n, gstart, gn;
+    std::array<std::vector<PetscReal>,3> weights; // Quadrature weights h*H[i][i] of the owned points per direction
+    // Sample in flight
+    PetscReal local = 0, global = 0;
+    MPI_Request request = MPI_REQUEST_NULL;
+    PetscInt step;
+    PetscReal t;
+    // History
+    PetscReal initial = -1, last = 0;
+    PetscBool flagged = PETSC_FALSE;
+    FILE *fp = NULL;
+    PetscInt count = 0;
+    PetscLogDouble wait_time = 0;
+  };
+
+  /**
+  * Sets up the energy monitor from the runtime options
+  *   -energy_interval N            Compute the energy every N time steps (default 0, off).
+  *   -energy_max_growth g          Flag an instability if the energy exceeds g times the initial energy, or is not
+  *                                 finite (default 10).
+  *   -energy_abort                 Stop the time stepping with an error when flagged, instead of a warning.
+  * and adds energy::monitor as a step monitor of the time stepping (see time_stepping/ts_monitor.h).
+  * Inputs: da      - DMDA object
+  *         soa     - If true, the local vectors of the time stepping are in component-major ordering.
+  *         folder  - Output folder of energy.tsv.
+  *         H       - SBP norm operator, e.g Ops::NormOp
+  *         h       - Grid spacings, unused dimensions are ignored.
+  *
+  * Output: ctx     - Energy monitor context. Must not be moved while in use.
+  **/
+  template <class NormOp>
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, const NormOp& H,
+                        const std::array<PetscReal,3> h, EnergyCtx& ctx);
+
+  /**
+  * Sets up the energy monitor with the quadrature weights of the owned points in each direction, see create above.
+  **/
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder,
+                        const std::array<std::vector<PetscReal>,3>& weights, EnergyCtx& ctx);
+
+  /**
+  * Step monitor computing the energy every interval steps. v is the local vector of the time stepping.
+  **/
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ctx);
+
+  /**
+  * Collects the last sample, prints the energy statistics and frees the context.
+  **/
+  PetscErrorCode destroy(EnergyCtx& ctx);
+
+  //=============================================================================
+  // Implementations
+  //=============================================================================
+  template <class NormOp>
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, const NormOp& H,
+                        const std::array<PetscReal,3> h, EnergyCtx& ctx)
+  {
+    PetscErrorCode ierr;
+    PetscInt       dim;
+    std::array<PetscInt,3> N, start, n;
+    std::array<std::vector<PetscReal>,3> weights;
+
+    ierr = DMDAGetInfo(da,&dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL);CHKERRQ(ierr);
+    ierr = DMDAGetCorners(da,&start[0],&start[1],&start[2],&n[0],&n[1],&n[2]);CHKERRQ(ierr);
+    for (PetscInt d = 0; d < 3; d++) {
+      for (PetscInt i = start[d]; i < start[d] + n[d]; i++) {
+        weights[d].push_back(d < dim ? h[d]*H.weight(N[d],i) : 1);
+      }
+    }
+    return create(da,soa,folder,weights,ctx);
+  }
+}
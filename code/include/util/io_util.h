@@ -2,15 +2,27 @@
 
 #include<petsc.h>
 #include<string>
+#include "util/mpiio.h"
 
 PetscErrorCode write_vector_to_binary(const Vec, const std::string, const std::string);
 
+/**
+* Writes the DMDA global vector v to folder/file in the format selected by the option -output_format petsc|mpiio
+* (default petsc). petsc writes a PETSc binary file with write_vector_to_binary, mpiio writes file.sbp with
+* mpiio::write (see util/mpiio.h), storing meta in the header.
+**/
+PetscErrorCode write_vector(const Vec v, const std::string folder, const std::string file, const mpiio::Metadata& meta);
+
 PetscErrorCode write_data_to_file(const std::string data_string, const std::string folder, const std::string file);
 
 void print_usage_1d(char* exec_name);
 
-int get_inputs(int argc, char *argv[], PetscInt& N, PetscScalar& Tend, PetscScalar& CFL, PetscBool& use_custom_sc);
+int get_inputs(int argc, char *argv[], PetscInt& N, PetscScalar& Tend, PetscScalar& CFL, PetscInt& use_custom_sc);
 
 void print_usage_2d(char* exec_name);
 
-int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscScalar& Tend, PetscScalar& CFL, PetscBool& use_custom_sc);
\ No newline at end of file
+int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscScalar& Tend, PetscScalar& CFL, PetscInt& use_custom_sc);
+
+void print_usage_3d(char* exec_name);
+
+int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscInt& Nz, PetscScalar& Tend, PetscScalar& CFL, PetscInt& use_custom_sc);
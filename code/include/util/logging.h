@@ -0,0 +1,98 @@
+#pragma once
+
+#include <petscsys.h>
+#include <petsclog.h>
+
+/**
+* PETSc log events of the solver phases. Run with -log_view to get the time, flop rate and message counts of each
+* phase. The events are registered on first use. Build with -DSBP_NO_LOGGING to compile them out, in which case
+* all functions below are empty.
+**/
+namespace logging
+{
+  enum Event {
+    RHS,            // Full RHS evaluation, including the halo exchange. Carries the flops of the RHS kernels.
+    RHS_LOCAL,      // RHS on points not depending on ghost points, overlapped with the halo exchange
+    RHS_OVERLAP,    // RHS on points depending on ghost points, after the halo exchange
+    RHS_BC,         // Boundary conditions
+    HALO_BEGIN,     // Start of the halo exchange (packing and posting of messages)
+    HALO_END,       // End of the halo exchange, i.e the communication wait time
+    SCATTER_SETUP,  // Construction of the ghost point scatter contexts
+    TS_UPDATE,      // Vector updates of the time stepping stages
+    IO_WRITE,       // Writing of solution vectors and data files
+    N_EVENTS
+  };
+
+  /**
+  * Registers the log class and events. Called on first use of begin().
+  **/
+  PetscErrorCode register_events();
+
+  /**
+  * Returns the PETSc event of e, registering the events if needed.
+  **/
+  PetscLogEvent get_event(const Event e);
+
+  /**
+  * Returns the log stage covering the time stepping loop, registering it if needed.
+  **/
+  PetscLogStage get_time_stepping_stage();
+
+  inline PetscErrorCode begin(const Event e)
+  {
+#ifndef SBP_NO_LOGGING
+    return PetscLogEventBegin(get_event(e),0,0,0,0);
+#else
+    return 0;
+#endif
+  }
+
+  inline PetscErrorCode end(const Event e)
+  {
+#ifndef SBP_NO_LOGGING
+    return PetscLogEventEnd(get_event(e),0,0,0,0);
+#else
+    return 0;
+#endif
+  }
+
+  /**
+  * Adds n floating point operations to the active events.
+  **/
+  inline PetscErrorCode flops(const PetscLogDouble n)
+  {
+#ifndef SBP_NO_LOGGING
+    return PetscLogFlops(n);
+#else
+    return 0;
+#endif
+  }
+
+  inline PetscErrorCode push_time_stepping_stage()
+  {
+#ifndef SBP_NO_LOGGING
+    return PetscLogStagePush(get_time_stepping_stage());
+#else
+    return 0;
+#endif
+  }
+
+  inline PetscErrorCode pop_stage()
+  {
+#ifndef SBP_NO_LOGGING
+    return PetscLogStagePop();
+#else
+    return 0;
+#endif
+  }
+
+  /**
+  * Nominal number of flops of a first derivative at an interior point: a multiply-add per stencil weight and the
+  * scaling by the inverse grid spacing. Used to count the flops of the RHS kernels.
+  **/
+  template <class SbpDerivative>
+  constexpr PetscLogDouble derivative_flops(const SbpDerivative& D1)
+  {
+    return 2*D1.interior_stencil_width() + 1;
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <petscdmda.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+* Native file format for DMDA global vectors, written in parallel with collective MPI-IO. Each rank writes its block
+* of the grid through a subarray file view, so the data is never gathered to a single rank.
+*
+* A file consists of a Header, followed by header.dof component names of NAME_LENGTH characters, and the data
+* starting at header.data_offset (aligned to DATA_ALIGNMENT bytes). The data is the global grid function in the
+* natural ordering of the DMDA, i.e with the components interleaved and x fastest, as double in native byte order.
+**/
+namespace mpiio
+{
+  constexpr int64_t NAME_LENGTH = 32;
+  constexpr int64_t DATA_ALIGNMENT = 4096;
+
+  struct Header {
+    char    magic[8];           // "SBPMPIO"
+    int64_t version;            // Format version, currently 1
+    int64_t data_offset;        // Offset of the data in bytes
+    int64_t scalar_size;        // Size of a value in bytes
+    int64_t dim;                // Dimension of the grid
+    int64_t N[3];               // Global grid size, 1 in unused dimensions
+    int64_t dof;                // Number of components
+    int64_t order;              // Order of the SBP operators, 0 if unknown
+    double  t;                  // Time of the solution
+  };
+
+  /**
+  * Metadata stored in the header along with the grid layout, which is taken from the DMDA.
+  **/
+  struct Metadata {
+    PetscReal t = 0;
+    PetscInt order = 0;
+  };
+
+  /**
+  * Writes the global vector v of the DMDA da to folder/file, collectively over the communicator of da. The component
+  * names are the field names of da (see DMDASetFieldName), or c0, c1, ... if not set. If sync is true, the data is
+  * flushed to the storage device (MPI_File_sync) before returning. Every MPI-IO call is checked and the result is
+  * reduced over the communicator, so an error is returned on all ranks if any rank failed to write its block.
+  **/
+  PetscErrorCode write(const DM da, const Vec v, const std::string folder, const std::string file, const Metadata& meta,
+                       const PetscBool sync = PETSC_FALSE);
+
+  /**
+  * Reads folder/file, written by write, into the global vector v of the DMDA da, collectively over the communicator
+  * of da. The grid size and number of components of the file must match da, and the file must hold the whole grid
+  * function. As in write, every MPI-IO call and the number of values read are checked and the result is reduced over
+  * the communicator, so an error is returned on all ranks if the file is truncated or any rank failed to read its
+  * block.
+  **/
+  PetscErrorCode read(const DM da, Vec v, const std::string folder, const std::string file, Metadata& meta);
+
+  /**
+  * A file mapped into memory, e.g for post-processing on a single process. The data is read on demand by the OS.
+  **/
+  struct MappedFile {
+    const Header* header = nullptr;
+    const char* names = nullptr;
+    const PetscScalar* data = nullptr;
+    void* addr = nullptr;
+    size_t size = 0;
+  };
+
+  /**
+  * Maps the file path read-only into memory and checks its header. Does not call MPI.
+  **/
+  PetscErrorCode map(const std::string path, MappedFile& f);
+
+  /**
+  * Unmaps the file.
+  **/
+  PetscErrorCode unmap(MappedFile& f);
+
+  /**
+  * Value of component c at the global grid index (i,j,k) of a mapped file.
+  **/
+  inline PetscScalar value(const MappedFile& f, const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt c)
+  {
+    const Header& h = *f.header;
+    return f.data[((k*h.N[1] + j)*h.N[0] + i)*h.dof + c];
+  }
+
+  /**
+  * Name of component c of a mapped file.
+  **/
+  inline std::string component_name(const MappedFile& f, const PetscInt c)
+  {
+    const char* name = f.names + c*NAME_LENGTH;
+    return std::string(name,strnlen(name,NAME_LENGTH));
+  }
+}
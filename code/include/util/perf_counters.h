@@ -0,0 +1,65 @@
+#pragma once
+
+#include <petscsys.h>
+
+/**
+* Hardware performance counters (Linux perf_event) around the region kernels dispatched by rhs_local, rhs_overlap,
+* rhs_all and rhs_serial (see partitioned_rhs/rhs.h), to tell whether the kernels are bandwidth or compute bound. The counters are opened
+* by each thread of the rank and summed over the threads. At the end of the run view() prints a roofline-style summary
+* per rank: cycles, instructions, last level cache misses, the memory traffic estimated from the misses, flops and
+* the arithmetic intensity. When the counters can not be opened (no perf_event support, e.g in containers, or a
+* restrictive /proc/sys/kernel/perf_event_paranoid) a warning is printed and nothing is counted.
+**/
+namespace perf_counters
+{
+  enum SectionType {RHS_LOCAL, RHS_OVERLAP, RHS_ALL, RHS_SERIAL, N_SECTIONS};
+
+  namespace detail
+  {
+    extern bool enabled;
+    extern PetscLogDouble nominal_flops;
+  }
+
+  /**
+  * Sets up the counters from the runtime options
+  *   -perf_counters                  Count the region kernels of the rhs.h dispatch functions (default off).
+  *   -perf_fp_event code             Raw event code (hex) counting retired floating point operations on the CPU at hand,
+  *                                   e.g 0xff03 on AMD Zen. Without it the nominal flops given to add_flops are used.
+  *   -perf_machine_balance B         Machine balance (peak flops per byte of memory bandwidth) of the node. If given,
+  *                                   the summary classifies the kernels as memory or compute bound.
+  * Must be called after threads::setup(), since the counters of a thread are opened by the thread itself.
+  **/
+  PetscErrorCode setup();
+
+  /**
+  * Starts and stops counting section s. Only called if the counters are enabled, see Section.
+  **/
+  void start(const SectionType s);
+  void stop(const SectionType s);
+
+  /**
+  * Adds n nominal floating point operations of the counted kernels. Should be called by every RHS evaluation that
+  * runs them, whichever of the dispatch functions it uses.
+  **/
+  inline void add_flops(const PetscLogDouble n)
+  {
+    detail::nominal_flops += n;
+  }
+
+  /**
+  * Prints the summary of each rank of comm. Does nothing if the counters are not enabled.
+  **/
+  PetscErrorCode view(MPI_Comm comm);
+
+  /**
+  * Counts the enclosing scope as section s, if the counters are enabled.
+  **/
+  class Section
+  {
+  public:
+    explicit Section(const SectionType s) : s_(s) { if (detail::enabled) start(s_); }
+    ~Section() { if (detail::enabled) stop(s_); }
+  private:
+    const SectionType s_;
+  };
+}
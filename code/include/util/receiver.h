@@ -0,0 +1,94 @@
+#pragma once
+
+#include <petscdmda.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+* Time traces (seismograms) of the solution at a set of receiver locations. The receiver coordinates are read from a
+* file and mapped once to the grid: a receiver is interpolated (linear, bilinear or trilinear) from the corners of the
+* grid cell containing it. Each rank keeps the corners it owns with their weights, and every sampled step adds the
+* weighted values of its corners into a local buffer of the traces. The per step cost is thus proportional to the
+* number of local receivers, not to the grid size. A receiver whose cell is split between ranks is sampled partially by
+* each of them.
+*
+* When the buffer is full, the ranks gather their partial traces on rank 0, which sums them and appends the batch to
+* <folder>/receivers/traces.bin. The file holds a FileHeader, the n_comps component indices (int64), the coordinates of
+* the receivers (3 doubles per receiver), followed by a record per sampled step: the time and the n_receivers x n_comps
+* values (double, receiver-major).
+**/
+namespace receiver
+{
+  struct FileHeader {
+    char    magic[8];           // "SBPRECV"
+    int64_t dim;                // Dimension of the grid
+    int64_t n_receivers;        // Number of receivers
+    int64_t n_comps;            // Number of components recorded per receiver
+  };
+
+  // Weighted corner of the interpolation stencil of a local receiver
+  struct Corner {
+    PetscInt receiver;                            // Index of the local receiver
+    PetscInt p;                                   // Local (ghosted) point index
+    PetscReal w;                                  // Interpolation weight
+  };
+
+  struct ReceiverCtx {
+    PetscBool soa;                                // Local vectors in component-major ordering (PartitionedLayout2DSoA)
+    PetscInt n_receivers = 0;                     // Total number of receivers, 0 if disabled
+    PetscInt interval = 1;                        // Time steps between samples
+    PetscInt buffer_steps = 256;                  // Samples buffered before a flush
+    std::vector<PetscInt> comps;                  // Components to record
+    std::string folder;
+    PetscInt dof, gnp;
+    std::vector<PetscInt> local;                  // Global indices of the local receivers
+    std::vector<Corner> corners;
+    // Local partial traces, [sample][local receiver][component]
+    std::vector<PetscScalar> buffer;
+    std::vector<PetscReal> times;
+    PetscInt n_buffered = 0;
+    // Gather on rank 0
+    std::vector<PetscMPIInt> counts, displs;
+    std::vector<PetscInt> gathered;               // Global indices of the receivers of all ranks, in rank order
+    FILE *fp = NULL;
+    // Statistics
+    PetscInt n_samples = 0;
+    PetscLogDouble sample_time = 0, flush_time = 0;
+  };
+
+  /**
+  * Sets up the receivers from the runtime options
+  *   -receivers file               Text file with the coordinates of one receiver per line, dim values separated by
+  *                                 whitespace. Lines starting with # are skipped. No receivers if not set.
+  *   -receiver_components c0,c1..  Components to record (default all).
+  *   -receiver_interval N          Record every N time steps (default 1).
+  *   -receiver_buffer M            Samples buffered before the traces are written (default 256).
+  *   -restart                      Append to the trace file of the run restarted from (see util/checkpoint.h). Its
+  *                                 records at time t_start or later are dropped, as the restarted run samples them
+  *                                 again. It must have been written for the same receivers and components.
+  * and adds receiver::monitor as a step monitor of the time stepping (see time_stepping/ts_monitor.h). Grid point i
+  * in direction d is at xl[d] + i*h[d].
+  * Inputs: da      - DMDA object
+  *         soa     - If true, the local vectors of the time stepping are in component-major ordering.
+  *         folder  - Output folder. The traces are written to folder/receivers.
+  *         xl      - Coordinates of the first grid point, unused dimensions are ignored.
+  *         h       - Grid spacings, unused dimensions are ignored.
+  *         t_start - Initial time of the time stepping, checkpoint::CheckpointCtx::t_start after a restart.
+  *
+  * Output: ctx     - Receiver context. Must not be moved while in use.
+  **/
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, const std::array<PetscReal,3> xl,
+                        const std::array<PetscReal,3> h, const PetscReal t_start, ReceiverCtx& ctx);
+
+  /**
+  * Step monitor sampling the receivers every interval steps. v is the local vector of the time stepping.
+  **/
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ctx);
+
+  /**
+  * Writes the buffered samples, prints the sampling statistics and frees the context.
+  **/
+  PetscErrorCode destroy(ReceiverCtx& ctx);
+}
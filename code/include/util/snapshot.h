@@ -0,0 +1,119 @@
+#pragma once
+
+#include <petscdmda.h>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+* Time series output of the solution every N time steps. A snapshot is copied (packed) from the working vector of the
+* time stepper into one of two buffers, which a background thread of each rank writes to disk while the time stepping
+* continues. The time stepping only stalls for the packing, or if the buffer to fill is still being written. The
+* writer thread does not call MPI.
+*
+* Each rank writes its block of each snapshot to the file <folder>/step<step>_rank<rank>.bin, holding a FileHeader,
+* the n_comps component indices (int64) and the selected components of the block (double, component-major, x fastest).
+*
+* The blocks can be compressed by the writer thread, each component separately:
+*   LOSSLESS  - The bytes of the values are shuffled (all first bytes, then all second bytes, ...) and deflated.
+*   LOSSY     - The values are quantized to integers q = round(v/(2*tolerance)), so that the pointwise error is at most
+*               the tolerance. The differences of consecutive q are shuffled and deflated. A component with values
+*               too large to quantize is stored LOSSLESS.
+* In a compressed file the component indices are followed by a (codec, size) int64 pair per component and the
+* compressed components. read() decodes a file.
+**/
+namespace snapshot
+{
+  enum Compression {NONE, LOSSLESS, LOSSY};
+
+  struct FileHeader {
+    char    magic[8];           // "SBPSNAP"
+    int64_t step;               // Time step of the snapshot
+    double  t;                  // Time of the snapshot
+    int64_t dim;                // Dimension of the grid
+    int64_t N[3];               // Global grid size, 1 in unused dimensions
+    int64_t start[3];           // First global index of the block
+    int64_t n[3];               // Size of the block
+    int64_t n_comps;            // Number of components in the file
+    int64_t compression;        // Compression of the file
+    double  tolerance;          // Pointwise error bound of LOSSY
+  };
+
+  struct Buffer {
+    std::vector<PetscScalar> data;
+    PetscInt step;
+    PetscReal t;
+    bool full = false;
+  };
+
+  struct SnapshotCtx {
+    DM da;
+    PetscBool soa;                                // Local vectors in component-major ordering (PartitionedLayout2DSoA)
+    PetscInt interval = 0;                        // Time steps between snapshots, 0 if disabled
+    PetscBool sync;                               // Write with VecView on the calling thread instead
+    Compression compression = NONE;
+    PetscReal tolerance = 0;                      // Pointwise error bound of LOSSY compression
+    PetscInt level = 1;                           // Deflate level
+    std::vector<PetscInt> comps;                  // Components to output
+    std::string folder;
+    PetscMPIInt rank;
+    PetscInt dim, dof;
+    std::array<PetscInt,3> N, start, n, gstart, gn;
+    Vec global, local_aos;                        // Work vectors of the synchronous path
+    // Double buffer drained by the writer thread
+    std::array<Buffer,2> buffers;
+    PetscInt next = 0;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    bool write_failed = false;
+    // Statistics
+    PetscInt count = 0;
+    PetscLogDouble stall = 0, stall_max = 0, write_time = 0, bytes = 0;
+    PetscLogDouble compress_time = 0, stored_bytes = 0, max_error = 0;
+  };
+
+  /**
+  * Sets up the snapshots from the runtime options
+  *   -snapshot_interval N          Write a snapshot every N time steps, including the initial data (default 0, off).
+  *   -snapshot_components c0,c1..  Components to output (default all).
+  *   -snapshot_sync                Write the full solution with VecView on the calling thread, i.e the synchronous
+  *                                 output path of write_vector_to_binary, to compare the stall per snapshot.
+  *   -snapshot_compression none|lossless|lossy
+  *                                 Compression of the snapshots (default none). Not used with -snapshot_sync.
+  *   -snapshot_tolerance tol       Pointwise error bound of lossy compression. Defaults to 0.1*discretization_error.
+  *   -snapshot_compression_level l Deflate level, 1 (fastest, default) to 9.
+  * and adds snapshot::monitor as a step monitor of the time stepping (see time_stepping/ts_monitor.h).
+  * Inputs: da      - DMDA object
+  *         soa     - If true, the local vectors of the time stepping are in component-major ordering.
+  *         folder  - Output folder. The snapshots are written to folder/snapshots.
+  *         discretization_error - Scale of the discretization error, h^p for grid spacing h and SBP order p.
+  *
+  * Output: ctx     - Snapshot context. Must not be moved while in use.
+  **/
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, const PetscReal discretization_error,
+                        SnapshotCtx& ctx);
+
+  /**
+  * Step monitor writing a snapshot if step is a multiple of the interval. v is the local vector of the time stepping.
+  **/
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ctx);
+
+  /**
+  * Waits for the pending snapshots to be written, prints the stall and write statistics and frees the context.
+  **/
+  PetscErrorCode destroy(SnapshotCtx& ctx);
+
+  /**
+  * Reads and decodes the snapshot file path, e.g for post-processing. Does not call MPI.
+  * Output: header  - File header
+  *         comps   - Component indices
+  *         data    - The components of the block, component-major, x fastest
+  **/
+  PetscErrorCode read(const std::string path, FileHeader& header, std::vector<int64_t>& comps, std::vector<PetscScalar>& data);
+}
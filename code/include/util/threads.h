@@ -0,0 +1,115 @@
+#pragma once
+
+#include <petscvec.h>
+#include <array>
+#include <type_traits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+* Utilities for shared memory (thread) parallelism within an MPI rank. Threads are used to evaluate the
+* RHS region functions (see partitioned_rhs/tiling.h). Without OpenMP all functions fall back to a single thread.
+**/
+namespace threads
+{
+  /**
+  * Sets up the threads used within each rank from the runtime options
+  *   -threads N                               Number of threads per rank (default 1).
+  *   -thread_pinning none | compact | spread   Pinning of threads to the cores available to the rank (default none).
+  *                                             compact places thread t on core t, spread distributes the threads
+  *                                             evenly over the available cores.
+  **/
+  PetscErrorCode setup();
+
+  /**
+  * Returns the number of threads used within the rank.
+  **/
+  inline PetscInt num_threads()
+  {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  };
+
+  /**
+  * Returns the subrange of the index range ind assigned to thread t out of nt threads.
+  * The range is split in contiguous bands of (almost) equal size.
+  **/
+  inline std::array<PetscInt,2> band(const std::array<PetscInt,2>& ind, const PetscInt t, const PetscInt nt)
+  {
+    const PetscInt n = ind[1] - ind[0];
+    return {ind[0] + (t*n)/nt, ind[0] + ((t+1)*n)/nt};
+  };
+
+  /**
+  * First touch allocation of a local vector holding a 2D or 3D grid function with layout mapping layout.
+  * PETSc zeroes the array of a vector on creation, which places all its memory pages on the NUMA node
+  * of the master thread. The array of v is therefore replaced by a new array which is zeroed in parallel,
+  * using the same banded partition of rows as the threaded RHS evaluation (see partitioned_rhs/tiling.h),
+  * such that the pages of a band are placed on the NUMA node of the thread working on that band.
+  * Must be called directly after v is created, before it is written to.
+  * Input:  v      - Local vector.
+  *         layout - Layout mapping of the grid function stored in v.
+  **/
+  template <typename Mapping>
+  PetscErrorCode first_touch(Vec v, const Mapping& layout)
+  {
+    PetscErrorCode ierr;
+    PetscScalar *array;
+    PetscInt n;
+    ierr = VecGetLocalSize(v,&n);CHKERRQ(ierr);
+    ierr = PetscMalloc1(n,&array);CHKERRQ(ierr);
+    if constexpr (std::decay_t<decltype(layout.extents())>::rank() == 4) {
+      // 3D grid function: the planes are distributed statically, since the tiles of the 3D RHS are.
+      const PetscInt nxg = layout.extents().extent(0);
+      const PetscInt nyg = layout.extents().extent(1);
+      const PetscInt nzg = layout.extents().extent(2);
+      const PetscInt dofs = layout.extents().extent(3);
+      #pragma omp parallel for schedule(static)
+      for (PetscInt k = 0; k < nzg; k++) {
+        for (PetscInt j = 0; j < nyg; j++) {
+          for (PetscInt i = 0; i < nxg; i++) {
+            for (PetscInt comp = 0; comp < dofs; comp++) {
+              array[layout.flatten(k,j,i,comp)] = 0;
+            }
+          }
+        }
+      }
+    } else {
+      const PetscInt nxg = layout.extents().extent(0);
+      const PetscInt nyg = layout.extents().extent(1);
+      const PetscInt dofs = layout.extents().extent(2);
+      #pragma omp parallel
+      {
+#ifdef _OPENMP
+        const std::array<PetscInt,2> rows = band({0,nyg}, omp_get_thread_num(), omp_get_num_threads());
+#else
+        const std::array<PetscInt,2> rows = {0,nyg};
+#endif
+        for (PetscInt j = rows[0]; j < rows[1]; j++) {
+          for (PetscInt i = 0; i < nxg; i++) {
+            for (PetscInt comp = 0; comp < dofs; comp++) {
+              array[layout.flatten(j,i,comp)] = 0;
+            }
+          }
+        }
+      }
+    }
+    // v takes ownership of array, the previous array is freed.
+    ierr = VecReplaceArray(v,array);CHKERRQ(ierr);
+    return 0;
+  };
+
+  /**
+  * First touch allocation of a vector of the size of a local vector when its layout is not at hand, e.g a work
+  * vector of the time stepping. The array is split into n_blocks equal blocks, each of which is zeroed in
+  * contiguous bands, one per thread. With n_blocks = 1 for the interleaved layout and n_blocks = dofs for the
+  * component-major layout, this matches the placement of first_touch above up to a partial row per band.
+  * Input:  v        - Vector, typically created by VecDuplicate of a local vector.
+  *         n_blocks - Number of blocks.
+  **/
+  PetscErrorCode first_touch(Vec v, const PetscInt n_blocks = 1);
+}
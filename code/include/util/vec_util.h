@@ -1,6 +1,7 @@
 #pragma once
 
 #include <petscvec.h>
+#include <petscdmda.h>
 #include <numeric>
 #include <array>
 
@@ -34,12 +35,43 @@ PetscScalar error_max(const Vec v1, const Vec v2);
 Vec compute_error(const Vec v1, const Vec v2);
 
 /**
-* Utility function computing the error between vectors v1, v2 in the norm n
+* Utility function computing the error between vectors v1, v2 in the norm n (NORM_1, NORM_2 or NORM_INFINITY), in a
+* single pass over the local arrays without a temporary vector.
 * v1, v2 - vectors being compared.
 * n - norm used to measure error.
 **/
 PetscScalar compute_error_norm(const Vec v1, const Vec v2, const NormType n);
 
+/**
+* Errors of a grid function in the norms used for convergence studies.
+**/
+struct ErrorNorms {
+  PetscReal l2;     // Grid l2-norm, sqrt(h_x*h_y*h_z*sum(e^2))
+  PetscReal hnorm;  // SBP norm, sqrt(e'*H*e)
+  PetscReal max;    // Max (infinity)-norm
+};
+
+/**
+* Computes the l2, H and max-norm errors between the DMDA global vectors v1 and v2 in one sweep over the owned points,
+* with a single MPI_Allreduce of the packed partial results.
+* Inputs: da    - DMDA of v1, v2
+*         v1, v2 - vectors being compared.
+*         H     - SBP norm operator, e.g Ops::NormOp
+*         h     - array storing grid spacings
+*
+* Output: norms - the errors
+**/
+template <class NormOp, size_t dim>
+PetscErrorCode error_norms(const DM da, const Vec v1, const Vec v2, const NormOp& H, const std::array<PetscScalar,dim>& h,
+                           ErrorNorms& norms);
+
+/**
+* Computes the l2, H and max-norm errors between the DMDA global vectors v1 and v2.
+* Special case used for 1D grids.
+**/
+template <class NormOp>
+PetscErrorCode error_norms(const DM da, const Vec v1, const Vec v2, const NormOp& H, const PetscScalar h, ErrorNorms& norms);
+
 
 //=============================================================================
 // Implementations
@@ -71,12 +103,99 @@ Vec compute_error(const Vec v1, const Vec v2)
 
 PetscScalar compute_error_norm(const Vec v1, const Vec v2, const NormType n)
 {
-  PetscScalar err_n;
-  Vec err = compute_error(v1, v2);
-  VecNorm(err,n,&err_n);
-  VecDestroy(&err);
-  return err_n;
+  const PetscScalar *a1, *a2;
+  PetscInt          size;
+  PetscReal         local = 0, global;
+
+  VecGetLocalSize(v1,&size);
+  VecGetArrayRead(v1,&a1);
+  VecGetArrayRead(v2,&a2);
+  if (n == NORM_INFINITY) {
+    #pragma omp parallel for reduction(max:local) schedule(static)
+    for (PetscInt i = 0; i < size; i++) local = PetscMax(local,PetscAbsScalar(a1[i]-a2[i]));
+  } else if (n == NORM_1) {
+    #pragma omp parallel for reduction(+:local) schedule(static)
+    for (PetscInt i = 0; i < size; i++) local += PetscAbsScalar(a1[i]-a2[i]);
+  } else {
+    #pragma omp parallel for reduction(+:local) schedule(static)
+    for (PetscInt i = 0; i < size; i++) {
+      const PetscReal e = PetscAbsScalar(a1[i]-a2[i]);
+      local += e*e;
+    }
+  }
+  VecRestoreArrayRead(v1,&a1);
+  VecRestoreArrayRead(v2,&a2);
+  MPIU_Allreduce(&local,&global,1,MPIU_REAL,n == NORM_INFINITY ? MPIU_MAX : MPIU_SUM,PetscObjectComm((PetscObject)v1));
+  return n == NORM_INFINITY || n == NORM_1 ? global : PetscSqrtReal(global);
+}
+
+/**
+* MPI reduction of the packed partial results (sum(e^2), sum(w*e^2), max|e|) of error_norms.
+**/
+inline void error_norms_reduce(void *in, void *inout, int *len, MPI_Datatype *type)
+{
+  const PetscReal *a = (const PetscReal*) in;
+  PetscReal *b = (PetscReal*) inout;
+  for (int i = 0; i < *len; i++) {
+    b[3*i] += a[3*i];
+    b[3*i+1] += a[3*i+1];
+    b[3*i+2] = PetscMax(b[3*i+2],a[3*i+2]);
+  }
 }
 
+template <class NormOp, size_t dim>
+PetscErrorCode error_norms(const DM da, const Vec v1, const Vec v2, const NormOp& H, const std::array<PetscScalar,dim>& h,
+                           ErrorNorms& norms)
+{
+  PetscErrorCode    ierr;
+  const PetscScalar *a1, *a2;
+  PetscInt          da_dim, dof, N[3], start[3], n[3];
+  PetscReal         sum = 0, hsum = 0, max = 0, local[3], global[3];
+  static MPI_Datatype type = MPI_DATATYPE_NULL;
+  static MPI_Op     op = MPI_OP_NULL;
 
+  if (op == MPI_OP_NULL) {
+    ierr = MPI_Type_contiguous(3,MPIU_REAL,&type);CHKERRQ(ierr);
+    ierr = MPI_Type_commit(&type);CHKERRQ(ierr);
+    ierr = MPI_Op_create(error_norms_reduce,1,&op);CHKERRQ(ierr);
+  }
+  ierr = DMDAGetInfo(da,&da_dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,&dof,NULL,NULL,NULL,NULL,NULL);CHKERRQ(ierr);
+  ierr = DMDAGetCorners(da,&start[0],&start[1],&start[2],&n[0],&n[1],&n[2]);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(v1,&a1);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(v2,&a2);CHKERRQ(ierr);
+  #pragma omp parallel for collapse(2) reduction(+:sum,hsum) reduction(max:max) schedule(static)
+  for (PetscInt k = 0; k < n[2]; k++) {
+    for (PetscInt j = 0; j < n[1]; j++) {
+      const PetscReal w_jk = (da_dim > 1 ? H.weight(N[1],start[1]+j) : 1)*(da_dim > 2 ? H.weight(N[2],start[2]+k) : 1);
+      const PetscInt  row = (k*n[1] + j)*n[0];
+      for (PetscInt i = 0; i < n[0]; i++) {
+        const PetscReal w = w_jk*H.weight(N[0],start[0]+i);
+        for (PetscInt c = 0; c < dof; c++) {
+          const PetscReal e = PetscAbsScalar(a1[(row + i)*dof + c] - a2[(row + i)*dof + c]);
+          sum += e*e;
+          hsum += w*e*e;
+          max = PetscMax(max,e);
+        }
+      }
+    }
+  }
+  ierr = VecRestoreArrayRead(v1,&a1);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(v2,&a2);CHKERRQ(ierr);
 
+  local[0] = sum;
+  local[1] = hsum;
+  local[2] = max;
+  ierr = MPIU_Allreduce(local,global,1,type,op,PetscObjectComm((PetscObject)da));CHKERRQ(ierr);
+  const PetscScalar h_prod = std::accumulate(h.begin(),h.end(), 1.0, std::multiplies<PetscScalar>());
+  norms.l2 = PetscSqrtReal(h_prod*global[0]);
+  norms.hnorm = PetscSqrtReal(h_prod*global[1]);
+  norms.max = global[2];
+  return 0;
+}
+
+template <class NormOp>
+PetscErrorCode error_norms(const DM da, const Vec v1, const Vec v2, const NormOp& H, const PetscScalar h, ErrorNorms& norms)
+{
+  std::array<PetscScalar,1> h_arr = {h};
+  return error_norms(da, v1, v2, H, h_arr, norms);
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Compares the forcing of the wave demo cached on the grid (default, separable g(t)*f(x,y)),
+# re-evaluated on the grid once per stage time (-general_forcing), and evaluated inline in the
+# kernels at every point and stage (baseline, the tree before the forcing cache).
+# Usage: ./run_forcing.sh [N] [Tend] [CFL] [order] [reps]
+# Builds the binaries itself: bin/wave_forcing from this tree and bin/wave_inline from a git
+# worktree of BASELINE_REV (default: the commit before grids/forcing.h was added).
+
+N=${1:-801}
+Tend=${2:-0.1}
+CFL=${3:-0.1}
+order=${4:-4}
+reps=${5:-3}
+baseline_rev=${BASELINE_REV:-$(git log --format=%H --diff-filter=A -- include/grids/forcing.h | tail -1)^}
+baseline_dir=$(mktemp -d)
+
+make init > /dev/null
+make clean > /dev/null
+make opt app=wave order=$order > /dev/null && cp bin/wave bin/wave_forcing
+git worktree add --detach $baseline_dir/tree $baseline_rev > /dev/null 2>&1
+(cd $baseline_dir/tree/code && make init > /dev/null && make opt app=wave order=$order > /dev/null) \
+	&& cp $baseline_dir/tree/code/bin/wave bin/wave_inline
+git worktree remove --force $baseline_dir/tree
+rm -rf $baseline_dir
+
+echo "forcing,order,elapsed,l2_error"
+for variant in "inline:bin/wave_inline" "general:bin/wave_forcing -general_forcing" "separable:bin/wave_forcing"
+do
+	name=${variant%%:*}
+	cmd=${variant#*:}
+	for (( r=0; r<reps; r++ ))
+	do
+		out=$(mpirun -n 1 $cmd $N $N $Tend $CFL 1)
+		elapsed=$(echo "$out" | grep "Elapsed time" | awk '{print $3}')
+		error=$(echo "$out" | grep "l2-error" | awk '{print $4}' | tr -d ',')
+		echo "$name,$order,$elapsed,$error"
+	done
+done
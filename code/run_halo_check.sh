@@ -0,0 +1,28 @@
+#!/bin/bash
+# Checks the ghost points exchanged by each halo exchange type (use_custom_sc = 0, 1, 2) on 1 to
+# max_ranks ranks, with both layouts of the local vectors. halo_bench compares the ghost points
+# across the edges of each local domain with the owned points of the neighbors after the exchanges,
+# and fails with "wrong ghost values" otherwise. The grid sizes are odd so that the partitions are
+# uneven.
+# Usage: ./run_halo_check.sh [max_ranks] [dof] [sw]
+# Build the benchmark first: make halo_bench
+
+max_ranks=${1:-9}
+dof=${2:-3}
+sw=${3:-3}
+
+echo "ranks,layout,result"
+for (( ranks=1; ranks<=max_ranks; ranks++ ))
+do
+	for layout in aos soa
+	do
+		opts=""
+		[ "$layout" == "soa" ] && opts="-soa"
+		if mpirun -n $ranks bin/halo_bench -sizes 97,255 -dof $dof -sw $sw -exchanges 3 -reps 1 $opts > /dev/null
+		then
+			echo "$ranks,$layout,ok"
+		else
+			echo "$ranks,$layout,failed"
+		fi
+	done
+done
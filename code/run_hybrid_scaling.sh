@@ -0,0 +1,26 @@
+#!/bin/bash
+# Compares pure MPI against hybrid MPI + threads on a single node, using the same
+# total number of cores: ncores ranks x 1 thread vs 1 rank x ncores threads
+# (and intermediate splits). Usage: ./run_hybrid_scaling.sh [target] [N] [Tend] [CFL]
+# Build the target first, e.g. make opt app=wave order=4
+# Each rank is bound to its own set of cores (Open MPI syntax), within which its
+# threads are pinned by the solver.
+
+target=${1:-wave}
+N=${2:-1001}
+Tend=${3:-0.1}
+CFL=${4:-0.1}
+pinning=${PINNING:-spread}
+
+echo "ranks,threads,elapsed"
+for ncores in 1 2 4 8 16 32
+do
+	for (( ranks=ncores; ranks>=1; ranks/=2 ))
+	do
+		threads=$(( ncores/ranks ))
+		export OMP_NUM_THREADS=$threads
+		elapsed=$(mpirun -n $ranks --map-by slot:PE=$threads --bind-to core bin/$target $N $N $Tend $CFL 1 \
+			-threads $threads -thread_pinning $pinning | grep "Elapsed time" | awk '{print $3}')
+		echo "$ranks,$threads,$elapsed"
+	done
+done
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Compares the binary with all SBP orders compiled in (selected at runtime with -sbp_order)
+# against single-order binaries (make order=N), for each order. The two builds should report
+# the same error and, within timing noise, the same elapsed time. The column same_error is 1
+# when a run prints the same l2-error as the first run of the single-order build. The error is
+# printed with %g, so this compares six significant digits, not the solutions bit for bit.
+# Usage: ./run_order_dispatch.sh [target] [N] [Tend] [CFL] [reps]
+# Builds the binaries itself, as bin/<target>_dispatch and bin/<target>_order<N>.
+
+target=${1:-wave}
+N=${2:-801}
+Tend=${3:-0.1}
+CFL=${4:-0.1}
+reps=${5:-3}
+
+make init > /dev/null
+make clean > /dev/null
+make opt app=$target > /dev/null && cp bin/$target bin/${target}_dispatch
+for order in 2 4 6
+do
+	make clean > /dev/null
+	make opt app=$target order=$order > /dev/null && cp bin/$target bin/${target}_order$order
+done
+
+echo "order,build,elapsed,l2_error,same_error"
+for order in 2 4 6
+do
+	ref=""
+	for build in order$order dispatch
+	do
+		for (( r=0; r<reps; r++ ))
+		do
+			out=$(mpirun -n 1 bin/${target}_$build $N $N $Tend $CFL 1 -sbp_order $order)
+			elapsed=$(echo "$out" | grep "Elapsed time" | awk '{print $3}')
+			error=$(echo "$out" | grep "l2-error" | awk '{print $4}' | tr -d ',')
+			[ -z "$ref" ] && ref=$error
+			same=$([ "$error" == "$ref" ] && echo 1 || echo 0)
+			echo "$order,$build,$elapsed,$error,$same"
+		done
+	done
+done
@@ -0,0 +1,23 @@
+#!/bin/bash
+# Compares the stall per snapshot of the synchronous output path (-snapshot_sync, VecView on the
+# calling thread) against the background writer, without and with compression.
+# Usage: ./run_snapshot_stall.sh [target] [N] [Tend] [CFL] [interval] [ranks]
+# Build the target first, e.g. make opt app=wave order=4
+
+target=${1:-wave}
+N=${2:-1001}
+Tend=${3:-0.1}
+CFL=${4:-0.1}
+interval=${5:-10}
+ranks=${6:-4}
+
+echo "mode,snapshots,stall_mean,stall_max,final_drain,elapsed"
+for mode in "sync:-snapshot_sync" "background:" "lossless:-snapshot_compression lossless" "lossy:-snapshot_compression lossy"
+do
+	name=${mode%%:*}
+	opts=${mode#*:}
+	out=$(mpirun -n $ranks bin/$target $N $N $Tend $CFL 1 -snapshot_interval $interval $opts)
+	stall=$(echo "$out" | grep "Stall per snapshot" | sed -E 's/.*: ([0-9]+) written.*mean ([^ ]+) s, max ([^ ]+) s\. Final drain: ([^ ]+) s.*/\1,\2,\3,\4/')
+	elapsed=$(echo "$out" | grep "Elapsed time" | awk '{print $3}')
+	echo "$name,$stall,$elapsed"
+done
@@ -0,0 +1,54 @@
+#include "grids/coefficient_field.h"
+
+namespace grid
+{
+    PetscErrorCode coefficient_field_create(const DM da, const PetscInt n_coeffs, CoefficientField2D& coeffs)
+    {
+        PetscErrorCode ierr;
+        ierr = DMDACreateCompatibleDMDA(da,n_coeffs,&coeffs.da);CHKERRQ(ierr);
+        ierr = DMCreateLocalVector(coeffs.da,&coeffs.v);CHKERRQ(ierr);
+        coeffs.layout = create_layout_2d(coeffs.da);
+        return 0;
+    }
+
+    PetscErrorCode coefficient_field_load(CoefficientField2D& coeffs, const std::string& file)
+    {
+        PetscErrorCode ierr;
+        PetscViewer viewer;
+        Vec v_global;
+
+        ierr = DMCreateGlobalVector(coeffs.da,&v_global);CHKERRQ(ierr);
+        ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,file.c_str(),FILE_MODE_READ,&viewer);CHKERRQ(ierr);
+        ierr = VecLoad(v_global,viewer);CHKERRQ(ierr);
+        ierr = PetscViewerDestroy(&viewer);CHKERRQ(ierr);
+        ierr = DMGlobalToLocalBegin(coeffs.da,v_global,INSERT_VALUES,coeffs.v);CHKERRQ(ierr);
+        ierr = DMGlobalToLocalEnd(coeffs.da,v_global,INSERT_VALUES,coeffs.v);CHKERRQ(ierr);
+        ierr = VecDestroy(&v_global);CHKERRQ(ierr);
+        return 0;
+    }
+
+    PetscErrorCode coefficient_field_get(const CoefficientField2D& coeffs, grid_function_2d<const PetscScalar>& gf)
+    {
+        PetscErrorCode ierr;
+        const PetscScalar *array;
+        ierr = VecGetArrayRead(coeffs.v,&array);CHKERRQ(ierr);
+        gf = grid_function_2d<const PetscScalar>(array, coeffs.layout);
+        return 0;
+    }
+
+    PetscErrorCode coefficient_field_restore(const CoefficientField2D& coeffs, grid_function_2d<const PetscScalar>& gf)
+    {
+        PetscErrorCode ierr;
+        const PetscScalar *array = gf.data();
+        ierr = VecRestoreArrayRead(coeffs.v,&array);CHKERRQ(ierr);
+        return 0;
+    }
+
+    PetscErrorCode coefficient_field_destroy(CoefficientField2D& coeffs)
+    {
+        PetscErrorCode ierr;
+        ierr = VecDestroy(&coeffs.v);CHKERRQ(ierr);
+        ierr = DMDestroy(&coeffs.da);CHKERRQ(ierr);
+        return 0;
+    }
+}
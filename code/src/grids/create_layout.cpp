@@ -22,16 +22,19 @@ namespace grid
 
     partitioned_layout_2d create_layout_2d(const DM& da)
     {   
-        PetscInt dim, nx, ny, nxg, nyg, dofs, sw, processor_x_offset, processor_y_offset, stencil_x_offset, stencil_y_offset, g2l_offset, g2l_x_offset, g2l_y_offset;
-        DMDAGetInfo(da,&dim,&nx,&ny,NULL,NULL,NULL,NULL,&dofs,&sw,NULL,NULL,NULL,NULL);
+        PetscInt dim, nx, ny, nxg, nyg, dofs, processor_x_offset, processor_y_offset, stencil_x_offset, stencil_y_offset, ghost_x_start, ghost_y_start, g2l_offset, g2l_x_offset, g2l_y_offset;
+        DMDAGetInfo(da,&dim,&nx,&ny,NULL,NULL,NULL,NULL,&dofs,NULL,NULL,NULL,NULL,NULL);
         DMDAGetGhostCorners(da,NULL,NULL,NULL,&nxg,&nyg,NULL);
         assert(dim==2);
 
         // Get the offsets this process has.
         DMDAGetCorners(da,&processor_x_offset,&processor_y_offset,NULL,NULL,NULL,NULL);
         
-        stencil_x_offset = (processor_x_offset == 0) ? 0 : -sw; // If on west boundary, no offset, otherwise offset by DMDA stencil width (halo size).
-        stencil_y_offset = (processor_y_offset == 0) ? 0 : -sw; // If on south boundary, no offset, otherwise offset by DMDA stencil width (halo size).
+        // Offset of the ghost region, i.e the DMDA stencil width (halo size) unless clipped by the west/south boundary.
+        // For wide halos the ghost region may be clipped also for processes not on the boundary.
+        DMDAGetGhostCorners(da,&ghost_x_start,&ghost_y_start,NULL,NULL,NULL,NULL);
+        stencil_x_offset = ghost_x_start - processor_x_offset;
+        stencil_y_offset = ghost_y_start - processor_y_offset;
         
         // Compute global to local offset. 
         g2l_x_offset = -(processor_x_offset+stencil_x_offset);
@@ -41,4 +44,84 @@ namespace grid
         return grid::partitioned_layout_2d(grid::extents_2d(nxg,nyg,dofs),g2l_offset,nx,ny);
     }
 
-}
+    partitioned_layout_2d_soa create_layout_2d_soa(const DM& da)
+    {   
+        PetscInt dim, nx, ny, nxg, nyg, dofs, processor_x_offset, processor_y_offset, stencil_x_offset, stencil_y_offset, ghost_x_start, ghost_y_start, g2l_offset, g2l_x_offset, g2l_y_offset;
+        DMDAGetInfo(da,&dim,&nx,&ny,NULL,NULL,NULL,NULL,&dofs,NULL,NULL,NULL,NULL,NULL);
+        DMDAGetGhostCorners(da,NULL,NULL,NULL,&nxg,&nyg,NULL);
+        assert(dim==2);
+
+        // Get the offsets this process has.
+        DMDAGetCorners(da,&processor_x_offset,&processor_y_offset,NULL,NULL,NULL,NULL);
+        
+        // Offset of the ghost region, i.e the DMDA stencil width (halo size) unless clipped by the west/south boundary.
+        // For wide halos the ghost region may be clipped also for processes not on the boundary.
+        DMDAGetGhostCorners(da,&ghost_x_start,&ghost_y_start,NULL,NULL,NULL,NULL);
+        stencil_x_offset = ghost_x_start - processor_x_offset;
+        stencil_y_offset = ghost_y_start - processor_y_offset;
+        
+        // Compute global to local offset. The components are stored in separate blocks, so the offset is not scaled by dofs.
+        g2l_x_offset = -(processor_x_offset+stencil_x_offset);
+        g2l_y_offset = -(processor_y_offset+stencil_y_offset);
+        g2l_offset = g2l_x_offset + nxg*g2l_y_offset;
+        
+        return grid::partitioned_layout_2d_soa(grid::extents_2d(nxg,nyg,dofs),g2l_offset,nx,ny);
+    }
+
+    partitioned_layout_3d create_layout_3d(const DM& da)
+    {   
+        PetscInt dim, nx, ny, nz, nxg, nyg, nzg, dofs, ghost_x_start, ghost_y_start, ghost_z_start, g2l_offset;
+        DMDAGetInfo(da,&dim,&nx,&ny,&nz,NULL,NULL,NULL,&dofs,NULL,NULL,NULL,NULL,NULL);
+        DMDAGetGhostCorners(da,&ghost_x_start,&ghost_y_start,&ghost_z_start,&nxg,&nyg,&nzg);
+        assert(dim==3);
+
+        // Compute global to local offset, i.e minus the flattened index of the first ghost point.
+        g2l_offset = -dofs*(ghost_x_start + nxg*(ghost_y_start + nyg*ghost_z_start));
+        
+        return grid::partitioned_layout_3d(grid::extents_3d(nxg,nyg,nzg,dofs),g2l_offset,nx,ny,nz);
+    }
+
+    /**
+    * Permutes the entries of a local vector between interleaved and component-major ordering.
+    * If to_soa is true, entry dofs*p + comp of v_src is placed at comp*n + p in v_dst, where n is the number of local
+    * grid points. Otherwise the inverse permutation is applied.
+    **/
+    static PetscErrorCode permute_local(const DM& da, const Vec v_src, Vec v_dst, const bool to_soa)
+    {
+        PetscInt nxg, nyg, dofs, n, p, comp;
+        const PetscScalar *array_src;
+        PetscScalar *array_dst;
+        DMDAGetInfo(da,NULL,NULL,NULL,NULL,NULL,NULL,NULL,&dofs,NULL,NULL,NULL,NULL,NULL);
+        DMDAGetGhostCorners(da,NULL,NULL,NULL,&nxg,&nyg,NULL);
+        n = nxg*nyg;
+
+        VecGetArrayRead(v_src,&array_src);
+        VecGetArray(v_dst,&array_dst);
+        if (to_soa) {
+            for (comp = 0; comp < dofs; comp++) {
+                for (p = 0; p < n; p++) {
+                    array_dst[comp*n + p] = array_src[dofs*p + comp];
+                }
+            }
+        } else {
+            for (p = 0; p < n; p++) {
+                for (comp = 0; comp < dofs; comp++) {
+                    array_dst[dofs*p + comp] = array_src[comp*n + p];
+                }
+            }
+        }
+        VecRestoreArrayRead(v_src,&array_src);
+        VecRestoreArray(v_dst,&array_dst);
+        return 0;
+    }
+
+    PetscErrorCode local_aos_to_soa(const DM& da, const Vec v_src, Vec v_dst)
+    {
+        return permute_local(da, v_src, v_dst, true);
+    }
+
+    PetscErrorCode local_soa_to_aos(const DM& da, const Vec v_src, Vec v_dst)
+    {
+        return permute_local(da, v_src, v_dst, false);
+    }
+}
\ No newline at end of file
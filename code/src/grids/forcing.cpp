@@ -0,0 +1,59 @@
+#include "grids/forcing.h"
+
+namespace grid
+{
+    PetscErrorCode forcing_field_create_separable(const DM da, const PetscInt n_comps, const SpatialSource2D& f,
+                                                  const TimeFactor& g, ForcingField2D& forcing)
+    {
+        PetscErrorCode ierr;
+        ierr = coefficient_field_create(da,n_comps,forcing.values);CHKERRQ(ierr);
+        ierr = coefficient_field_fill(forcing.values,f);CHKERRQ(ierr);
+        forcing.time_factor = g;
+        forcing.source = nullptr;
+        forcing.valid = true;
+        return 0;
+    }
+
+    PetscErrorCode forcing_field_create(const DM da, const PetscInt n_comps, const SpaceTimeSource2D& f,
+                                        ForcingField2D& forcing)
+    {
+        PetscErrorCode ierr;
+        ierr = coefficient_field_create(da,n_comps,forcing.values);CHKERRQ(ierr);
+        forcing.time_factor = nullptr;
+        forcing.source = f;
+        forcing.g = 1;
+        forcing.valid = false;
+        return 0;
+    }
+
+    PetscErrorCode forcing_field_get(ForcingField2D& forcing, const PetscScalar t, forcing_function_2d& force)
+    {
+        PetscErrorCode ierr;
+        if (forcing.time_factor) {
+            forcing.g = forcing.time_factor(t);
+        } else if (!forcing.valid || forcing.t != t) {
+            ierr = coefficient_field_fill(forcing.values, [&](const PetscInt i, const PetscInt j, const PetscInt c) {
+                return forcing.source(i, j, c, t);
+            });CHKERRQ(ierr);
+            forcing.valid = true;
+        }
+        forcing.t = t;
+        ierr = coefficient_field_get(forcing.values,force.f);CHKERRQ(ierr);
+        force.g = forcing.g;
+        return 0;
+    }
+
+    PetscErrorCode forcing_field_restore(ForcingField2D& forcing, forcing_function_2d& force)
+    {
+        PetscErrorCode ierr;
+        ierr = coefficient_field_restore(forcing.values,force.f);CHKERRQ(ierr);
+        return 0;
+    }
+
+    PetscErrorCode forcing_field_destroy(ForcingField2D& forcing)
+    {
+        PetscErrorCode ierr;
+        ierr = coefficient_field_destroy(forcing.values);CHKERRQ(ierr);
+        return 0;
+    }
+}
@@ -0,0 +1,71 @@
+#include <petsc.h>
+#include "partitioned_rhs/deep_halo.h"
+
+namespace deep_halo
+{
+    PetscErrorCode setup(const PetscInt radius, const PetscInt cls_sz, const PetscInt stages, DeepHaloCtx& ctx,
+                         PetscInt& stencil_width, DMDAStencilType& stencil_type)
+    {
+        PetscErrorCode ierr;
+        ctx.steps = 0;
+        ctx.stages = stages;
+        ctx.radius = radius;
+        ctx.cls_sz = cls_sz;
+        ctx.n_evals = 0;
+        ierr = PetscOptionsGetInt(NULL,NULL,"-deep_halo",&ctx.steps,NULL);CHKERRQ(ierr);
+
+        if (enabled(ctx)) {
+            // One radius per evaluation, plus the part of the closure region a shrinking range has to skip.
+            stencil_width = ctx.steps*stages*radius + std::max(cls_sz - radius, (PetscInt) 0);
+            stencil_type = DMDA_STENCIL_BOX;
+            PetscPrintf(PETSC_COMM_WORLD,"Deep halo: exchange every %d steps (%d RHS evaluations), ghost width %d\n",
+                        ctx.steps,ctx.steps*stages,stencil_width);
+        } else {
+            stencil_width = radius;
+            stencil_type = DMDA_STENCIL_STAR;
+        }
+        return 0;
+    }
+
+    PetscErrorCode setup_ranges(const DM da, const HaloType type, const PetscBool soa, DeepHaloCtx& ctx)
+    {
+        PetscInt Nx, Ny, i_xstart, i_ystart, nx, ny, ig_xstart, ig_ystart, ngx, ngy;
+        PetscMPIInt size;
+        MPI_Comm comm;
+
+        PetscObjectGetComm((PetscObject) da, &comm);
+        MPI_Comm_size(comm, &size);
+        if (size == 1) ctx.steps = 0; // The serial RHS does not use the halo
+        if (!enabled(ctx)) return 0;
+        if (type != HALO_PETSC || soa) {
+            PetscPrintf(PETSC_COMM_WORLD,"Error: -deep_halo requires use_custom_sc = 0 and the interleaved layout, since the ghost corners must be exchanged.\n");
+            return -1;
+        }
+
+        DMDAGetInfo(da,NULL,&Nx,&Ny,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL);
+        DMDAGetCorners(da,&i_xstart,&i_ystart,NULL,&nx,&ny,NULL);
+        DMDAGetGhostCorners(da,&ig_xstart,&ig_ystart,NULL,&ngx,&ngy,NULL);
+        ctx.N = {Nx, Ny};
+        ctx.ghost_i = {ig_xstart, ig_xstart + ngx};
+        ctx.ghost_j = {ig_ystart, ig_ystart + ngy};
+
+        // The region functions only handle one physical boundary per direction.
+        int invalid = (ctx.ghost_i[0] == 0 && ctx.ghost_i[1] == Nx) || (ctx.ghost_j[0] == 0 && ctx.ghost_j[1] == Ny);
+
+        // Valid range after the last evaluation before the next exchange.
+        std::array<PetscInt,2> ind_i = ctx.ghost_i, ind_j = ctx.ghost_j;
+        for (PetscInt m = 0; m < ctx.steps*ctx.stages; m++) {
+            ind_i = shrink(ind_i, Nx, ctx.radius, ctx.cls_sz);
+            ind_j = shrink(ind_j, Ny, ctx.radius, ctx.cls_sz);
+        }
+        invalid = invalid || ind_i[0] > i_xstart || ind_i[1] < i_xstart + nx || ind_j[0] > i_ystart || ind_j[1] < i_ystart + ny;
+
+        int any_invalid;
+        MPI_Allreduce(&invalid, &any_invalid, 1, MPI_INT, MPI_LOR, comm);
+        if (any_invalid) {
+            PetscPrintf(PETSC_COMM_WORLD,"Error: -deep_halo %d is too deep for the local grid sizes. Use fewer steps or fewer processes.\n",ctx.steps);
+            return -1;
+        }
+        return 0;
+    }
+}
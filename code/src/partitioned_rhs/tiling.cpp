@@ -0,0 +1,57 @@
+#include <petsc.h>
+#include <unistd.h>
+#include <cmath>
+#include "partitioned_rhs/tiling.h"
+#include "sbpops/simd.h"
+
+namespace tiling
+{
+    /**
+    * Returns the size of the L2 cache in bytes, or a default value of 1 MiB if it cannot be determined.
+    **/
+    static long l2_cache_size()
+    {
+        long sz = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        sz = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        return (sz > 0) ? sz : 1048576;
+    }
+
+    PetscErrorCode get_tile_size(const PetscInt stencil_width, const PetscInt dofs, std::array<PetscInt,2>& tile)
+    {
+        PetscErrorCode ierr;
+        PetscInt tile_i, tile_j;
+
+        // A row of a tile is streamed once for each of the stencil_width rows of the y-stencil reaching it,
+        // so stencil_width rows of the input plus the output row should fit in (half) the L2 cache.
+        const long row_bytes = (stencil_width + 1)*dofs*sizeof(PetscScalar);
+        tile_i = l2_cache_size()/(2*row_bytes);
+        tile_i = std::max((tile_i/sbp::simd::row_block)*sbp::simd::row_block, sbp::simd::row_block);
+        tile_j = tile_i;
+
+        ierr = PetscOptionsGetInt(NULL,NULL,"-tile_i",&tile_i,NULL);CHKERRQ(ierr);
+        ierr = PetscOptionsGetInt(NULL,NULL,"-tile_j",&tile_j,NULL);CHKERRQ(ierr);
+        tile = {tile_i, tile_j};
+        return 0;
+    }
+
+    PetscErrorCode get_tile_size_3d(const PetscInt stencil_width, const PetscInt dofs, std::array<PetscInt,2>& tile)
+    {
+        PetscErrorCode ierr;
+        PetscInt tile_i, tile_j;
+
+        // A tile column is swept in z-direction, so the stencil_width planes of the input reached by the z-stencil
+        // plus the output plane of a tile should fit in (half) the L2 cache. The tiles are square, with tile_i
+        // rounded to the SIMD row block.
+        const long point_bytes = (stencil_width + 1)*dofs*sizeof(PetscScalar);
+        tile_i = (PetscInt) std::sqrt((double) l2_cache_size()/(2*point_bytes));
+        tile_j = std::max(tile_i, (PetscInt) 1);
+        tile_i = std::max((tile_i/sbp::simd::row_block)*sbp::simd::row_block, sbp::simd::row_block);
+
+        ierr = PetscOptionsGetInt(NULL,NULL,"-tile_i",&tile_i,NULL);CHKERRQ(ierr);
+        ierr = PetscOptionsGetInt(NULL,NULL,"-tile_j",&tile_j,NULL);CHKERRQ(ierr);
+        tile = {tile_i, tile_j};
+        return 0;
+    }
+}
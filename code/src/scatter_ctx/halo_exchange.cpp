@@ -0,0 +1,235 @@
+#include <petsc.h>
+#include <array>
+#include "scatter_ctx/halo_exchange.h"
+#include "scatter_ctx/scatter_ctx.h"
+#include "util/logging.h"
+
+/**
+* Lays out the strips of halo.send_counts contiguously in the send buffer.
+**/
+static void set_send_buffer(HaloCtx& halo)
+{
+  size_t size = 0;
+  for (size_t k = 0; k < halo.send_counts.size(); k++) {
+    halo.send_displs[k] = size*sizeof(PetscScalar);
+    size += halo.send_counts[k];
+  }
+  halo.send_buffer.assign(size, 0);
+}
+
+/**
+* Builds the Cartesian communicator and subarray datatypes used by HALO_NEIGHBOR.
+* The local array is viewed as a 3D array of size lny x lnx x dof (or dof x lny x lnx if soa),
+* where lny = 1 for 1D DMDAs.
+**/
+static PetscErrorCode build_neighbor(DM da, const PetscBool soa, HaloCtx& halo)
+{
+  PetscInt        dim, m, n, dof, sw, i_xstart, i_ystart, nx, ny, ig_xstart, ig_ystart, lnx, lny;
+  DMBoundaryType  bx, by;
+  MPI_Comm        comm;
+
+  DMDAGetInfo(da,&dim,NULL,NULL,NULL,&m,&n,NULL,&dof,&sw,&bx,&by,NULL,NULL);
+  DMDAGetCorners(da,&i_xstart,&i_ystart,NULL,&nx,&ny,NULL);
+  DMDAGetGhostCorners(da,&ig_xstart,&ig_ystart,NULL,&lnx,&lny,NULL);
+  PetscObjectGetComm((PetscObject) da, &comm);
+  if (dim != 1 && dim != 2) {
+    PetscPrintf(PETSC_COMM_WORLD,"Error: the neighborhood halo exchange only supports 1D and 2D DMDAs.\n");
+    return -1;
+  }
+
+  // Offset of the owned points within the local array
+  const PetscInt lx = i_xstart - ig_xstart;
+  const PetscInt ly = i_ystart - ig_ystart;
+
+  // Process grid of the DMDA. Ranks are ordered with x fastest, i.e the Cartesian dimensions are (y,x).
+  std::array<int,2> dims, periods;
+  if (dim == 1) {
+    dims = {(int) m, 1};
+    periods = {bx == DM_BOUNDARY_PERIODIC, 0};
+  } else {
+    dims = {(int) n, (int) m};
+    periods = {by == DM_BOUNDARY_PERIODIC, bx == DM_BOUNDARY_PERIODIC};
+  }
+  // With fewer than 3 processes in a periodic direction both neighbors in that direction are the same process,
+  // in which case the messages of the neighborhood collective cannot be told apart.
+  for (int d = 0; d < dim; d++) {
+    if (periods[d] && dims[d] < 3) {
+      PetscPrintf(PETSC_COMM_WORLD,"Error: neighborhood halo exchange requires at least 3 processes in periodic directions.\n");
+      return -1;
+    }
+  }
+  MPI_Cart_create(comm, dim, dims.data(), periods.data(), 0, &halo.comm);
+  halo.soa = soa;
+  halo.local_sizes = {lnx, lny, dof};
+
+  // Subarray box = (j0, sj, i0, si), i.e (j0:j0+sj, i0:i0+si, all components), of the local array
+  auto subarray = [&](const std::array<PetscInt,4>& box) {
+    const PetscInt j0 = box[0], sj = box[1], i0 = box[2], si = box[3];
+    MPI_Datatype type;
+    int sizes[3], subsizes[3], starts[3];
+    if (soa) {
+      sizes[0] = dof; sizes[1] = lny;  sizes[2] = lnx;
+      subsizes[0] = dof; subsizes[1] = sj; subsizes[2] = si;
+      starts[0] = 0; starts[1] = j0; starts[2] = i0;
+    } else {
+      sizes[0] = lny; sizes[1] = lnx; sizes[2] = dof;
+      subsizes[0] = sj; subsizes[1] = si; subsizes[2] = dof;
+      starts[0] = j0; starts[1] = i0; starts[2] = 0;
+    }
+    MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPIU_SCALAR, &type);
+    MPI_Type_commit(&type);
+    return type;
+  };
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    Neighbors in the order of the Cartesian topology: (south, north) in y
+    followed by (west, east) in x. The 1D topology only has (west, east).
+  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  const PetscInt n_neighbors = 2*dim;
+  halo.neighbors.assign(n_neighbors, MPI_PROC_NULL);
+  halo.send_boxes.resize(n_neighbors);
+  halo.recv_boxes.resize(n_neighbors);
+  halo.send_counts.assign(n_neighbors, 0);
+  halo.send_displs.assign(n_neighbors, 0);
+  halo.send_types.assign(n_neighbors, MPIU_SCALAR);
+  halo.counts.assign(n_neighbors, 0);
+  halo.displs.assign(n_neighbors, 0);
+  halo.recv_types.assign(n_neighbors, MPIU_SCALAR);
+
+  int k = 0;
+  for (int d = 0; d < dim; d++) {
+    int source, dest;
+    MPI_Cart_shift(halo.comm, d, 1, &source, &dest);
+    const bool in_x = (dim == 1) || (d == 1);
+    const std::array<int,2> neighbors = {source, dest};
+    for (int side = 0; side < 2; side++, k++) {
+      halo.neighbors[k] = neighbors[side];
+      if (neighbors[side] == MPI_PROC_NULL) continue;
+      if (in_x) {
+        const PetscInt i_send = (side == 0) ? lx : lx + nx - sw;
+        const PetscInt i_recv = (side == 0) ? lx - sw : lx + nx;
+        halo.send_boxes[k] = {ly, ny, i_send, sw};
+        halo.recv_boxes[k] = {ly, ny, i_recv, sw};
+      } else {
+        const PetscInt j_send = (side == 0) ? ly : ly + ny - sw;
+        const PetscInt j_recv = (side == 0) ? ly - sw : ly + ny;
+        halo.send_boxes[k] = {j_send, sw, lx, nx};
+        halo.recv_boxes[k] = {j_recv, sw, lx, nx};
+      }
+      halo.send_counts[k] = halo.send_boxes[k][1]*halo.send_boxes[k][3]*dof;
+      halo.counts[k] = 1;
+      halo.recv_types[k] = subarray(halo.recv_boxes[k]);
+    }
+  }
+  set_send_buffer(halo);
+  return 0;
+}
+
+/**
+* Packs the points of box = (j0, sj, i0, si), all components, of the local array into strip,
+* traversing the box in the memory order of the local array.
+**/
+static void pack_box(const HaloCtx& halo, const std::array<PetscInt,4>& box, const PetscScalar *array, PetscScalar *strip)
+{
+  const PetscInt lnx = halo.local_sizes[0], lny = halo.local_sizes[1], dof = halo.local_sizes[2];
+  const PetscInt j0 = box[0], sj = box[1], i0 = box[2], si = box[3];
+  PetscInt k = 0;
+  if (halo.soa) {
+    for (PetscInt l = 0; l < dof; l++) {
+      for (PetscInt j = j0; j < j0 + sj; j++) {
+        const PetscScalar *row = array + (l*lny + j)*lnx + i0;
+        for (PetscInt i = 0; i < si; i++, k++) strip[k] = row[i];
+      }
+    }
+  } else {
+    for (PetscInt j = j0; j < j0 + sj; j++) {
+      const PetscScalar *row = array + (j*lnx + i0)*dof;
+      for (PetscInt i = 0; i < si*dof; i++, k++) strip[k] = row[i];
+    }
+  }
+}
+
+PetscErrorCode halo_ctx_create(DM da, const HaloType type, const PetscBool soa, HaloCtx& halo)
+{
+  halo.type = type;
+  halo.comm = MPI_COMM_NULL;
+  halo.scatctx = NULL;
+  halo.request = MPI_REQUEST_NULL;
+  halo.array = NULL;
+  switch (type)
+  {
+    case HALO_NEIGHBOR:
+      return build_neighbor(da, soa, halo);
+      break;
+    case HALO_PETSC:
+      if (!soa) {
+        return DMDAGetScatter(da, NULL, &halo.scatctx);
+      }
+      // The DMDA scatter context only supports the interleaved ordering.
+      halo.type = HALO_CUSTOM;
+      [[fallthrough]];
+    case HALO_CUSTOM:
+      return soa ? scatter_ctx_ltol_soa(da, halo.scatctx) : scatter_ctx_ltol(da, halo.scatctx);
+      break;
+    default:
+      return -1;
+      break;
+  }
+}
+
+PetscErrorCode halo_ctx_destroy(HaloCtx& halo)
+{
+  switch (halo.type)
+  {
+    case HALO_NEIGHBOR:
+      for (size_t k = 0; k < halo.counts.size(); k++) {
+        if (halo.counts[k]) MPI_Type_free(&halo.recv_types[k]);
+      }
+      MPI_Comm_free(&halo.comm);
+      break;
+    case HALO_CUSTOM:
+      VecScatterDestroy(&halo.scatctx);
+      break;
+    default: // The DMDA scatter context is owned by the DMDA
+      break;
+  }
+  return 0;
+}
+
+PetscErrorCode halo_exchange_begin(HaloCtx& halo, Vec v)
+{
+  PetscErrorCode ierr;
+  logging::begin(logging::HALO_BEGIN);
+  if (halo.type == HALO_NEIGHBOR) {
+    VecGetArray(v,&halo.array);
+    // The send buffer must not alias the receive buffer, even though the sent and received regions of the local
+    // array are disjoint, so the strips sent through the collective are packed.
+    for (size_t k = 0; k < halo.neighbors.size(); k++) {
+      PetscScalar *strip = halo.send_buffer.data() + halo.send_displs[k]/sizeof(PetscScalar);
+      if (halo.send_counts[k]) pack_box(halo, halo.send_boxes[k], halo.array, strip);
+    }
+    MPI_Ineighbor_alltoallw(halo.send_buffer.data(), halo.send_counts.data(), halo.send_displs.data(), halo.send_types.data(),
+                            halo.array, halo.counts.data(), halo.displs.data(), halo.recv_types.data(),
+                            halo.comm, &halo.request);
+    ierr = 0;
+  } else {
+    ierr = VecScatterBegin(halo.scatctx,v,v,INSERT_VALUES,SCATTER_FORWARD);
+  }
+  logging::end(logging::HALO_BEGIN);
+  return ierr;
+}
+
+PetscErrorCode halo_exchange_end(HaloCtx& halo, Vec v)
+{
+  PetscErrorCode ierr;
+  logging::begin(logging::HALO_END);
+  if (halo.type == HALO_NEIGHBOR) {
+    MPI_Wait(&halo.request, MPI_STATUS_IGNORE);
+    VecRestoreArray(v,&halo.array);
+    ierr = 0;
+  } else {
+    ierr = VecScatterEnd(halo.scatctx,v,v,INSERT_VALUES,SCATTER_FORWARD);
+  }
+  logging::end(logging::HALO_END);
+  return ierr;
+}
@@ -1,27 +1,55 @@
 #include <petsc.h>
 #include <petsc/private/dmdaimpl.h> 
 #include "scatter_ctx/scatter_ctx.h"
+#include "util/logging.h"
 
 PetscErrorCode build_ltol_1D(DM da, VecScatter& ltol);
-PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol);
+PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol, const PetscBool soa);
+PetscErrorCode build_ltol_3D(DM da, VecScatter& ltol);
 
 
 PetscErrorCode scatter_ctx_ltol(DM da, VecScatter& ltol)
 {
+  PetscErrorCode ierr;
   PetscInt dim;
   DMDAGetInfo(da,&dim,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL);
+  logging::begin(logging::SCATTER_SETUP);
   switch (dim)
   {
     case 1:
-      return build_ltol_1D(da, ltol);
+      ierr = build_ltol_1D(da, ltol);
       break;
     case 2:
-      return build_ltol_2D(da, ltol);
+      ierr = build_ltol_2D(da, ltol, PETSC_FALSE);
+      break;
+    case 3:
+      ierr = build_ltol_3D(da, ltol);
       break;
     default:
-      return -1;
+      ierr = -1;
       break;
   }
+  logging::end(logging::SCATTER_SETUP);
+  return ierr;
+}
+
+PetscErrorCode scatter_ctx_ltol_soa(DM da, VecScatter& ltol)
+{
+  PetscErrorCode ierr;
+  PetscInt dim;
+  DMDAGetInfo(da,&dim,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL);
+  logging::begin(logging::SCATTER_SETUP);
+  switch (dim)
+  {
+    case 2:
+      ierr = build_ltol_2D(da, ltol, PETSC_TRUE);
+      break;
+    default:
+      ierr = -1;
+      break;
+  }
+  logging::end(logging::SCATTER_SETUP);
+  return ierr;
 }
 
 /**
@@ -124,8 +152,10 @@ PetscErrorCode build_ltol_1D(DM da, VecScatter& ltol)
 * Build local to local scatter context containing only ghost point communications
 * Inputs: da        - DMDA object
 *         ltol      - pointer to local to local scatter context
+*         soa       - If true, the local vectors are stored in component-major ordering (grid::PartitionedLayout2DSoA),
+*                     otherwise in the interleaved ordering of the DMDA.
 **/
-PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
+PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol, const PetscBool soa)
 {
   AO          ao;
   PetscInt    stencil_radius, i_xstart, i_xend, i_ystart, i_yend, ig_xstart, ig_xend, ig_ystart, ig_yend, nx, ny, i, j, l, lnx, lny, no_com_vals, count, Nx, Ny, dof;
@@ -143,6 +173,11 @@ PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
   ig_xend = ig_xstart + lnx;
   ig_yend = ig_ystart + lny;
 
+  // Index of component l at local grid point (i,j) in the local vector.
+  auto local_index = [&](const PetscInt i, const PetscInt j, const PetscInt l) {
+    return soa ? l*lnx*lny + (i - ig_xstart) + lnx*(j - ig_ystart) : ((i - ig_xstart) + lnx*(j - ig_ystart))*dof + l;
+  };
+
   /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     Compute how many elements to receive
   - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -174,7 +209,7 @@ PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
     for (j = i_yend; j < ig_yend; j++) {
       for (l = 0; l < dof; l++) {
         ixx[count] = (i + Nx*j)*dof + l;
-        iyy[count] = ((i - ig_xstart) + lnx*(j - ig_ystart))*dof + l;
+        iyy[count] = local_index(i,j,l);
         count++;
       }
     }
@@ -184,7 +219,7 @@ PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
     for (j = ig_ystart; j < i_ystart; j++) { 
       for (l = 0; l < dof; l++) {
         ixx[count] = (i + Nx*j)*dof + l;
-        iyy[count] = ((i - ig_xstart) + lnx*(j - ig_ystart))*dof + l;
+        iyy[count] = local_index(i,j,l);
         count++;
       }
     }
@@ -194,7 +229,7 @@ PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
     for (j = i_ystart; j < i_yend; j++) {
       for (l = 0; l < dof; l++) {
         ixx[count] = (i + Nx*j)*dof + l;
-        iyy[count] = ((i - ig_xstart) + lnx*(j - ig_ystart))*dof + l;
+        iyy[count] = local_index(i,j,l);
         count++;
       }
     }
@@ -204,7 +239,7 @@ PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
     for (j = i_ystart; j < i_yend; j++) {
       for (l = 0; l < dof; l++) {
         ixx[count] = (i + Nx*j)*dof + l;
-        iyy[count] = ((i - ig_xstart) + lnx*(j - ig_ystart))*dof + l;
+        iyy[count] = local_index(i,j,l);
         count++;
       }
     }
@@ -244,12 +279,143 @@ PetscErrorCode build_ltol_2D(DM da, VecScatter& ltol)
   left  = dd->xs - dd->Xs; down  = dd->ys - dd->Ys; up = down + dd->ye-dd->ys;
   PetscMalloc1((dd->xe-dd->xs)*(up - down),&idx);
   count = 0;
-  for (i=down; i<up; i++) {
-    for (j=0; j<dd->xe-dd->xs; j++) {
-      idx[count++] = left + i*(dd->Xe-dd->Xs) + j;
+  if (soa) {
+    // Owned entries are interleaved in the global vector but component-major in the local vector.
+    for (j=i_ystart; j<i_yend; j++) {
+      for (i=i_xstart; i<i_xend; i++) {
+        for (l=0; l<dof; l++) {
+          idx[count++] = local_index(i,j,l);
+        }
+      }
+    }
+  } else {
+    for (i=down; i<up; i++) {
+      for (j=0; j<dd->xe-dd->xs; j++) {
+        idx[count++] = left + i*(dd->Xe-dd->Xs) + j;
+      }
+    }
+  }
+  VecScatterRemap(ltol,idx,NULL);
+
+  return 0;
+}
+
+/**
+* Build local to local scatter context containing only ghost point communications, for a 3D DMDA.
+* Only the ghost points across the faces of the local domain are communicated (star stencil).
+* Inputs: da        - DMDA object
+*         ltol      - pointer to local to local scatter context
+**/
+PetscErrorCode build_ltol_3D(DM da, VecScatter& ltol)
+{
+  AO          ao;
+  PetscInt    stencil_radius, i_xstart, i_xend, i_ystart, i_yend, i_zstart, i_zend, ig_xstart, ig_xend, ig_ystart, ig_yend, ig_zstart, ig_zend;
+  PetscInt    nx, ny, nz, i, j, k, l, lnx, lny, lnz, no_com_vals, count, Nx, Ny, Nz, dof;
+  IS          ix, iy;
+  Vec         vglobal, vlocal;
+  VecScatter  gtol;
+
+  DMDAGetStencilWidth(da, &stencil_radius);
+  DMDAGetCorners(da,&i_xstart,&i_ystart,&i_zstart,&nx,&ny,&nz);
+  DMDAGetGhostCorners(da,&ig_xstart,&ig_ystart,&ig_zstart,&lnx,&lny,&lnz);
+  DMDAGetInfo(da, NULL, &Nx, &Ny, &Nz,NULL,NULL,NULL,&dof,NULL,NULL,NULL,NULL,NULL);
+
+  i_xend = i_xstart + nx;
+  i_yend = i_ystart + ny;
+  i_zend = i_zstart + nz;
+  ig_xend = ig_xstart + lnx;
+  ig_yend = ig_ystart + lny;
+  ig_zend = ig_zstart + lnz;
+
+  // Index of component l at local grid point (i,j,k) in the local vector.
+  auto local_index = [&](const PetscInt i, const PetscInt j, const PetscInt k, const PetscInt l) {
+    return ((i - ig_xstart) + lnx*((j - ig_ystart) + lny*(k - ig_zstart)))*dof + l;
+  };
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    Compute how many elements to receive
+  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  no_com_vals = 0;
+  if (i_xstart != 0) no_com_vals += ny*nz;  // NOT WEST BOUNDARY, RECEIVE WEST
+  if (i_xend != Nx) no_com_vals += ny*nz;   // NOT EAST BOUNDARY, RECEIVE EAST
+  if (i_ystart != 0) no_com_vals += nx*nz;  // NOT SOUTH BOUNDARY, RECEIVE SOUTH
+  if (i_yend != Ny) no_com_vals += nx*nz;   // NOT NORTH BOUNDARY, RECEIVE NORTH
+  if (i_zstart != 0) no_com_vals += nx*ny;  // NOT BOTTOM BOUNDARY, RECEIVE BELOW
+  if (i_zend != Nz) no_com_vals += nx*ny;   // NOT TOP BOUNDARY, RECEIVE ABOVE
+  no_com_vals *= stencil_radius*dof;
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    Define communication pattern, from global index ixx[i] to local index iyy[i].
+    The ghost boxes are those of the faces, i.e the ghost range in one direction
+    and the owned ranges in the other two.
+  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  PetscInt *ixx, *iyy;
+  PetscMalloc2(no_com_vals,&ixx,no_com_vals,&iyy);
+  count = 0;
+  auto add_box = [&](const PetscInt i0, const PetscInt i1, const PetscInt j0, const PetscInt j1, const PetscInt k0, const PetscInt k1) {
+    for (PetscInt k = k0; k < k1; k++) {
+      for (PetscInt j = j0; j < j1; j++) {
+        for (PetscInt i = i0; i < i1; i++) {
+          for (PetscInt l = 0; l < dof; l++) {
+            ixx[count] = (i + Nx*(j + Ny*k))*dof + l;
+            iyy[count] = local_index(i,j,k,l);
+            count++;
+          }
+        }
+      }
+    }
+  };
+  add_box(ig_xstart, i_xstart, i_ystart, i_yend, i_zstart, i_zend); // WEST
+  add_box(i_xend, ig_xend, i_ystart, i_yend, i_zstart, i_zend);     // EAST
+  add_box(i_xstart, i_xend, ig_ystart, i_ystart, i_zstart, i_zend); // SOUTH
+  add_box(i_xstart, i_xend, i_yend, ig_yend, i_zstart, i_zend);     // NORTH
+  add_box(i_xstart, i_xend, i_ystart, i_yend, ig_zstart, i_zstart); // BOTTOM
+  add_box(i_xstart, i_xend, i_ystart, i_yend, i_zend, ig_zend);     // TOP
+
+  // Map global indices from natural ordering to petsc application ordering
+  DMDAGetAO(da,&ao);
+  AOApplicationToPetsc(ao,no_com_vals,ixx);
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    Build global to local scatter context
+  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  ISCreateGeneral(PETSC_COMM_SELF,no_com_vals,ixx,PETSC_COPY_VALUES,&ix);  
+  ISCreateGeneral(PETSC_COMM_SELF,no_com_vals,iyy,PETSC_COPY_VALUES,&iy);  
+  PetscFree2(ixx,iyy);
+
+  DMGetGlobalVector(da, &vglobal);
+  DMGetLocalVector(da, &vlocal);
+
+  VecScatterCreate(vglobal,ix,vlocal,iy, &gtol);  
+  VecScatterSetUp(gtol);
+
+  DMRestoreGlobalVector(da, &vglobal);
+  DMRestoreLocalVector(da, &vlocal);
+
+  ISDestroy(&ix);
+  ISDestroy(&iy);
+
+  /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    Map 3D global to local scatter context to local to local, by remapping
+    the owned entries of the global vector to their position in the local vector.
+  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  VecScatterCopy(gtol,&ltol);
+  VecScatterDestroy(&gtol);
+
+  PetscInt *idx;
+  PetscMalloc1(nx*ny*nz*dof,&idx);
+  count = 0;
+  for (k=i_zstart; k<i_zend; k++) {
+    for (j=i_ystart; j<i_yend; j++) {
+      for (i=i_xstart; i<i_xend; i++) {
+        for (l=0; l<dof; l++) {
+          idx[count++] = local_index(i,j,k,l);
+        }
+      }
     }
   }
   VecScatterRemap(ltol,idx,NULL);
+  PetscFree(idx);
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,516 @@
+#include "time_stepping/rhs_shell.h"
+#include "time_stepping/ts_monitor.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/**
+* Copies the owned points from src to dst. If to_local, src is a global and dst a local vector array, otherwise the
+* reverse.
+**/
+static void copy_owned(const RHSShellCtx& s, const PetscScalar *src, PetscScalar *dst, const bool to_local)
+{
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (PetscInt k = 0; k < s.n[2]; k++) {
+    for (PetscInt j = 0; j < s.n[1]; j++) {
+      // Local (ghosted) and global index of the first point of the row
+      const PetscInt p = ((k + s.start[2] - s.gstart[2])*s.gn[1] + j + s.start[1] - s.gstart[1])*s.gn[0] + s.start[0] - s.gstart[0];
+      const PetscInt q = (k*s.n[1] + j)*s.n[0];
+      for (PetscInt i = 0; i < s.n[0]; i++) {
+        for (PetscInt c = 0; c < s.dof; c++) {
+          const PetscInt l = s.soa ? c*s.gnp + p + i : (p + i)*s.dof + c;
+          const PetscInt g = (q + i)*s.dof + c;
+          if (to_local) dst[l] = src[g];
+          else dst[g] = src[l];
+        }
+      }
+    }
+  }
+}
+
+static PetscErrorCode to_local(const RHSShellCtx& s, Vec v_global, Vec v_local)
+{
+  PetscErrorCode    ierr;
+  const PetscScalar *src;
+  PetscScalar       *dst;
+
+  ierr = VecGetArrayRead(v_global,&src);CHKERRQ(ierr);
+  ierr = VecGetArray(v_local,&dst);CHKERRQ(ierr);
+  copy_owned(s,src,dst,true);
+  ierr = VecRestoreArray(v_local,&dst);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(v_global,&src);CHKERRQ(ierr);
+  return 0;
+}
+
+static PetscErrorCode to_global(const RHSShellCtx& s, Vec v_local, Vec v_global)
+{
+  PetscErrorCode    ierr;
+  const PetscScalar *src;
+  PetscScalar       *dst;
+
+  ierr = VecGetArrayRead(v_local,&src);CHKERRQ(ierr);
+  ierr = VecGetArrayWrite(v_global,&dst);CHKERRQ(ierr);
+  copy_owned(s,src,dst,false);
+  ierr = VecRestoreArrayWrite(v_global,&dst);CHKERRQ(ierr);
+  ierr = VecRestoreArrayRead(v_local,&src);CHKERRQ(ierr);
+  return 0;
+}
+
+/**
+* y = F(t,x) for global vectors x, y.
+**/
+static PetscErrorCode apply_rhs(RHSShellCtx& s, const PetscReal t, Vec x, Vec y)
+{
+  PetscErrorCode ierr;
+
+  ierr = to_local(s,x,s.x_local);CHKERRQ(ierr);
+  ierr = s.rhs(NULL,t,s.x_local,s.y_local,s.ctx);CHKERRQ(ierr);
+  ierr = to_global(s,s.y_local,y);CHKERRQ(ierr);
+  return 0;
+}
+
+/**
+* Computes the forcing g(t) = F(t,0) of an affine RHS, unless already computed at t. x is a global vector.
+**/
+static PetscErrorCode update_offset(RHSShellCtx& s, const PetscReal t, Vec x)
+{
+  PetscErrorCode ierr;
+
+  if (s.offset_t == t) return 0;
+  if (!s.offset) {
+    ierr = VecDuplicate(x,&s.offset);CHKERRQ(ierr);
+  }
+  ierr = VecZeroEntries(s.x_local);CHKERRQ(ierr);
+  ierr = s.rhs(NULL,t,s.x_local,s.y_local,s.ctx);CHKERRQ(ierr);
+  ierr = to_global(s,s.y_local,s.offset);CHKERRQ(ierr);
+  s.offset_t = t;
+  return 0;
+}
+
+static PetscErrorCode rhs_shell_mult(Mat A, Vec x, Vec y)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  if (s->affine) {
+    ierr = update_offset(*s,s->t,x);CHKERRQ(ierr);
+  }
+  ierr = apply_rhs(*s,s->t,x,y);CHKERRQ(ierr);
+  if (s->affine) {
+    ierr = VecAXPY(y,-1,s->offset);CHKERRQ(ierr);
+  }
+  return 0;
+}
+
+static PetscErrorCode rhs_shell_destroy(Mat A)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  ierr = VecDestroy(&s->x_local);CHKERRQ(ierr);
+  ierr = VecDestroy(&s->y_local);CHKERRQ(ierr);
+  ierr = VecDestroy(&s->offset);CHKERRQ(ierr);
+  ierr = MatDestroy(&s->J);CHKERRQ(ierr);
+  ierr = VecDestroy(&s->x_global);CHKERRQ(ierr);
+  ierr = VecDestroy(&s->y_global);CHKERRQ(ierr);
+  delete s;
+  return 0;
+}
+
+PetscErrorCode rhs_shell_create(const DM da, const PetscBool soa, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *),
+                                void* ctx, const PetscBool affine, Mat& A)
+{
+  PetscErrorCode ierr;
+  PetscInt       deep_halo = 0;
+  RHSShellCtx    *s;
+
+  // The deep halo RHS computes on ghost points, which the shell does not copy.
+  ierr = PetscOptionsGetInt(NULL,NULL,"-deep_halo",&deep_halo,NULL);CHKERRQ(ierr);
+  if (deep_halo > 0) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_INCOMP,"The MatShell operator can not be used with -deep_halo");
+
+  s = new RHSShellCtx;
+  s->da = da;
+  s->soa = soa;
+  s->rhs = rhs;
+  s->ctx = ctx;
+  s->affine = affine;
+  ierr = DMDAGetInfo(da,NULL,NULL,NULL,NULL,NULL,NULL,NULL,&s->dof,NULL,NULL,NULL,NULL,NULL);CHKERRQ(ierr);
+  ierr = DMDAGetCorners(da,&s->start[0],&s->start[1],&s->start[2],&s->n[0],&s->n[1],&s->n[2]);CHKERRQ(ierr);
+  ierr = DMDAGetGhostCorners(da,&s->gstart[0],&s->gstart[1],&s->gstart[2],&s->gn[0],&s->gn[1],&s->gn[2]);CHKERRQ(ierr);
+  s->gnp = s->gn[0]*s->gn[1]*s->gn[2];
+  ierr = DMCreateLocalVector(da,&s->x_local);CHKERRQ(ierr);
+  ierr = VecDuplicate(s->x_local,&s->y_local);CHKERRQ(ierr);
+
+  const PetscInt m = s->n[0]*s->n[1]*s->n[2]*s->dof;
+  ierr = MatCreateShell(PETSC_COMM_WORLD,m,m,PETSC_DETERMINE,PETSC_DETERMINE,s,&A);CHKERRQ(ierr);
+  ierr = MatShellSetOperation(A,MATOP_MULT,(void(*)(void))rhs_shell_mult);CHKERRQ(ierr);
+  ierr = MatShellSetOperation(A,MATOP_DESTROY,(void(*)(void))rhs_shell_destroy);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode rhs_shell_set_time(Mat A, const PetscReal t)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  s->t = t;
+  return 0;
+}
+
+PetscErrorCode rhs_shell_function(TS ts, PetscReal t, Vec x, Vec y, void* A)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext((Mat) A,&s);CHKERRQ(ierr);
+  ierr = apply_rhs(*s,t,x,y);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode rhs_shell_jacobian(TS ts, PetscReal t, Vec x, Mat A, Mat P, void* ctx)
+{
+  return rhs_shell_set_time(A,t);
+}
+
+PetscErrorCode rhs_shell_global_to_local(Mat A, Vec v_global, Vec v_local)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  ierr = to_local(*s,v_global,v_local);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode rhs_shell_local_to_global(Mat A, Vec v_local, Vec v_global)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  ierr = to_global(*s,v_local,v_global);CHKERRQ(ierr);
+  return 0;
+}
+
+/**
+* Returns the index in [max(i-w,0), min(i+w,N-1)] with i_c = color mod P, or -1 if there is none.
+**/
+static inline PetscInt colored_index(const PetscInt i, const PetscInt w, const PetscInt N, const PetscInt P, const PetscInt color)
+{
+  const PetscInt lo = PetscMax(i - w,0);
+  const PetscInt ic = lo + ((color - lo)%P + P)%P;
+  return ic <= PetscMin(i + w,N - 1) ? ic : -1;
+}
+
+PetscErrorCode rhs_shell_assemble(Mat A, const MatType type, const PetscInt width)
+{
+  PetscErrorCode         ierr;
+  RHSShellCtx            *s;
+  PetscInt               dim, N[3], P[3];
+  DMBoundaryType         bd[3];
+  ISLocalToGlobalMapping ltog;
+  Vec                    x, y;
+  PetscScalar            *x_arr;
+  const PetscScalar      *y_arr;
+  std::vector<PetscInt>  rows, cols;
+  std::vector<PetscScalar> vals;
+  PetscBool              too_wide = PETSC_FALSE;
+  PetscLogDouble         t0, t1;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  if (width <= 0) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_WRONG,"The assembled operator requires the coupling width of the stencils");
+  ierr = DMDAGetInfo(s->da,&dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,NULL,NULL,&bd[0],&bd[1],&bd[2],NULL);CHKERRQ(ierr);
+  for (PetscInt d = 0; d < 3; d++) {
+    if (bd[d] == DM_BOUNDARY_PERIODIC) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_SUP,"The assembled operator does not support periodic boundaries");
+    // Points of the same color are more than 2*width apart, so that each row couples to at most one of them.
+    P[d] = d < dim ? PetscMin(2*width + 1,N[d]) : 1;
+  }
+  const PetscInt ncolors = P[0]*P[1]*P[2]*s->dof;
+  PetscTime(&t0);
+
+  // Probe the linear part of the operator with each color, recording the nonzeros as local (ghosted) indices.
+  ierr = MatCreateVecs(A,&x,&y);CHKERRQ(ierr);
+  for (PetscInt color = 0; color < ncolors; color++) {
+    const PetscInt c = color%s->dof, q = color/s->dof;
+    const PetscInt color_p[3] = {q%P[0], (q/P[0])%P[1], q/(P[0]*P[1])};
+    ierr = VecGetArrayWrite(x,&x_arr);CHKERRQ(ierr);
+    for (PetscInt k = 0; k < s->n[2]; k++) {
+      for (PetscInt j = 0; j < s->n[1]; j++) {
+        for (PetscInt i = 0; i < s->n[0]; i++) {
+          const bool on = (s->start[0] + i)%P[0] == color_p[0] && (s->start[1] + j)%P[1] == color_p[1] && (s->start[2] + k)%P[2] == color_p[2];
+          for (PetscInt cc = 0; cc < s->dof; cc++) {
+            x_arr[((k*s->n[1] + j)*s->n[0] + i)*s->dof + cc] = (on && cc == c) ? 1 : 0;
+          }
+        }
+      }
+    }
+    ierr = VecRestoreArrayWrite(x,&x_arr);CHKERRQ(ierr);
+    ierr = MatMult(A,x,y);CHKERRQ(ierr);
+
+    ierr = VecGetArrayRead(y,&y_arr);CHKERRQ(ierr);
+    for (PetscInt k = 0; k < s->n[2]; k++) {
+      for (PetscInt j = 0; j < s->n[1]; j++) {
+        for (PetscInt i = 0; i < s->n[0]; i++) {
+          const PetscInt row[3] = {s->start[0] + i, s->start[1] + j, s->start[2] + k};
+          PetscInt col[3];
+          bool found = true;
+          for (PetscInt d = 0; d < 3; d++) {
+            col[d] = colored_index(row[d],d < dim ? width : 0,N[d],P[d],color_p[d]);
+            found = found && col[d] >= s->gstart[d] && col[d] < s->gstart[d] + s->gn[d];
+          }
+          for (PetscInt r = 0; r < s->dof; r++) {
+            const PetscScalar val = y_arr[((k*s->n[1] + j)*s->n[0] + i)*s->dof + r];
+            if (val == 0) continue;
+            if (!found) {
+              too_wide = PETSC_TRUE;
+              continue;
+            }
+            rows.push_back((((row[2] - s->gstart[2])*s->gn[1] + row[1] - s->gstart[1])*s->gn[0] + row[0] - s->gstart[0])*s->dof + r);
+            cols.push_back((((col[2] - s->gstart[2])*s->gn[1] + col[1] - s->gstart[1])*s->gn[0] + col[0] - s->gstart[0])*s->dof + c);
+            vals.push_back(val);
+          }
+        }
+      }
+    }
+    ierr = VecRestoreArrayRead(y,&y_arr);CHKERRQ(ierr);
+  }
+  ierr = VecDestroy(&x);CHKERRQ(ierr);
+  ierr = VecDestroy(&y);CHKERRQ(ierr);
+  PetscMPIInt wide = too_wide, any_wide;
+  MPI_Allreduce(&wide,&any_wide,1,MPI_INT,MPI_LOR,PETSC_COMM_WORLD);
+  if (any_wide) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"The operator couples points further apart than the coupling width or the ghost region");
+
+  // Exact preallocation, counting the (block) columns owned by this process and by others per (block) row
+  const PetscInt bs = std::string(type) == MATBAIJ ? s->dof : 1;
+  const PetscInt m = s->n[0]*s->n[1]*s->n[2]*s->dof;
+  const auto owned = [&](const PetscInt l) {
+    const PetscInt p = l/s->dof;
+    const PetscInt i = p%s->gn[0] + s->gstart[0], j = (p/s->gn[0])%s->gn[1] + s->gstart[1], k = p/(s->gn[0]*s->gn[1]) + s->gstart[2];
+    return i >= s->start[0] && i < s->start[0] + s->n[0] && j >= s->start[1] && j < s->start[1] + s->n[1]
+           && k >= s->start[2] && k < s->start[2] + s->n[2];
+  };
+  const auto local_row = [&](const PetscInt l) {
+    const PetscInt p = l/s->dof;
+    const PetscInt i = p%s->gn[0] + s->gstart[0] - s->start[0], j = (p/s->gn[0])%s->gn[1] + s->gstart[1] - s->start[1];
+    const PetscInt k = p/(s->gn[0]*s->gn[1]) + s->gstart[2] - s->start[2];
+    return ((k*s->n[1] + j)*s->n[0] + i)*s->dof + l%s->dof;
+  };
+  std::vector<std::pair<PetscInt,PetscInt>> blocks(rows.size());
+  for (size_t e = 0; e < rows.size(); e++) blocks[e] = {local_row(rows[e])/bs, cols[e]/bs};
+  std::sort(blocks.begin(),blocks.end());
+  blocks.erase(std::unique(blocks.begin(),blocks.end()),blocks.end());
+  std::vector<PetscInt> dnnz(m/bs,0), onnz(m/bs,0);
+  for (const auto& b : blocks) {
+    if (owned(b.second*bs)) dnnz[b.first]++;
+    else onnz[b.first]++;
+  }
+
+  ierr = MatCreate(PETSC_COMM_WORLD,&s->J);CHKERRQ(ierr);
+  ierr = MatSetSizes(s->J,m,m,PETSC_DETERMINE,PETSC_DETERMINE);CHKERRQ(ierr);
+  ierr = MatSetType(s->J,type);CHKERRQ(ierr);
+  ierr = MatSetBlockSize(s->J,bs);CHKERRQ(ierr);
+  ierr = MatXAIJSetPreallocation(s->J,bs,dnnz.data(),onnz.data(),NULL,NULL);CHKERRQ(ierr);
+  ierr = DMGetLocalToGlobalMapping(s->da,&ltog);CHKERRQ(ierr);
+  ierr = ISLocalToGlobalMappingApply(ltog,rows.size(),rows.data(),rows.data());CHKERRQ(ierr);
+  ierr = ISLocalToGlobalMappingApply(ltog,cols.size(),cols.data(),cols.data());CHKERRQ(ierr);
+  for (size_t e = 0; e < rows.size(); e++) {
+    ierr = MatSetValues(s->J,1,&rows[e],1,&cols[e],&vals[e],INSERT_VALUES);CHKERRQ(ierr);
+  }
+  ierr = MatAssemblyBegin(s->J,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+  ierr = MatAssemblyEnd(s->J,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+  ierr = MatCreateVecs(s->J,&s->x_global,&s->y_global);CHKERRQ(ierr);
+  PetscTime(&t1);
+
+  MatInfo info;
+  ierr = MatGetInfo(s->J,MAT_GLOBAL_SUM,&info);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"Assembled the operator as %s with %.0f nonzeros from %d colors in %.3e s\n",type,info.nz_used,ncolors,t1 - t0);
+  return 0;
+}
+
+PetscErrorCode rhs_shell_assembled(TS ts, PetscReal t, Vec v_src, Vec v_dst, void* A)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+
+  ierr = MatShellGetContext((Mat) A,&s);CHKERRQ(ierr);
+  ierr = to_global(*s,v_src,s->x_global);CHKERRQ(ierr);
+  ierr = MatMult(s->J,s->x_global,s->y_global);CHKERRQ(ierr);
+  if (s->affine) {
+    ierr = update_offset(*s,t,s->x_global);CHKERRQ(ierr);
+    ierr = VecAXPY(s->y_global,1,s->offset);CHKERRQ(ierr);
+  }
+  ierr = to_local(*s,s->y_global,v_dst);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode rhs_shell_spectral_radius(Mat A, const PetscInt iters, PetscReal& rho)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+  Vec            x, y;
+  PetscReal      norm;
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  Mat op = s->J ? s->J : A;
+  ierr = MatCreateVecs(op,&x,&y);CHKERRQ(ierr);
+  ierr = VecSetRandom(x,NULL);CHKERRQ(ierr);
+  ierr = VecNormalize(x,NULL);CHKERRQ(ierr);
+  rho = 0;
+  for (PetscInt it = 0; it < iters; it++) {
+    ierr = MatMult(op,x,y);CHKERRQ(ierr);
+    ierr = VecNorm(y,NORM_2,&norm);CHKERRQ(ierr);
+    rho = norm;
+    if (norm == 0) break;
+    ierr = VecAXPBY(x,1/norm,0,y);CHKERRQ(ierr);
+  }
+  ierr = VecDestroy(&x);CHKERRQ(ierr);
+  ierr = VecDestroy(&y);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode rhs_shell_bench(Mat A, Vec v_local, const PetscInt reps)
+{
+  PetscErrorCode ierr;
+  RHSShellCtx    *s;
+  Vec            y_local, x, y;
+  PetscLogDouble t0, t1, local[4], global[4];
+
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  ierr = VecDuplicate(v_local,&y_local);CHKERRQ(ierr);
+  ierr = MatCreateVecs(A,&x,&y);CHKERRQ(ierr);
+  ierr = to_global(*s,v_local,x);CHKERRQ(ierr);
+
+  // One warm-up call each, then the time per call
+  ierr = s->rhs(NULL,s->t,v_local,y_local,s->ctx);CHKERRQ(ierr);
+  ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  PetscTime(&t0);
+  for (PetscInt r = 0; r < reps; r++) {
+    ierr = s->rhs(NULL,s->t,v_local,y_local,s->ctx);CHKERRQ(ierr);
+  }
+  PetscTime(&t1);
+  local[0] = (t1 - t0)/reps;
+  ierr = MatMult(A,x,y);CHKERRQ(ierr);
+  ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRQ(ierr);
+  PetscTime(&t0);
+  for (PetscInt r = 0; r < reps; r++) {
+    ierr = MatMult(A,x,y);CHKERRQ(ierr);
+  }
+  PetscTime(&t1);
+  local[1] = (t1 - t0)/reps;
+  local[2] = 0;
+  if (s->J) {
+    ierr = MatMult(s->J,x,y);CHKERRQ(ierr);
+    ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRQ(ierr);
+    PetscTime(&t0);
+    for (PetscInt r = 0; r < reps; r++) {
+      ierr = MatMult(s->J,x,y);CHKERRQ(ierr);
+    }
+    PetscTime(&t1);
+    local[2] = (t1 - t0)/reps;
+  }
+  // The forcing g(t) = F(t,0) of an affine shell is recomputed at each new stage time, which the timings above
+  // do not include.
+  local[3] = 0;
+  if (s->affine) {
+    ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRQ(ierr);
+    PetscTime(&t0);
+    for (PetscInt r = 0; r < reps; r++) {
+      s->offset_t = PETSC_MAX_REAL;
+      ierr = update_offset(*s,s->t,x);CHKERRQ(ierr);
+    }
+    PetscTime(&t1);
+    local[3] = (t1 - t0)/reps;
+  }
+  MPI_Allreduce(local,global,4,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);
+  PetscPrintf(PETSC_COMM_WORLD,"MatShell benchmark (%d reps%s): raw rhs %.3e s, MatShell apply %.3e s per call, overhead %.1f%%\n",
+              reps,s->affine ? ", affine" : "",global[0],global[1],100*(global[1] - global[0])/global[0]);
+  if (s->J) {
+    MatInfo info;
+    MatType type;
+    ierr = MatGetInfo(s->J,MAT_GLOBAL_SUM,&info);CHKERRQ(ierr);
+    ierr = MatGetType(s->J,&type);CHKERRQ(ierr);
+    PetscPrintf(PETSC_COMM_WORLD,"Assembled %s SpMV %.3e s per call (%.2f GFlop/s), %.2f times the raw rhs\n",
+                type,global[2],2*info.nz_used/global[2]*1e-9,global[2]/global[0]);
+  }
+  if (s->affine) {
+    PetscPrintf(PETSC_COMM_WORLD,"Affine offset F(t,0) %.3e s per new stage time (3 per RK4 step), %.2f times the raw rhs. "
+                "Use -matshell_affine 0 if the RHS has no forcing.\n",global[3],global[3]/global[0]);
+  }
+  if (s->J) {
+    PetscPrintf(PETSC_COMM_WORLD,"Per RK4 step: assembled %.3e s, matrix-free %.3e s\n",4*global[2] + 3*global[3],4*global[0]);
+  }
+
+  ierr = VecDestroy(&y_local);CHKERRQ(ierr);
+  ierr = VecDestroy(&x);CHKERRQ(ierr);
+  ierr = VecDestroy(&y);CHKERRQ(ierr);
+  return 0;
+}
+
+struct MonitorCtx {
+  Mat A;
+  Vec v_local;
+};
+
+/**
+* TS monitor calling the step monitors with the solution in the local layout.
+**/
+static PetscErrorCode monitor_local(TS ts, PetscInt step, PetscReal t, Vec v, void* ptr)
+{
+  PetscErrorCode ierr;
+  MonitorCtx     *mon = (MonitorCtx*) ptr;
+
+  ierr = rhs_shell_global_to_local(mon->A,v,mon->v_local);CHKERRQ(ierr);
+  ierr = ts_monitor_call(step,t,mon->v_local);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode ts_matshell(const PetscScalar t_end, const PetscScalar dt, Vec v, Mat A, const PetscReal t_start,
+                           const PetscInt step_start)
+{
+  PetscErrorCode ierr;
+  TS             ts;
+  SNES           snes;
+  KSP            ksp;
+  PC             pc;
+  Vec            x;
+  RHSShellCtx    *s;
+  MonitorCtx     mon = {A, v};
+
+  ierr = MatCreateVecs(A,&x,NULL);CHKERRQ(ierr);
+  ierr = rhs_shell_local_to_global(A,v,x);CHKERRQ(ierr);
+
+  ierr = TSCreate(PETSC_COMM_WORLD,&ts);CHKERRQ(ierr);
+  ierr = TSSetProblemType(ts,TS_LINEAR);CHKERRQ(ierr);
+  ierr = TSSetRHSFunction(ts,NULL,rhs_shell_function,A);CHKERRQ(ierr);
+  ierr = MatShellGetContext(A,&s);CHKERRQ(ierr);
+  ierr = TSSetRHSJacobian(ts,A,s->J ? s->J : A,rhs_shell_jacobian,NULL);CHKERRQ(ierr);
+  // The implicit integrators shift and scale A in place. Let TS undo it, since rhs_shell_jacobian only sets the time.
+  ierr = TSRHSJacobianSetReuse(ts,PETSC_TRUE);CHKERRQ(ierr);
+  ierr = TSSetType(ts,TSCN);CHKERRQ(ierr);
+  ierr = TSGetSNES(ts,&snes);CHKERRQ(ierr);
+  ierr = SNESGetKSP(snes,&ksp);CHKERRQ(ierr);
+  ierr = KSPSetType(ksp,KSPGMRES);CHKERRQ(ierr);
+  if (!s->J) {
+    // The shell has no entries to precondition with
+    ierr = KSPGetPC(ksp,&pc);CHKERRQ(ierr);
+    ierr = PCSetType(pc,PCNONE);CHKERRQ(ierr);
+  }
+  ierr = TSSetExactFinalTime(ts,TS_EXACTFINALTIME_MATCHSTEP);CHKERRQ(ierr);
+  ierr = TSSetTime(ts,t_start);CHKERRQ(ierr);
+  ierr = TSSetTimeStep(ts,dt);CHKERRQ(ierr);
+  ierr = TSSetMaxTime(ts,t_end);CHKERRQ(ierr);
+  ierr = TSSetStepNumber(ts,step_start);CHKERRQ(ierr);
+  ierr = TSMonitorSet(ts,monitor_local,&mon,NULL);CHKERRQ(ierr);
+  ierr = TSSetFromOptions(ts);CHKERRQ(ierr);
+
+  ierr = TSSetSolution(ts,x);CHKERRQ(ierr);
+  ierr = TSSolve(ts,x);CHKERRQ(ierr);
+  ierr = rhs_shell_global_to_local(A,x,v);CHKERRQ(ierr);
+
+  ierr = TSDestroy(&ts);CHKERRQ(ierr);
+  ierr = VecDestroy(&x);CHKERRQ(ierr);
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include "time_stepping/ts_lsrk.h"
+#include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_monitor.h"
+#include "util/logging.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+/**
+* Coefficients of a low-storage Runge-Kutta scheme on 2N form.
+**/
+struct LSRKCoeffs {
+  const char* name;
+  std::vector<PetscScalar> A, B, C;
+};
+
+static LSRKCoeffs get_coeffs(const LSRKType type)
+{
+  switch (type) {
+    case LSRK_WILLIAMSON3:
+      return {"williamson3",
+              {0., -5./9., -153./128.},
+              {1./3., 15./16., 8./15.},
+              {0., 1./3., 3./4.}};
+    case LSRK_CK45:
+    default:
+      return {"ck45",
+              {0.,
+               -567301805773./1357537059087.,
+               -2404267990393./2016746695238.,
+               -3550918686646./2091501179385.,
+               -1275806237668./842570457699.},
+              {1432997174477./9575080441755.,
+               5161836677717./13612068292357.,
+               1720146321549./2090206949498.,
+               3134564353537./4481467310338.,
+               2277821191437./14882151754819.},
+              {0.,
+               1432997174477./9575080441755.,
+               2526269341429./6820363962896.,
+               2006345519317./3224310063776.,
+               2802321613138./2924317926251.}};
+  }
+}
+
+/**
+* Computes dq = a*dq + dt*f and v = v + b*dq in a single sweep over the local arrays.
+* Ghost entries are updated as well, they are overwritten by the next halo exchange (or, with a deep halo, recomputed
+* by the RHS while they are valid).
+**/
+static PetscErrorCode lsrk_stage_update(Vec v, Vec dq, const Vec f, const PetscScalar a, const PetscScalar b, const PetscScalar dt)
+{
+  PetscErrorCode     ierr;
+  PetscInt           n;
+  PetscScalar        *v_arr, *dq_arr;
+  const PetscScalar  *f_arr;
+
+  ierr = logging::begin(logging::TS_UPDATE);CHKERRQ(ierr);
+  ierr = VecGetLocalSize(v,&n);CHKERRQ(ierr);
+  ierr = VecGetArrayRead(f,&f_arr);CHKERRQ(ierr);
+  ierr = VecGetArray(dq,&dq_arr);CHKERRQ(ierr);
+  ierr = VecGetArray(v,&v_arr);CHKERRQ(ierr);
+
+  if (a == 0) { // First stage, dq holds data from the previous step
+    #pragma omp parallel for simd schedule(static)
+    for (PetscInt i = 0; i < n; i++) {
+      dq_arr[i] = dt*f_arr[i];
+      v_arr[i] += b*dq_arr[i];
+    }
+  } else {
+    #pragma omp parallel for simd schedule(static)
+    for (PetscInt i = 0; i < n; i++) {
+      dq_arr[i] = a*dq_arr[i] + dt*f_arr[i];
+      v_arr[i] += b*dq_arr[i];
+    }
+  }
+
+  ierr = VecRestoreArrayRead(f,&f_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArray(dq,&dq_arr);CHKERRQ(ierr);
+  ierr = VecRestoreArray(v,&v_arr);CHKERRQ(ierr);
+  ierr = logging::flops((a == 0 ? 3 : 5)*n);CHKERRQ(ierr);
+  ierr = logging::end(logging::TS_UPDATE);CHKERRQ(ierr);
+  return 0;
+}
+
+/**
+* Time stepping loop shared by the ts_lsrk overloads. eval_rhs(t, v_src, v_dst) evaluates the RHS.
+**/
+template <typename RhsEval>
+static PetscErrorCode lsrk_solve(const DM da, const PetscScalar t_end, PetscScalar dt, Vec v, const LSRKType type, const PetscReal t_start,
+                                 const PetscInt step_start, const PetscBool soa, RhsEval&& eval_rhs)
+{
+  PetscErrorCode ierr;
+  Vec f, dq;
+  PetscScalar t = t_start;
+  const LSRKCoeffs coeffs = get_coeffs(type);
+  const PetscInt n_stages = coeffs.A.size();
+
+  const PetscInt tlen = std::round(t_end/dt);
+  if (std::abs(tlen*dt - t_end) > 1e-14) {
+    PetscPrintf(PETSC_COMM_WORLD,"Warning: Non-matching time step. dt*tlen = %.12f.\nChanging timestep from %e to %e.\n",dt*tlen,dt,t_end/tlen);
+    dt = t_end/tlen;
+  }
+  const std::string scheme = std::string("Low-storage RK (") + coeffs.name + ")";
+  ierr = ts_report_work_vectors(scheme.c_str(), n_stages, 2, v);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"tlen: %d, dt: %e\n",tlen,dt);
+
+  ierr = VecDuplicate(v,&f);CHKERRQ(ierr);
+  ierr = VecDuplicate(v,&dq);CHKERRQ(ierr);
+  Vec work[2] = {f, dq};
+  ierr = ts_first_touch_work_vectors(da, soa, 2, work);CHKERRQ(ierr);
+
+  ierr = ts_monitor_call(step_start, t, v);CHKERRQ(ierr);
+  for (PetscInt tidx = step_start; tidx < tlen; tidx++) {
+    for (PetscInt s = 0; s < n_stages; s++) {
+      ierr = eval_rhs(t + coeffs.C[s]*dt, v, f);CHKERRQ(ierr);
+      ierr = lsrk_stage_update(v, dq, f, coeffs.A[s], coeffs.B[s], dt);CHKERRQ(ierr);
+    }
+    t = t + dt;
+    ierr = ts_monitor_call(tidx + 1, t, v);CHKERRQ(ierr);
+  }
+
+  ierr = VecDestroy(&f);CHKERRQ(ierr);
+  ierr = VecDestroy(&dq);CHKERRQ(ierr);
+  return 0;
+}
+
+PetscErrorCode ts_lsrk(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, const LSRKType type, PetscErrorCode (*rhs)(DM, PetscReal, Vec, Vec, void *), void* ctx,
+                       const PetscReal t_start, const PetscInt step_start, const PetscBool soa)
+{
+  return lsrk_solve(da, t_end, dt, v, type, t_start, step_start, soa, [&](const PetscReal t, Vec v_src, Vec v_dst) {
+    return rhs(da, t, v_src, v_dst, ctx);
+  });
+}
+
+PetscErrorCode ts_lsrk(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, const LSRKType type, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                       const PetscReal t_start, const PetscInt step_start, const PetscBool soa)
+{
+  return lsrk_solve(da, t_end, dt, v, type, t_start, step_start, soa, [&](const PetscReal t, Vec v_src, Vec v_dst) {
+    return rhs(NULL, t, v_src, v_dst, ctx);
+  });
+}
+
+/**
+* Reads the runtime option -lsrk. Returns true if it is set, in which case type holds the selected scheme.
+**/
+static PetscBool lsrk_from_options(LSRKType& type)
+{
+  PetscInt  selected = LSRK_CK45;
+  PetscBool use_lsrk = PETSC_FALSE;
+  const char *const types[] = {"williamson3","ck45"};
+  PetscOptionsGetEList(NULL,NULL,"-lsrk",types,2,&selected,&use_lsrk);
+  type = static_cast<LSRKType>(selected);
+  return use_lsrk;
+}
+
+PetscInt ts_stages_from_options()
+{
+  LSRKType type;
+  if (lsrk_from_options(type)) {
+    return get_coeffs(type).A.size();
+  } else {
+    return 4; // RK4
+  }
+}
+
+PetscErrorCode ts_rk_from_options(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                                  const PetscReal t_start, const PetscInt step_start, const PetscBool soa, const PetscInt coupling,
+                                  PetscBool affine)
+{
+  PetscErrorCode ierr;
+  LSRKType type;
+  PetscBool use_matshell = PETSC_FALSE;
+  PetscInt bench_reps = 0, eig_iters = 0, op = 0;
+  const char *const operators[] = {"matfree","aij","baij"};
+  Mat A = NULL;
+  PetscLogDouble t0, t1;
+  ierr = PetscOptionsGetBool(NULL,NULL,"-use_matshell",&use_matshell,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetBool(NULL,NULL,"-matshell_affine",&affine,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetInt(NULL,NULL,"-matshell_bench",&bench_reps,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetEList(NULL,NULL,"-operator",operators,3,&op,NULL);CHKERRQ(ierr);
+  ierr = PetscOptionsGetInt(NULL,NULL,"-operator_spectral_radius",&eig_iters,NULL);CHKERRQ(ierr);
+  if (use_matshell || bench_reps > 0 || op > 0 || eig_iters > 0) {
+    ierr = rhs_shell_create(da, soa, rhs, ctx, affine, A);CHKERRQ(ierr);
+    ierr = rhs_shell_set_time(A, t_start);CHKERRQ(ierr);
+  }
+  if (op > 0) {
+    ierr = rhs_shell_assemble(A, op == 1 ? MATAIJ : MATBAIJ, coupling);CHKERRQ(ierr);
+    // Time step the assembled operator in place of rhs
+    rhs = rhs_shell_assembled;
+    ctx = A;
+  }
+  if (eig_iters > 0) {
+    PetscReal rho;
+    ierr = rhs_shell_spectral_radius(A, eig_iters, rho);CHKERRQ(ierr);
+    PetscPrintf(PETSC_COMM_WORLD,"Spectral radius estimate of the operator: %g, dt*rho = %g\n",rho,dt*rho);
+  }
+  if (bench_reps > 0) {
+    ierr = rhs_shell_bench(A, v, bench_reps);CHKERRQ(ierr);
+  }
+  // Separate the time stepping from the setup and post-processing in -log_view
+  ierr = logging::push_time_stepping_stage();CHKERRQ(ierr);
+  ierr = PetscTime(&t0);CHKERRQ(ierr);
+  if (use_matshell) {
+    ierr = ts_matshell(t_end, dt, v, A, t_start, step_start);CHKERRQ(ierr);
+  } else if (lsrk_from_options(type)) {
+    ierr = ts_lsrk(da, t_end, dt, v, type, rhs, ctx, t_start, step_start, soa);CHKERRQ(ierr);
+  } else {
+    ierr = ts_rk4(da, t_end, dt, v, rhs, ctx, t_start, step_start, soa);CHKERRQ(ierr);
+  }
+  ierr = PetscTime(&t1);CHKERRQ(ierr);
+  ierr = logging::pop_stage();CHKERRQ(ierr);
+  t1 -= t0;
+  ierr = MPI_Allreduce(MPI_IN_PLACE,&t1,1,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"Time stepping wall time: %f s\n",t1);
+  ierr = MatDestroy(&A);CHKERRQ(ierr);
+  return 0;
+}
@@ -0,0 +1,32 @@
+#include "time_stepping/ts_monitor.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+static std::vector<std::pair<TSStepMonitor,void*>> monitors;
+
+PetscErrorCode ts_monitor_add(TSStepMonitor monitor, void* ctx)
+{
+  monitors.push_back({monitor,ctx});
+  return 0;
+}
+
+PetscErrorCode ts_monitor_remove(TSStepMonitor monitor, void* ctx)
+{
+  monitors.erase(std::remove(monitors.begin(),monitors.end(),std::make_pair(monitor,ctx)),monitors.end());
+  return 0;
+}
+
+PetscErrorCode ts_monitor_call(const PetscInt step, const PetscReal t, Vec v)
+{
+  PetscErrorCode ierr;
+  for (const auto& m : monitors) {
+    ierr = m.first(step,t,v,m.second);CHKERRQ(ierr);
+  }
+  return 0;
+}
+
+PetscErrorCode ts_monitor_petsc(TS ts, PetscInt step, PetscReal t, Vec v, void* ctx)
+{
+  return ts_monitor_call(step,t,v);
+}
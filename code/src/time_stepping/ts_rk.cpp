@@ -1,4 +1,5 @@
 #include "time_stepping/ts_rk.h"
+#include "time_stepping/ts_monitor.h"
 #include <array>
 
 /**
@@ -33,16 +34,21 @@ PetscErrorCode ts_rk_setup(TS& ts, const TSRKType rk_type, const TSAdaptType ada
   TSSetTimeStep(ts,dt);
   TSSetMaxTime(ts,t_span[1]);
 
+  // Step monitors, see ts_monitor.h
+  TSMonitorSet(ts,ts_monitor_petsc,NULL,NULL);
+
   // Set all options
   TSSetFromOptions(ts);
   return 0;
 };
 
-PetscErrorCode ts_rk45(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx)
+PetscErrorCode ts_rk45(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                      const PetscReal t_start, const PetscInt step_start)
 {
   TS             ts;
   // Setup context
-  ts_rk_setup(ts, TSRK5F, TSADAPTBASIC, da, {0,t_end}, dt, rhs, ctx);
+  ts_rk_setup(ts, TSRK5F, TSADAPTBASIC, da, {t_start,t_end}, dt, rhs, ctx);
+  TSSetStepNumber(ts, step_start);
   // Set initial condition and solve
   TSSetSolution(ts, v);
   TSSolve(ts,v);
@@ -51,15 +57,47 @@ PetscErrorCode ts_rk45(const DM da, const PetscScalar t_end, const PetscScalar d
   return 0;
 }
 
-PetscErrorCode ts_rk4(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx)
+PetscErrorCode ts_rk4(const DM da, const PetscScalar t_end, const PetscScalar dt, Vec v, PetscErrorCode (*rhs)(TS, PetscReal, Vec, Vec, void *), void* ctx,
+                      const PetscReal t_start, const PetscInt step_start, const PetscBool soa)
 {
   TS             ts;
+  PetscInt       n_stages;
+  Vec            *Y;
   // Setup context
-  ts_rk_setup(ts, TSRK4, TSADAPTNONE, da, {0,t_end}, dt, rhs, ctx);
+  ts_rk_setup(ts, TSRK4, TSADAPTNONE, da, {t_start,t_end}, dt, rhs, ctx);
+  TSSetStepNumber(ts, step_start);
   // Set initial condition and solve
   TSSetSolution(ts, v);
+  TSSetUp(ts);
+  // TSRK holds the stage values Y and the stage RHS evaluations YdotRHS
+  TSGetStages(ts, &n_stages, &Y);
+  ts_first_touch_work_vectors(da, soa, n_stages, Y);
+  ts_report_work_vectors("RK4 (PETSc TS)", n_stages, 2*n_stages, v);
   TSSolve(ts,v);
 
   TSDestroy(&ts);
   return 0;
-}
\ No newline at end of file
+}
+
+PetscErrorCode ts_report_work_vectors(const char *scheme, const PetscInt n_stages, const PetscInt n_work, const Vec v)
+{
+  PetscErrorCode ierr;
+  PetscInt       n, n_max;
+  ierr = VecGetLocalSize(v,&n);CHKERRQ(ierr);
+  ierr = MPI_Allreduce(&n,&n_max,1,MPIU_INT,MPI_MAX,PETSC_COMM_WORLD);CHKERRQ(ierr);
+  PetscPrintf(PETSC_COMM_WORLD,"%s, %d stages, %d work vectors (%.1f MB on the largest rank)\n",scheme,n_stages,n_work,
+              1e-6*n_work*n_max*sizeof(PetscScalar));
+  return 0;
+}
+
+PetscErrorCode ts_first_touch_work_vectors(const DM da, const PetscBool soa, const PetscInt n, Vec *w)
+{
+  PetscErrorCode ierr;
+  PetscInt       dofs;
+  if (threads::num_threads() == 1) return 0;
+  ierr = DMDAGetInfo(da,NULL,NULL,NULL,NULL,NULL,NULL,NULL,&dofs,NULL,NULL,NULL,NULL,NULL);CHKERRQ(ierr);
+  for (PetscInt i = 0; i < n; i++) {
+    ierr = threads::first_touch(w[i], soa ? dofs : 1);CHKERRQ(ierr);
+  }
+  return 0;
+}
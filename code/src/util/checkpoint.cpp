@@ -0,0 +1,202 @@
+#include <petsc.h>
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
+#include "util/checkpoint.h"
+#include "util/mpiio.h"
+#include "grids/create_layout.h"
+#include "time_stepping/ts_monitor.h"
+
+namespace checkpoint
+{
+  struct Info {
+    PetscInt slot, step;
+    PetscReal t;
+  };
+
+  static std::string slot_file(const PetscInt slot)
+  {
+    return "slot" + std::to_string(slot) + ".sbp";
+  }
+
+  /**
+  * Reads checkpoint.info on rank 0 and broadcasts it. Returns -1 on all ranks if there is no checkpoint.
+  **/
+  static PetscErrorCode read_info(const std::string folder, Info& info)
+  {
+    PetscMPIInt rank;
+    PetscInt    found = 0;
+    double      buf[3];
+
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    if (rank == 0) {
+      FILE *f = std::fopen((folder+"/checkpoint.info").c_str(),"r");
+      int slot = 0, step = 0;
+      double t = 0;
+      if (f) {
+        found = std::fscanf(f,"slot %d\nstep %d\nt %lf\n",&slot,&step,&t) == 3;
+        std::fclose(f);
+      }
+      buf[0] = slot;
+      buf[1] = step;
+      buf[2] = t;
+    }
+    MPI_Bcast(&found,1,MPIU_INT,0,PETSC_COMM_WORLD);
+    if (!found) return -1;
+    MPI_Bcast(buf,3,MPI_DOUBLE,0,PETSC_COMM_WORLD);
+    info.slot = buf[0];
+    info.step = buf[1];
+    info.t = buf[2];
+    return 0;
+  }
+
+  /**
+  * Replaces checkpoint.info on rank 0 by writing a temporary file, flushing it and renaming it.
+  **/
+  static PetscErrorCode write_info(const std::string folder, const Info& info)
+  {
+    PetscMPIInt       rank;
+    PetscInt          ok = 1;
+    const std::string tmp = folder+"/checkpoint.info.tmp";
+
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    if (rank == 0) {
+      FILE *f = std::fopen(tmp.c_str(),"w");
+      ok = f != NULL;
+      if (f) {
+        std::fprintf(f,"slot %d\nstep %d\nt %.17g\n",(int)info.slot,(int)info.step,info.t);
+        ok = std::fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = std::fclose(f) == 0 && ok;
+        ok = ok && std::rename(tmp.c_str(),(folder+"/checkpoint.info").c_str()) == 0;
+      }
+    }
+    MPI_Bcast(&ok,1,MPIU_INT,0,PETSC_COMM_WORLD);
+    if (!ok) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_WRITE,"Could not write checkpoint.info");
+    return 0;
+  }
+
+  /**
+  * Writes the local vector v to the next slot and commits it once all ranks have written and synced their blocks.
+  **/
+  static PetscErrorCode write(CheckpointCtx& ctx, const PetscInt step, const PetscReal t, const Vec v)
+  {
+    PetscErrorCode ierr;
+    PetscLogDouble t0, t1;
+    Vec            vlocal = v;
+
+    PetscTime(&t0);
+    if (ctx.soa) {
+      ierr = grid::local_soa_to_aos(ctx.da,v,ctx.local_aos);CHKERRQ(ierr);
+      vlocal = ctx.local_aos;
+    }
+    ierr = DMLocalToGlobalBegin(ctx.da,vlocal,INSERT_VALUES,ctx.global);CHKERRQ(ierr);
+    ierr = DMLocalToGlobalEnd(ctx.da,vlocal,INSERT_VALUES,ctx.global);CHKERRQ(ierr);
+    // mpiio::write reduces the success of the write and sync of every rank (MPI_LAND) and returns an error on all ranks
+    // if any failed, so checkpoint.info only ever points to a slot that is complete on disk.
+    ierr = mpiio::write(ctx.da,ctx.global,ctx.folder,slot_file(ctx.slot),{t,0},PETSC_TRUE);CHKERRQ(ierr);
+    ierr = write_info(ctx.folder,{ctx.slot,step,t});CHKERRQ(ierr);
+    PetscTime(&t1);
+
+    ctx.slot = 1 - ctx.slot;
+    ctx.last_step = step;
+    ctx.last_time = t1;
+    ctx.write_time += t1 - t0;
+    ctx.count++;
+    return 0;
+  }
+
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, Vec v, CheckpointCtx& ctx)
+  {
+    PetscErrorCode ierr;
+    PetscBool      restart = PETSC_FALSE;
+
+    ctx.da = da;
+    ctx.soa = soa;
+    ctx.folder = folder + "/checkpoints";
+    ierr = PetscOptionsGetInt(NULL,NULL,"-checkpoint_interval",&ctx.interval,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetReal(NULL,NULL,"-checkpoint_walltime",&ctx.walltime,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetBool(NULL,NULL,"-restart",&restart,NULL);CHKERRQ(ierr);
+    ctx.interval = PetscMax(ctx.interval,0);
+    ctx.walltime = PetscMax(ctx.walltime,0);
+    if (!ctx.interval && !ctx.walltime && !restart) return 0;
+
+    ierr = DMCreateGlobalVector(da,&ctx.global);CHKERRQ(ierr);
+    if (soa) {
+      ierr = DMCreateLocalVector(da,&ctx.local_aos);CHKERRQ(ierr);
+    }
+
+    if (restart) {
+      Info           info;
+      mpiio::Metadata meta;
+      if (read_info(ctx.folder,info)) {
+        SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_OPEN,"-restart: no checkpoint found");
+      }
+      ierr = mpiio::read(da,ctx.global,ctx.folder,slot_file(info.slot),meta);CHKERRQ(ierr);
+      Vec vlocal = soa ? ctx.local_aos : v;
+      ierr = DMGlobalToLocalBegin(da,ctx.global,INSERT_VALUES,vlocal);CHKERRQ(ierr);
+      ierr = DMGlobalToLocalEnd(da,ctx.global,INSERT_VALUES,vlocal);CHKERRQ(ierr);
+      if (soa) {
+        ierr = grid::local_aos_to_soa(da,ctx.local_aos,v);CHKERRQ(ierr);
+      }
+      ctx.t_start = info.t;
+      ctx.step_start = info.step;
+      ctx.slot = 1 - info.slot;
+      PetscPrintf(PETSC_COMM_WORLD,"Restarting from %s/%s at step %d, t = %f\n",ctx.folder.c_str(),
+                  slot_file(info.slot).c_str(),ctx.step_start,ctx.t_start);
+    }
+
+    if (ctx.interval || ctx.walltime) {
+      std::filesystem::create_directories(ctx.folder);
+      ctx.last_step = ctx.step_start;
+      PetscTime(&ctx.last_time);
+      ierr = ts_monitor_add(monitor,&ctx);CHKERRQ(ierr);
+    }
+    return 0;
+  }
+
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ptr)
+  {
+    PetscErrorCode ierr;
+    CheckpointCtx& ctx = *(CheckpointCtx*) ptr;
+
+    // Nothing to save at the initial data or the step just restarted from
+    if (step == ctx.last_step) return 0;
+    PetscBool due = (PetscBool) (ctx.interval && step % ctx.interval == 0);
+    if (ctx.walltime) {
+      // Use the decision of rank 0 from the previous step, so the broadcast overlaps a time step.
+      if (ctx.request != MPI_REQUEST_NULL) {
+        MPI_Wait(&ctx.request,MPI_STATUS_IGNORE);
+        due = (PetscBool) (due || ctx.walltime_due);
+      }
+    }
+    if (due) {
+      ierr = write(ctx,step,t,v);CHKERRQ(ierr);
+    }
+    if (ctx.walltime) {
+      PetscMPIInt    rank;
+      PetscLogDouble now;
+      MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+      PetscTime(&now);
+      ctx.walltime_due = rank == 0 && now - ctx.last_time >= ctx.walltime;
+      MPI_Ibcast(&ctx.walltime_due,1,MPI_INT,0,PETSC_COMM_WORLD,&ctx.request);
+    }
+    return 0;
+  }
+
+  PetscErrorCode destroy(CheckpointCtx& ctx)
+  {
+    PetscErrorCode ierr;
+
+    if (ctx.request != MPI_REQUEST_NULL) MPI_Wait(&ctx.request,MPI_STATUS_IGNORE);
+    if (ctx.interval || ctx.walltime) {
+      PetscPrintf(PETSC_COMM_WORLD,"Checkpoints: %d written to %s, %.3e s per checkpoint\n",ctx.count,ctx.folder.c_str(),
+                  ctx.count ? ctx.write_time/ctx.count : 0.);
+      ierr = ts_monitor_remove(monitor,&ctx);CHKERRQ(ierr);
+    }
+    ierr = VecDestroy(&ctx.global);CHKERRQ(ierr);
+    ierr = VecDestroy(&ctx.local_aos);CHKERRQ(ierr);
+    ctx.interval = 0;
+    ctx.walltime = 0;
+    return 0;
+  }
+}
@@ -0,0 +1,127 @@
+#include <petsc.h>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include "util/energy.h"
+#include "time_stepping/ts_monitor.h"
+
+namespace energy
+{
+  /**
+  * Waits for the sample in flight, records it and checks its growth.
+  **/
+  static PetscErrorCode collect(EnergyCtx& ctx)
+  {
+    PetscMPIInt    rank;
+    PetscLogDouble t0, t1;
+
+    if (ctx.request == MPI_REQUEST_NULL) return 0;
+    PetscTime(&t0);
+    MPI_Wait(&ctx.request,MPI_STATUS_IGNORE);
+    PetscTime(&t1);
+    ctx.wait_time += t1 - t0;
+
+    const PetscReal e = PetscSqrtReal(ctx.global);
+    if (ctx.initial < 0) ctx.initial = e;
+    ctx.last = e;
+    ctx.count++;
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    if (rank == 0 && ctx.fp) std::fprintf(ctx.fp,"%d\t%.10e\t%.16e\n",(int)ctx.step,ctx.t,e);
+    if (!ctx.flagged && (!std::isfinite(e) || e > ctx.max_growth*ctx.initial)) {
+      ctx.flagged = PETSC_TRUE;
+      PetscPrintf(PETSC_COMM_WORLD,"Warning: energy %g at step %d (t = %f) exceeds %g times the initial energy %g. The solution is unstable.\n",
+                  e,ctx.step,ctx.t,ctx.max_growth,ctx.initial);
+      if (ctx.abort) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_NOT_CONVERGED,"Energy growth, stopping (-energy_abort)");
+    }
+    return 0;
+  }
+
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder,
+                        const std::array<std::vector<PetscReal>,3>& weights, EnergyCtx& ctx)
+  {
+    PetscErrorCode ierr;
+    PetscMPIInt    rank;
+
+    ctx.da = da;
+    ctx.soa = soa;
+    ctx.folder = folder;
+    ierr = PetscOptionsGetInt(NULL,NULL,"-energy_interval",&ctx.interval,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetReal(NULL,NULL,"-energy_max_growth",&ctx.max_growth,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetBool(NULL,NULL,"-energy_abort",&ctx.abort,NULL);CHKERRQ(ierr);
+    if (ctx.interval <= 0) {
+      ctx.interval = 0;
+      return 0;
+    }
+
+    DMDAGetInfo(da,NULL,NULL,NULL,NULL,NULL,NULL,NULL,&ctx.dof,NULL,NULL,NULL,NULL,NULL);
+    DMDAGetCorners(da,&ctx.start[0],&ctx.start[1],&ctx.start[2],&ctx.n[0],&ctx.n[1],&ctx.n[2]);
+    DMDAGetGhostCorners(da,&ctx.gstart[0],&ctx.gstart[1],&ctx.gstart[2],&ctx.gn[0],&ctx.gn[1],&ctx.gn[2]);
+    ctx.gnp = ctx.gn[0]*ctx.gn[1]*ctx.gn[2];
+    ctx.weights = weights;
+
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    if (rank == 0) {
+      std::filesystem::create_directories(ctx.folder);
+      ctx.fp = std::fopen((ctx.folder + "/energy.tsv").c_str(),"w");
+      if (!ctx.fp) PetscPrintf(PETSC_COMM_SELF,"Warning: could not open %s/energy.tsv\n",ctx.folder.c_str());
+    }
+    ierr = ts_monitor_add(monitor,&ctx);CHKERRQ(ierr);
+    PetscPrintf(PETSC_COMM_WORLD,"Energy monitor every %d steps, flagging growth by more than %g\n",ctx.interval,ctx.max_growth);
+    return 0;
+  }
+
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ptr)
+  {
+    PetscErrorCode    ierr;
+    const PetscScalar *arr;
+    EnergyCtx&        ctx = *(EnergyCtx*) ptr;
+    PetscReal         sum = 0;
+
+    if (!ctx.interval || step % ctx.interval) return 0;
+    // The previous sample has had interval time steps to complete.
+    ierr = collect(ctx);CHKERRQ(ierr);
+
+    const PetscReal *wx = ctx.weights[0].data(), *wy = ctx.weights[1].data(), *wz = ctx.weights[2].data();
+    ierr = VecGetArrayRead(v,&arr);CHKERRQ(ierr);
+    #pragma omp parallel for collapse(2) reduction(+:sum) schedule(static)
+    for (PetscInt k = 0; k < ctx.n[2]; k++) {
+      for (PetscInt j = 0; j < ctx.n[1]; j++) {
+        const PetscReal w_jk = wz[k]*wy[j];
+        // Local (ghosted) index of the first point of the row
+        const PetscInt p = ((k + ctx.start[2] - ctx.gstart[2])*ctx.gn[1] + j + ctx.start[1] - ctx.gstart[1])*ctx.gn[0]
+                           + ctx.start[0] - ctx.gstart[0];
+        for (PetscInt i = 0; i < ctx.n[0]; i++) {
+          PetscReal u = 0;
+          for (PetscInt c = 0; c < ctx.dof; c++) {
+            const PetscReal a = PetscAbsScalar(ctx.soa ? arr[c*ctx.gnp + p + i] : arr[(p + i)*ctx.dof + c]);
+            u += a*a;
+          }
+          sum += w_jk*wx[i]*u;
+        }
+      }
+    }
+    ierr = VecRestoreArrayRead(v,&arr);CHKERRQ(ierr);
+
+    ctx.local = sum;
+    ctx.step = step;
+    ctx.t = t;
+    MPI_Iallreduce(&ctx.local,&ctx.global,1,MPIU_REAL,MPIU_SUM,PETSC_COMM_WORLD,&ctx.request);
+    return 0;
+  }
+
+  PetscErrorCode destroy(EnergyCtx& ctx)
+  {
+    PetscErrorCode ierr;
+
+    if (!ctx.interval) return 0;
+    ierr = collect(ctx);CHKERRQ(ierr);
+    PetscPrintf(PETSC_COMM_WORLD,"Energy: %d samples, initial %g, final %g (ratio %g)%s. Waiting %.3e s in total on rank 0\n",
+                ctx.count,ctx.initial,ctx.last,ctx.initial > 0 ? ctx.last/ctx.initial : 0.,
+                ctx.flagged ? ", growth flagged" : "",ctx.wait_time);
+    if (ctx.fp) std::fclose(ctx.fp);
+    ctx.fp = NULL;
+    ierr = ts_monitor_remove(monitor,&ctx);CHKERRQ(ierr);
+    ctx.interval = 0;
+    return 0;
+  }
+}
@@ -1,8 +1,11 @@
 #include<petsc.h>
 #include <filesystem>
+#include "util/io_util.h"
+#include "util/logging.h"
 
 PetscErrorCode write_vector_to_binary(const Vec v, const std::string folder, const std::string file)
 { 
+  logging::begin(logging::IO_WRITE);
   std::filesystem::create_directories(folder);
   PetscErrorCode ierr;
   PetscViewer viewer;
@@ -10,6 +13,24 @@ PetscErrorCode write_vector_to_binary(const Vec v, const std::string folder, con
   ierr = VecView(v,viewer);
   ierr = PetscViewerDestroy(&viewer);
   CHKERRQ(ierr);
+  logging::end(logging::IO_WRITE);
+  return 0;
+}
+
+PetscErrorCode write_vector(const Vec v, const std::string folder, const std::string file, const mpiio::Metadata& meta)
+{
+  PetscErrorCode ierr;
+  PetscInt       format = 0;
+  DM             da;
+  const char     *formats[2] = {"petsc","mpiio"};
+
+  ierr = PetscOptionsGetEList(NULL,NULL,"-output_format",formats,2,&format,NULL);CHKERRQ(ierr);
+  if (format == 0) {
+    ierr = write_vector_to_binary(v,folder,file);CHKERRQ(ierr);
+  } else {
+    ierr = VecGetDM(v,&da);CHKERRQ(ierr);
+    ierr = mpiio::write(da,v,folder,file+".sbp",meta);CHKERRQ(ierr);
+  }
   return 0;
 }
 
@@ -18,11 +39,13 @@ PetscErrorCode write_data_to_file(const std::string data_string, const std::stri
   PetscInt rank;
 
   MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+  logging::begin(logging::IO_WRITE);
   std::filesystem::create_directories(folder);
   if (rank == 0) {
     FILE *f = fopen((folder+"/"+file).c_str(), "a");
     if (!f) {
       printf("File '%s' failed to open.\n",(folder+"/"+file).c_str());
+      logging::end(logging::IO_WRITE);
       return -1;
     }
     fseek(f, 0, SEEK_END);
@@ -32,6 +55,7 @@ PetscErrorCode write_data_to_file(const std::string data_string, const std::stri
     fprintf(f,"%s",data_string.c_str());
     fclose(f);
   }
+  logging::end(logging::IO_WRITE);
   return 0;
 }
 
@@ -45,15 +69,16 @@ void print_usage_1d(char* exec_name) {
 	PetscPrintf(PETSC_COMM_WORLD,"N:\t\tnumber of grid points.\n");
 	PetscPrintf(PETSC_COMM_WORLD,"Tend:\t\tfinal time.\n");
 	PetscPrintf(PETSC_COMM_WORLD,"CFL:\t\tCFL number, dt = CFL*min(dx).\n");
-	PetscPrintf(PETSC_COMM_WORLD,"use_custom_sc:\t1 - use custom scatter context, 0 - use PETSc scatter context.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"use_custom_sc:\t2 - use neighborhood collective halo exchange, 1 - use custom scatter context, 0 - use PETSc scatter context.\n");
 	PetscPrintf(PETSC_COMM_WORLD,"------------------------------ Example ------------------------------\n");
 	PetscPrintf(PETSC_COMM_WORLD,"\"%s 101 1 0.1 0 1\"\n",exec_name);
 	PetscPrintf(PETSC_COMM_WORLD,"\n");
 }
 
-int get_inputs(int argc, char *argv[], PetscInt& N, PetscScalar& Tend, PetscScalar& CFL, PetscBool& use_custom_sc) {
+int get_inputs(int argc, char *argv[], PetscInt& N, PetscScalar& Tend, PetscScalar& CFL, PetscInt& use_custom_sc) {
 
-	if (argc != 5) {
+	// Arguments following the positional arguments are PETSc options.
+	if (argc < 5) {
 		PetscPrintf(PETSC_COMM_WORLD,"Error, wrong number of input arguments. Expected 4 arguments, got %d.\n",argc-1);
 		print_usage_1d(argv[0]);
 		return -1;
@@ -80,9 +105,9 @@ int get_inputs(int argc, char *argv[], PetscInt& N, PetscScalar& Tend, PetscScal
 		return -1;
 	}
 
-	use_custom_sc = (PetscBool) atoi(argv[4]);
-	if (use_custom_sc != 0 && use_custom_sc != 1) {
-		PetscPrintf(PETSC_COMM_WORLD, "Error, sixth argument wrong. Expected use_custom_sc = 1 or 0, got %d.\n",use_custom_sc);
+	use_custom_sc = atoi(argv[4]);
+	if (use_custom_sc < 0 || use_custom_sc > 2) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, sixth argument wrong. Expected use_custom_sc = 0, 1 or 2, got %d.\n",use_custom_sc);
 		print_usage_1d(argv[0]);
 		return -1;
 	}
@@ -101,15 +126,16 @@ void print_usage_2d(char* exec_name) {
 	PetscPrintf(PETSC_COMM_WORLD,"Ny:\t\tnumber of grid points in y-direction.\n");
 	PetscPrintf(PETSC_COMM_WORLD,"Tend:\t\tfinal time.\n");
 	PetscPrintf(PETSC_COMM_WORLD,"CFL:\t\tCFL number, dt = CFL*min(dx).\n");
-	PetscPrintf(PETSC_COMM_WORLD,"use_custom_sc:\t1 - use custom scatter context, 0 - use PETSc scatter context.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"use_custom_sc:\t2 - use neighborhood collective halo exchange, 1 - use custom scatter context, 0 - use PETSc scatter context.\n");
 	PetscPrintf(PETSC_COMM_WORLD,"------------------------------ Example ------------------------------\n");
 	PetscPrintf(PETSC_COMM_WORLD,"\"%s 101 101 1 0.1 0 1\"\n",exec_name);
 	PetscPrintf(PETSC_COMM_WORLD,"\n");
 }
 
-int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscScalar& Tend, PetscScalar& CFL, PetscBool& use_custom_sc) {
+int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscScalar& Tend, PetscScalar& CFL, PetscInt& use_custom_sc) {
 
-	if (argc != 6) {
+	// Arguments following the positional arguments are PETSc options.
+	if (argc < 6) {
 		PetscPrintf(PETSC_COMM_WORLD,"Error, wrong number of input arguments. Expected 5 arguments, got %d.\n",argc-1);
 		print_usage_2d(argv[0]);
 		return -1;
@@ -143,12 +169,83 @@ int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscScalar&
 		return -1;
 	}
 
-	use_custom_sc = (PetscBool) atoi(argv[5]);
-	if (use_custom_sc != 0 && use_custom_sc != 1) {
-		PetscPrintf(PETSC_COMM_WORLD, "Error, sixth argument wrong. Expected use_custom_sc = 1 or 0, got %d.\n",use_custom_sc);
+	use_custom_sc = atoi(argv[5]);
+	if (use_custom_sc < 0 || use_custom_sc > 2) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, sixth argument wrong. Expected use_custom_sc = 0, 1 or 2, got %d.\n",use_custom_sc);
 		print_usage_2d(argv[0]);
 		return -1;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+//=============================================================================
+// 3D functions
+//=============================================================================
+void print_usage_3d(char* exec_name) {
+	PetscPrintf(PETSC_COMM_WORLD,"------------------------------ USAGE ------------------------------\n");
+	PetscPrintf(PETSC_COMM_WORLD,"\"%s Nx Ny Nz Tend CFL use_custom_sc\"\n",exec_name);
+	PetscPrintf(PETSC_COMM_WORLD,"\n");
+	PetscPrintf(PETSC_COMM_WORLD,"Nx:\t\tnumber of grid points in x-direction.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"Ny:\t\tnumber of grid points in y-direction.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"Nz:\t\tnumber of grid points in z-direction.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"Tend:\t\tfinal time.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"CFL:\t\tCFL number, dt = CFL*min(dx).\n");
+	PetscPrintf(PETSC_COMM_WORLD,"use_custom_sc:\t1 - use custom scatter context, 0 - use PETSc scatter context.\n");
+	PetscPrintf(PETSC_COMM_WORLD,"------------------------------ Example ------------------------------\n");
+	PetscPrintf(PETSC_COMM_WORLD,"\"%s 101 101 101 1 0.1 1\"\n",exec_name);
+	PetscPrintf(PETSC_COMM_WORLD,"\n");
+}
+
+int get_inputs(int argc, char *argv[], PetscInt& Nx, PetscInt& Ny, PetscInt& Nz, PetscScalar& Tend, PetscScalar& CFL, PetscInt& use_custom_sc) {
+
+	// Arguments following the positional arguments are PETSc options.
+	if (argc < 7) {
+		PetscPrintf(PETSC_COMM_WORLD,"Error, wrong number of input arguments. Expected 6 arguments, got %d.\n",argc-1);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	Nx = atoi(argv[1]);
+	if (Nx <= 0) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, first argument wrong. Expected Nx > 0, got %d.\n",Nx);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	Ny = atoi(argv[2]);
+	if (Ny <= 0) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, second argument wrong. Expected Ny > 0, got %d.\n",Ny);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	Nz = atoi(argv[3]);
+	if (Nz <= 0) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, third argument wrong. Expected Nz > 0, got %d.\n",Nz);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	Tend = atof(argv[4]);
+	if (Tend <= 0) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, fourth argument wrong. Expected Tend > 0, got %f.\n",Tend);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	CFL = atof(argv[5]);
+	if (CFL <= 0) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, fifth argument wrong. Expected CFL > 0, got %f.\n",CFL);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	use_custom_sc = atoi(argv[6]);
+	if (use_custom_sc < 0 || use_custom_sc > 1) {
+		PetscPrintf(PETSC_COMM_WORLD, "Error, sixth argument wrong. Expected use_custom_sc = 0 or 1, got %d.\n",use_custom_sc);
+		print_usage_3d(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,38 @@
+#include <petsc.h>
+#include "util/logging.h"
+
+namespace logging
+{
+  static PetscBool registered = PETSC_FALSE;
+  static PetscLogEvent events[N_EVENTS];
+  static PetscLogStage time_stepping_stage;
+
+  PetscErrorCode register_events()
+  {
+    PetscErrorCode ierr;
+    PetscClassId   classid;
+    const char *const names[N_EVENTS] = {"SBPRHS","SBPRHSLocal","SBPRHSOverlap","SBPRHSBC","SBPHaloBegin",
+                                         "SBPHaloEnd","SBPScatterSetup","SBPTSUpdate","SBPIOWrite"};
+
+    if (registered) return 0;
+    ierr = PetscClassIdRegister("SBP solver",&classid);CHKERRQ(ierr);
+    for (PetscInt e = 0; e < N_EVENTS; e++) {
+      ierr = PetscLogEventRegister(names[e],classid,&events[e]);CHKERRQ(ierr);
+    }
+    ierr = PetscLogStageRegister("Time stepping",&time_stepping_stage);CHKERRQ(ierr);
+    registered = PETSC_TRUE;
+    return 0;
+  }
+
+  PetscLogEvent get_event(const Event e)
+  {
+    if (PetscUnlikely(!registered)) register_events();
+    return events[e];
+  }
+
+  PetscLogStage get_time_stepping_stage()
+  {
+    if (PetscUnlikely(!registered)) register_events();
+    return time_stepping_stage;
+  }
+}
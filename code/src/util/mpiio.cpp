@@ -0,0 +1,204 @@
+#include <petsc.h>
+#include <filesystem>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util/mpiio.h"
+#include "util/logging.h"
+
+namespace mpiio
+{
+  /**
+  * Creates the file type of the block of the rank in the global array [N[2]][N[1]][N[0]*dof] of da.
+  **/
+  static PetscErrorCode create_filetype(const DM da, MPI_Datatype& filetype)
+  {
+    PetscInt dim, dof, N[3], start[3], n[3];
+    int      sizes[3], subsizes[3], starts[3];
+
+    DMDAGetInfo(da,&dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,&dof,NULL,NULL,NULL,NULL,NULL);
+    DMDAGetCorners(da,&start[0],&start[1],&start[2],&n[0],&n[1],&n[2]);
+    for (PetscInt d = 0; d < dim; d++) {
+      sizes[dim-1-d] = N[d];
+      subsizes[dim-1-d] = n[d];
+      starts[dim-1-d] = start[d];
+    }
+    sizes[dim-1] *= dof;
+    subsizes[dim-1] *= dof;
+    starts[dim-1] *= dof;
+    MPI_Type_create_subarray(dim,sizes,subsizes,starts,MPI_ORDER_C,MPIU_SCALAR,&filetype);
+    MPI_Type_commit(&filetype);
+    return 0;
+  }
+
+  PetscErrorCode write(const DM da, const Vec v, const std::string folder, const std::string file, const Metadata& meta, const PetscBool sync)
+  {
+    PetscErrorCode    ierr;
+    MPI_Comm          comm;
+    MPI_File          fh = MPI_FILE_NULL;
+    MPI_Datatype      filetype;
+    PetscMPIInt       rank;
+    PetscInt          dim, dof, N[3], n_local;
+    const PetscScalar *arr;
+    Header            header;
+
+    ierr = PetscObjectGetComm((PetscObject)da,&comm);CHKERRQ(ierr);
+    MPI_Comm_rank(comm,&rank);
+    DMDAGetInfo(da,&dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,&dof,NULL,NULL,NULL,NULL,NULL);
+    logging::begin(logging::IO_WRITE);
+
+    // Header and component names
+    std::memset(&header,0,sizeof(header));
+    std::strncpy(header.magic,"SBPMPIO",sizeof(header.magic));
+    header.version = 1;
+    header.data_offset = ((sizeof(Header) + dof*NAME_LENGTH + DATA_ALIGNMENT - 1)/DATA_ALIGNMENT)*DATA_ALIGNMENT;
+    header.scalar_size = sizeof(PetscScalar);
+    header.dim = dim;
+    header.dof = dof;
+    header.order = meta.order;
+    header.t = meta.t;
+    for (PetscInt d = 0; d < 3; d++) header.N[d] = N[d];
+    std::vector<char> names(dof*NAME_LENGTH,0);
+    for (PetscInt c = 0; c < dof; c++) {
+      const char *name = NULL;
+      ierr = DMDAGetFieldName(da,c,&name);CHKERRQ(ierr);
+      if (name && name[0]) std::strncpy(&names[c*NAME_LENGTH],name,NAME_LENGTH-1);
+      else std::snprintf(&names[c*NAME_LENGTH],NAME_LENGTH,"c%d",(int)c);
+    }
+
+    std::filesystem::create_directories(folder);
+    // The file routines are collective, so a failure on one rank is reduced before any rank stops calling them.
+    // Otherwise the file handles return the error codes (MPI_ERRORS_RETURN), which are all checked below.
+    int ok = MPI_File_open(comm,(folder+"/"+file).c_str(),MPI_MODE_CREATE|MPI_MODE_WRONLY,MPI_INFO_NULL,&fh) == MPI_SUCCESS;
+    MPI_Allreduce(MPI_IN_PLACE,&ok,1,MPI_INT,MPI_LAND,comm);
+    if (!ok) {
+      if (fh != MPI_FILE_NULL) MPI_File_close(&fh);
+      logging::end(logging::IO_WRITE);
+      SETERRQ(comm,PETSC_ERR_FILE_OPEN,"Could not open the MPI-IO output file");
+    }
+    auto check = [&ok](const int err) { ok = ok && err == MPI_SUCCESS; };
+    // Also truncates a previous, larger file
+    check(MPI_File_set_size(fh,header.data_offset + header.N[0]*header.N[1]*header.N[2]*header.dof*header.scalar_size));
+    if (rank == 0) {
+      check(MPI_File_write_at(fh,0,&header,sizeof(header),MPI_BYTE,MPI_STATUS_IGNORE));
+      check(MPI_File_write_at(fh,sizeof(header),names.data(),names.size(),MPI_BYTE,MPI_STATUS_IGNORE));
+    }
+    ierr = create_filetype(da,filetype);CHKERRQ(ierr);
+    check(MPI_File_set_view(fh,header.data_offset,MPIU_SCALAR,filetype,"native",MPI_INFO_NULL));
+    ierr = VecGetLocalSize(v,&n_local);CHKERRQ(ierr);
+    ierr = VecGetArrayRead(v,&arr);CHKERRQ(ierr);
+    MPI_Status status;
+    int        count = 0;
+    check(MPI_File_write_all(fh,arr,n_local,MPIU_SCALAR,&status));
+    ierr = VecRestoreArrayRead(v,&arr);CHKERRQ(ierr);
+    if (ok) check(MPI_Get_count(&status,MPIU_SCALAR,&count));
+    ok = ok && count == n_local;
+    if (sync) check(MPI_File_sync(fh));
+    check(MPI_File_close(&fh));
+    MPI_Type_free(&filetype);
+    // Every rank has written (and synced) its block only if all succeeded. The reduction is also a barrier.
+    MPI_Allreduce(MPI_IN_PLACE,&ok,1,MPI_INT,MPI_LAND,comm);
+    logging::end(logging::IO_WRITE);
+    if (!ok) SETERRQ(comm,PETSC_ERR_FILE_WRITE,"Could not write the MPI-IO output file");
+    return 0;
+  }
+
+  PetscErrorCode read(const DM da, Vec v, const std::string folder, const std::string file, Metadata& meta)
+  {
+    PetscErrorCode ierr;
+    MPI_Comm       comm;
+    MPI_File       fh = MPI_FILE_NULL;
+    MPI_Datatype   filetype;
+    MPI_Offset     file_size = 0;
+    PetscInt       dim, dof, N[3], n_local;
+    PetscScalar    *arr;
+    Header         header;
+
+    ierr = PetscObjectGetComm((PetscObject)da,&comm);CHKERRQ(ierr);
+    DMDAGetInfo(da,&dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,&dof,NULL,NULL,NULL,NULL,NULL);
+    // As in write, a failure on one rank is reduced before any rank stops calling the collective file routines.
+    int ok = MPI_File_open(comm,(folder+"/"+file).c_str(),MPI_MODE_RDONLY,MPI_INFO_NULL,&fh) == MPI_SUCCESS;
+    MPI_Allreduce(MPI_IN_PLACE,&ok,1,MPI_INT,MPI_LAND,comm);
+    if (!ok) {
+      if (fh != MPI_FILE_NULL) MPI_File_close(&fh);
+      SETERRQ(comm,PETSC_ERR_FILE_OPEN,"Could not open the MPI-IO input file");
+    }
+    auto check = [&ok](const int err) { ok = ok && err == MPI_SUCCESS; };
+    MPI_Status status;
+    int        count = 0;
+    std::memset(&header,0,sizeof(header));
+    check(MPI_File_get_size(fh,&file_size));
+    check(MPI_File_read_at_all(fh,0,&header,sizeof(header),MPI_BYTE,&status));
+    if (ok) check(MPI_Get_count(&status,MPI_BYTE,&count));
+    ok = ok && count == (int) sizeof(header);
+    // The file must hold the whole grid function, so that a file truncated by an interrupted write is rejected
+    const int64_t data_size = header.N[0]*header.N[1]*header.N[2]*header.dof*header.scalar_size;
+    const bool valid = !std::strncmp(header.magic,"SBPMPIO",sizeof(header.magic)) && header.version == 1
+                       && header.scalar_size == sizeof(PetscScalar) && header.dim == dim && header.dof == dof
+                       && header.N[0] == N[0] && header.N[1] == N[1] && header.N[2] == N[2]
+                       && header.data_offset >= (int64_t) sizeof(Header) && file_size >= header.data_offset + data_size;
+    int flags[2] = {ok, ok && valid};
+    MPI_Allreduce(MPI_IN_PLACE,flags,2,MPI_INT,MPI_LAND,comm);
+    if (!flags[1]) {
+      MPI_File_close(&fh);
+      if (!flags[0]) SETERRQ(comm,PETSC_ERR_FILE_READ,"Could not read the header of the MPI-IO input file");
+      SETERRQ(comm,PETSC_ERR_FILE_UNEXPECTED,"The MPI-IO input file does not match the grid or is truncated");
+    }
+    meta.t = header.t;
+    meta.order = header.order;
+
+    ierr = create_filetype(da,filetype);CHKERRQ(ierr);
+    check(MPI_File_set_view(fh,header.data_offset,MPIU_SCALAR,filetype,"native",MPI_INFO_NULL));
+    ierr = VecGetLocalSize(v,&n_local);CHKERRQ(ierr);
+    ierr = VecGetArray(v,&arr);CHKERRQ(ierr);
+    count = 0;
+    check(MPI_File_read_all(fh,arr,n_local,MPIU_SCALAR,&status));
+    ierr = VecRestoreArray(v,&arr);CHKERRQ(ierr);
+    if (ok) check(MPI_Get_count(&status,MPIU_SCALAR,&count));
+    ok = ok && count == n_local;
+    check(MPI_File_close(&fh));
+    MPI_Type_free(&filetype);
+    // v holds the file only if every rank has read its whole block
+    MPI_Allreduce(MPI_IN_PLACE,&ok,1,MPI_INT,MPI_LAND,comm);
+    if (!ok) SETERRQ(comm,PETSC_ERR_FILE_READ,"Could not read the MPI-IO input file");
+    return 0;
+  }
+
+  PetscErrorCode map(const std::string path, MappedFile& f)
+  {
+    struct stat st;
+
+    const int fd = open(path.c_str(),O_RDONLY);
+    if (fd == -1) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_OPEN,"Could not open the file to map");
+    if (fstat(fd,&st) == -1 || (size_t) st.st_size < sizeof(Header)) {
+      close(fd);
+      SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_UNEXPECTED,"Not an MPI-IO output file");
+    }
+    void *addr = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (addr == MAP_FAILED) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_READ,"Could not map the file");
+
+    const Header *header = (const Header*) addr;
+    const int64_t data_size = header->N[0]*header->N[1]*header->N[2]*header->dof*header->scalar_size;
+    if (std::strncmp(header->magic,"SBPMPIO",sizeof(header->magic)) || header->version != 1
+        || header->scalar_size != sizeof(PetscScalar) || st.st_size < header->data_offset + data_size) {
+      munmap(addr,st.st_size);
+      SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_UNEXPECTED,"Not an MPI-IO output file of this version and scalar type");
+    }
+    f.header = header;
+    f.names = (const char*) addr + sizeof(Header);
+    f.data = (const PetscScalar*) ((const char*) addr + header->data_offset);
+    f.addr = addr;
+    f.size = st.st_size;
+    return 0;
+  }
+
+  PetscErrorCode unmap(MappedFile& f)
+  {
+    if (f.addr) munmap(f.addr,f.size);
+    f = MappedFile();
+    return 0;
+  }
+}
@@ -0,0 +1,207 @@
+#include <petsc.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include "util/perf_counters.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf_counters
+{
+  namespace detail
+  {
+    bool enabled = false;
+    PetscLogDouble nominal_flops = 0;
+  }
+
+  enum Counter {CYCLES, INSTRUCTIONS, LLC_MISSES, FP_OPS, N_COUNTERS};
+
+  struct SectionCounts {
+    PetscInt calls = 0;
+    PetscLogDouble time = 0, t_start = 0;
+    std::array<PetscLogDouble,N_COUNTERS> counts = {};
+  };
+
+  // fds[t][c] is the counter c of thread t, or -1 if not available. The cycle counter of a thread leads its group.
+  static std::vector<std::array<int,N_COUNTERS>> fds;
+  static std::array<bool,N_COUNTERS> available = {};
+  static std::array<SectionCounts,N_SECTIONS> sections;
+  static PetscBool requested = PETSC_FALSE;
+  static PetscReal machine_balance = 0;
+  static PetscInt line_size = 64;
+
+#ifdef __linux__
+  /**
+  * Opens a counter of the calling thread, counting user space only. Returns -1 on failure.
+  **/
+  static int open_counter(const __u32 type, const __u64 config, const int group_fd)
+  {
+    struct perf_event_attr attr;
+    std::memset(&attr,0,sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1; // The group is enabled through its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open,&attr,0,-1,group_fd,0);
+  }
+
+  /**
+  * Opens the counters of the calling thread into fds.
+  **/
+  static void open_thread_counters(std::array<int,N_COUNTERS>& fd, const PetscBool has_fp_event, const __u64 fp_event)
+  {
+    fd.fill(-1);
+    fd[CYCLES] = open_counter(PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES,-1);
+    if (fd[CYCLES] == -1) return;
+    fd[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS,fd[CYCLES]);
+    fd[LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES,fd[CYCLES]);
+    if (has_fp_event) fd[FP_OPS] = open_counter(PERF_TYPE_RAW,fp_event,fd[CYCLES]);
+  }
+#endif
+
+  PetscErrorCode setup()
+  {
+    PetscErrorCode ierr;
+    PetscBool      has_fp_event = PETSC_FALSE;
+    char           fp_event_str[64] = "";
+
+    ierr = PetscOptionsGetBool(NULL,NULL,"-perf_counters",&requested,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetString(NULL,NULL,"-perf_fp_event",fp_event_str,sizeof(fp_event_str),&has_fp_event);CHKERRQ(ierr);
+    ierr = PetscOptionsGetReal(NULL,NULL,"-perf_machine_balance",&machine_balance,NULL);CHKERRQ(ierr);
+    if (!requested) return 0;
+
+#ifdef __linux__
+    const unsigned long long fp_event = std::strtoull(fp_event_str,NULL,16);
+    const long ls = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+    if (ls > 0) line_size = ls;
+
+    // The counters of a thread only count the thread that opened them, so each thread opens its own.
+#ifdef _OPENMP
+    fds.resize(omp_get_max_threads());
+    #pragma omp parallel
+    open_thread_counters(fds[omp_get_thread_num()],has_fp_event,fp_event);
+#else
+    fds.resize(1);
+    open_thread_counters(fds[0],has_fp_event,fp_event);
+#endif
+
+    // A counter is used if it could be opened on all threads.
+    for (PetscInt c = 0; c < N_COUNTERS; c++) {
+      available[c] = true;
+      for (const auto& fd : fds) available[c] = available[c] && fd[c] != -1;
+    }
+    if (!available[CYCLES]) {
+      PetscPrintf(PETSC_COMM_WORLD,"Warning: perf_event counters are not available (%s), -perf_counters is ignored.\n",std::strerror(errno));
+      for (auto& fd : fds) for (int f : fd) if (f != -1) close(f);
+      fds.clear();
+      return 0;
+    }
+    if (!available[LLC_MISSES]) PetscPrintf(PETSC_COMM_WORLD,"Warning: the last level cache miss counter is not available, memory traffic is not reported.\n");
+    if (has_fp_event && !available[FP_OPS]) PetscPrintf(PETSC_COMM_WORLD,"Warning: the event -perf_fp_event %s is not available, using nominal flops.\n",fp_event_str);
+    detail::enabled = true;
+#else
+    PetscPrintf(PETSC_COMM_WORLD,"Warning: perf_event counters are only supported on Linux, -perf_counters is ignored.\n");
+#endif
+    return 0;
+  }
+
+  void start(const SectionType s)
+  {
+#ifdef __linux__
+    for (const auto& fd : fds) {
+      ioctl(fd[CYCLES],PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+      ioctl(fd[CYCLES],PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    PetscTime(&sections[s].t_start);
+  }
+
+  void stop(const SectionType s)
+  {
+    PetscLogDouble t_end;
+    PetscTime(&t_end);
+    SectionCounts& section = sections[s];
+    section.time += t_end - section.t_start;
+    section.calls++;
+#ifdef __linux__
+    for (const auto& fd : fds) {
+      ioctl(fd[CYCLES],PERF_EVENT_IOC_DISABLE,PERF_IOC_FLAG_GROUP);
+      for (PetscInt c = 0; c < N_COUNTERS; c++) {
+        unsigned long long count;
+        if (available[c] && read(fd[c],&count,sizeof(count)) == sizeof(count)) section.counts[c] += count;
+      }
+    }
+#endif
+  }
+
+  PetscErrorCode view(MPI_Comm comm)
+  {
+    PetscErrorCode ierr;
+    PetscMPIInt    rank;
+    const char     *names[N_SECTIONS] = {"local","overlap","all","serial"};
+
+    if (!requested) return 0;
+    MPI_Comm_rank(comm,&rank);
+
+    // Totals over the sections. Nominal flops are only known for the total.
+    SectionCounts total;
+    for (const auto& section : sections) {
+      total.calls += section.calls;
+      total.time += section.time;
+      for (PetscInt c = 0; c < N_COUNTERS; c++) total.counts[c] += section.counts[c];
+    }
+    if (!available[FP_OPS]) total.counts[FP_OPS] = detail::nominal_flops;
+
+    ierr = PetscPrintf(comm,"Hardware counters of the RHS region kernels, per rank. Memory traffic is estimated as LLC misses x %d bytes%s.\n",
+                       line_size,available[FP_OPS] ? "" : ", flops are nominal");CHKERRQ(ierr);
+    ierr = PetscPrintf(comm,"%4s  %-8s %8s %10s %12s %12s %5s %12s %8s %8s %10s%s\n","rank","section","calls","time[s]",
+                       "cycles","instr","IPC","LLC-miss","GB/s","Gflop/s","flop/byte",machine_balance > 0 ? "  bound" : "");CHKERRQ(ierr);
+    // Ranks where the counters could not be opened take part in the collective output without counts.
+    if (!detail::enabled) {
+      ierr = PetscSynchronizedPrintf(comm,"%4d  counters not available\n",rank);CHKERRQ(ierr);
+      ierr = PetscSynchronizedFlush(comm,PETSC_STDOUT);CHKERRQ(ierr);
+      return 0;
+    }
+    for (PetscInt s = 0; s <= N_SECTIONS; s++) {
+      const SectionCounts& section = s < N_SECTIONS ? sections[s] : total;
+      const char* name = s < N_SECTIONS ? names[s] : "total";
+      const PetscLogDouble bytes = section.counts[LLC_MISSES]*line_size;
+      const PetscLogDouble flops = section.counts[FP_OPS];
+      const PetscLogDouble time = section.time > 0 ? section.time : 1;
+      const PetscLogDouble ipc = section.counts[CYCLES] > 0 ? section.counts[INSTRUCTIONS]/section.counts[CYCLES] : 0;
+      const PetscLogDouble intensity = bytes > 0 ? flops/bytes : 0;
+      char line[256];
+      std::snprintf(line,sizeof(line),"%4d  %-8s %8d %10.4f %12.4e %12.4e %5.2f %12.4e",
+                    rank,name,(int)section.calls,section.time,section.counts[CYCLES],section.counts[INSTRUCTIONS],ipc,section.counts[LLC_MISSES]);
+      ierr = PetscSynchronizedPrintf(comm,"%s",line);CHKERRQ(ierr);
+      if (available[LLC_MISSES]) {
+        ierr = PetscSynchronizedPrintf(comm," %8.2f",1e-9*bytes/time);CHKERRQ(ierr);
+      } else {
+        ierr = PetscSynchronizedPrintf(comm," %8s","-");CHKERRQ(ierr);
+      }
+      if (flops > 0 && available[LLC_MISSES]) {
+        ierr = PetscSynchronizedPrintf(comm," %8.2f %10.3f",1e-9*flops/time,intensity);CHKERRQ(ierr);
+        if (machine_balance > 0) {
+          ierr = PetscSynchronizedPrintf(comm,"  %s",intensity < machine_balance ? "memory" : "compute");CHKERRQ(ierr);
+        }
+      } else if (flops > 0) {
+        ierr = PetscSynchronizedPrintf(comm," %8.2f %10s",1e-9*flops/time,"-");CHKERRQ(ierr);
+      } else {
+        ierr = PetscSynchronizedPrintf(comm," %8s %10s","-","-");CHKERRQ(ierr);
+      }
+      ierr = PetscSynchronizedPrintf(comm,"\n");CHKERRQ(ierr);
+    }
+    ierr = PetscSynchronizedFlush(comm,PETSC_STDOUT);CHKERRQ(ierr);
+    return 0;
+  }
+}
@@ -0,0 +1,318 @@
+#include <petsc.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include "util/receiver.h"
+#include "time_stepping/ts_monitor.h"
+
+namespace receiver
+{
+  /**
+  * Reads the receiver coordinates from file on rank 0 and broadcasts them. Returns -1 on all ranks if the file can
+  * not be read.
+  **/
+  static PetscErrorCode read_coordinates(const char *file, const PetscInt dim, std::vector<PetscReal>& coords)
+  {
+    PetscMPIInt rank;
+    PetscInt    n = -1;
+
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    if (rank == 0) {
+      FILE *f = std::fopen(file,"r");
+      if (f) {
+        char   line[1024];
+        double x[3];
+        n = 0;
+        while (std::fgets(line,sizeof(line),f)) {
+          if (line[0] == '#') continue;
+          x[0] = x[1] = x[2] = 0;
+          const int n_read = std::sscanf(line,"%lf %lf %lf",&x[0],&x[1],&x[2]);
+          if (n_read <= 0) continue;
+          if (n_read < dim) {
+            n = -1;
+            break;
+          }
+          coords.insert(coords.end(),x,x+3);
+          n++;
+        }
+        std::fclose(f);
+      }
+    }
+    MPI_Bcast(&n,1,MPIU_INT,0,PETSC_COMM_WORLD);
+    if (n < 0) return -1;
+    coords.resize(3*n);
+    MPI_Bcast(coords.data(),3*n,MPIU_REAL,0,PETSC_COMM_WORLD);
+    return 0;
+  }
+
+  /**
+  * Gathers the buffered partial traces on rank 0, sums them per receiver and appends them to the trace file.
+  **/
+  static PetscErrorCode flush(ReceiverCtx& ctx)
+  {
+    PetscMPIInt    rank, size;
+    PetscInt       ok = 1;
+    PetscLogDouble t0, t1;
+    const PetscInt nc = ctx.comps.size();
+    const PetscInt n = ctx.n_buffered;
+    std::vector<PetscScalar> recv, traces;
+    std::vector<PetscMPIInt> counts, displs;
+
+    PetscTime(&t0);
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    MPI_Comm_size(PETSC_COMM_WORLD,&size);
+    if (rank == 0) {
+      counts.resize(size);
+      displs.resize(size);
+      for (PetscMPIInt q = 0; q < size; q++) {
+        counts[q] = ctx.counts[q]*n*nc;
+        displs[q] = ctx.displs[q]*n*nc;
+      }
+      recv.resize(ctx.gathered.size()*n*nc);
+    }
+    MPI_Gatherv(ctx.buffer.data(),ctx.local.size()*n*nc,MPIU_SCALAR,recv.data(),counts.data(),displs.data(),MPIU_SCALAR,0,
+                PETSC_COMM_WORLD);
+    if (rank == 0) {
+      traces.assign(ctx.n_receivers*nc,0);
+      for (PetscInt s = 0; s < n; s++) {
+        std::fill(traces.begin(),traces.end(),0);
+        for (PetscMPIInt q = 0; q < size; q++) {
+          const PetscScalar *block = &recv[displs[q] + s*ctx.counts[q]*nc];
+          for (PetscInt r = 0; r < ctx.counts[q]; r++) {
+            const PetscInt g = ctx.gathered[ctx.displs[q] + r];
+            for (PetscInt c = 0; c < nc; c++) traces[g*nc + c] += block[r*nc + c];
+          }
+        }
+        const double t = ctx.times[s];
+        ok = ok && std::fwrite(&t,sizeof(double),1,ctx.fp) == 1;
+        ok = ok && std::fwrite(traces.data(),sizeof(PetscScalar),traces.size(),ctx.fp) == traces.size();
+      }
+      ok = ok && std::fflush(ctx.fp) == 0;
+    }
+    MPI_Bcast(&ok,1,MPIU_INT,0,PETSC_COMM_WORLD);
+    if (!ok) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_WRITE,"Could not write the receiver traces");
+    ctx.n_buffered = 0;
+    PetscTime(&t1);
+    ctx.flush_time += t1 - t0;
+    return 0;
+  }
+
+  /**
+  * Opens the trace file of an earlier run on rank 0 to append to it after a restart from time t_start. Checks that the
+  * file holds the same header, components and receiver coordinates, and truncates it before the first record at time
+  * t_start or later, which also drops a partial record of an interrupted write. The restarted run samples these steps
+  * again. Returns 1 if the file does not exist and -1 if it does not match or can not be opened.
+  **/
+  static int open_for_restart(const std::string path, const FileHeader& header, const std::vector<int64_t>& comps64,
+                              const std::vector<double>& coords64, const PetscReal t_start, FILE*& fp)
+  {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path,ec);
+    if (ec) return 1;
+    FILE *f = std::fopen(path.c_str(),"rb");
+    if (!f) return -1;
+    FileHeader           old;
+    std::vector<int64_t> old_comps(comps64.size());
+    std::vector<double>  old_coords(coords64.size());
+    bool match = std::fread(&old,sizeof(old),1,f) == 1 && std::memcmp(&old,&header,sizeof(header)) == 0;
+    match = match && std::fread(old_comps.data(),sizeof(int64_t),old_comps.size(),f) == old_comps.size();
+    match = match && std::fread(old_coords.data(),sizeof(double),old_coords.size(),f) == old_coords.size();
+    match = match && old_comps == comps64 && old_coords == coords64;
+    const std::uintmax_t record_size = sizeof(double) + header.n_receivers*header.n_comps*sizeof(PetscScalar);
+    std::uintmax_t keep = sizeof(FileHeader) + comps64.size()*sizeof(int64_t) + coords64.size()*sizeof(double);
+    while (match && keep + record_size <= size) {
+      double t;
+      if (std::fseek(f,keep,SEEK_SET) || std::fread(&t,sizeof(double),1,f) != 1) match = false;
+      else if (t >= t_start) break;
+      else keep += record_size;
+    }
+    std::fclose(f);
+    if (!match) return -1;
+    std::filesystem::resize_file(path,keep,ec);
+    if (ec) return -1;
+    fp = std::fopen(path.c_str(),"ab");
+    return fp ? 0 : -1;
+  }
+
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, const std::array<PetscReal,3> xl,
+                        const std::array<PetscReal,3> h, const PetscReal t_start, ReceiverCtx& ctx)
+  {
+    PetscErrorCode ierr;
+    PetscMPIInt    rank, size;
+    PetscInt       comps[64], n_comps = 64, dim;
+    PetscBool      comps_set = PETSC_FALSE, file_set = PETSC_FALSE, restart = PETSC_FALSE;
+    char           file[PETSC_MAX_PATH_LEN];
+    std::array<PetscInt,3> N, start, n, gstart, gn;
+    std::vector<PetscReal> coords;
+
+    ctx.soa = soa;
+    ctx.folder = folder + "/receivers";
+    ierr = PetscOptionsGetString(NULL,NULL,"-receivers",file,sizeof(file),&file_set);CHKERRQ(ierr);
+    ierr = PetscOptionsGetIntArray(NULL,NULL,"-receiver_components",comps,&n_comps,&comps_set);CHKERRQ(ierr);
+    ierr = PetscOptionsGetInt(NULL,NULL,"-receiver_interval",&ctx.interval,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetInt(NULL,NULL,"-receiver_buffer",&ctx.buffer_steps,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetBool(NULL,NULL,"-restart",&restart,NULL);CHKERRQ(ierr);
+    ctx.interval = PetscMax(ctx.interval,1);
+    ctx.buffer_steps = PetscMax(ctx.buffer_steps,1);
+    if (!file_set) return 0;
+
+    MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+    MPI_Comm_size(PETSC_COMM_WORLD,&size);
+    DMDAGetInfo(da,&dim,&N[0],&N[1],&N[2],NULL,NULL,NULL,&ctx.dof,NULL,NULL,NULL,NULL,NULL);
+    DMDAGetCorners(da,&start[0],&start[1],&start[2],&n[0],&n[1],&n[2]);
+    DMDAGetGhostCorners(da,&gstart[0],&gstart[1],&gstart[2],&gn[0],&gn[1],&gn[2]);
+    ctx.gnp = gn[0]*gn[1]*gn[2];
+    if (comps_set) {
+      for (PetscInt c = 0; c < n_comps; c++) {
+        if (comps[c] < 0 || comps[c] >= ctx.dof) {
+          SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"-receiver_components: component out of range");
+        }
+        ctx.comps.push_back(comps[c]);
+      }
+    } else {
+      for (PetscInt c = 0; c < ctx.dof; c++) ctx.comps.push_back(c);
+    }
+    if (read_coordinates(file,dim,coords)) {
+      SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_READ,"-receivers: could not read the receiver coordinates");
+    }
+    ctx.n_receivers = coords.size()/3;
+
+    // Map each receiver to the cell containing it and keep the owned corners of the cell.
+    for (PetscInt r = 0; r < ctx.n_receivers; r++) {
+      std::array<PetscInt,3> i0 = {0, 0, 0};
+      std::array<PetscReal,3> frac = {0, 0, 0};
+      for (PetscInt d = 0; d < dim; d++) {
+        const PetscReal s = (coords[3*r + d] - xl[d])/h[d];
+        if (s < -1e-8 || s > N[d] - 1 + 1e-8) {
+          SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"-receivers: receiver outside of the domain");
+        }
+        i0[d] = PetscMin(PetscMax((PetscInt) std::floor(s),0),PetscMax(N[d] - 2,0));
+        frac[d] = PetscMin(PetscMax(s - i0[d],0),1);
+      }
+      bool is_local = false;
+      for (PetscInt corner = 0; corner < 8; corner++) {
+        std::array<PetscInt,3> i;
+        PetscReal w = 1;
+        bool owned = true;
+        for (PetscInt d = 0; d < 3; d++) {
+          const PetscInt o = (corner >> d) & 1;
+          i[d] = i0[d] + o;
+          w *= o ? frac[d] : 1 - frac[d];
+          owned = owned && i[d] >= start[d] && i[d] < start[d] + n[d];
+        }
+        if (w == 0 || !owned) continue;
+        if (!is_local) {
+          ctx.local.push_back(r);
+          is_local = true;
+        }
+        const PetscInt p = ((i[2] - gstart[2])*gn[1] + i[1] - gstart[1])*gn[0] + i[0] - gstart[0];
+        ctx.corners.push_back({(PetscInt) ctx.local.size() - 1, p, w});
+      }
+    }
+    ctx.buffer.resize(ctx.buffer_steps*ctx.local.size()*ctx.comps.size());
+    ctx.times.resize(ctx.buffer_steps);
+
+    // Global indices of the local receivers of each rank, to sum the partial traces on rank 0
+    PetscMPIInt n_local = ctx.local.size();
+    if (rank == 0) {
+      ctx.counts.resize(size);
+      ctx.displs.resize(size);
+    }
+    MPI_Gather(&n_local,1,MPI_INT,ctx.counts.data(),1,MPI_INT,0,PETSC_COMM_WORLD);
+    if (rank == 0) {
+      for (PetscMPIInt q = 1; q < size; q++) ctx.displs[q] = ctx.displs[q-1] + ctx.counts[q-1];
+      ctx.gathered.resize(ctx.displs[size-1] + ctx.counts[size-1]);
+    }
+    MPI_Gatherv(ctx.local.data(),n_local,MPIU_INT,ctx.gathered.data(),ctx.counts.data(),ctx.displs.data(),MPIU_INT,0,
+                PETSC_COMM_WORLD);
+
+    PetscInt status[2] = {1, 1};                  // File written, restart status of open_for_restart
+    if (rank == 0) {
+      FileHeader header;
+      std::memset(&header,0,sizeof(header));
+      std::strncpy(header.magic,"SBPRECV",sizeof(header.magic));
+      header.dim = dim;
+      header.n_receivers = ctx.n_receivers;
+      header.n_comps = ctx.comps.size();
+      const std::vector<int64_t> comps64(ctx.comps.begin(),ctx.comps.end());
+      const std::vector<double> coords64(coords.begin(),coords.end());
+      const std::string path = ctx.folder + "/traces.bin";
+      std::filesystem::create_directories(ctx.folder);
+      // After a restart, continue the traces of the earlier run instead of truncating them
+      if (restart) status[1] = open_for_restart(path,header,comps64,coords64,t_start,ctx.fp);
+      if (status[1] == 1) {
+        ctx.fp = std::fopen(path.c_str(),"wb");
+        status[0] = ctx.fp != NULL;
+        status[0] = status[0] && std::fwrite(&header,sizeof(header),1,ctx.fp) == 1;
+        status[0] = status[0] && std::fwrite(comps64.data(),sizeof(int64_t),comps64.size(),ctx.fp) == comps64.size();
+        status[0] = status[0] && std::fwrite(coords64.data(),sizeof(double),coords64.size(),ctx.fp) == coords64.size();
+      }
+    }
+    MPI_Bcast(status,2,MPIU_INT,0,PETSC_COMM_WORLD);
+    if (status[1] < 0) {
+      SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_UNEXPECTED,"-restart: the receiver trace file does not match the receivers");
+    }
+    if (!status[0]) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_OPEN,"Could not create the receiver trace file");
+
+    ierr = ts_monitor_add(monitor,&ctx);CHKERRQ(ierr);
+    PetscPrintf(PETSC_COMM_WORLD,"Receivers: %d from %s, %d components every %d steps to %s%s\n",ctx.n_receivers,file,
+                (int)ctx.comps.size(),ctx.interval,ctx.folder.c_str(),status[1] == 0 ? ", appending after the restart" : "");
+    return 0;
+  }
+
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ptr)
+  {
+    PetscErrorCode    ierr;
+    PetscLogDouble    t0, t1;
+    const PetscScalar *arr;
+    ReceiverCtx&      ctx = *(ReceiverCtx*) ptr;
+    const PetscInt    nc = ctx.comps.size();
+
+    if (!ctx.n_receivers || step % ctx.interval) return 0;
+    PetscTime(&t0);
+    PetscScalar *sample = &ctx.buffer[ctx.n_buffered*ctx.local.size()*nc];
+    std::fill(sample,sample + ctx.local.size()*nc,0);
+    ierr = VecGetArrayRead(v,&arr);CHKERRQ(ierr);
+    for (const auto& corner : ctx.corners) {
+      PetscScalar *dst = &sample[corner.receiver*nc];
+      if (ctx.soa) {
+        for (PetscInt c = 0; c < nc; c++) dst[c] += corner.w*arr[ctx.comps[c]*ctx.gnp + corner.p];
+      } else {
+        for (PetscInt c = 0; c < nc; c++) dst[c] += corner.w*arr[corner.p*ctx.dof + ctx.comps[c]];
+      }
+    }
+    ierr = VecRestoreArrayRead(v,&arr);CHKERRQ(ierr);
+    ctx.times[ctx.n_buffered++] = t;
+    ctx.n_samples++;
+    PetscTime(&t1);
+    ctx.sample_time += t1 - t0;
+
+    if (ctx.n_buffered == ctx.buffer_steps) {
+      ierr = flush(ctx);CHKERRQ(ierr);
+    }
+    return 0;
+  }
+
+  PetscErrorCode destroy(ReceiverCtx& ctx)
+  {
+    PetscErrorCode ierr;
+    PetscLogDouble local[2], global[2];
+
+    if (!ctx.n_receivers) return 0;
+    if (ctx.n_buffered) {
+      ierr = flush(ctx);CHKERRQ(ierr);
+    }
+    local[0] = ctx.sample_time;
+    local[1] = ctx.flush_time;
+    MPI_Allreduce(local,global,2,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);
+    PetscPrintf(PETSC_COMM_WORLD,"Receivers: %d samples of %d receivers. Sampling %.3e s per sample, flushing %.3e s in total (max over ranks)\n",
+                ctx.n_samples,ctx.n_receivers,ctx.n_samples ? global[0]/ctx.n_samples : 0.,global[1]);
+    if (ctx.fp) std::fclose(ctx.fp);
+    ctx.fp = NULL;
+    ierr = ts_monitor_remove(monitor,&ctx);CHKERRQ(ierr);
+    ctx.n_receivers = 0;
+    return 0;
+  }
+}
@@ -0,0 +1,414 @@
+#include <petsc.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <zlib.h>
+#include "util/snapshot.h"
+#include "util/io_util.h"
+#include "grids/create_layout.h"
+#include "time_stepping/ts_monitor.h"
+
+namespace snapshot
+{
+  /**
+  * Byte shuffle of n values of width bytes: byte b of value i is moved to dst[b*n + i], grouping bytes of equal
+  * significance, which makes smooth data compress better.
+  **/
+  static void shuffle(const unsigned char* src, const size_t n, const size_t width, unsigned char* dst)
+  {
+    for (size_t b = 0; b < width; b++) {
+      for (size_t i = 0; i < n; i++) dst[b*n + i] = src[i*width + b];
+    }
+  }
+
+  static void unshuffle(const unsigned char* src, const size_t n, const size_t width, unsigned char* dst)
+  {
+    for (size_t b = 0; b < width; b++) {
+      for (size_t i = 0; i < n; i++) dst[i*width + b] = src[b*n + i];
+    }
+  }
+
+  /**
+  * Compresses the n values x into out. Returns the codec used, which is LOSSLESS if LOSSY was requested but x can not
+  * be quantized with the tolerance. max_error is updated with the largest error of LOSSY.
+  **/
+  static int64_t encode(const PetscScalar* x, const size_t n, const Compression compression, const PetscReal tolerance,
+                        const int level, std::vector<uint64_t>& ints, std::vector<unsigned char>& shuffled,
+                        std::vector<unsigned char>& out, PetscLogDouble& max_error)
+  {
+    int64_t codec = compression;
+    const unsigned char* src = (const unsigned char*) x;
+    if (compression == LOSSY) {
+      // Quantize, then zigzag encode the differences so that small differences of either sign give small integers.
+      const double scale = 1/(2*tolerance);
+      double err = 0;
+      int64_t prev = 0;
+      ints.resize(n);
+      for (size_t i = 0; i < n && codec == LOSSY; i++) {
+        const double r = x[i]*scale;
+        if (!(std::abs(r) < 4e18)) {
+          codec = LOSSLESS;
+          break;
+        }
+        const int64_t q = std::llround(r);
+        const int64_t d = q - prev;
+        prev = q;
+        ints[i] = ((uint64_t) d << 1) ^ (uint64_t) (d >> 63);
+        err = std::max(err,std::abs(q*(2*tolerance) - x[i]));
+      }
+      if (codec == LOSSY) {
+        max_error = std::max(max_error,err);
+        src = (const unsigned char*) ints.data();
+      }
+    }
+    shuffled.resize(n*sizeof(PetscScalar));
+    shuffle(src,n,sizeof(PetscScalar),shuffled.data());
+    uLongf size = compressBound(shuffled.size());
+    out.resize(size);
+    if (compress2(out.data(),&size,shuffled.data(),shuffled.size(),level) != Z_OK) return -1;
+    out.resize(size);
+    return codec;
+  }
+
+  /**
+  * Decompresses in into the n values x.
+  **/
+  static bool decode(const std::vector<unsigned char>& in, const int64_t codec, const PetscReal tolerance, const size_t n,
+                     PetscScalar* x)
+  {
+    std::vector<unsigned char> shuffled(n*sizeof(PetscScalar));
+    uLongf size = shuffled.size();
+    if (uncompress(shuffled.data(),&size,in.data(),in.size()) != Z_OK || size != shuffled.size()) return false;
+    if (codec == LOSSY) {
+      std::vector<uint64_t> ints(n);
+      unshuffle(shuffled.data(),n,sizeof(PetscScalar),(unsigned char*) ints.data());
+      int64_t q = 0;
+      for (size_t i = 0; i < n; i++) {
+        q += (int64_t) (ints[i] >> 1) ^ -(int64_t) (ints[i] & 1);
+        x[i] = q*(2*tolerance);
+      }
+    } else {
+      unshuffle(shuffled.data(),n,sizeof(PetscScalar),(unsigned char*) x);
+    }
+    return true;
+  }
+
+  /**
+  * Writes the buffer b to its file, compressing it if requested. Called by the writer thread.
+  **/
+  static bool write_buffer(SnapshotCtx& ctx, const Buffer& b)
+  {
+    char file[PETSC_MAX_PATH_LEN];
+    std::snprintf(file,sizeof(file),"%s/step%06d_rank%04d.bin",ctx.folder.c_str(),(int)b.step,(int)ctx.rank);
+
+    FileHeader header;
+    std::memset(&header,0,sizeof(header));
+    std::strncpy(header.magic,"SBPSNAP",sizeof(header.magic));
+    header.step = b.step;
+    header.t = b.t;
+    header.dim = ctx.dim;
+    header.n_comps = ctx.comps.size();
+    header.compression = ctx.compression;
+    header.tolerance = ctx.tolerance;
+    for (PetscInt d = 0; d < 3; d++) {
+      header.N[d] = ctx.N[d];
+      header.start[d] = ctx.start[d];
+      header.n[d] = ctx.n[d];
+    }
+    const std::vector<int64_t> comps(ctx.comps.begin(),ctx.comps.end());
+
+    // Compress each component
+    const size_t np = ctx.n[0]*ctx.n[1]*ctx.n[2];
+    std::vector<int64_t> table;
+    std::vector<std::vector<unsigned char>> streams;
+    if (ctx.compression != NONE) {
+      PetscLogDouble t0, t1;
+      std::vector<uint64_t> ints;
+      std::vector<unsigned char> shuffled;
+      PetscTime(&t0);
+      streams.resize(comps.size());
+      for (size_t c = 0; c < comps.size(); c++) {
+        const int64_t codec = encode(&b.data[c*np],np,ctx.compression,ctx.tolerance,ctx.level,ints,shuffled,streams[c],ctx.max_error);
+        if (codec == -1) return false;
+        table.push_back(codec);
+        table.push_back(streams[c].size());
+      }
+      PetscTime(&t1);
+      ctx.compress_time += t1 - t0;
+    }
+
+    FILE *f = std::fopen(file,"wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&header,sizeof(header),1,f) == 1;
+    ok = ok && std::fwrite(comps.data(),sizeof(int64_t),comps.size(),f) == comps.size();
+    size_t stored = 0;
+    if (ctx.compression == NONE) {
+      ok = ok && std::fwrite(b.data.data(),sizeof(PetscScalar),b.data.size(),f) == b.data.size();
+      stored = b.data.size()*sizeof(PetscScalar);
+    } else {
+      ok = ok && std::fwrite(table.data(),sizeof(int64_t),table.size(),f) == table.size();
+      for (const auto& stream : streams) {
+        ok = ok && std::fwrite(stream.data(),1,stream.size(),f) == stream.size();
+        stored += stream.size();
+      }
+    }
+    ctx.stored_bytes += stored;
+    return std::fclose(f) == 0 && ok;
+  }
+
+  /**
+  * Writer thread. Drains the buffers in the order they are filled, until destroy is called and both are empty.
+  **/
+  static void writer_loop(SnapshotCtx* ctx)
+  {
+    PetscInt k = 0;
+    for (;;) {
+      std::unique_lock<std::mutex> lock(ctx->mutex);
+      ctx->cv.wait(lock,[&]{ return ctx->buffers[k].full || ctx->done; });
+      if (!ctx->buffers[k].full) break;
+      lock.unlock();
+
+      PetscLogDouble t0, t1;
+      PetscTime(&t0);
+      const bool ok = write_buffer(*ctx,ctx->buffers[k]);
+      PetscTime(&t1);
+
+      lock.lock();
+      ctx->write_time += t1 - t0;
+      ctx->bytes += ctx->buffers[k].data.size()*sizeof(PetscScalar);
+      ctx->write_failed = ctx->write_failed || !ok;
+      ctx->buffers[k].full = false;
+      lock.unlock();
+      ctx->cv.notify_all();
+      k = 1 - k;
+    }
+  }
+
+  /**
+  * Copies the selected components of the inner points of the local vector v into data, component-major.
+  **/
+  static PetscErrorCode pack(const SnapshotCtx& ctx, const Vec v, std::vector<PetscScalar>& data)
+  {
+    PetscErrorCode    ierr;
+    const PetscScalar *arr;
+    const PetscInt    nc = ctx.comps.size();
+    const PetscInt    np = ctx.n[0]*ctx.n[1]*ctx.n[2];
+    const PetscInt    gnp = ctx.gn[0]*ctx.gn[1]*ctx.gn[2];
+
+    ierr = VecGetArrayRead(v,&arr);CHKERRQ(ierr);
+    #pragma omp parallel for collapse(3) schedule(static)
+    for (PetscInt c = 0; c < nc; c++) {
+      for (PetscInt k = 0; k < ctx.n[2]; k++) {
+        for (PetscInt j = 0; j < ctx.n[1]; j++) {
+          const PetscInt comp = ctx.comps[c];
+          // Local (ghosted) index of the first point of the row
+          const PetscInt p = ((k + ctx.start[2] - ctx.gstart[2])*ctx.gn[1] + j + ctx.start[1] - ctx.gstart[1])*ctx.gn[0]
+                             + ctx.start[0] - ctx.gstart[0];
+          PetscScalar *dst = &data[c*np + (k*ctx.n[1] + j)*ctx.n[0]];
+          if (ctx.soa) {
+            for (PetscInt i = 0; i < ctx.n[0]; i++) dst[i] = arr[comp*gnp + p + i];
+          } else {
+            for (PetscInt i = 0; i < ctx.n[0]; i++) dst[i] = arr[(p + i)*ctx.dof + comp];
+          }
+        }
+      }
+    }
+    ierr = VecRestoreArrayRead(v,&arr);CHKERRQ(ierr);
+    return 0;
+  }
+
+  PetscErrorCode create(const DM da, const PetscBool soa, const std::string folder, const PetscReal discretization_error,
+                        SnapshotCtx& ctx)
+  {
+    PetscErrorCode    ierr;
+    PetscInt          comps[64], n_comps = 64, compression = NONE;
+    PetscBool         comps_set = PETSC_FALSE;
+    const char *const compressions[] = {"none", "lossless", "lossy"};
+
+    ctx.da = da;
+    ctx.soa = soa;
+    ctx.sync = PETSC_FALSE;
+    ctx.global = NULL;
+    ctx.local_aos = NULL;
+    ctx.folder = folder + "/snapshots";
+    ierr = PetscOptionsGetInt(NULL,NULL,"-snapshot_interval",&ctx.interval,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetBool(NULL,NULL,"-snapshot_sync",&ctx.sync,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetIntArray(NULL,NULL,"-snapshot_components",comps,&n_comps,&comps_set);CHKERRQ(ierr);
+    ierr = PetscOptionsGetEList(NULL,NULL,"-snapshot_compression",compressions,3,&compression,NULL);CHKERRQ(ierr);
+    ctx.tolerance = 0.1*discretization_error;
+    ierr = PetscOptionsGetReal(NULL,NULL,"-snapshot_tolerance",&ctx.tolerance,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetInt(NULL,NULL,"-snapshot_compression_level",&ctx.level,NULL);CHKERRQ(ierr);
+    ctx.compression = ctx.sync ? NONE : (Compression) compression;
+    ctx.level = PetscMin(PetscMax(ctx.level,1),9);
+    if (ctx.compression == LOSSY && !(ctx.tolerance > 0)) {
+      SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"-snapshot_tolerance must be positive");
+    }
+    if (ctx.interval <= 0) {
+      ctx.interval = 0;
+      return 0;
+    }
+
+    MPI_Comm_rank(PETSC_COMM_WORLD,&ctx.rank);
+    DMDAGetInfo(da,&ctx.dim,&ctx.N[0],&ctx.N[1],&ctx.N[2],NULL,NULL,NULL,&ctx.dof,NULL,NULL,NULL,NULL,NULL);
+    DMDAGetCorners(da,&ctx.start[0],&ctx.start[1],&ctx.start[2],&ctx.n[0],&ctx.n[1],&ctx.n[2]);
+    DMDAGetGhostCorners(da,&ctx.gstart[0],&ctx.gstart[1],&ctx.gstart[2],&ctx.gn[0],&ctx.gn[1],&ctx.gn[2]);
+    if (comps_set) {
+      for (PetscInt c = 0; c < n_comps; c++) {
+        if (comps[c] < 0 || comps[c] >= ctx.dof) {
+          SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"-snapshot_components: component out of range");
+        }
+        ctx.comps.push_back(comps[c]);
+      }
+    } else {
+      for (PetscInt c = 0; c < ctx.dof; c++) ctx.comps.push_back(c);
+    }
+
+    if (ctx.sync) {
+      ierr = DMCreateGlobalVector(da,&ctx.global);CHKERRQ(ierr);
+      if (soa) {
+        ierr = DMCreateLocalVector(da,&ctx.local_aos);CHKERRQ(ierr);
+      }
+    } else {
+      std::filesystem::create_directories(ctx.folder);
+      for (auto& b : ctx.buffers) b.data.resize(ctx.comps.size()*ctx.n[0]*ctx.n[1]*ctx.n[2]);
+      ctx.writer = std::thread(writer_loop,&ctx);
+    }
+    ierr = ts_monitor_add(monitor,&ctx);CHKERRQ(ierr);
+    PetscPrintf(PETSC_COMM_WORLD,"Snapshots every %d steps of %d components to %s (%s)\n",ctx.interval,(int)ctx.comps.size(),
+                ctx.folder.c_str(),ctx.sync ? "synchronous VecView" : "background writer");
+    if (ctx.compression == LOSSY) {
+      PetscPrintf(PETSC_COMM_WORLD,"Snapshots: lossy compression, tolerance %.3e\n",ctx.tolerance);
+    } else if (ctx.compression == LOSSLESS) {
+      PetscPrintf(PETSC_COMM_WORLD,"Snapshots: lossless compression\n");
+    }
+    return 0;
+  }
+
+  PetscErrorCode monitor(PetscInt step, PetscReal t, Vec v, void* ptr)
+  {
+    PetscErrorCode ierr;
+    PetscLogDouble t0, t1;
+    SnapshotCtx&   ctx = *(SnapshotCtx*) ptr;
+
+    if (!ctx.interval || step % ctx.interval) return 0;
+    PetscTime(&t0);
+    if (ctx.sync) {
+      Vec vlocal = v;
+      if (ctx.soa) {
+        ierr = grid::local_soa_to_aos(ctx.da,v,ctx.local_aos);CHKERRQ(ierr);
+        vlocal = ctx.local_aos;
+      }
+      ierr = DMLocalToGlobalBegin(ctx.da,vlocal,INSERT_VALUES,ctx.global);CHKERRQ(ierr);
+      ierr = DMLocalToGlobalEnd(ctx.da,vlocal,INSERT_VALUES,ctx.global);CHKERRQ(ierr);
+      char file[64];
+      std::snprintf(file,sizeof(file),"step%06d",(int)step);
+      ierr = write_vector_to_binary(ctx.global,ctx.folder,file);CHKERRQ(ierr);
+    } else {
+      // Wait until the writer thread has drained the buffer, then fill it and hand it over.
+      Buffer& b = ctx.buffers[ctx.next];
+      {
+        std::unique_lock<std::mutex> lock(ctx.mutex);
+        ctx.cv.wait(lock,[&]{ return !b.full; });
+      }
+      ierr = pack(ctx,v,b.data);CHKERRQ(ierr);
+      b.step = step;
+      b.t = t;
+      {
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        b.full = true;
+      }
+      ctx.cv.notify_all();
+      ctx.next = 1 - ctx.next;
+    }
+    PetscTime(&t1);
+    ctx.stall += t1 - t0;
+    ctx.stall_max = PetscMax(ctx.stall_max,t1 - t0);
+    ctx.count++;
+    return 0;
+  }
+
+  PetscErrorCode destroy(SnapshotCtx& ctx)
+  {
+    PetscErrorCode ierr;
+    PetscLogDouble t0, t1, local[3], global[3];
+
+    if (!ctx.interval) return 0;
+    // Time spent waiting for the last snapshots after the time stepping
+    PetscTime(&t0);
+    if (ctx.writer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        ctx.done = true;
+      }
+      ctx.cv.notify_all();
+      ctx.writer.join();
+    }
+    PetscTime(&t1);
+
+    local[0] = ctx.stall;
+    local[1] = ctx.stall_max;
+    local[2] = t1 - t0;
+    MPI_Allreduce(local,global,3,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);
+    PetscPrintf(PETSC_COMM_WORLD,"Snapshots: %d written (%s). Stall per snapshot: mean %.3e s, max %.3e s. Final drain: %.3e s (max over ranks)\n",
+                ctx.count,ctx.sync ? "synchronous VecView" : "background writer",ctx.count ? global[0]/ctx.count : 0.,global[1],global[2]);
+    if (!ctx.sync) {
+      local[0] = ctx.write_time;
+      local[1] = ctx.bytes;
+      MPI_Allreduce(local,global,2,MPI_DOUBLE,MPI_SUM,PETSC_COMM_WORLD);
+      PetscPrintf(PETSC_COMM_WORLD,"Snapshots: background write time %.3e s summed over ranks, %.3e MB/s per rank\n",
+                  global[0],global[0] > 0 ? 1e-6*global[1]/global[0] : 0.);
+    }
+    if (ctx.compression != NONE) {
+      local[0] = ctx.compress_time;
+      local[1] = ctx.bytes;
+      local[2] = ctx.stored_bytes;
+      MPI_Allreduce(local,global,3,MPI_DOUBLE,MPI_SUM,PETSC_COMM_WORLD);
+      PetscPrintf(PETSC_COMM_WORLD,"Snapshots: compression ratio %.2f, compression %.3e MB/s per rank\n",
+                  global[2] > 0 ? global[1]/global[2] : 0.,global[0] > 0 ? 1e-6*global[1]/global[0] : 0.);
+      if (ctx.compression == LOSSY) {
+        MPI_Allreduce(&ctx.max_error,&global[0],1,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);
+        PetscPrintf(PETSC_COMM_WORLD,"Snapshots: max pointwise error %.3e (tolerance %.3e)\n",global[0],ctx.tolerance);
+      }
+    }
+    PetscInt failed = ctx.write_failed, any_failed;
+    MPI_Allreduce(&failed,&any_failed,1,MPIU_INT,MPI_MAX,PETSC_COMM_WORLD);
+    if (any_failed) PetscPrintf(PETSC_COMM_WORLD,"Warning: some snapshots could not be written to %s.\n",ctx.folder.c_str());
+
+    ierr = VecDestroy(&ctx.global);CHKERRQ(ierr);
+    ierr = VecDestroy(&ctx.local_aos);CHKERRQ(ierr);
+    ierr = ts_monitor_remove(monitor,&ctx);CHKERRQ(ierr);
+    ctx.interval = 0;
+    return 0;
+  }
+
+  PetscErrorCode read(const std::string path, FileHeader& header, std::vector<int64_t>& comps, std::vector<PetscScalar>& data)
+  {
+    FILE *f = std::fopen(path.c_str(),"rb");
+    if (!f) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_OPEN,"Could not open the snapshot file");
+    bool ok = std::fread(&header,sizeof(header),1,f) == 1 && std::strncmp(header.magic,"SBPSNAP",sizeof(header.magic)) == 0
+              && header.n_comps >= 0 && header.n_comps <= 64;
+    const size_t np = ok ? header.n[0]*header.n[1]*header.n[2] : 0;
+    if (ok) {
+      comps.resize(header.n_comps);
+      data.resize(header.n_comps*np);
+      ok = std::fread(comps.data(),sizeof(int64_t),comps.size(),f) == comps.size();
+    }
+    if (ok && header.compression == NONE) {
+      ok = std::fread(data.data(),sizeof(PetscScalar),data.size(),f) == data.size();
+    } else if (ok) {
+      std::vector<int64_t> table(2*header.n_comps);
+      std::vector<unsigned char> stream;
+      ok = std::fread(table.data(),sizeof(int64_t),table.size(),f) == table.size();
+      for (int64_t c = 0; ok && c < header.n_comps; c++) {
+        stream.resize(table[2*c+1]);
+        ok = std::fread(stream.data(),1,stream.size(),f) == stream.size()
+             && decode(stream,table[2*c],header.tolerance,np,&data[c*np]);
+      }
+    }
+    std::fclose(f);
+    if (!ok) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_UNEXPECTED,"Not a valid snapshot file");
+    return 0;
+  }
+}
@@ -0,0 +1,104 @@
+#include <petsc.h>
+#include <vector>
+#include "util/threads.h"
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace threads
+{
+  enum Pinning {NONE, COMPACT, SPREAD};
+
+  /**
+  * Pins the threads of the rank to the cores in the affinity mask of the process. The cores
+  * available to the rank are typically restricted by the MPI launcher (e.g mpirun --bind-to socket),
+  * so that the threads of different ranks do not compete for the same cores.
+  **/
+  static PetscErrorCode pin_threads(const Pinning pinning)
+  {
+#if defined(__linux__) && defined(_OPENMP)
+    cpu_set_t mask;
+    if (sched_getaffinity(0,sizeof(mask),&mask)) {
+      PetscPrintf(PETSC_COMM_WORLD,"Warning: could not get the cpu affinity, threads are not pinned.\n");
+      return 0;
+    }
+    std::vector<int> cores;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+      if (CPU_ISSET(c,&mask))
+        cores.push_back(c);
+    }
+    const PetscInt nc = cores.size();
+    PetscInt n_failed = 0;
+    #pragma omp parallel reduction(+:n_failed)
+    {
+      const PetscInt t = omp_get_thread_num();
+      const PetscInt nt = omp_get_num_threads();
+      const PetscInt c = (pinning == COMPACT) ? t % nc : ((t*nc)/nt) % nc;
+      cpu_set_t thread_mask;
+      CPU_ZERO(&thread_mask);
+      CPU_SET(cores[c],&thread_mask);
+      if (sched_setaffinity(0,sizeof(thread_mask),&thread_mask))
+        n_failed++;
+    }
+    if (n_failed)
+      PetscPrintf(PETSC_COMM_SELF,"Warning: could not pin %d threads.\n",n_failed);
+#else
+    PetscPrintf(PETSC_COMM_WORLD,"Warning: thread pinning is not supported on this platform.\n");
+#endif
+    return 0;
+  }
+
+  PetscErrorCode setup()
+  {
+    PetscErrorCode ierr;
+    PetscInt n_threads = 1;
+    PetscInt pinning = NONE;
+    PetscBool set = PETSC_FALSE;
+    const char *const pinnings[] = {"none","compact","spread"};
+
+    ierr = PetscOptionsGetInt(NULL,NULL,"-threads",&n_threads,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsGetEList(NULL,NULL,"-thread_pinning",pinnings,3,&pinning,&set);CHKERRQ(ierr);
+    if (n_threads < 1) {
+      PetscPrintf(PETSC_COMM_WORLD,"Invalid number of threads %d.\n",n_threads);
+      return -1;
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(n_threads);
+#else
+    if (n_threads > 1)
+      PetscPrintf(PETSC_COMM_WORLD,"Warning: compiled without OpenMP, running with a single thread per rank.\n");
+#endif
+    if (pinning != NONE) {
+      ierr = pin_threads(static_cast<Pinning>(pinning));CHKERRQ(ierr);
+    }
+    PetscPrintf(PETSC_COMM_WORLD,"Threads per rank: %d, pinning: %s\n",num_threads(),pinnings[pinning]);
+    return 0;
+  }
+
+  PetscErrorCode first_touch(Vec v, const PetscInt n_blocks)
+  {
+    PetscErrorCode ierr;
+    PetscScalar *array;
+    PetscInt n;
+    ierr = VecGetLocalSize(v,&n);CHKERRQ(ierr);
+    ierr = PetscMalloc1(n,&array);CHKERRQ(ierr);
+    const PetscInt block = n/n_blocks;
+    #pragma omp parallel
+    {
+#ifdef _OPENMP
+      const PetscInt t = omp_get_thread_num(), nt = omp_get_num_threads();
+#else
+      const PetscInt t = 0, nt = 1;
+#endif
+      for (PetscInt b = 0; b < n_blocks; b++) {
+        const std::array<PetscInt,2> ind = band({b*block,(b+1)*block}, t, nt);
+        for (PetscInt i = ind[0]; i < ind[1]; i++) {
+          array[i] = 0;
+        }
+      }
+    }
+    // v takes ownership of array, the previous array is freed.
+    ierr = VecReplaceArray(v,array);CHKERRQ(ierr);
+    return 0;
+  }
+}